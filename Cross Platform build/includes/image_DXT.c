@@ -5,6 +5,12 @@
 	simple DXT compression / decompression code
 
 	public domain
+
+	The block encoder was later rewritten for speed: palette matching runs
+	on AVX2 or SSE2 where the compiler targets them (scalar otherwise),
+	endpoints come from one of three quality levels, and
+	convert_image_rows_to_DXT compresses a band of block rows so callers
+	can spread an image across threads.
 */
 
 #include "image_DXT.h"
@@ -13,31 +19,44 @@
 #include <string.h>
 #include <stdio.h>
 
-/*	set this =1 if you want to use the covariance matrix method...
-	which is better than my method of using standard deviations
-	overall, except on the infinitesimal chance that the power
-	method fails for finding the largest eigenvector	*/
-#define USE_COV_MAT	1
+/*	AVX2 only when the compiler targets it; SSE2 on every x86-64 target	*/
+#if defined(__AVX2__)
+#define DXT_AVX2	1
+#include <immintrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DXT_SSE2	1
+#include <emmintrin.h>
+#endif
 
 /********* Function Prototypes *********/
 /*
-	Takes a 4x4 block of pixels and compresses it into 8 bytes
-	in DXT1 format (color only, no alpha).  Speed is valued
-	over prettiness, at least for now.
+	Copies the 4x4 block at block (bx, by) as 16 RGBA pixels, repeating
+	the image's last row and column past its edges.  Grey images fill R, G
+	and B; images without alpha get 255.
 */
-void compress_DDS_color_block(
-				int channels,
+static void load_block(
 				const unsigned char *const uncompressed,
+				int width, int height, int channels,
+				int bx, int by,
+				unsigned char block[64] );
+/*
+	Takes a 4x4 block of RGBA pixels and compresses the color into 8
+	bytes in DXT1 format (also the color half of a DXT5 block).
+*/
+static void compress_color_block(
+				const unsigned char block[64],
+				int quality,
 				unsigned char compressed[8] );
 /*
-	Takes a 4x4 block of pixels and compresses the alpha
+	Takes a 4x4 block of RGBA pixels and compresses the alpha
 	component it into 8 bytes for use in DXT5 DDS files.
-	Speed is valued over prettiness, at least for now.
 */
-void compress_DDS_alpha_block(
-				const unsigned char *const uncompressed,
+static void compress_alpha_block(
+				const unsigned char block[64],
 				unsigned char compressed[8] );
 
+/********* Actual Exposed Functions *********/
 /********* Actual Exposed Functions *********/
 int
 	save_image_as_DDS
@@ -98,17 +117,13 @@ int
 	return 1;
 }
 
+
 unsigned char* convert_image_to_DXT1(
 		const unsigned char *const uncompressed,
 		int width, int height, int channels,
 		int *out_size )
 {
 	unsigned char *compressed;
-	int i, j, x, y;
-	unsigned char ublock[16*3];
-	unsigned char cblock[8];
-	int index = 0, chan_step = 1;
-	int block_count = 0;
 	/*	error check	*/
 	*out_size = 0;
 	if( (width < 1) || (height < 1) ||
@@ -117,65 +132,12 @@ unsigned char* convert_image_to_DXT1(
 	{
 		return NULL;
 	}
-	/*	for channels == 1 or 2, I do not step forward for R,G,B values	*/
-	if( channels < 3 )
-	{
-		chan_step = 0;
-	}
 	/*	get the RAM for the compressed image
 		(8 bytes per 4x4 pixel block)	*/
 	*out_size = ((width+3) >> 2) * ((height+3) >> 2) * 8;
 	compressed = (unsigned char*)malloc( *out_size );
-	/*	go through each block	*/
-	for( j = 0; j < height; j += 4 )
-	{
-		for( i = 0; i < width; i += 4 )
-		{
-			/*	copy this block into a new one	*/
-			int idx = 0;
-			int mx = 4, my = 4;
-			if( j+4 >= height )
-			{
-				my = height - j;
-			}
-			if( i+4 >= width )
-			{
-				mx = width - i;
-			}
-			for( y = 0; y < my; ++y )
-			{
-				for( x = 0; x < mx; ++x )
-				{
-					ublock[idx++] = uncompressed[(j+y)*width*channels+(i+x)*channels];
-					ublock[idx++] = uncompressed[(j+y)*width*channels+(i+x)*channels+chan_step];
-					ublock[idx++] = uncompressed[(j+y)*width*channels+(i+x)*channels+chan_step+chan_step];
-				}
-				for( x = mx; x < 4; ++x )
-				{
-					ublock[idx++] = ublock[0];
-					ublock[idx++] = ublock[1];
-					ublock[idx++] = ublock[2];
-				}
-			}
-			for( y = my; y < 4; ++y )
-			{
-				for( x = 0; x < 4; ++x )
-				{
-					ublock[idx++] = ublock[0];
-					ublock[idx++] = ublock[1];
-					ublock[idx++] = ublock[2];
-				}
-			}
-			/*	compress the block	*/
-			++block_count;
-			compress_DDS_color_block( 3, ublock, cblock );
-			/*	copy the data from the block into the main block	*/
-			for( x = 0; x < 8; ++x )
-			{
-				compressed[index++] = cblock[x];
-			}
-		}
-	}
+	convert_image_rows_to_DXT( uncompressed, width, height, channels,
+		0, DXT_QUALITY_NORMAL, 0, (height+3) >> 2, compressed );
 	return compressed;
 }
 
@@ -185,11 +147,6 @@ unsigned char* convert_image_to_DXT5(
 		int *out_size )
 {
 	unsigned char *compressed;
-	int i, j, x, y;
-	unsigned char ublock[16*4];
-	unsigned char cblock[8];
-	int index = 0, chan_step = 1;
-	int block_count = 0, has_alpha;
 	/*	error check	*/
 	*out_size = 0;
 	if( (width < 1) || (height < 1) ||
@@ -198,435 +155,652 @@ unsigned char* convert_image_to_DXT5(
 	{
 		return NULL;
 	}
-	/*	for channels == 1 or 2, I do not step forward for R,G,B vales	*/
-	if( channels < 3 )
-	{
-		chan_step = 0;
-	}
-	/*	# channels = 1 or 3 have no alpha, 2 & 4 do have alpha	*/
-	has_alpha = 1 - (channels & 1);
 	/*	get the RAM for the compressed image
 		(16 bytes per 4x4 pixel block)	*/
 	*out_size = ((width+3) >> 2) * ((height+3) >> 2) * 16;
 	compressed = (unsigned char*)malloc( *out_size );
-	/*	go through each block	*/
-	for( j = 0; j < height; j += 4 )
+	convert_image_rows_to_DXT( uncompressed, width, height, channels,
+		1, DXT_QUALITY_NORMAL, 0, (height+3) >> 2, compressed );
+	return compressed;
+}
+
+int convert_image_rows_to_DXT(
+		const unsigned char *const uncompressed,
+		int width, int height, int channels,
+		int dxt5, int quality,
+		int first_block_row, int block_row_count,
+		unsigned char *compressed )
+{
+	int bx, by, last_block_row;
+	const int blocks_wide = (width+3) >> 2;
+	const size_t block_bytes = dxt5 ? 16 : 8;
+	unsigned char block[64];
+	/*	error check	*/
+	if( (width < 1) || (height < 1) ||
+		(NULL == uncompressed) || (NULL == compressed) ||
+		(channels < 1) || (channels > 4) ||
+		(first_block_row < 0) || (block_row_count < 0) )
+	{
+		return 0;
+	}
+	last_block_row = first_block_row + block_row_count;
+	if( last_block_row > ((height+3) >> 2) )
 	{
-		for( i = 0; i < width; i += 4 )
+		last_block_row = (height+3) >> 2;
+	}
+	for( by = first_block_row; by < last_block_row; ++by )
+	{
+		unsigned char *out = compressed + (size_t)by * blocks_wide * block_bytes;
+		for( bx = 0; bx < blocks_wide; ++bx )
 		{
-			/*	local variables, and my block counter	*/
-			int idx = 0;
-			int mx = 4, my = 4;
-			if( j+4 >= height )
-			{
-				my = height - j;
-			}
-			if( i+4 >= width )
-			{
-				mx = width - i;
-			}
-			for( y = 0; y < my; ++y )
+			load_block( uncompressed, width, height, channels, bx, by, block );
+			if( dxt5 )
 			{
-				for( x = 0; x < mx; ++x )
-				{
-					ublock[idx++] = uncompressed[(j+y)*width*channels+(i+x)*channels];
-					ublock[idx++] = uncompressed[(j+y)*width*channels+(i+x)*channels+chan_step];
-					ublock[idx++] = uncompressed[(j+y)*width*channels+(i+x)*channels+chan_step+chan_step];
-					ublock[idx++] =
-						has_alpha * uncompressed[(j+y)*width*channels+(i+x)*channels+channels-1]
-						+ (1-has_alpha)*255;
-				}
-				for( x = mx; x < 4; ++x )
-				{
-					ublock[idx++] = ublock[0];
-					ublock[idx++] = ublock[1];
-					ublock[idx++] = ublock[2];
-					ublock[idx++] = ublock[3];
-				}
+				compress_alpha_block( block, out );
+				out += 8;
 			}
-			for( y = my; y < 4; ++y )
+			compress_color_block( block, quality, out );
+			out += 8;
+		}
+	}
+	return 1;
+}
+
+/********* Helper Functions *********/
+static void load_block(
+		const unsigned char *const uncompressed,
+		int width, int height, int channels,
+		int bx, int by,
+		unsigned char block[64] )
+{
+	int x, y, i = 0;
+	for( y = 0; y < 4; ++y )
+	{
+		const unsigned char *row;
+		int py = by * 4 + y;
+		if( py >= height )
+		{
+			py = height - 1;
+		}
+		row = uncompressed + (size_t)py * width * channels;
+		for( x = 0; x < 4; ++x )
+		{
+			const unsigned char *p;
+			int px = bx * 4 + x;
+			if( px >= width )
 			{
-				for( x = 0; x < 4; ++x )
-				{
-					ublock[idx++] = ublock[0];
-					ublock[idx++] = ublock[1];
-					ublock[idx++] = ublock[2];
-					ublock[idx++] = ublock[3];
-				}
+				px = width - 1;
 			}
-			/*	now compress the alpha block	*/
-			compress_DDS_alpha_block( ublock, cblock );
-			/*	copy the data from the compressed alpha block into the main buffer	*/
-			for( x = 0; x < 8; ++x )
+			p = row + px * channels;
+			if( channels >= 3 )
 			{
-				compressed[index++] = cblock[x];
-			}
-			/*	then compress the color block	*/
-			++block_count;
-			compress_DDS_color_block( 4, ublock, cblock );
-			/*	copy the data from the compressed color block into the main buffer	*/
-			for( x = 0; x < 8; ++x )
+				block[i+0] = p[0];
+				block[i+1] = p[1];
+				block[i+2] = p[2];
+			} else
 			{
-				compressed[index++] = cblock[x];
+				block[i+0] = block[i+1] = block[i+2] = p[0];
 			}
+			/*	# channels = 1 or 3 have no alpha, 2 & 4 do have alpha	*/
+			block[i+3] = (channels & 1) ? 255 : p[channels-1];
+			i += 4;
 		}
 	}
-	return compressed;
 }
 
-/********* Helper Functions *********/
-int convert_bit_range( int c, int from_bits, int to_bits )
+static int clamp_255( int c )
 {
-	int b = (1 << (from_bits - 1)) + c * ((1 << to_bits) - 1);
-	return (b + (b >> from_bits)) >> from_bits;
+	return c < 0 ? 0 : (c > 255 ? 255 : c);
 }
 
-int rgb_to_565( int r, int g, int b )
+static int rgb_to_565( const int c[3] )
 {
 	return
-		(convert_bit_range( r, 8, 5 ) << 11) |
-		(convert_bit_range( g, 8, 6 ) << 05) |
-		(convert_bit_range( b, 8, 5 ) << 00);
+		(((clamp_255( c[0] ) * 31 + 127) / 255) << 11) |
+		(((clamp_255( c[1] ) * 63 + 127) / 255) << 5) |
+		(((clamp_255( c[2] ) * 31 + 127) / 255) << 0);
 }
 
-void rgb_888_from_565( unsigned int c, int *r, int *g, int *b )
+/*	bit replication, which is what the hardware expands 565 with	*/
+static void rgb_888_from_565( int c, int rgb[3] )
 {
-	*r = convert_bit_range( (c >> 11) & 31, 5, 8 );
-	*g = convert_bit_range( (c >> 05) & 63, 6, 8 );
-	*b = convert_bit_range( (c >> 00) & 31, 5, 8 );
+	int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+	rgb[0] = (r << 3) | (r >> 2);
+	rgb[1] = (g << 2) | (g >> 4);
+	rgb[2] = (b << 3) | (b >> 2);
 }
 
-void compute_color_line_STDEV(
-		const unsigned char *const uncompressed,
-		int channels,
-		float point[3], float direction[3] )
+#if defined(DXT_SSE2)
+/*	R, G and B of the block as 16-bit lanes, pixels 0-7 and 8-15	*/
+static void block_planes(
+		const unsigned char block[64],
+		__m128i r[2], __m128i g[2], __m128i b[2] )
 {
-	const float inv_16 = 1.0f / 16.0f;
-	int i;
-	float sum_r = 0.0f, sum_g = 0.0f, sum_b = 0.0f;
-	float sum_rr = 0.0f, sum_gg = 0.0f, sum_bb = 0.0f;
-	float sum_rg = 0.0f, sum_rb = 0.0f, sum_gb = 0.0f;
-	/*	calculate all data needed for the covariance matrix
-		( to compare with _rygdxt code)	*/
-	for( i = 0; i < 16*channels; i += channels )
-	{
-		sum_r += uncompressed[i+0];
-		sum_rr += uncompressed[i+0] * uncompressed[i+0];
-		sum_g += uncompressed[i+1];
-		sum_gg += uncompressed[i+1] * uncompressed[i+1];
-		sum_b += uncompressed[i+2];
-		sum_bb += uncompressed[i+2] * uncompressed[i+2];
-		sum_rg += uncompressed[i+0] * uncompressed[i+1];
-		sum_rb += uncompressed[i+0] * uncompressed[i+2];
-		sum_gb += uncompressed[i+1] * uncompressed[i+2];
-	}
-	/*	convert the sums to averages	*/
-	sum_r *= inv_16;
-	sum_g *= inv_16;
-	sum_b *= inv_16;
-	/*	and convert the squares to the squares of the value - avg_value	*/
-	sum_rr -= 16.0f * sum_r * sum_r;
-	sum_gg -= 16.0f * sum_g * sum_g;
-	sum_bb -= 16.0f * sum_b * sum_b;
-	sum_rg -= 16.0f * sum_r * sum_g;
-	sum_rb -= 16.0f * sum_r * sum_b;
-	sum_gb -= 16.0f * sum_g * sum_b;
-	/*	the point on the color line is the average	*/
-	point[0] = sum_r;
-	point[1] = sum_g;
-	point[2] = sum_b;
-	#if USE_COV_MAT
-	/*
-		The following idea was from ryg.
-		(https://mollyrocket.com/forums/viewtopic.php?t=392)
-		The method worked great (less RMSE than mine) most of
-		the time, but had some issues handling some simple
-		boundary cases, like full green next to full red,
-		which would generate a covariance matrix like this:
+	const __m128i mask = _mm_set1_epi32( 0xff );
+	int h;
+	for( h = 0; h < 2; ++h )
+	{
+		const __m128i p0 = _mm_loadu_si128( (const __m128i*)(block + 32 * h) );
+		const __m128i p1 = _mm_loadu_si128( (const __m128i*)(block + 32 * h + 16) );
+		r[h] = _mm_packs_epi32( _mm_and_si128( p0, mask ), _mm_and_si128( p1, mask ) );
+		g[h] = _mm_packs_epi32( _mm_and_si128( _mm_srli_epi32( p0, 8 ), mask ),
+			_mm_and_si128( _mm_srli_epi32( p1, 8 ), mask ) );
+		b[h] = _mm_packs_epi32( _mm_and_si128( _mm_srli_epi32( p0, 16 ), mask ),
+			_mm_and_si128( _mm_srli_epi32( p1, 16 ), mask ) );
+	}
+}
 
-		| 1  -1  0 |
-		| -1  1  0 |
-		| 0   0  0 |
+static int horizontal_sum( __m128i v )
+{
+	v = _mm_add_epi32( v, _mm_shuffle_epi32( v, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+	v = _mm_add_epi32( v, _mm_shuffle_epi32( v, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+	return _mm_cvtsi128_si32( v );
+}
+#endif
 
-		For a given starting vector, the power method can
-		generate all zeros!  So no starting with {1,1,1}
-		as I was doing!  This kind of error is still a
-		slight possibility, but will be very rare.
-	*/
-	/*	use the covariance matrix directly
-		(1st iteration, don't use all 1.0 values!)	*/
-	sum_r = 1.0f;
-	sum_g = 2.718281828f;
-	sum_b = 3.141592654f;
-	direction[0] = sum_r*sum_rr + sum_g*sum_rg + sum_b*sum_rb;
-	direction[1] = sum_r*sum_rg + sum_g*sum_gg + sum_b*sum_gb;
-	direction[2] = sum_r*sum_rb + sum_g*sum_gb + sum_b*sum_bb;
-	/*	2nd iteration, use results from the 1st guy	*/
-	sum_r = direction[0];
-	sum_g = direction[1];
-	sum_b = direction[2];
-	direction[0] = sum_r*sum_rr + sum_g*sum_rg + sum_b*sum_rb;
-	direction[1] = sum_r*sum_rg + sum_g*sum_gg + sum_b*sum_gb;
-	direction[2] = sum_r*sum_rb + sum_g*sum_gb + sum_b*sum_bb;
-	/*	3rd iteration, use results from the 2nd guy	*/
-	sum_r = direction[0];
-	sum_g = direction[1];
-	sum_b = direction[2];
-	direction[0] = sum_r*sum_rr + sum_g*sum_rg + sum_b*sum_rb;
-	direction[1] = sum_r*sum_rg + sum_g*sum_gg + sum_b*sum_gb;
-	direction[2] = sum_r*sum_rb + sum_g*sum_gb + sum_b*sum_bb;
-	#else
-	/*	use my standard deviation method
-		(very robust, a tiny bit slower and less accurate)	*/
-	direction[0] = sqrt( sum_rr );
-	direction[1] = sqrt( sum_gg );
-	direction[2] = sqrt( sum_bb );
-	/*	which has a greater component	*/
-	if( sum_gg > sum_rr )
-	{
-		/*	green has greater component, so base the other signs off of green	*/
-		if( sum_rg < 0.0f )
+/*
+	Picks the nearest of the 4 palette colors for every pixel of the
+	block.  Fills in the 32 bits of 2-bit indices and returns the summed
+	squared error.
+*/
+static int match_colors(
+		const unsigned char block[64],
+		const int palette[4][3],
+		unsigned int *indices )
+{
+	int i, error = 0;
+	unsigned int bits = 0;
+#if defined(DXT_AVX2)
+	/*	R, G and B of all 16 pixels as 16-bit lanes; the in-lane packs leave
+		them in the order 0-3 8-11 4-7 12-15, which the in-lane unpacks below
+		put back as 0-7 and 8-15	*/
+	int best_index[16], best_distance[16];
+	const __m256i mask = _mm256_set1_epi32( 0xff );
+	const __m256i p0 = _mm256_loadu_si256( (const __m256i*)block );
+	const __m256i p1 = _mm256_loadu_si256( (const __m256i*)(block + 32) );
+	const __m256i r = _mm256_packs_epi32( _mm256_and_si256( p0, mask ), _mm256_and_si256( p1, mask ) );
+	const __m256i g = _mm256_packs_epi32( _mm256_and_si256( _mm256_srli_epi32( p0, 8 ), mask ),
+		_mm256_and_si256( _mm256_srli_epi32( p1, 8 ), mask ) );
+	const __m256i b = _mm256_packs_epi32( _mm256_and_si256( _mm256_srli_epi32( p0, 16 ), mask ),
+		_mm256_and_si256( _mm256_srli_epi32( p1, 16 ), mask ) );
+	__m256i best_lo = _mm256_set1_epi32( 0x7fffffff ), best_hi = best_lo;
+	__m256i index_lo = _mm256_setzero_si256(), index_hi = index_lo;
+	int k;
+	for( k = 0; k < 4; ++k )
+	{
+		const __m256i dr = _mm256_sub_epi16( r, _mm256_set1_epi16( (short)palette[k][0] ) );
+		const __m256i dg = _mm256_sub_epi16( g, _mm256_set1_epi16( (short)palette[k][1] ) );
+		const __m256i db = _mm256_sub_epi16( b, _mm256_set1_epi16( (short)palette[k][2] ) );
+		const __m256i rg_lo = _mm256_unpacklo_epi16( dr, dg ), rg_hi = _mm256_unpackhi_epi16( dr, dg );
+		const __m256i b_lo = _mm256_unpacklo_epi16( db, _mm256_setzero_si256() );
+		const __m256i b_hi = _mm256_unpackhi_epi16( db, _mm256_setzero_si256() );
+		const __m256i d_lo = _mm256_add_epi32( _mm256_madd_epi16( rg_lo, rg_lo ), _mm256_madd_epi16( b_lo, b_lo ) );
+		const __m256i d_hi = _mm256_add_epi32( _mm256_madd_epi16( rg_hi, rg_hi ), _mm256_madd_epi16( b_hi, b_hi ) );
+		const __m256i closer_lo = _mm256_cmpgt_epi32( best_lo, d_lo );
+		const __m256i closer_hi = _mm256_cmpgt_epi32( best_hi, d_hi );
+		best_lo = _mm256_min_epi32( best_lo, d_lo );
+		best_hi = _mm256_min_epi32( best_hi, d_hi );
+		index_lo = _mm256_blendv_epi8( index_lo, _mm256_set1_epi32( k ), closer_lo );
+		index_hi = _mm256_blendv_epi8( index_hi, _mm256_set1_epi32( k ), closer_hi );
+	}
+	_mm256_storeu_si256( (__m256i*)best_index, index_lo );
+	_mm256_storeu_si256( (__m256i*)(best_index + 8), index_hi );
+	_mm256_storeu_si256( (__m256i*)best_distance, best_lo );
+	_mm256_storeu_si256( (__m256i*)(best_distance + 8), best_hi );
+	for( i = 0; i < 16; ++i )
+	{
+		bits |= (unsigned int)best_index[i] << (2 * i);
+		error += best_distance[i];
+	}
+#elif defined(DXT_SSE2)
+	int best_index[16], best_distance[16];
+	__m128i r[2], g[2], b[2];
+	__m128i best[4], index[4];
+	int h, k;
+	block_planes( block, r, g, b );
+	for( i = 0; i < 4; ++i )
+	{
+		best[i] = _mm_set1_epi32( 0x7fffffff );
+		index[i] = _mm_setzero_si128();
+	}
+	for( k = 0; k < 4; ++k )
+	{
+		const __m128i pr = _mm_set1_epi16( (short)palette[k][0] );
+		const __m128i pg = _mm_set1_epi16( (short)palette[k][1] );
+		const __m128i pb = _mm_set1_epi16( (short)palette[k][2] );
+		const __m128i k_lanes = _mm_set1_epi32( k );
+		for( h = 0; h < 2; ++h )
 		{
-			direction[0] = -direction[0];
+			const __m128i dr = _mm_sub_epi16( r[h], pr );
+			const __m128i dg = _mm_sub_epi16( g[h], pg );
+			const __m128i db = _mm_sub_epi16( b[h], pb );
+			const __m128i rg_lo = _mm_unpacklo_epi16( dr, dg ), rg_hi = _mm_unpackhi_epi16( dr, dg );
+			const __m128i b_lo = _mm_unpacklo_epi16( db, _mm_setzero_si128() );
+			const __m128i b_hi = _mm_unpackhi_epi16( db, _mm_setzero_si128() );
+			__m128i d[2];
+			int q;
+			d[0] = _mm_add_epi32( _mm_madd_epi16( rg_lo, rg_lo ), _mm_madd_epi16( b_lo, b_lo ) );
+			d[1] = _mm_add_epi32( _mm_madd_epi16( rg_hi, rg_hi ), _mm_madd_epi16( b_hi, b_hi ) );
+			for( q = 0; q < 2; ++q )
+			{
+				/*	SSE2 has no 32-bit min or blend: select with masks	*/
+				const __m128i closer = _mm_cmpgt_epi32( best[2*h+q], d[q] );
+				best[2*h+q] = _mm_or_si128( _mm_and_si128( closer, d[q] ), _mm_andnot_si128( closer, best[2*h+q] ) );
+				index[2*h+q] = _mm_or_si128( _mm_and_si128( closer, k_lanes ), _mm_andnot_si128( closer, index[2*h+q] ) );
+			}
 		}
-		if( sum_gb < 0.0f )
+	}
+	for( i = 0; i < 4; ++i )
+	{
+		_mm_storeu_si128( (__m128i*)(best_index + 4 * i), index[i] );
+		_mm_storeu_si128( (__m128i*)(best_distance + 4 * i), best[i] );
+	}
+	for( i = 0; i < 16; ++i )
+	{
+		bits |= (unsigned int)best_index[i] << (2 * i);
+		error += best_distance[i];
+	}
+#else
+	for( i = 0; i < 16; ++i )
+	{
+		int k, best = 0x7fffffff, best_index = 0;
+		for( k = 0; k < 4; ++k )
 		{
-			direction[2] = -direction[2];
+			int dr = block[i*4+0] - palette[k][0];
+			int dg = block[i*4+1] - palette[k][1];
+			int db = block[i*4+2] - palette[k][2];
+			int d = dr*dr + dg*dg + db*db;
+			if( d < best )
+			{
+				best = d;
+				best_index = k;
+			}
 		}
-	} else
+		bits |= (unsigned int)best_index << (2 * i);
+		error += best;
+	}
+#endif
+	*indices = bits;
+	return error;
+}
+
+/*
+	Quantizes a pair of endpoints to 565 (color 0 the larger, so the block
+	decodes in 4 color mode), and matches the pixels against the palette
+	they give.  Returns the summed squared error.
+*/
+static int encode_endpoints(
+		const unsigned char block[64],
+		const int c0[3], const int c1[3],
+		int *enc_c0, int *enc_c1,
+		unsigned int *indices )
+{
+	int i, e0 = rgb_to_565( c0 ), e1 = rgb_to_565( c1 );
+	int palette[4][3];
+	if( e0 < e1 )
 	{
-		/*	red has a greater component	*/
-		if( sum_rg < 0.0f )
+		int swap = e0;
+		e0 = e1;
+		e1 = swap;
+	}
+	rgb_888_from_565( e0, palette[0] );
+	rgb_888_from_565( e1, palette[1] );
+	for( i = 0; i < 3; ++i )
+	{
+		if( e0 == e1 )
 		{
-			direction[1] = -direction[1];
-		}
-		if( sum_rb < 0.0f )
+			/*	a flat block: every index 0 (the 3 color mode's
+				black must never be picked)	*/
+			palette[2][i] = palette[3][i] = palette[0][i];
+		} else
 		{
-			direction[2] = -direction[2];
+			palette[2][i] = (2 * palette[0][i] + palette[1][i] + 1) / 3;
+			palette[3][i] = (palette[0][i] + 2 * palette[1][i] + 1) / 3;
 		}
 	}
-	#endif
+	*enc_c0 = e0;
+	*enc_c1 = e1;
+	return match_colors( block, (const int (*)[3])palette, indices );
 }
 
-void LSE_master_colors_max_min(
-		int *cmax, int *cmin,
-		int channels,
-		const unsigned char *const uncompressed )
+/*	per channel minimum and maximum, inset by 1/16 of the range	*/
+static void endpoints_bounding_box(
+		const unsigned char block[64],
+		int c0[3], int c1[3] )
 {
-	int i, j;
-	/*	the master colors	*/
-	int c0[3], c1[3];
-	/*	used for fitting the line	*/
-	float sum_x[] = { 0.0f, 0.0f, 0.0f };
-	float sum_x2[] = { 0.0f, 0.0f, 0.0f };
-	float dot_max = 1.0f, dot_min = -1.0f;
-	float vec_len2 = 0.0f;
-	float dot;
-	/*	error check	*/
-	if( (channels < 3) || (channels > 4) )
+	int i, lo[3], hi[3];
+#if defined(DXT_SSE2)
+	unsigned char extremes[32];
+	__m128i mn = _mm_loadu_si128( (const __m128i*)block );
+	__m128i mx = mn;
+	for( i = 1; i < 4; ++i )
 	{
-		return;
+		const __m128i p = _mm_loadu_si128( (const __m128i*)(block + 16 * i) );
+		mn = _mm_min_epu8( mn, p );
+		mx = _mm_max_epu8( mx, p );
 	}
-	compute_color_line_STDEV( uncompressed, channels, sum_x, sum_x2 );
-	vec_len2 = 1.0f / ( 0.00001f +
-			sum_x2[0]*sum_x2[0] + sum_x2[1]*sum_x2[1] + sum_x2[2]*sum_x2[2] );
-	/*	finding the max and min vector values	*/
-	dot_max =
-			(
-				sum_x2[0] * uncompressed[0] +
-				sum_x2[1] * uncompressed[1] +
-				sum_x2[2] * uncompressed[2]
-			);
-	dot_min = dot_max;
-	for( i = 1; i < 16; ++i )
+	mn = _mm_min_epu8( mn, _mm_srli_si128( mn, 8 ) );
+	mx = _mm_max_epu8( mx, _mm_srli_si128( mx, 8 ) );
+	mn = _mm_min_epu8( mn, _mm_srli_si128( mn, 4 ) );
+	mx = _mm_max_epu8( mx, _mm_srli_si128( mx, 4 ) );
+	_mm_storeu_si128( (__m128i*)extremes, mn );
+	_mm_storeu_si128( (__m128i*)(extremes + 16), mx );
+	for( i = 0; i < 3; ++i )
 	{
-		dot =
-			(
-				sum_x2[0] * uncompressed[i*channels+0] +
-				sum_x2[1] * uncompressed[i*channels+1] +
-				sum_x2[2] * uncompressed[i*channels+2]
-			);
-		if( dot < dot_min )
-		{
-			dot_min = dot;
-		} else if( dot > dot_max )
+		lo[i] = extremes[i];
+		hi[i] = extremes[16 + i];
+	}
+#else
+	int j;
+	for( i = 0; i < 3; ++i )
+	{
+		lo[i] = hi[i] = block[i];
+	}
+	for( j = 1; j < 16; ++j )
+	{
+		for( i = 0; i < 3; ++i )
 		{
-			dot_max = dot;
+			int c = block[j*4+i];
+			lo[i] = c < lo[i] ? c : lo[i];
+			hi[i] = c > hi[i] ? c : hi[i];
 		}
 	}
-	/*	and the offset (from the average location)	*/
-	dot = sum_x2[0]*sum_x[0] + sum_x2[1]*sum_x[1] + sum_x2[2]*sum_x[2];
-	dot_min -= dot;
-	dot_max -= dot;
-	/*	post multiply by the scaling factor	*/
-	dot_min *= vec_len2;
-	dot_max *= vec_len2;
-	/*	OK, build the master colors	*/
+#endif
 	for( i = 0; i < 3; ++i )
 	{
-		/*	color 0	*/
-		c0[i] = (int)(0.5f + sum_x[i] + dot_max * sum_x2[i]);
-		if( c0[i] < 0 )
-		{
-			c0[i] = 0;
-		} else if( c0[i] > 255 )
+		int inset = (hi[i] - lo[i]) >> 4;
+		c0[i] = hi[i] - inset;
+		c1[i] = lo[i] + inset;
+	}
+}
+
+/*
+	The endpoints are the extremes of the pixels along the principal
+	axis of their colors.  The axis comes from the covariance matrix by
+	the power method, an idea from ryg
+	(https://mollyrocket.com/forums/viewtopic.php?t=392); the start
+	vector is not all 1.0 values, which the power method can turn into
+	all zeros for blocks like full green next to full red.
+*/
+static void endpoints_principal_axis(
+		const unsigned char block[64],
+		int c0[3], int c1[3] )
+{
+	int i, iteration;
+	int sum[3] = { 0, 0, 0 }, products[6] = { 0, 0, 0, 0, 0, 0 };
+	float mean[3], cov[6];
+	float axis[3] = { 1.0f, 2.718281828f, 3.141592654f };
+	float length, t_min = 0.0f, t_max = 0.0f;
+	/*	integer sums (exact), turned into the covariance matrix times 256
+		(only its direction matters)	*/
+#if defined(DXT_SSE2)
+	__m128i r[2], g[2], b[2];
+	block_planes( block, r, g, b );
+	{
+		const __m128i ones = _mm_set1_epi16( 1 );
+		const __m128i r16 = _mm_add_epi16( r[0], r[1] );
+		const __m128i g16 = _mm_add_epi16( g[0], g[1] );
+		const __m128i b16 = _mm_add_epi16( b[0], b[1] );
+		/*	each madd lane sums 2 products of bytes, so 8 lanes of a
+			plane fit easily	*/
+		sum[0] = horizontal_sum( _mm_madd_epi16( r16, ones ) );
+		sum[1] = horizontal_sum( _mm_madd_epi16( g16, ones ) );
+		sum[2] = horizontal_sum( _mm_madd_epi16( b16, ones ) );
+		products[0] = horizontal_sum( _mm_add_epi32( _mm_madd_epi16( r[0], r[0] ), _mm_madd_epi16( r[1], r[1] ) ) );
+		products[1] = horizontal_sum( _mm_add_epi32( _mm_madd_epi16( r[0], g[0] ), _mm_madd_epi16( r[1], g[1] ) ) );
+		products[2] = horizontal_sum( _mm_add_epi32( _mm_madd_epi16( r[0], b[0] ), _mm_madd_epi16( r[1], b[1] ) ) );
+		products[3] = horizontal_sum( _mm_add_epi32( _mm_madd_epi16( g[0], g[0] ), _mm_madd_epi16( g[1], g[1] ) ) );
+		products[4] = horizontal_sum( _mm_add_epi32( _mm_madd_epi16( g[0], b[0] ), _mm_madd_epi16( g[1], b[1] ) ) );
+		products[5] = horizontal_sum( _mm_add_epi32( _mm_madd_epi16( b[0], b[0] ), _mm_madd_epi16( b[1], b[1] ) ) );
+	}
+#else
+	for( i = 0; i < 16; ++i )
+	{
+		int r = block[i*4+0], g = block[i*4+1], b = block[i*4+2];
+		sum[0] += r;
+		sum[1] += g;
+		sum[2] += b;
+		products[0] += r*r;
+		products[1] += r*g;
+		products[2] += r*b;
+		products[3] += g*g;
+		products[4] += g*b;
+		products[5] += b*b;
+	}
+#endif
+	cov[0] = (float)(16 * products[0] - sum[0] * sum[0]);
+	cov[1] = (float)(16 * products[1] - sum[0] * sum[1]);
+	cov[2] = (float)(16 * products[2] - sum[0] * sum[2]);
+	cov[3] = (float)(16 * products[3] - sum[1] * sum[1]);
+	cov[4] = (float)(16 * products[4] - sum[1] * sum[2]);
+	cov[5] = (float)(16 * products[5] - sum[2] * sum[2]);
+	for( i = 0; i < 3; ++i )
+	{
+		mean[i] = sum[i] * (1.0f / 16.0f);
+	}
+	/*	scaled by the trace, so the power method's products stay small
+		enough for a float without renormalizing every step	*/
+	length = cov[0] + cov[3] + cov[5];
+	if( length <= 0.0f )
+	{
+		/*	a flat block	*/
+		for( i = 0; i < 3; ++i )
 		{
-			c0[i] = 255;
+			c0[i] = c1[i] = (int)(mean[i] + 0.5f);
 		}
-		/*	color 1	*/
-		c1[i] = (int)(0.5f + sum_x[i] + dot_min * sum_x2[i]);
-		if( c1[i] < 0 )
-		{
-			c1[i] = 0;
-		} else if( c1[i] > 255 )
+		return;
+	}
+	length = 1.0f / length;
+	for( i = 0; i < 6; ++i )
+	{
+		cov[i] *= length;
+	}
+	for( iteration = 0; iteration < 4; ++iteration )
+	{
+		float x = axis[0]*cov[0] + axis[1]*cov[1] + axis[2]*cov[2];
+		float y = axis[0]*cov[1] + axis[1]*cov[3] + axis[2]*cov[4];
+		float z = axis[0]*cov[2] + axis[1]*cov[4] + axis[2]*cov[5];
+		axis[0] = x;
+		axis[1] = y;
+		axis[2] = z;
+	}
+	length = axis[0]*axis[0] + axis[1]*axis[1] + axis[2]*axis[2];
+	if( length < 1e-20f )
+	{
+		/*	the start vector was (nearly) orthogonal to the colors	*/
+		axis[0] = axis[1] = axis[2] = 1.0f;
+		length = 3.0f;
+	}
+	length = 1.0f / (float)sqrt( length );
+	axis[0] *= length;
+	axis[1] *= length;
+	axis[2] *= length;
+	/*	project onto the axis, through the mean	*/
+#if defined(DXT_SSE2)
+	{
+		const __m128 ax = _mm_set1_ps( axis[0] ), ay = _mm_set1_ps( axis[1] ), az = _mm_set1_ps( axis[2] );
+		const __m128i zero = _mm_setzero_si128();
+		__m128 lo = _mm_set1_ps( 1e30f ), hi = _mm_set1_ps( -1e30f );
+		float extremes[8];
+		int h;
+		for( h = 0; h < 4; ++h )
 		{
-			c1[i] = 255;
+			/*	4 pixels at a time, widened to floats	*/
+			const __m128i r32 = (h & 1) ? _mm_unpackhi_epi16( r[h>>1], zero ) : _mm_unpacklo_epi16( r[h>>1], zero );
+			const __m128i g32 = (h & 1) ? _mm_unpackhi_epi16( g[h>>1], zero ) : _mm_unpacklo_epi16( g[h>>1], zero );
+			const __m128i b32 = (h & 1) ? _mm_unpackhi_epi16( b[h>>1], zero ) : _mm_unpacklo_epi16( b[h>>1], zero );
+			const __m128 t = _mm_add_ps( _mm_add_ps(
+				_mm_mul_ps( _mm_cvtepi32_ps( r32 ), ax ),
+				_mm_mul_ps( _mm_cvtepi32_ps( g32 ), ay ) ),
+				_mm_mul_ps( _mm_cvtepi32_ps( b32 ), az ) );
+			lo = _mm_min_ps( lo, t );
+			hi = _mm_max_ps( hi, t );
 		}
+		lo = _mm_min_ps( lo, _mm_movehl_ps( lo, lo ) );
+		hi = _mm_max_ps( hi, _mm_movehl_ps( hi, hi ) );
+		_mm_storeu_ps( extremes, lo );
+		_mm_storeu_ps( extremes + 4, hi );
+		t_min = extremes[0] < extremes[1] ? extremes[0] : extremes[1];
+		t_max = extremes[4] > extremes[5] ? extremes[4] : extremes[5];
 	}
-	/*	down_sample (with rounding?)	*/
-	i = rgb_to_565( c0[0], c0[1], c0[2] );
-	j = rgb_to_565( c1[0], c1[1], c1[2] );
-	if( i > j )
+#else
+	t_min = t_max = block[0] * axis[0] + block[1] * axis[1] + block[2] * axis[2];
+	for( i = 1; i < 16; ++i )
 	{
-		*cmax = i;
-		*cmin = j;
-	} else
+		float t = block[i*4+0] * axis[0] + block[i*4+1] * axis[1] + block[i*4+2] * axis[2];
+		t_min = t < t_min ? t : t_min;
+		t_max = t > t_max ? t : t_max;
+	}
+#endif
+	length = mean[0] * axis[0] + mean[1] * axis[1] + mean[2] * axis[2];
+	t_min -= length;
+	t_max -= length;
+	for( i = 0; i < 3; ++i )
 	{
-		*cmax = j;
-		*cmin = i;
+		c0[i] = clamp_255( (int)(mean[i] + t_max * axis[i] + 0.5f) );
+		c1[i] = clamp_255( (int)(mean[i] + t_min * axis[i] + 0.5f) );
 	}
 }
 
-void
-	compress_DDS_color_block
-	(
-		int channels,
-		const unsigned char *const uncompressed,
-		unsigned char compressed[8]
-	)
+/*
+	Least squares fit of the two endpoints to the pixels, given the
+	indices they were matched to.  Returns 0 when the indices do not
+	determine the endpoints (all pixels on one of them).
+*/
+static int refine_endpoints(
+		const unsigned char block[64],
+		unsigned int indices,
+		int c0[3], int c1[3] )
 {
-	/*	variables	*/
-	int i;
-	int next_bit;
-	int enc_c0, enc_c1;
-	int c0[4], c1[4];
-	float color_line[] = { 0.0f, 0.0f, 0.0f, 0.0f };
-	float vec_len2 = 0.0f, dot_offset = 0.0f;
-	/*	stupid order	*/
-	int swizzle4[] = { 0, 2, 3, 1 };
-	/*	get the master colors	*/
-	LSE_master_colors_max_min( &enc_c0, &enc_c1, channels, uncompressed );
-	/*	store the 565 color 0 and color 1	*/
-	compressed[0] = (enc_c0 >> 0) & 255;
-	compressed[1] = (enc_c0 >> 8) & 255;
-	compressed[2] = (enc_c1 >> 0) & 255;
-	compressed[3] = (enc_c1 >> 8) & 255;
-	/*	zero out the compressed data	*/
-	compressed[4] = 0;
-	compressed[5] = 0;
-	compressed[6] = 0;
-	compressed[7] = 0;
-	/*	reconstitute the master color vectors	*/
-	rgb_888_from_565( enc_c0, &c0[0], &c0[1], &c0[2] );
-	rgb_888_from_565( enc_c1, &c1[0], &c1[1], &c1[2] );
-	/*	the new vector	*/
-	vec_len2 = 0.0f;
-	for( i = 0; i < 3; ++i )
+	/*	weight of color 0 for each index, in thirds	*/
+	static const int weight0[4] = { 3, 0, 2, 1 };
+	float aa = 0.0f, bb = 0.0f, ab = 0.0f, det;
+	float ax[3] = { 0.0f, 0.0f, 0.0f }, bx[3] = { 0.0f, 0.0f, 0.0f };
+	int i, k;
+	for( i = 0; i < 16; ++i )
 	{
-		color_line[i] = (float)(c1[i] - c0[i]);
-		vec_len2 += color_line[i] * color_line[i];
+		float a = weight0[(indices >> (2 * i)) & 3] * (1.0f / 3.0f);
+		float b = 1.0f - a;
+		aa += a * a;
+		bb += b * b;
+		ab += a * b;
+		for( k = 0; k < 3; ++k )
+		{
+			ax[k] += a * block[i*4+k];
+			bx[k] += b * block[i*4+k];
+		}
 	}
-	if( vec_len2 > 0.0f )
+	det = aa * bb - ab * ab;
+	if( fabs( det ) < 1e-6f )
 	{
-		vec_len2 = 1.0f / vec_len2;
+		return 0;
 	}
-	/*	pre-proform the scaling	*/
-	color_line[0] *= vec_len2;
-	color_line[1] *= vec_len2;
-	color_line[2] *= vec_len2;
-	/*	compute the offset (constant) portion of the dot product	*/
-	dot_offset = color_line[0]*c0[0] + color_line[1]*c0[1] + color_line[2]*c0[2];
-	/*	store the rest of the bits	*/
-	next_bit = 8*4;
-	for( i = 0; i < 16; ++i )
+	det = 1.0f / det;
+	for( k = 0; k < 3; ++k )
 	{
-		/*	find the dot product of this color, to place it on the line
-			(should be [-1,1])	*/
-		int next_value = 0;
-		float dot_product =
-			color_line[0] * uncompressed[i*channels+0] +
-			color_line[1] * uncompressed[i*channels+1] +
-			color_line[2] * uncompressed[i*channels+2] -
-			dot_offset;
-		/*	map to [0,3]	*/
-		next_value = (int)( dot_product * 3.0f + 0.5f );
-		if( next_value > 3 )
-		{
-			next_value = 3;
-		} else if( next_value < 0 )
-		{
-			next_value = 0;
-		}
-		/*	OK, store this value	*/
-		compressed[next_bit >> 3] |= swizzle4[ next_value ] << (next_bit & 7);
-		next_bit += 2;
+		c0[k] = clamp_255( (int)((ax[k] * bb - bx[k] * ab) * det + 0.5f) );
+		c1[k] = clamp_255( (int)((bx[k] * aa - ax[k] * ab) * det + 0.5f) );
 	}
-	/*	done compressing to DXT1	*/
+	return 1;
 }
 
-void
-	compress_DDS_alpha_block
-	(
-		const unsigned char *const uncompressed,
-		unsigned char compressed[8]
-	)
+static void compress_color_block(
+		const unsigned char block[64],
+		int quality,
+		unsigned char compressed[8] )
 {
-	/*	variables	*/
-	int i;
-	int next_bit;
-	int a0, a1;
-	float scale_me;
-	/*	stupid order	*/
-	int swizzle8[] = { 1, 7, 6, 5, 4, 3, 2, 0 };
-	/*	get the alpha limits (a0 > a1)	*/
-	a0 = a1 = uncompressed[3];
-	for( i = 4+3; i < 16*4; i += 4 )
-	{
-		if( uncompressed[i] > a0 )
+	int c0[3], c1[3];
+	int enc_c0, enc_c1, error, iteration;
+	unsigned int indices;
+	if( quality == DXT_QUALITY_FAST )
+	{
+		endpoints_bounding_box( block, c0, c1 );
+	} else
+	{
+		endpoints_principal_axis( block, c0, c1 );
+	}
+	error = encode_endpoints( block, c0, c1, &enc_c0, &enc_c1, &indices );
+	if( quality >= DXT_QUALITY_HIGH )
+	{
+		int try_c0, try_c1, try_error;
+		unsigned int try_indices;
+		/*	saturated blocks can fit the bounding box better than the axis	*/
+		endpoints_bounding_box( block, c0, c1 );
+		try_error = encode_endpoints( block, c0, c1, &try_c0, &try_c1, &try_indices );
+		if( try_error < error )
 		{
-			a0 = uncompressed[i];
-		} else if( uncompressed[i] < a1 )
+			error = try_error;
+			enc_c0 = try_c0;
+			enc_c1 = try_c1;
+			indices = try_indices;
+		}
+		for( iteration = 0; iteration < 2 && error > 0; ++iteration )
 		{
-			a1 = uncompressed[i];
+			if( !refine_endpoints( block, indices, c0, c1 ) )
+			{
+				break;
+			}
+			try_error = encode_endpoints( block, c0, c1, &try_c0, &try_c1, &try_indices );
+			if( try_error >= error )
+			{
+				break;
+			}
+			error = try_error;
+			enc_c0 = try_c0;
+			enc_c1 = try_c1;
+			indices = try_indices;
 		}
 	}
-	/*	store those limits, and zero the rest of the compressed dataset	*/
-	compressed[0] = a0;
-	compressed[1] = a1;
-	/*	zero out the compressed data	*/
-	compressed[2] = 0;
-	compressed[3] = 0;
-	compressed[4] = 0;
-	compressed[5] = 0;
-	compressed[6] = 0;
-	compressed[7] = 0;
-	/*	store the all of the alpha values	*/
-	next_bit = 8*2;
-	scale_me = 7.9999f / (a0 - a1);
-	for( i = 3; i < 16*4; i += 4 )
-	{
-		/*	convert this alpha value to a 3 bit number	*/
-		int svalue;
-		int value = (int)((uncompressed[i] - a1) * scale_me);
-		svalue = swizzle8[ value&7 ];
-		/*	OK, store this value, start with the 1st byte	*/
-		compressed[next_bit >> 3] |= svalue << (next_bit & 7);
-		if( (next_bit & 7) > 5 )
+	/*	store the 565 color 0 and color 1, then the indices	*/
+	compressed[0] = (enc_c0 >> 0) & 255;
+	compressed[1] = (enc_c0 >> 8) & 255;
+	compressed[2] = (enc_c1 >> 0) & 255;
+	compressed[3] = (enc_c1 >> 8) & 255;
+	compressed[4] = (indices >> 0) & 255;
+	compressed[5] = (indices >> 8) & 255;
+	compressed[6] = (indices >> 16) & 255;
+	compressed[7] = (indices >> 24) & 255;
+}
+
+static void compress_alpha_block(
+		const unsigned char block[64],
+		unsigned char compressed[8] )
+{
+	int i, a0, a1, range;
+	unsigned int low = 0, high = 0;
+	/*	get the alpha limits (a0 > a1, the 8 alpha mode)	*/
+	a0 = a1 = block[3];
+	for( i = 1; i < 16; ++i )
+	{
+		int a = block[i*4+3];
+		a0 = a > a0 ? a : a0;
+		a1 = a < a1 ? a : a1;
+	}
+	compressed[0] = (unsigned char)a0;
+	compressed[1] = (unsigned char)a1;
+	range = a0 - a1;
+	/*	every index 0 (alpha 0) when the block's alpha is constant	*/
+	if( range > 0 )
+	{
+		for( i = 0; i < 16; ++i )
 		{
-			/*	spans 2 bytes, fill in the start of the 2nd byte	*/
-			compressed[1 + (next_bit >> 3)] |= svalue >> (8 - (next_bit & 7) );
+			/*	nearest of the 8 steps from a1 (0) to a0 (7), and its index:
+				0 is a0, 1 is a1, and 2..7 run from a0 towards a1	*/
+			int step = ((block[i*4+3] - a1) * 14 + range) / (2 * range);
+			unsigned int index = step == 7 ? 0 : (step == 0 ? 1 : 8 - step);
+			if( i < 8 )
+			{
+				low |= index << (3 * i);
+			} else
+			{
+				high |= index << (3 * (i - 8));
+			}
 		}
-		next_bit += 3;
 	}
-	/*	done compressing to DXT1	*/
+	compressed[2] = (low >> 0) & 255;
+	compressed[3] = (low >> 8) & 255;
+	compressed[4] = (low >> 16) & 255;
+	compressed[5] = (high >> 0) & 255;
+	compressed[6] = (high >> 8) & 255;
+	compressed[7] = (high >> 16) & 255;
 }
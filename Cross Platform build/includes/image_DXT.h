@@ -10,6 +10,15 @@
 #ifndef HEADER_IMAGE_DXT
 #define HEADER_IMAGE_DXT
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**	quality / speed switch of the block encoder	**/
+#define DXT_QUALITY_FAST	0	/* bounding box endpoints: fastest, a little more error */
+#define DXT_QUALITY_NORMAL	1	/* principal axis endpoints, used by convert_image_to_DXT1/5 */
+#define DXT_QUALITY_HIGH	2	/* adds least squares endpoint refinement */
+
 /**
 	Converts an image from an array of unsigned chars (RGB or RGBA) to
 	DXT1 or DXT5, then saves the converted image to disk.
@@ -45,6 +54,24 @@ convert_image_to_DXT5
     int *out_size
 );
 
+/**
+	Compresses block rows [first_block_row, first_block_row + block_row_count)
+	of an image (RGB or RGBA, 1 to 4 channels) to DXT1, or DXT5 if dxt5 is
+	nonzero. "compressed" is the output of the whole image,
+	((width+3)/4) * ((height+3)/4) * (8 or 16) bytes; only the band's blocks
+	are written, so bands can be compressed on separate threads at once.
+	\return 0 if failed, otherwise returns 1
+**/
+int
+convert_image_rows_to_DXT
+(
+    const unsigned char *const uncompressed,
+    int width, int height, int channels,
+    int dxt5, int quality,
+    int first_block_row, int block_row_count,
+    unsigned char *compressed
+);
+
 /**	A bunch of DirectDraw Surface structures and flags **/
 typedef struct
 {
@@ -120,4 +147,8 @@ DDS_header ;
 #define DDSCAPS2_CUBEMAP_NEGATIVEZ	0x00008000
 #define DDSCAPS2_VOLUME	0x00200000
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* HEADER_IMAGE_DXT	*/
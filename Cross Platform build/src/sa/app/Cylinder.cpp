@@ -1,13 +1,17 @@
 // credit to Song Ho Ahn
 
 #include "Cylinder.h"
-#include "shader.h"
+#include "profiler.h"
+#include "render_counters.h"
+#include <glad/glad.h>
+#include <math.h>
 
 const int MIN_SECTOR_COUNT = 3;
 const int MIN_STACK_COUNT = 1;
 
 Cylinder::Cylinder(float baseRadius, float topRadius, float height, int sectors,
-    int stacks, bool smooth) : interleavedStride(32)
+    int stacks, bool smooth, int buildFlags) : baseIndex(0), topIndex(0), vertexCount(0), indexCount(0),
+    buildFlags(buildFlags), interleavedStride(32)
 {
     set(baseRadius, topRadius, height, sectors, stacks, smooth);
 }
@@ -28,9 +32,16 @@ void Cylinder::set(float baseRadius, float topRadius, float height, int sectors,
     this->smooth = smooth;
 
     buildUnitCircleVertices();
+    rebuild();
+}
 
-    if (smooth)
-        buildVerticesSmooth();
+void Cylinder::setBuildFlags(int buildFlags)
+{
+    if (this->buildFlags == buildFlags)
+        return;
+
+    this->buildFlags = buildFlags;
+    rebuild();
 }
 
 void Cylinder::setBaseRadius(float radius)
@@ -69,13 +80,55 @@ void Cylinder::setSmooth(bool smooth)
         return;
 
     this->smooth = smooth;
+    rebuild();
+}
+
+// rebuilds the arrays for the current parameters. An uploaded copy is replaced as well,
+// or released when there is nothing to replace it with, so draw() never shows the old shape.
+void Cylinder::rebuild()
+{
+    if (unitCircleVertices.empty())     // freed by releaseCpuData()
+        buildUnitCircleVertices();
     if (smooth)
         buildVerticesSmooth();
+    if (!mesh.isValid())
+        return;
+    if (smooth)
+        upload();
+    else
+        mesh.release();
+}
+
+// keeps a GPU copy; the CPU arrays are no longer needed to draw after this
+void Cylinder::upload()
+{
+    mesh.upload(getInterleavedVertices(), getInterleavedVertexSize(), getIndices(), getIndexCount());
+}
+
+// frees every CPU-side array. Counts and index ranges stay valid, the array getters return nothing.
+void Cylinder::releaseCpuData()
+{
+    clearArrays();
+    std::vector<float>().swap(unitCircleVertices);
 }
 
+// draws the uploaded copy if there is one. Otherwise takes the immediate path: uploads,
+// draws with whatever program is bound and frees the buffers again.
+// Use GeometryCache to keep a cylinder resident across frames.
 void Cylinder::draw() const
 {
-    Shader shader("shader.vs", "shader.fs");
+    PROFILE_SCOPE("Cylinder::draw");
+    if (mesh.isValid())
+    {
+        mesh.draw();
+        return;
+    }
+    if (interleavedVertices.empty())
+        return;
+
+    GLuint vaoId;
+    glGenVertexArrays(1, &vaoId);
+    glBindVertexArray(vaoId);
 
     GLuint vboId;
     glGenBuffers(1, &vboId);
@@ -87,27 +140,22 @@ void Cylinder::draw() const
     glGenBuffers(1, &iboId);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, iboId);     // for index data
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, getIndexSize(), getIndices(), GL_STATIC_DRAW);                     // usage
-    glBindBuffer(GL_ARRAY_BUFFER, vboId);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, iboId);
 
-    glEnableVertexAttribArray(0);
     int stride = getInterleavedStride();   // should be 32 bytes
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
     glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
     glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)(6 * sizeof(float)));
     glEnableVertexAttribArray(2);
     glDrawElements(GL_TRIANGLES, getIndexCount(), GL_UNSIGNED_INT, (void*)0);
-    glPushMatrix();
-    glBindVertexArray(vboId);
-
-    glDrawArrays(GL_TRIANGLES, 0, 36);
-    glm::mat4 model = glm::mat4(1.0f);
-    shader.setMat4("model", model);
+    countStateChanges();
+    countDraw(GL_TRIANGLES, getIndexCount());
 
-
-    glPopMatrix();
+    glBindVertexArray(0);
+    glDeleteVertexArrays(1, &vaoId);
+    glDeleteBuffers(1, &vboId);
+    glDeleteBuffers(1, &iboId);
 }
 
 void Cylinder::clearArrays()
@@ -117,19 +165,39 @@ void Cylinder::clearArrays()
     std::vector<float>().swap(texCoords);
     std::vector<unsigned int>().swap(indices);
     std::vector<unsigned int>().swap(lineIndices);
+    std::vector<float>().swap(interleavedVertices);
 }
 
+// single pass: every vertex goes straight into the reserved interleaved array (and into the
+// separate arrays only when CYLINDER_SEPARATE_ARRAYS is set)
 void Cylinder::buildVerticesSmooth()
 {
     // clear memory of prev arrays
     clearArrays();
 
+    const bool separate = (buildFlags & CYLINDER_SEPARATE_ARRAYS) != 0;
+    const bool lines = (buildFlags & CYLINDER_LINE_INDICES) != 0;
+    vertexCount = (stackCount + 1) * (sectorCount + 1) + 2 * (sectorCount + 1);
+    indexCount = stackCount * sectorCount * 6 + 2 * sectorCount * 3;
+    interleavedVertices.reserve((std::size_t)vertexCount * 8);
+    indices.reserve(indexCount);
+    if (separate)
+    {
+        vertices.reserve((std::size_t)vertexCount * 3);
+        normals.reserve((std::size_t)vertexCount * 3);
+        texCoords.reserve((std::size_t)vertexCount * 2);
+    }
+    if (lines)
+        lineIndices.reserve((std::size_t)stackCount * sectorCount * 4 + sectorCount * 2);
+
     float x, y, z;                                  // vertex position
-    //float s, t;                                     // texCoord
     float radius;                                   // radius for each stack
 
-    // get normals for cylinder sides
-    std::vector<float> sideNormals = getSideNormals();
+    // side normals: the normal at 0 degree, rotated per sector
+    // tanA = (baseRadius-topRadius) / height
+    float zAngle = atan2(baseRadius - topRadius, height);
+    float nxy = cos(zAngle);
+    float nz = sin(zAngle);
 
     // put vertices of side cylinder to array by scaling unit circle
     for (int i = 0; i <= stackCount; ++i)
@@ -142,44 +210,34 @@ void Cylinder::buildVerticesSmooth()
         {
             x = unitCircleVertices[k];
             y = unitCircleVertices[k + 1];
-            addVertex(x * radius, y * radius, z);   // position
-            addNormal(sideNormals[k], sideNormals[k + 1], sideNormals[k + 2]); // normal
-            addTexCoord((float)j / sectorCount, t); // tex coord
+            addVertex(x * radius, y * radius, z, x * nxy, y * nxy, nz, (float)j / sectorCount, t);
         }
     }
 
     // remember where the base.top vertices start
-    unsigned int baseVertexIndex = (unsigned int)vertices.size() / 3;
+    unsigned int baseVertexIndex = (stackCount + 1) * (sectorCount + 1);
 
     // put vertices of base of cylinder
     z = -height * 0.5f;
-    addVertex(0, 0, z);
-    addNormal(0, 0, -1);
-    addTexCoord(0.5f, 0.5f);
+    addVertex(0, 0, z, 0, 0, -1, 0.5f, 0.5f);
     for (int i = 0, j = 0; i < sectorCount; ++i, j += 3)
     {
         x = unitCircleVertices[j];
         y = unitCircleVertices[j + 1];
-        addVertex(x * baseRadius, y * baseRadius, z);
-        addNormal(0, 0, -1);
-        addTexCoord(-x * 0.5f + 0.5f, -y * 0.5f + 0.5f);    // flip horizontal
+        addVertex(x * baseRadius, y * baseRadius, z, 0, 0, -1, -x * 0.5f + 0.5f, -y * 0.5f + 0.5f);    // flip horizontal
     }
 
     // remember where the base vertices start
-    unsigned int topVertexIndex = (unsigned int)vertices.size() / 3;
+    unsigned int topVertexIndex = baseVertexIndex + sectorCount + 1;
 
     // put vertices of top of cylinder
     z = height * 0.5f;
-    addVertex(0, 0, z);
-    addNormal(0, 0, 1);
-    addTexCoord(0.5f, 0.5f);
+    addVertex(0, 0, z, 0, 0, 1, 0.5f, 0.5f);
     for (int i = 0, j = 0; i < sectorCount; ++i, j += 3)
     {
         x = unitCircleVertices[j];
         y = unitCircleVertices[j + 1];
-        addVertex(x * topRadius, y * topRadius, z);
-        addNormal(0, 0, 1);
-        addTexCoord(x * 0.5f + 0.5f, -y * 0.5f + 0.5f);
+        addVertex(x * topRadius, y * topRadius, z, 0, 0, 1, x * 0.5f + 0.5f, -y * 0.5f + 0.5f);
     }
 
     // put indices for sides
@@ -195,6 +253,8 @@ void Cylinder::buildVerticesSmooth()
             addIndices(k1, k1 + 1, k2);
             addIndices(k2, k1 + 1, k2 + 1);
 
+            if (!lines)
+                continue;
             // vertical lines for all stacks
             lineIndices.push_back(k1);
             lineIndices.push_back(k2);
@@ -231,33 +291,6 @@ void Cylinder::buildVerticesSmooth()
         else
             addIndices(topVertexIndex, k, topVertexIndex + 1);
     }
-
-    // generate interleaved vertex array as well
-    buildInterleavedVertices();
-}
-
-void Cylinder::buildInterleavedVertices()
-{
-    std::vector<float>().swap(interleavedVertices);
-
-    std::size_t i, j;
-    std::size_t count = vertices.size();
-    for (i = 0, j = 0; i < count; i += 3, j += 2)
-    {
-        //interleavedVertices.push_back(vertices[i]);
-        //interleavedVertices.push_back(vertices[i+1]);
-        //interleavedVertices.push_back(vertices[i+2]);
-        interleavedVertices.insert(interleavedVertices.end(), &vertices[i], &vertices[i] + 3);
-
-        //interleavedVertices.push_back(normals[i]);
-        //interleavedVertices.push_back(normals[i+1]);
-        //interleavedVertices.push_back(normals[i+2]);
-        interleavedVertices.insert(interleavedVertices.end(), &normals[i], &normals[i] + 3);
-
-        //interleavedVertices.push_back(texCoords[j]);
-        //interleavedVertices.push_back(texCoords[j+1]);
-        interleavedVertices.insert(interleavedVertices.end(), &texCoords[j], &texCoords[j] + 2);
-    }
 }
 
 void Cylinder::buildUnitCircleVertices()
@@ -267,6 +300,7 @@ void Cylinder::buildUnitCircleVertices()
     float sectorAngle;  // radian
 
     std::vector<float>().swap(unitCircleVertices);
+    unitCircleVertices.reserve((sectorCount + 1) * 3);
     for (int i = 0; i <= sectorCount; ++i)
     {
         sectorAngle = i * sectorStep;
@@ -276,24 +310,17 @@ void Cylinder::buildUnitCircleVertices()
     }
 }
 
-void Cylinder::addVertex(float x, float y, float z)
-{
-    vertices.push_back(x);
-    vertices.push_back(y);
-    vertices.push_back(z);
-}
-
-void Cylinder::addNormal(float nx, float ny, float nz)
+void Cylinder::addVertex(float x, float y, float z, float nx, float ny, float nz, float s, float t)
 {
-    normals.push_back(nx);
-    normals.push_back(ny);
-    normals.push_back(nz);
-}
+    const float vertex[8] = { x, y, z, nx, ny, nz, s, t };
+    interleavedVertices.insert(interleavedVertices.end(), vertex, vertex + 8);
 
-void Cylinder::addTexCoord(float s, float t)
-{
-    texCoords.push_back(s);
-    texCoords.push_back(t);
+    if (buildFlags & CYLINDER_SEPARATE_ARRAYS)
+    {
+        vertices.insert(vertices.end(), vertex, vertex + 3);
+        normals.insert(normals.end(), vertex + 3, vertex + 6);
+        texCoords.insert(texCoords.end(), vertex + 6, vertex + 8);
+    }
 }
 
 void Cylinder::addIndices(unsigned int i1, unsigned int i2, unsigned int i3)
@@ -303,39 +330,14 @@ void Cylinder::addIndices(unsigned int i1, unsigned int i2, unsigned int i3)
     indices.push_back(i3);
 }
 
-std::vector<float> Cylinder::getSideNormals()
-{
-    const float PI = acos(-1);
-    float sectorStep = 2 * PI / sectorCount;
-    float sectorAngle;  // radian
-
-    // compute the normal vector at 0 degree first
-    // tanA = (baseRadius-topRadius) / height
-    float zAngle = atan2(baseRadius - topRadius, height);
-    float x0 = cos(zAngle);     // nx
-    float y0 = 0;               // ny
-    float z0 = sin(zAngle);     // nz
-
-    // rotate (x0,y0,z0) per sector angle
-    std::vector<float> normals;
-    for (int i = 0; i <= sectorCount; ++i)
-    {
-        sectorAngle = i * sectorStep;
-        normals.push_back(cos(sectorAngle) * x0 - sin(sectorAngle) * y0);   // nx
-        normals.push_back(sin(sectorAngle) * x0 + cos(sectorAngle) * y0);   // ny
-        normals.push_back(z0);  // nz
-    }
-
-    return normals;
-}
-
-std::vector<float> Cylinder::computeFaceNormal(float x1, float y1, float z1,  // v1
+void Cylinder::computeFaceNormal(float x1, float y1, float z1,  // v1
     float x2, float y2, float z2,  // v2
-    float x3, float y3, float z3)  // v3
+    float x3, float y3, float z3,  // v3
+    float normal[3])
 {
     const float EPSILON = 0.000001f;
 
-    std::vector<float> normal(3, 0.0f);     // default return value (0,0,0)
+    normal[0] = normal[1] = normal[2] = 0.0f;   // default value (0,0,0)
     float nx, ny, nz;
 
     // find 2 edge vectors: v1-v2, v1-v3
@@ -361,5 +363,4 @@ std::vector<float> Cylinder::computeFaceNormal(float x1, float y1, float z1,  //
         normal[1] = ny * lengthInv;
         normal[2] = nz * lengthInv;
     }
-    return normal;
 }
\ No newline at end of file
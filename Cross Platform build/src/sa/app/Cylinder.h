@@ -1,11 +1,20 @@
 #pragma once
 #include <vector>
+#include "gpu_mesh.h"
+
+// optional outputs; by default only the interleaved vertices and triangle indices are built
+enum CylinderBuildFlags
+{
+    CYLINDER_SEPARATE_ARRAYS = 1,   // vertices/normals/texCoords as separate arrays as well
+    CYLINDER_LINE_INDICES = 2       // wireframe line indices
+};
+
 class Cylinder
 {
 public:
     // ctor/dtor
     Cylinder(float baseRadius = 1.0f, float topRadius = 1.0f, float height = 1.0f,
-        int sectorCount = 36, int stackCount = 1, bool smooth = true);
+        int sectorCount = 36, int stackCount = 1, bool smooth = true, int buildFlags = 0);
     ~Cylinder() {}
 
     // getters/setters
@@ -22,12 +31,14 @@ public:
     void setSectorCount(int sectorCount);
     void setStackCount(int stackCount);
     void setSmooth(bool smooth);
+    void setBuildFlags(int buildFlags);
+    int getBuildFlags() const { return buildFlags; }
 
-    // for vertex data
-    unsigned int getVertexCount() const { return (unsigned int)vertices.size() / 3; }
+    // for vertex data; counts stay valid after releaseCpuData()
+    unsigned int getVertexCount() const { return vertexCount; }
     unsigned int getNormalCount() const { return (unsigned int)normals.size() / 3; }
     unsigned int getTexCoordCount() const { return (unsigned int)texCoords.size() / 2; }
-    unsigned int getIndexCount() const { return (unsigned int)indices.size(); }
+    unsigned int getIndexCount() const { return indexCount; }
     unsigned int getLineIndexCount() const { return (unsigned int)lineIndices.size(); }
     unsigned int getTriangleCount() const { return getIndexCount() / 3; }
     unsigned int getVertexSize() const { return (unsigned int)vertices.size() * sizeof(float); }
@@ -43,18 +54,24 @@ public:
 
     // for interleaved vertices: V/N/T
     unsigned int getInterleavedVertexCount() const { return getVertexCount(); }    // # of vertices
-    unsigned int getInterleavedVertexSize() const { return (unsigned int)interleavedVertices.size() * sizeof(unsigned int); }    // # of bytes
+    unsigned int getInterleavedVertexSize() const { return (unsigned int)interleavedVertices.size() * sizeof(float); }    // # of bytes
     int getInterleavedStride() const { return interleavedStride; }   // should be 32 bytes
-    const float* getInterleavedVertices() const { return &interleavedVertices[0]; }
+    const float* getInterleavedVertices() const { return interleavedVertices.data(); }
 
     // for indices of base/top/side parts
-    unsigned int getBaseIndexCount() const { return ((unsigned int)indices.size() - baseIndex) / 2; }
-    unsigned int getTopIndexCount() const { return ((unsigned int)indices.size() - baseIndex) / 2; }
+    unsigned int getBaseIndexCount() const { return (indexCount - baseIndex) / 2; }
+    unsigned int getTopIndexCount() const { return (indexCount - baseIndex) / 2; }
     unsigned int getSideIndexCount() const { return baseIndex; }
     unsigned int getBaseStartIndex() const { return baseIndex; }
     unsigned int getTopStartIndex() const { return topIndex; }
     unsigned int getSideStartIndex() const { return 0; }   // side starts from the begining
 
+    // GPU copy: after upload() the CPU arrays can be released and draw() keeps working;
+    // the setters rebuild it with the geometry
+    void upload();
+    void releaseCpuData();
+    const GpuMesh& getMesh() const { return mesh; }
+
     void draw() const;          // draw all
 
 
@@ -63,17 +80,14 @@ protected:
 private:
     // member functions
     void clearArrays();
+    void rebuild();
     void buildVerticesSmooth();
-    void buildInterleavedVertices();
     void buildUnitCircleVertices();
-    void addVertex(float x, float y, float z);
-    void addNormal(float x, float y, float z);
-    void addTexCoord(float s, float t);
+    void addVertex(float x, float y, float z, float nx, float ny, float nz, float s, float t);
     void addIndices(unsigned int i1, unsigned int i2, unsigned int i3);
-    std::vector<float> getSideNormals();
-    std::vector<float> computeFaceNormal(float x1, float y1, float z1,
+    void computeFaceNormal(float x1, float y1, float z1,
         float x2, float y2, float z2,
-        float x3, float y3, float z3);
+        float x3, float y3, float z3, float normal[3]);
 
     // memeber vars
     float baseRadius;
@@ -83,7 +97,10 @@ private:
     int stackCount;                         // # of stacks
     unsigned int baseIndex;                 // starting index of base
     unsigned int topIndex;                  // starting index of top
+    unsigned int vertexCount;
+    unsigned int indexCount;
     bool smooth;
+    int buildFlags;                         // CylinderBuildFlags
     std::vector<float> unitCircleVertices;
     std::vector<float> vertices;
     std::vector<float> normals;
@@ -95,4 +112,6 @@ private:
     std::vector<float> interleavedVertices;
     int interleavedStride;                  // # of bytes to hop to the next vertex (should be 32 bytes)
 
+    GpuMesh mesh;
+
 };
\ No newline at end of file
@@ -7,19 +7,79 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
 #include <iostream>
+#include <thread>
 #include"camera.h"
 #include"shader.h"
 #include"Cylinder.h"
 #include "black_hole.h"
+#include "geometry_cache.h"
+#include "shader_cache.h"
+#include "lighting_block.h"
+#include "cluster_lighting.h"
+#include "instanced_renderer.h"
+#include "lod_manager.h"
+#include "run_options.h"
+#include "headless_context.h"
+#include "offscreen_target.h"
+#include "frame_timings.h"
+#include "image_writer.h"
+#include "camera_path.h"
+#include "profiler.h"
+#include "performance_hud.h"
+#include "frame_scheduler.h"
+#include "frame_snapshot.h"
+#include "job_system.h"
+#include "texture_manager.h"
+
+
+// dim lights spiralling along the tunnel wall, on top of the scene's hand placed lights
+#define NR_TUNNEL_LIGHTS 128
+// thin bands lining the tunnel, drawn with one instanced call
+#define NR_TUNNEL_RINGS 1000
+// the tunnel is split along its length so far segments can use coarser levels
+#define NR_TUNNEL_SEGMENTS 10
+
+// sector counts of the resident LOD levels, finest first
+const int LOD_SECTORS[] = { 64, 32, 16, 8 };
+const unsigned int LOD_LEVELS = sizeof(LOD_SECTORS) / sizeof(LOD_SECTORS[0]);
+// headless runs advance one simulation step per frame so every run renders the same frames
+const float HEADLESS_TIMESTEP = (float)SIMULATION_TIMESTEP;
+// the black hole turns about its poles, degrees per second
+const float WORMHOLE_SPIN = 6.0f;
+
+// what the fixed-rate simulation advances; frames draw an interpolation of the last two
+struct SimulationState
+{
+    glm::vec3 cameraPosition = glm::vec3(0.0f);
+    float wormholeAngle = 0.0f;
+};
 
+// uniform handles for shader.fs, resolved once after the program is linked
+struct SceneUniforms
+{
+    UniformHandle<glm::mat4> view, projection;
+    UniformHandle<glm::vec3> viewPos;
+    UniformHandle<float> materialShininess;
+};
 
 // functions
+SceneUniforms resolveSceneUniforms(const Shader& shader);
+void setupLighting(LightingBuffer& lighting);
+void buildTunnelRings(InstancedRenderer& rings, float tunnelLength);
+std::vector<unsigned int> buildTunnelLods(LodManager& lods, const CylinderKey& tunnel);
+unsigned int buildBlackHoleLods(LodManager& lods, const glm::mat4& model);
+std::vector<PointLightData> buildPointLights(const glm::vec3* positions, unsigned int count,
+    const std::vector<glm::vec3>& colorPositions, const std::vector<glm::vec3>& colors);
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow* window);
-unsigned int loadTexture(const char* path);
+void processMovement(GLFWwindow* window, float step);
+void scriptedCameraPose(Camera& camera, float time);
 
 
 int t = 0;
@@ -38,85 +98,80 @@ float lastY = SCR_HEIGHT / 2.0f;
 bool firstMouse = true;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
+PerformanceHud hud;
+bool showHud = false;           // 'H', applied by the render thread
+bool traceRequested = false;    // 'P', written by the render thread
 
-int main()
+int main(int argc, char** argv)
 {
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    RunOptions options;
+    if (!parseRunOptions(argc, argv, options))
+        return -1;
+    // mesh generation, LOD builds and light binning run as jobs on one worker per spare core
+    jobSystem().create();
+
+    // headless runs get an EGL context with no window and draw into an offscreen framebuffer
+    HeadlessContext headlessContext;
+    GLFWwindow* window = NULL;
+    if (options.headless)
+    {
+        if (!headlessContext.create(3, 3))
+            return -1;
+        SCR_WIDTH = (float)options.width;
+        SCR_HEIGHT = (float)options.height;
+    }
+    else
+    {
+        glfwInit();
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
 #ifdef __APPLE__
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
 
-    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Sheras Dark Pyramid", NULL, NULL);
-    if (window == NULL)
-    {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return -1;
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Sheras Dark Pyramid", NULL, NULL);
+        if (window == NULL)
+        {
+            std::cout << "Failed to create GLFW window" << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        glfwMakeContextCurrent(window);
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+        glfwSetCursorPosCallback(window, mouse_callback);
+        glfwSetScrollCallback(window, scroll_callback);
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+
+        if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+        {
+            std::cout << "Failed to initialize GLAD" << std::endl;
+            return -1;
+        }
+        hud.create();
     }
-    glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    glfwSetCursorPosCallback(window, mouse_callback);
-    glfwSetScrollCallback(window, scroll_callback);
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    // the simulation steps at a fixed rate; windowed frames are paced as asked
+    FrameScheduler scheduler;
+    if (!options.headless)
     {
-        std::cout << "Failed to initialize GLAD" << std::endl;
-        return -1;
+        glfwSwapInterval(options.pacing == PACING_VSYNC ? 1 : 0);
+        scheduler.setPacing(options.pacing, options.targetFps);
     }
 
     glEnable(GL_DEPTH_TEST);
 
-    Shader shader("shader.vs", "shader.fs");
-
-    float vertices[] = {
-        // positions          // normals           // texture coords
-        -0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f,  0.0f,
-         0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f,  0.0f,
-         0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f,  1.0f,
-         0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f,  1.0f,
-        -0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f,  1.0f,
-        -0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f,  0.0f,
-
-        -0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f,  0.0f,
-         0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f,  0.0f,
-         0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f,  1.0f,
-         0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f,  1.0f,
-        -0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f,  1.0f,
-        -0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f,  0.0f,
-
-        -0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
-        -0.5f,  0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  1.0f,  1.0f,
-        -0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  0.0f,  1.0f,
-        -0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  0.0f,  1.0f,
-        -0.5f, -0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  0.0f,  0.0f,
-        -0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
-
-         0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
-         0.5f,  0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  1.0f,  1.0f,
-         0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  0.0f,  1.0f,
-         0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  0.0f,  1.0f,
-         0.5f, -0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  0.0f,  0.0f,
-         0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
-
-        -0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f,  1.0f,
-         0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  1.0f,  1.0f,
-         0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  1.0f,  0.0f,
-         0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  1.0f,  0.0f,
-        -0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  0.0f,  0.0f,
-        -0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f,  1.0f,
-
-        -0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f,  1.0f,
-         0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  1.0f,  1.0f,
-         0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  1.0f,  0.0f,
-         0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  1.0f,  0.0f,
-        -0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  0.0f,  0.0f,
-        -0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f,  1.0f
-    };
+    // linked programs are kept in memory and, where supported, as binaries on disk
+    ShaderCache shaderCache("shader_cache");
+    std::shared_ptr<Shader> sceneShader = shaderCache.load("shader.vs", "shader.fs");
+    if (!sceneShader)
+    {
+        glfwTerminate();
+        return -1;
+    }
+    Shader& shader = *sceneShader;
+    SceneUniforms uniforms = resolveSceneUniforms(shader);
 
     glm::vec3 directLightPositions[] = {
         glm::vec3(0.7f,  0.2f,  2.0f),
@@ -141,183 +196,642 @@ int main()
     lightColors.push_back(glm::vec3(0.0f, 0.0f, 0.2f));
     lightColors.push_back(glm::vec3(0.0f, 0.1f, 0.0f));
 
-    unsigned int diffuseMap = loadTexture("resources/textures/space/5.jpeg");
-    unsigned int specularMap = loadTexture("resources/textures/space/5.jpeg");
-    unsigned int wormholeTexture = loadTexture("resources/textures/space/5.jpeg");
-    unsigned int tex1 = loadTexture("resources/textures/space/2.png");
-    unsigned int tex2 = loadTexture("resources/textures/space/6.png");
-    unsigned int tex3 = loadTexture("resources/textures/space/5.png");
-    unsigned int tex4 = loadTexture("resources/textures/space/5.jpeg");
+    // decoded by jobs while the rest of the scene is built; each shows a placeholder until
+    // its image is uploaded. Cooked DXT copies are kept next to the shader binaries.
+    if (options.compressTextures)
+        textureManager().setCompression("texture_cache");
+    textures.push_back(textureManager().load("resources/textures/space/2.png"));
+    textures.push_back(textureManager().load("resources/textures/space/6.png"));
+    textures.push_back(textureManager().load("resources/textures/space/5.png"));
+    textures.push_back(textureManager().load("resources/textures/space/5.jpeg"));
+
+    // lights live in a uniform buffer shared by all programs and are only re-sent when they change
+    LightingBuffer lighting;
+    lighting.create();
+    lighting.attach(shader);
+    setupLighting(lighting);
+
+    // point lights are binned into view-space clusters every frame
+    ClusteredLighting clusteredLighting;
+    clusteredLighting.create();
+    clusteredLighting.attach(shader);
+    clusteredLighting.setLights(buildPointLights(directLightPositions, 8, lightPositions, lightColors));
+
+    // the tunnel is built and uploaded once, then reused every frame
+    GeometryCache geometryCache;
+    CylinderKey tunnelKey;
+    tunnelKey.baseRadius = 1.5f;
+    tunnelKey.topRadius = 1.5f;
+    tunnelKey.height = 100.0f;
+    tunnelKey.sectorCount = 36;
+    tunnelKey.smooth = true;
+
+    // every ring shares one cached mesh; the instances never change, so they are uploaded once
+    CylinderKey ringKey = tunnelKey;
+    ringKey.baseRadius = 1.45f;
+    ringKey.topRadius = 1.45f;
+    ringKey.height = 0.01f;
+    InstancedRenderer tunnelRings;
+    tunnelRings.create();
+    tunnelRings.attach(shader);
+    buildTunnelRings(tunnelRings, tunnelKey.height);
+
+    // tunnel segments and the black hole keep every level resident and pick one per frame
+    LodManager lods;
+    std::vector<unsigned int> tunnelSegments = buildTunnelLods(lods, tunnelKey);
+    glm::mat4 blackHoleModel = glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f), glm::vec3(0.01f, 0.0f, 0.f));
+    unsigned int blackHole = buildBlackHoleLods(lods, blackHoleModel);
+
+    // --play drives the camera from a recorded path, --record captures one
+    CameraPath cameraPath;
+    const bool playing = !options.playPath.empty();
+    const bool recording = !options.recordPath.empty();
+    if (playing && !cameraPath.load(options.playPath))
+        return -1;
+    unsigned int measuredFrames = options.frames;
+    if (measuredFrames == 0)
+        measuredFrames = playing ? cameraPath.size() : DEFAULT_HEADLESS_FRAMES;
+
+    // every frame is timed; headless runs print each one as its GPU time comes in
+    OffscreenTarget offscreen;
+    GpuTimer gpuTimer;
+    gpuTimer.create();
+    FrameTimings timings;
+    const bool printFrames = options.headless && options.printFrames;
+    std::vector<unsigned char> framePixels;
+    if (options.headless)
+    {
+        if (!offscreen.create(options.width, options.height))
+            return -1;
+        offscreen.bind();
+        if (options.format != FRAME_NONE)
+        {
+            std::error_code error;
+            std::filesystem::create_directories(options.outputDirectory, error);
+        }
+    }
+    // headless frames must not depend on how far the decodes got, so they start complete
+    if (options.headless)
+        textureManager().finish();
+
+    // The main thread simulates (GLFW only delivers input there) and a render thread owns the
+    // GL context and draws. They only meet in `snapshots`: each frame the simulation publishes
+    // an immutable FrameSnapshot and moves on to the next while the previous one is drawn.
+    SnapshotBuffer snapshots;
+    const float initialWidth = SCR_WIDTH;
+    const float initialHeight = SCR_HEIGHT;
+    if (options.headless)
+        headlessContext.doneCurrent();
+    else
+        glfwMakeContextCurrent(NULL);
+    std::thread renderThread([&]()
+    {
+        PROFILE_THREAD("render");
+        bool current = true;
+        if (options.headless)
+            current = headlessContext.makeCurrent();
+        else
+            glfwMakeContextCurrent(window);
+        jobSystem().setGlThread();
+        float viewportWidth = initialWidth;
+        float viewportHeight = initialHeight;
+        for (;;)
+        {
+            const FrameSnapshot& snapshot = snapshots.acquire();
+            if (snapshot.quit || !current)
+            {
+                const bool quit = snapshot.quit;
+                snapshots.release();
+                if (quit)
+                    break;
+                continue;
+            }
+            PROFILE_FRAME();
+            PROFILE_SCOPE("frame");
+            renderCounters().beginFrame();
+            jobSystem().runGlThreadJobs();
+            textureManager().update();
+
+            // a full query ring means the oldest frame has to finish before this one is timed
+            if (gpuTimer.getPending() == GpuTimer::LATENCY)
+                timings.collect(gpuTimer, printFrames, 1);
+            if (!options.headless && (snapshot.viewportWidth != viewportWidth || snapshot.viewportHeight != viewportHeight))
+            {
+                viewportWidth = snapshot.viewportWidth;
+                viewportHeight = snapshot.viewportHeight;
+                glViewport(0, 0, (int)viewportWidth, (int)viewportHeight);
+            }
+            if (snapshot.measured)
+                gpuTimer.begin(snapshot.tick);
+            std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+
+            const glm::mat4& projection = snapshot.projection;
+            const glm::mat4& view = snapshot.view;
+            glm::mat4 model = glm::mat4(1.0f);
+            {
+                PROFILE_SCOPE("scene uniforms");
+                glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+                shader.use();
+                uniforms.viewPos.set(snapshot.camera.Position);
+                uniforms.materialShininess.set(32.0f);
+
+                InstancedRenderer::setSingleInstance(model);
+                uniforms.projection.set(projection);
+                uniforms.view.set(view);
+            }
+            {
+                // only the flashlight pose and (on resize) the cluster grid change per frame;
+                // the rest of the block stays resident. The lights were binned by the simulation.
+                PROFILE_SCOPE("lighting");
+                lighting.setSpotLightPose(snapshot.camera.Position, snapshot.camera.Front);
+                clusteredLighting.upload(snapshot.clusterBins, lighting);
+                lighting.upload();
+                clusteredLighting.bind();
+            }
+
+            glActiveTexture(GL_TEXTURE2);
+            glBindTexture(GL_TEXTURE_2D, snapshot.tunnelTexture);
+            countStateChanges();
+
+
+            float ambient[] = { 0.5f, 0.5f, 0.5f, 1 };
+            float diffuse[] = { 0.8f, 0.8f, 0.8f, 1 };
+            float specular[] = { 1.0f, 1.0f, 1.0f, 1 };
+            float shininess = 128;
+            glMaterialfv(GL_FRONT, GL_AMBIENT, ambient);
+            glMaterialfv(GL_FRONT, GL_DIFFUSE, diffuse);
+            glMaterialfv(GL_FRONT, GL_SPECULAR, specular);
+            glMaterialf(GL_FRONT, GL_SHININESS, shininess);
+
+            {
+                PROFILE_SCOPE("tunnel");
+                PROFILE_GPU_SCOPE("tunnel");
+                for (const LodDraw& segment : snapshot.tunnelDraws)
+                    lods.draw(segment);
+            }
+            {
+                // ring sides only, the caps would close off the tunnel
+                PROFILE_SCOPE("rings");
+                PROFILE_GPU_SCOPE("rings");
+                const CachedCylinder& ring = geometryCache.getCylinder(ringKey);
+                tunnelRings.draw(ring.mesh, ring.sideStart, ring.sideCount);
+            }
+            {
+                PROFILE_SCOPE("black hole");
+                PROFILE_GPU_SCOPE("black hole");
+                shader.use();
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, snapshot.blackHoleTexture);
+                countStateChanges();
+                lods.draw(snapshot.blackHoleDraw);
+            }
+            lods.endFrame();
+
+            // the frame is submitted: keep what is left to do and hand the slot back, so the
+            // simulation can fill it while this frame is read back and presented
+            const bool measured = snapshot.measured;
+            const unsigned int tick = snapshot.tick;
+            const float frameMilliseconds = snapshot.frameMilliseconds;
+            const bool hudVisible = snapshot.showHud;
+            const bool writeTrace = snapshot.writeTrace;
+            snapshots.release();
+
+            if (measured)
+            {
+                // CPU time covers recording and submitting the frame, not presenting or reading it back
+                gpuTimer.end();
+                timings.cpuMilliseconds.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count());
+                if (options.headless && options.format != FRAME_NONE)
+                {
+                    PROFILE_SCOPE("readback");
+                    offscreen.readPixels(framePixels);
+                    std::string path = frameFileName(options, tick);
+                    if (options.format == FRAME_PNG)
+                        writePng(path, options.width, options.height, framePixels.data());
+                    else
+                        writeRaw(path, options.width, options.height, framePixels.data());
+                }
+                timings.collect(gpuTimer, printFrames, 0);
+            }
+#ifdef SA_PROFILER
+            if (writeTrace && profiler().writeChromeTrace("profile_trace.json"))
+                std::cout << "Profiler trace written to profile_trace.json" << std::endl;
+#else
+            (void)writeTrace;
+#endif
+            if (!options.headless)
+            {
+                PROFILE_SCOPE("hud");
+                hud.setVisible(hudVisible);
+                hud.addFrame(frameMilliseconds, renderCounters());
+                hud.draw(viewportWidth, viewportHeight);
+            }
+            if (!options.headless)
+            {
+                PROFILE_SCOPE("glfwSwapBuffers");
+                glfwSwapBuffers(window);
+            }
+        }
+        if (options.headless)
+            headlessContext.doneCurrent();
+        else
+            glfwMakeContextCurrent(NULL);
+    });
+
+    SimulationState simulation, previousSimulation;
+    simulation.cameraPosition = previousSimulation.cameraPosition = camera.Position;
+    unsigned int frame = 0;
+    PROFILE_THREAD("main");
+    while (options.headless ? frame < options.warmupFrames + measuredFrames : !glfwWindowShouldClose(window))
+    {
+        PROFILE_SCOPE("simulate");
+        // headless warm-up frames (first shader use, first uploads; llvmpipe also reports a bogus
+        // time for the first query on a new framebuffer) show the first pose and are not measured
+        const bool measured = !options.headless || frame >= options.warmupFrames;
+        // index among the measured frames, which is also the camera path tick
+        const unsigned int tick = measured ? frame - (options.headless ? options.warmupFrames : 0) : 0;
+        if (playing && !options.headless && tick >= cameraPath.size())
+            break;
+
+        if (options.headless)
+        {
+            deltaTime = HEADLESS_TIMESTEP;
+            if (!playing)
+                scriptedCameraPose(camera, tick * HEADLESS_TIMESTEP);
+        }
+        else
+        {
+            PROFILE_SCOPE("input");
+            float currentFrame = static_cast<float>(glfwGetTime());
+            deltaTime = currentFrame - lastFrame;
+            lastFrame = currentFrame;
+            processInput(window);
+        }
+        // playback overrides any input with the recorded pose and advances one tick per frame
+        if (playing)
+        {
+            deltaTime = cameraPath.getTimestep();
+            cameraPath.apply(camera, tick);
+        }
+        // scripted and recorded poses are set per frame; only live runs simulate the camera
+        const bool liveCamera = !options.headless && !playing;
+        if (!liveCamera)
+            simulation.cameraPosition = camera.Position;
+        {
+            PROFILE_SCOPE("simulation");
+            const unsigned int steps = scheduler.beginFrame(options.headless ? scheduler.getTimestep() : deltaTime);
+            const float step = (float)scheduler.getTimestep();
+            for (unsigned int i = 0; i < steps; i++)
+            {
+                previousSimulation = simulation;
+                if (liveCamera)
+                {
+                    // drift back down the tunnel, plus whatever the keys add
+                    camera.ProcessKeyboard(BACKWARD, step / 3);
+                    processMovement(window, step);
+                    simulation.cameraPosition = camera.Position;
+                }
+                simulation.wormholeAngle = std::fmod(simulation.wormholeAngle + WORMHOLE_SPIN * step, 360.0f);
+            }
+            if (!liveCamera)
+                previousSimulation.cameraPosition = simulation.cameraPosition;
+        }
+        if (recording && measured)
+            cameraPath.advance(camera, deltaTime);
+
+        // the frame is drawn between the last two simulated states
+        const float alpha = scheduler.getAlpha();
+        Camera eye = camera;
+        eye.Position = glm::mix(previousSimulation.cameraPosition, simulation.cameraPosition, alpha);
+        float spin = simulation.wormholeAngle - previousSimulation.wormholeAngle;
+        if (spin < 0.0f)
+            spin += 360.0f;     // wrapped during the last step
+        float wormholeAngle = previousSimulation.wormholeAngle + alpha * spin;
+        {
+            // waits here when the renderer is two frames behind
+            PROFILE_SCOPE("publish");
+            FrameSnapshot& snapshot = snapshots.beginWrite();
+            snapshot.frame = frame;
+            snapshot.tick = tick;
+            snapshot.measured = measured;
+            snapshot.quit = false;
+            snapshot.camera = eye;
+            snapshot.viewportWidth = SCR_WIDTH;
+            snapshot.viewportHeight = SCR_HEIGHT;
+            snapshot.projection = glm::perspective(glm::radians(eye.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+            snapshot.view = eye.GetViewMatrix();
+            {
+                // the frame's CPU work, done here while the renderer draws the last one
+                PROFILE_SCOPE("prepare");
+                clusteredLighting.bin(snapshot.view, snapshot.projection, 0.1f, 100.0f, snapshot.viewportWidth,
+                    snapshot.viewportHeight, snapshot.clusterBins);
+                lods.setModel(blackHole, blackHoleModel * glm::translate(glm::mat4(1.0f), BlackHole::center())
+                    * glm::rotate(glm::mat4(1.0f), glm::radians(wormholeAngle), glm::vec3(0.0f, 1.0f, 0.0f))
+                    * glm::translate(glm::mat4(1.0f), -BlackHole::center()));
+                lods.beginFrame(eye, snapshot.projection, snapshot.viewportHeight);
+                snapshot.tunnelDraws.clear();
+                for (unsigned int segment : tunnelSegments)
+                    snapshot.tunnelDraws.push_back(lods.choose(segment));
+                snapshot.blackHoleDraw = lods.choose(blackHole);
+            }
+            snapshot.tunnelTexture = textures[t];
+            snapshot.blackHoleTexture = textures[r];
+            snapshot.frameMilliseconds = deltaTime * 1000.0f;
+            snapshot.showHud = showHud;
+            snapshot.writeTrace = traceRequested;
+            traceRequested = false;
+            snapshots.publish();
+        }
+        if (!options.headless)
+        {
+            // input is polled after the wait so it is as fresh as possible for the next frame
+            PROFILE_SCOPE("pacing");
+            scheduler.waitForNextFrame();
+            glfwPollEvents();
+        }
+        frame++;
+    }
 
+    // the last snapshot stops the render thread, which hands the context back
+    snapshots.beginWrite().quit = true;
+    snapshots.publish();
+    renderThread.join();
+    if (options.headless)
+        headlessContext.makeCurrent();
+    else
+        glfwMakeContextCurrent(window);
+    jobSystem().setGlThread();
+
+    timings.collect(gpuTimer, printFrames, gpuTimer.getPending());
+    timings.printSummary();
+    if (!options.frameLogPath.empty())
+    {
+        std::string description = std::string(options.headless ? "headless " : "windowed ")
+            + std::to_string((int)SCR_WIDTH) + "x" + std::to_string((int)SCR_HEIGHT)
+            + (playing ? ", camera path " + options.playPath : options.headless ? ", scripted camera" : ", live input");
+        timings.writeLog(options.frameLogPath, description);
+    }
+    if (recording && cameraPath.save(options.recordPath))
+        std::cout << "Camera path: " << cameraPath.size() << " ticks (" << cameraPath.getDuration() << " s) recorded to "
+            << options.recordPath << std::endl;
+    gpuTimer.release();
+    offscreen.release();
+    hud.release();
+    const SnapshotBuffer::Stats& snapshotStats = snapshots.getStats();
+    std::cout << "Snapshots: " << snapshotStats.published << " published, simulation waited " << snapshotStats.simulationWaits
+        << " times, render thread waited " << snapshotStats.renderWaits << " times" << std::endl;
+    const FrameScheduler::Stats& schedulerStats = scheduler.getStats();
+    std::cout << "Frame scheduler: " << schedulerStats.steps << " steps in " << schedulerStats.frames << " frames, "
+        << schedulerStats.droppedSeconds << " s dropped, " << schedulerStats.sleptMilliseconds << " ms slept, "
+        << schedulerStats.spunMilliseconds << " ms spun" << std::endl;
+
+#ifdef SA_PROFILER
+    // two more frame boundaries read back the last two frames' GPU scopes
+    glFinish();
+    profiler().beginFrame();
+    profiler().beginFrame();
+    if (!options.tracePath.empty() && profiler().writeChromeTrace(options.tracePath))
+        std::cout << "Profiler trace written to " << options.tracePath << std::endl;
+    const Profiler::Stats& profileStats = profiler().getStats();
+    std::cout << "Profiler: " << profileStats.cpuEvents << " CPU and " << profileStats.gpuEvents << " GPU events from "
+        << profileStats.threads << " threads, " << profileStats.droppedEvents << " dropped" << std::endl;
+    profiler().release();
+#else
+    if (!options.tracePath.empty())
+        std::cout << "--trace needs a build with SA_PROFILER (any configuration but Release)" << std::endl;
+#endif
 
-    textures.push_back(tex1);
-    textures.push_back(tex2);
-    textures.push_back(tex3);
-    textures.push_back(tex4);
+    const GeometryCache::Stats& geometryStats = geometryCache.getStats();
+    std::cout << "Geometry cache: " << geometryStats.hits << " hits, " << geometryStats.misses << " misses" << std::endl;
+    geometryCache.clear();
+
+    const TextureManager::Stats& textureStats = textureManager().getStats();
+    std::cout << "Textures: " << textureStats.requests << " requests, " << textureStats.duplicates << " shared ("
+        << textureStats.contentDuplicates << " by content), " << textureStats.evictions << " evicted, "
+        << textureStats.uploads << " uploaded, " << textureStats.failed << " failed, " << textureStats.streamedBytes
+        << " bytes streamed (" << (textureStats.persistentMapping ? "persistent mapping" : "mapped per upload") << ")" << std::endl;
+    if (textureStats.compressed)
+        std::cout << "Compressed textures: " << textureStats.compressed << " (" << textureStats.cacheHits << " from the cache), "
+            << textureStats.compressedBytes << " bytes instead of " << textureStats.uncompressedBytes << std::endl;
+    textureManager().release();
+
+    const ShaderCache::Stats& shaderStats = shaderCache.getStats();
+    std::cout << "Shader cache: " << shaderStats.compiled << " compiled, " << shaderStats.binaryHits << " loaded from binary" << std::endl;
+#ifdef SA_PROFILER
+    const UniformStats& uniformStatistics = uniformStats();
+    std::cout << "Uniform handles: " << uniformStatistics.lookupsAvoided << " lookups avoided, "
+        << uniformStatistics.allocationsAvoided << " name strings not built, "
+        << uniformStatistics.stringLookups << " name lookups made" << std::endl;
+#endif
+    const LightingBuffer::Stats& lightingStats = lighting.getStats();
+    std::cout << "Lighting buffer: " << lightingStats.uploads << " uploads, " << lightingStats.bytesUploaded << " bytes" << std::endl;
+    const ClusteredLighting::Stats& clusterStats = clusteredLighting.getStats();
+    std::cout << "Clustered lighting: " << clusterStats.lights << " lights, " << clusterStats.occupiedClusters << " occupied clusters, "
+        << clusterStats.maxPerCluster << " max per cluster, " << clusterStats.binMilliseconds << " ms last bin" << std::endl;
+    const InstancedRenderer::Stats& ringStats = tunnelRings.getStats();
+    std::cout << "Tunnel rings: " << tunnelRings.size() << " instances, " << ringStats.drawCalls << " draw calls, "
+        << ringStats.bytesUploaded << " bytes uploaded" << std::endl;
+    tunnelRings.release();
+    const LodManager::Stats& lodStats = lods.getStats();
+    std::cout << "LOD: " << lodStats.frameTriangles << " triangles last frame, "
+        << (lodStats.frames ? lodStats.totalTriangles / lodStats.frames : 0) << " per frame on average; objects per level:";
+    for (unsigned int level = 0; level < LOD_LEVELS; level++)
+        std::cout << " " << LOD_SECTORS[level] << ":" << lodStats.levelObjects[level];
+    std::cout << std::endl;
+    lods.clear();
+    clusteredLighting.release();
+    lighting.release();
+    sceneShader.reset();
+    shaderCache.clear();
+    const JobSystem::Stats& jobStats = jobSystem().getStats();
+    std::cout << "Job system: " << jobSystem().getWorkerCount() << " workers, " << jobStats.jobs << " jobs, "
+        << jobStats.steals << " steals, " << jobStats.inlineJobs << " run inline" << std::endl;
+    jobSystem().release();
 
+    glfwTerminate();
+    return 0;
+}
 
-    float rotation = 0.0f;
-    while (!glfwWindowShouldClose(window))
+SceneUniforms resolveSceneUniforms(const Shader& shader)
+{
+    SceneUniforms uniforms;
+    uniforms.view = shader.uniform<glm::mat4>("view");
+    uniforms.projection = shader.uniform<glm::mat4>("projection");
+    uniforms.viewPos = shader.uniform<glm::vec3>("viewPos");
+    uniforms.materialShininess = shader.uniform<float>("material.shininess");
+
+    return uniforms;
+}
+
+void setupLighting(LightingBuffer& lighting)
+{
+    DirLightData dirLight = {};
+    dirLight.direction = glm::vec3(-0.2f, -1.0f, -0.3f);
+    dirLight.ambient = glm::vec3(0.05f, 0.05f, 0.05f);
+    dirLight.diffuse = glm::vec3(0.4f, 0.4f, 0.4f);
+    dirLight.specular = glm::vec3(0.5f, 0.5f, 0.5f);
+    lighting.setDirLight(dirLight);
+
+    SpotLightData spotLight = {};
+    spotLight.position = camera.Position;
+    spotLight.direction = camera.Front;
+    spotLight.ambient = glm::vec3(0.0f, 0.0f, 0.0f);
+    spotLight.diffuse = glm::vec3(1.0f, 1.0f, 1.0f);
+    spotLight.specular = glm::vec3(1.0f, 1.0f, 1.0f);
+    spotLight.constant = 1.0f;
+    spotLight.linear = 0.09f;
+    spotLight.quadratic = 0.032f;
+    spotLight.cutOff = glm::cos(glm::radians(12.5f));
+    spotLight.outerCutOff = glm::cos(glm::radians(15.0f));
+    lighting.setSpotLight(spotLight);
+    lighting.upload();
+}
+
+void buildTunnelRings(InstancedRenderer& rings, float tunnelLength)
+{
+    rings.clear();
+    rings.reserve(NR_TUNNEL_RINGS);
+    for (unsigned int i = 0; i < NR_TUNNEL_RINGS; i++)
     {
+        float along = (i + 0.5f) / NR_TUNNEL_RINGS;
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, (along - 0.5f) * tunnelLength));
+        // slow blue to violet drift down the tunnel
+        glm::vec4 tint(0.4f + 0.3f * std::sin(along * 12.0f), 0.3f, 0.9f, 1.0f);
+        rings.add(model, tint);
+    }
+}
+
+std::vector<unsigned int> buildTunnelLods(LodManager& lods, const CylinderKey& tunnel)
+{
+    const float segmentHeight = tunnel.height / NR_TUNNEL_SEGMENTS;
 
-        float currentFrame = static_cast<float>(glfwGetTime());
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
-       
-        // animate the camera
-        if (currentFrame - lastFrame >= 1 / 60)
-            camera.ProcessKeyboard(BACKWARD, deltaTime / 3);
-
-
-            
-
-        
-        processInput(window);
-
-        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        shader.use();
-        shader.setVec3("viewPos", camera.Position);
-        shader.setFloat("material.shininess", 32.0f);
-        // light colors
-        shader.setVec3("dirLight.direction", -0.2f, -1.0f, -0.3f);
-        shader.setVec3("dirLight.ambient", 0.05f, 0.05f, 0.05f);
-        shader.setVec3("dirLight.diffuse", 0.4f, 0.4f, 0.4f);
-        shader.setVec3("dirLight.specular", 0.5f, 0.5f, 0.5f);
-
-        shader.setVec3("pointLights[0].position", directLightPositions[0]);
-        shader.setVec3("pointLights[0].ambient", 0.05f, 0.05f, 0.05f);
-        shader.setVec3("pointLights[0].diffuse", 0.8f, 0.8f, 0.8f);
-        shader.setVec3("pointLights[0].specular", 1.0f, 1.0f, 1.0f);
-        shader.setFloat("pointLights[0].constant", 1.0f);
-        shader.setFloat("pointLights[0].linear", 0.09f);
-        shader.setFloat("pointLights[0].quadratic", 0.032f);
-
-        shader.setVec3("pointLights[1].position", directLightPositions[1]);
-        shader.setVec3("pointLights[1].ambient", 0.05f, 0.05f, 0.05f);
-        shader.setVec3("pointLights[1].diffuse", 0.8f, 0.8f, 0.8f);
-        shader.setVec3("pointLights[1].specular", 1.0f, 1.0f, 1.0f);
-        shader.setFloat("pointLights[1].constant", 1.0f);
-        shader.setFloat("pointLights[1].linear", 0.09f);
-        shader.setFloat("pointLights[1].quadratic", 0.032f);
-
-        shader.setVec3("pointLights[2].position", directLightPositions[2]);
-        shader.setVec3("pointLights[2].ambient", 0.05f, 0.05f, 0.05f);
-        shader.setVec3("pointLights[2].diffuse", 0.8f, 0.8f, 0.8f);
-        shader.setVec3("pointLights[2].specular", 1.0f, 1.0f, 1.0f);
-        shader.setFloat("pointLights[2].constant", 1.0f);
-        shader.setFloat("pointLights[2].linear", 0.09f);
-        shader.setFloat("pointLights[2].quadratic", 0.032f);
-
-        shader.setVec3("pointLights[3].position", directLightPositions[3]);
-        shader.setVec3("pointLights[3].ambient", 0.05f, 0.05f, 0.05f);
-        shader.setVec3("pointLights[3].diffuse", 0.8f, 0.8f, 0.8f);
-        shader.setVec3("pointLights[3].specular", 1.0f, 1.0f, 1.0f);
-        shader.setFloat("pointLights[3].constant", 1.0f);
-        shader.setFloat("pointLights[3].linear", 0.09f);
-        shader.setFloat("pointLights[3].quadratic", 0.032f);
-
-        shader.setVec3("spotLight.position", camera.Position);
-        shader.setVec3("spotLight.direction", camera.Front);
-        shader.setVec3("spotLight.ambient", 0.0f, 0.0f, 0.0f);
-        shader.setVec3("spotLight.diffuse", 1.0f, 1.0f, 1.0f);
-        shader.setVec3("spotLight.specular", 1.0f, 1.0f, 1.0f);
-        shader.setFloat("spotLight.constant", 1.0f);
-        shader.setFloat("spotLight.linear", 0.09f);
-        shader.setFloat("spotLight.quadratic", 0.032f);
-        shader.setFloat("spotLight.cutOff", glm::cos(glm::radians(12.5f)));
-        shader.setFloat("spotLight.outerCutOff", glm::cos(glm::radians(15.0f)));
-
-        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        glm::mat4 view = camera.GetViewMatrix();
-        glm::mat4 model = glm::mat4(1.0f);
-       
-        shader.setMat4("model", model);
-        shader.setMat4("projection", projection);
-        shader.setMat4("view", view);
-
-
-        for (unsigned int i = 0; i < lightPositions.size(); i++)
+    // every level of every segment is generated as a job; only the uploads need the GL thread
+    std::vector<GeneratedMesh> levels(NR_TUNNEL_SEGMENTS * LOD_LEVELS);
+    jobSystem().parallelFor((unsigned int)levels.size(), 1, [&](unsigned int first, unsigned int last)
+    {
+        for (unsigned int job = first; job < last; job++)
         {
-            shader.setVec3("lights[" + std::to_string(i) + "].Position", lightPositions[i]);
-            shader.setVec3("lights[" + std::to_string(i) + "].Color", lightColors[i]);
+            const unsigned int segment = job / LOD_LEVELS;
+            const int sectors = LOD_SECTORS[job % LOD_LEVELS];
+            float r0 = tunnel.baseRadius + (tunnel.topRadius - tunnel.baseRadius) * segment / NR_TUNNEL_SEGMENTS;
+            float r1 = tunnel.baseRadius + (tunnel.topRadius - tunnel.baseRadius) * (segment + 1) / NR_TUNNEL_SEGMENTS;
+            GeneratedMesh& geometry = levels[job];
+            generateCylinder(geometry, r0, r1, segmentHeight, sectors, tunnel.stackCount);
+
+            // map the segment's t onto its share of the whole tunnel, as one long cylinder would
+            const unsigned int sideVertices = (tunnel.stackCount + 1) * (sectors + 1);
+            for (unsigned int v = 0; v < sideVertices; v++)
+            {
+                float& texV = geometry.vertices[v * 8 + 7];
+                texV = (NR_TUNNEL_SEGMENTS - segment - 1 + texV) / NR_TUNNEL_SEGMENTS;
+            }
+            // only the two ends of the tunnel keep their caps (indices are side, base, top)
+            if (segment == NR_TUNNEL_SEGMENTS - 1 && segment != 0)
+                geometry.indices.erase(geometry.indices.begin() + geometry.baseStart, geometry.indices.begin() + geometry.topStart);
+            else if (segment == 0 && NR_TUNNEL_SEGMENTS > 1)
+                geometry.indices.resize(geometry.topStart);
+            else if (segment != 0)
+                geometry.indices.resize(geometry.baseStart);
         }
-        shader.setVec3("viewPos", camera.Position);
-
-        unsigned int VBO, cubeVAO;
-        glGenVertexArrays(1, &cubeVAO);
-        glGenBuffers(1, &VBO);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-        glBindVertexArray(cubeVAO);
-
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, textures[t]);
-
-
-        float ambient[] = { 0.5f, 0.5f, 0.5f, 1 };
-        float diffuse[] = { 0.8f, 0.8f, 0.8f, 1 };
-        float specular[] = { 1.0f, 1.0f, 1.0f, 1 };
-        float shininess = 128;
-        glMaterialfv(GL_FRONT, GL_AMBIENT, ambient);
-        glMaterialfv(GL_FRONT, GL_DIFFUSE, diffuse);
-        glMaterialfv(GL_FRONT, GL_SPECULAR, specular);
-        glMaterialf(GL_FRONT, GL_SHININESS, shininess);
-
-        Cylinder cylinder1;
-        cylinder1.setBaseRadius(1.5);
-        cylinder1.setTopRadius(1.5);
-        cylinder1.setHeight(100);
-        cylinder1.setSmooth(true);
-        cylinder1.setSectorCount(36);
-        cylinder1.draw();
-
-        model = glm::mat4(1.0f);
-        shader.use();
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, textures[r]);
-        model = glm::mat4(1.0f);
-        model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(0.01f, 0.0f, 0.f));
-        model = glm::rotate(model, glm::radians(0.0f), glm::vec3(0.01f, 0.0f, 0.f));
-        shader.setMat4("model", model);
-        BlackHole blackHole;
-        blackHole.Draw();
-       
-        glDeleteVertexArrays(1, &cubeVAO);
-        glDeleteBuffers(1, &VBO);
-      
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+    });
+
+    std::vector<unsigned int> objects;
+    for (unsigned int segment = 0; segment < NR_TUNNEL_SEGMENTS; segment++)
+    {
+        float r0 = tunnel.baseRadius + (tunnel.topRadius - tunnel.baseRadius) * segment / NR_TUNNEL_SEGMENTS;
+        float r1 = tunnel.baseRadius + (tunnel.topRadius - tunnel.baseRadius) * (segment + 1) / NR_TUNNEL_SEGMENTS;
+
+        LodShape shape;
+        shape.boundsRadius = glm::length(glm::vec2(segmentHeight * 0.5f, std::max(r0, r1)));
+        shape.lodRadius = std::max(r0, r1);
+        for (unsigned int level = 0; level < LOD_LEVELS; level++)
+            shape.levels.push_back(makeLodLevel(levels[segment * LOD_LEVELS + level], LOD_SECTORS[level]));
+
+        float center = -tunnel.height * 0.5f + (segment + 0.5f) * segmentHeight;
+        unsigned int id = lods.addShape(std::move(shape));
+        objects.push_back(lods.addObject(id, glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, center))));
     }
+    return objects;
+}
 
-    BlackHole blackHole;
-    blackHole.~BlackHole();
-    Cylinder cylinder;
-    cylinder.~Cylinder();
+unsigned int buildBlackHoleLods(LodManager& lods, const glm::mat4& model)
+{
+    LodShape shape;
+    shape.boundsCenter = BlackHole::center();
+    shape.boundsRadius = BlackHole::RADIUS;
+    // only the CPU geometry is used, generated as jobs; each level is uploaded once by makeLodLevel
+    std::vector<GeneratedMesh> levels(LOD_LEVELS);
+    jobSystem().parallelFor(LOD_LEVELS, 1, [&](unsigned int first, unsigned int last)
+    {
+        for (unsigned int level = first; level < last; level++)
+            levels[level] = BlackHole(LOD_SECTORS[level]).getGeometry();
+    });
+    for (unsigned int level = 0; level < LOD_LEVELS; level++)
+        shape.levels.push_back(makeLodLevel(levels[level], LOD_SECTORS[level]));
+    return lods.addObject(lods.addShape(std::move(shape)), model);
+}
 
-    glDeleteTextures(1, &diffuseMap);
-    glDeleteTextures(1, &specularMap);
-    glDeleteTextures(1, &wormholeTexture);
+std::vector<PointLightData> buildPointLights(const glm::vec3* positions, unsigned int count,
+    const std::vector<glm::vec3>& colorPositions, const std::vector<glm::vec3>& colors)
+{
+    std::vector<PointLightData> lights;
+    lights.reserve(count + colorPositions.size() + NR_TUNNEL_LIGHTS);
 
-    glDeleteShader(shader.ID);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        PointLightData light = {};
+        light.position = positions[i];
+        light.ambient = glm::vec3(0.05f, 0.05f, 0.05f);
+        light.diffuse = glm::vec3(0.8f, 0.8f, 0.8f);
+        light.specular = glm::vec3(1.0f, 1.0f, 1.0f);
+        light.constant = 1.0f;
+        light.linear = 0.09f;
+        light.quadratic = 0.032f;
+        lights.push_back(light);
+    }
 
-    glfwTerminate();
-    return 0;
+    // colored lights, clamped to LDR since shader.fs has no exposure step
+    for (unsigned int i = 0; i < colorPositions.size() && i < colors.size(); i++)
+    {
+        PointLightData light = {};
+        light.position = colorPositions[i];
+        light.ambient = glm::vec3(0.0f);
+        light.diffuse = glm::min(colors[i], glm::vec3(1.0f));
+        light.specular = light.diffuse;
+        light.constant = 1.0f;
+        light.linear = 0.09f;
+        light.quadratic = 0.032f;
+        lights.push_back(light);
+    }
+
+    const glm::vec3 palette[] = {
+        glm::vec3(0.3f, 0.4f, 1.0f),
+        glm::vec3(0.6f, 0.2f, 0.9f),
+        glm::vec3(0.2f, 0.8f, 0.9f)
+    };
+    for (unsigned int i = 0; i < NR_TUNNEL_LIGHTS; i++)
+    {
+        float along = (float)i / NR_TUNNEL_LIGHTS;
+        float angle = along * 40.0f;
+        PointLightData light = {};
+        light.position = glm::vec3(1.3f * cos(angle), 1.3f * sin(angle), -50.0f + 100.0f * along);
+        light.ambient = glm::vec3(0.0f);
+        light.diffuse = palette[i % 3] * 0.5f;
+        light.specular = light.diffuse;
+        light.constant = 1.0f;
+        light.linear = 0.7f;
+        light.quadratic = 1.8f;
+        lights.push_back(light);
+    }
+    return lights;
 }
 
 void processInput(GLFWwindow* window)
 {
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-        camera.ProcessKeyboard(FORWARD, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-        camera.ProcessKeyboard(BACKWARD, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-        camera.ProcessKeyboard(LEFT, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-        camera.ProcessKeyboard(RIGHT, deltaTime);
 
     // optional keys 'T' and 'R' scroll though textures vector of textures for development
     if ((glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS))
@@ -334,11 +848,57 @@ void processInput(GLFWwindow* window)
         else
             r = 0;
     }
+
+#ifdef SA_PROFILER
+    // 'P' has the render thread write the profiler's recent history as a Chrome trace,
+    // once per key press
+    static bool traceKeyDown = false;
+    bool traceKey = glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS;
+    if (traceKey && !traceKeyDown)
+        traceRequested = true;
+    traceKeyDown = traceKey;
+#endif
+
+    // 'H' shows or hides the performance HUD
+    static bool hudKeyDown = false;
+    bool hudKey = glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS;
+    if (hudKey && !hudKeyDown)
+        showHud = !showHud;
+    hudKeyDown = hudKey;
+}
+
+// WASD movement, applied once per simulation step
+void processMovement(GLFWwindow* window, float step)
+{
+    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+        camera.ProcessKeyboard(FORWARD, step);
+    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+        camera.ProcessKeyboard(BACKWARD, step);
+    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+        camera.ProcessKeyboard(LEFT, step);
+    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+        camera.ProcessKeyboard(RIGHT, step);
+}
+
+// camera path of headless runs: the interactive drift back down the tunnel, plus a slow
+// look around so the lighting and LOD selection see some variety
+void scriptedCameraPose(Camera& camera, float time)
+{
+    glm::vec3 position(0.0f, 0.0f, 3.0f + time * SPEED / 3.0f);
+    float yaw = YAW + 20.0f * std::sin(time * 0.4f);
+    float pitch = 8.0f * std::sin(time * 0.3f);
+    camera.SetPose(position, yaw, pitch);
 }
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
-    glViewport(0, 0, width, height);
+    // called on the main thread, which has no GL context: the size goes out with the next
+    // snapshot and the render thread sets the viewport, projection and cluster grid from it
+    if (width > 0 && height > 0)
+    {
+        SCR_WIDTH = (float)width;
+        SCR_HEIGHT = (float)height;
+    }
 }
 
 void mouse_callback(GLFWwindow* window, double xposIn, double yposIn)
@@ -365,39 +925,4 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
     camera.ProcessMouseScroll(static_cast<float>(yoffset));
 }
 
-unsigned int loadTexture(char const* path)
-{
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char* data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
-}
-
 
@@ -0,0 +1,119 @@
+#include "camera_path.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+    const char CAMERA_PATH_MAGIC[4] = { 'S', 'A', 'C', 'P' };
+    const std::uint32_t CAMERA_PATH_VERSION = 1;
+
+    struct CameraPathHeader
+    {
+        char magic[4];
+        std::uint32_t version;
+        std::uint32_t sampleCount;
+        float timestep;
+    };
+
+    static_assert(sizeof(CameraSample) == 24, "camera path samples are written as they are");
+    static_assert(sizeof(CameraPathHeader) == 16, "camera path header is written as it is");
+}
+
+void CameraPath::reset(float timestep)
+{
+    samples.clear();
+    this->timestep = timestep;
+    elapsed = 0.0f;
+}
+
+void CameraPath::advance(const Camera& camera, float deltaTime)
+{
+    elapsed += deltaTime;
+    while (elapsed >= timestep)
+    {
+        record(camera);
+        elapsed -= timestep;
+    }
+}
+
+void CameraPath::record(const Camera& camera)
+{
+    CameraSample sample;
+    sample.position[0] = camera.Position.x;
+    sample.position[1] = camera.Position.y;
+    sample.position[2] = camera.Position.z;
+    sample.yaw = camera.Yaw;
+    sample.pitch = camera.Pitch;
+    sample.zoom = camera.Zoom;
+    samples.push_back(sample);
+}
+
+void CameraPath::apply(Camera& camera, unsigned int tick) const
+{
+    if (samples.empty())
+        return;
+    const CameraSample& sample = samples[tick < samples.size() ? tick : samples.size() - 1];
+    camera.SetPose(glm::vec3(sample.position[0], sample.position[1], sample.position[2]), sample.yaw, sample.pitch);
+    camera.Zoom = sample.zoom;
+}
+
+bool CameraPath::load(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    CameraPathHeader header;
+    if (!file || !file.read((char*)&header, sizeof(header)))
+    {
+        std::cout << "ERROR::CAMERA_PATH::FILE_NOT_READ: " << path << std::endl;
+        return false;
+    }
+    if (std::memcmp(header.magic, CAMERA_PATH_MAGIC, sizeof(CAMERA_PATH_MAGIC)) != 0 || header.version != CAMERA_PATH_VERSION
+        || !(header.timestep > 0.0f))
+    {
+        std::cout << "ERROR::CAMERA_PATH::BAD_HEADER: " << path << std::endl;
+        return false;
+    }
+
+    // the count comes from the file: check the samples are there before allocating them
+    const std::streamoff start = file.tellg();
+    file.seekg(0, std::ios::end);
+    const std::streamoff remaining = file.tellg() - start;
+    file.seekg(start);
+    if (!file || (std::uint64_t)header.sampleCount * sizeof(CameraSample) > (std::uint64_t)remaining)
+    {
+        std::cout << "ERROR::CAMERA_PATH::TRUNCATED: " << path << std::endl;
+        return false;
+    }
+
+    std::vector<CameraSample> loaded(header.sampleCount);
+    if (!file.read((char*)loaded.data(), loaded.size() * sizeof(CameraSample)))
+    {
+        std::cout << "ERROR::CAMERA_PATH::TRUNCATED: " << path << std::endl;
+        return false;
+    }
+    samples.swap(loaded);
+    timestep = header.timestep;
+    elapsed = 0.0f;
+    return true;
+}
+
+bool CameraPath::save(const std::string& path) const
+{
+    CameraPathHeader header;
+    std::memcpy(header.magic, CAMERA_PATH_MAGIC, sizeof(CAMERA_PATH_MAGIC));
+    header.version = CAMERA_PATH_VERSION;
+    header.sampleCount = (std::uint32_t)samples.size();
+    header.timestep = timestep;
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+    {
+        std::cout << "ERROR::CAMERA_PATH::FILE_NOT_WRITTEN: " << path << std::endl;
+        return false;
+    }
+    file.write((const char*)&header, sizeof(header));
+    file.write((const char*)samples.data(), samples.size() * sizeof(CameraSample));
+    return (bool)file;
+}
@@ -0,0 +1,54 @@
+#ifndef CAMERA_PATH_H
+#define CAMERA_PATH_H
+
+#include "camera.h"
+
+#include <string>
+#include <vector>
+
+// rate camera paths are recorded at
+const float CAMERA_PATH_TIMESTEP = 1.0f / 60.0f;
+
+// camera state at one tick
+struct CameraSample
+{
+    float position[3];
+    float yaw;
+    float pitch;
+    float zoom;
+};
+
+// Camera pose per fixed tick, for repeatable runs. Recording samples the camera once per
+// elapsed tick however fast frames come; playback sets the camera from one tick per frame,
+// so the same file renders the same frames on any machine.
+// File layout (little endian): "SACP", version, sample count, timestep in seconds, then
+// 24 bytes per sample (position xyz, yaw, pitch, zoom as floats).
+class CameraPath
+{
+public:
+    CameraPath() {}
+
+    // drops the samples and starts a new recording at `timestep` seconds per tick
+    void reset(float timestep = CAMERA_PATH_TIMESTEP);
+    // adds one sample per tick completed during `deltaTime`
+    void advance(const Camera& camera, float deltaTime);
+    // adds a sample for the current tick
+    void record(const Camera& camera);
+    // sets the camera to the pose of `tick`, clamped to the last sample
+    void apply(Camera& camera, unsigned int tick) const;
+
+    bool load(const std::string& path);
+    bool save(const std::string& path) const;
+
+    unsigned int size() const { return (unsigned int)samples.size(); }
+    bool empty() const { return samples.empty(); }
+    float getTimestep() const { return timestep; }
+    float getDuration() const { return samples.size() * timestep; }
+
+private:
+    std::vector<CameraSample> samples;
+    float timestep = CAMERA_PATH_TIMESTEP;
+    float elapsed = 0.0f;   // recording time not yet turned into a sample
+};
+
+#endif
@@ -0,0 +1,399 @@
+#include "cluster_lighting.h"
+#include "simd.h"
+#include "profiler.h"
+#include "job_system.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+namespace
+{
+    // below this many lights handing slices out as jobs costs more than the binning
+    const std::size_t PARALLEL_LIGHT_THRESHOLD = 32;
+    const std::size_t MAX_LIGHTS = 65535;     // light indices are stored as 16 bits
+    const std::size_t GRID_BYTES = CLUSTER_COUNT * 2 * sizeof(std::uint32_t);
+
+    inline float squared(float value) { return value * value; }
+
+    // distance from `value` to the interval [low, high], zero inside it
+    inline float outside(float value, float low, float high)
+    {
+        return std::max(std::max(low - value, value - high), 0.0f);
+    }
+
+    int toTile(float ndc, unsigned int tiles)
+    {
+        int tile = (int)std::floor((ndc * 0.5f + 0.5f) * tiles);
+        return std::min(std::max(tile, 0), (int)tiles - 1);
+    }
+}
+
+ClusteredLighting::ClusteredLighting()
+{
+    clusterCounts.assign(CLUSTER_COUNT, 0);
+    clusterSlots.assign(CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER, 0);
+    sliceOverflow.assign(CLUSTER_Z, 0);
+    boundsMinX.assign(CLUSTER_Z * CLUSTER_X, 0.0f);
+    boundsMaxX.assign(CLUSTER_Z * CLUSTER_X, 0.0f);
+    boundsMinY.assign(CLUSTER_Z * CLUSTER_Y, 0.0f);
+    boundsMaxY.assign(CLUSTER_Z * CLUSTER_Y, 0.0f);
+    std::fill(sliceNear, sliceNear + CLUSTER_Z + 1, 0.0f);
+}
+
+void ClusteredLighting::create()
+{
+    glGenBuffers(1, &lightBuffer);
+    glGenBuffers(1, &gridBuffer);
+    glGenBuffers(1, &indexBuffer);
+    glGenTextures(1, &lightTexture);
+    glGenTextures(1, &gridTexture);
+    glGenTextures(1, &indexTexture);
+
+    // texture buffers may not be empty, so every buffer starts with a minimal store
+    lightBufferBytes = 4 * sizeof(glm::vec4);
+    glBindBuffer(GL_TEXTURE_BUFFER, lightBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, lightBufferBytes, NULL, GL_STATIC_DRAW);
+    const std::vector<std::uint32_t> emptyGrid(CLUSTER_COUNT * 2, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, gridBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, GRID_BYTES, emptyGrid.data(), GL_STREAM_DRAW);
+    indexCapacity = 1024;
+    glBindBuffer(GL_TEXTURE_BUFFER, indexBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, indexCapacity * sizeof(std::uint16_t), NULL, GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    trackBufferBytes(trackedBytes, lightBufferBytes + GRID_BYTES + indexCapacity * sizeof(std::uint16_t));
+
+    glBindTexture(GL_TEXTURE_BUFFER, lightTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, lightBuffer);
+    glBindTexture(GL_TEXTURE_BUFFER, gridTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, gridBuffer);
+    glBindTexture(GL_TEXTURE_BUFFER, indexTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R16UI, indexBuffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    lightsDirty = true;
+}
+
+void ClusteredLighting::release()
+{
+    if (lightBuffer == 0)
+        return;
+    glDeleteTextures(1, &lightTexture);
+    glDeleteTextures(1, &gridTexture);
+    glDeleteTextures(1, &indexTexture);
+    glDeleteBuffers(1, &lightBuffer);
+    glDeleteBuffers(1, &gridBuffer);
+    glDeleteBuffers(1, &indexBuffer);
+    lightBuffer = gridBuffer = indexBuffer = 0;
+    lightTexture = gridTexture = indexTexture = 0;
+    trackBufferBytes(trackedBytes, 0);
+}
+
+void ClusteredLighting::attach(const Shader& shader) const
+{
+    shader.use();
+    shader.setInt("lightData", LIGHT_DATA_UNIT);
+    shader.setInt("clusterGrid", CLUSTER_GRID_UNIT);
+    shader.setInt("clusterLights", CLUSTER_INDEX_UNIT);
+}
+
+void ClusteredLighting::bind() const
+{
+    glActiveTexture(GL_TEXTURE0 + LIGHT_DATA_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, lightTexture);
+    glActiveTexture(GL_TEXTURE0 + CLUSTER_GRID_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, gridTexture);
+    glActiveTexture(GL_TEXTURE0 + CLUSTER_INDEX_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, indexTexture);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+float ClusteredLighting::lightRadius(const PointLightData& light)
+{
+    glm::vec3 peak = glm::max(glm::max(light.ambient, light.diffuse), light.specular);
+    float intensity = std::max(std::max(peak.x, peak.y), peak.z);
+    // solve constant + linear * d + quadratic * d^2 = intensity * 256 / 5 for d
+    float c = light.constant - intensity * (256.0f / 5.0f);
+    if (c >= 0.0f)
+        return 0.0f;
+    if (light.quadratic <= 0.0f)
+        return light.linear > 0.0f ? -c / light.linear : 1e30f;
+    return (-light.linear + std::sqrt(light.linear * light.linear - 4.0f * light.quadratic * c)) / (2.0f * light.quadratic);
+}
+
+void ClusteredLighting::setLights(const std::vector<PointLightData>& lights)
+{
+    std::size_t count = std::min(lights.size(), MAX_LIGHTS);
+    if (count < lights.size())
+        std::cout << "ERROR::CLUSTER::TOO_MANY_LIGHTS: using the first " << MAX_LIGHTS << " of " << lights.size() << std::endl;
+
+    lightParams.assign(lights.begin(), lights.begin() + count);
+    worldSpheres.resize(count);
+    for (std::size_t i = 0; i < count; i++)
+        worldSpheres[i] = glm::vec4(lightParams[i].position, lightRadius(lightParams[i]));
+
+    // pad the view-space arrays so the SIMD transform can always work on groups of 4
+    std::size_t padded = (count + 3) & ~(std::size_t)3;
+    lightX.assign(padded, 0.0f);
+    lightY.assign(padded, 0.0f);
+    lightDepth.assign(padded, 0.0f);
+    lightRange.assign(padded, 0.0f);
+    stats.lights = (unsigned int)count;
+    lightsDirty = true;
+}
+
+void ClusteredLighting::updateClusterBounds(const glm::mat4& projection, float nearPlane, float farPlane)
+{
+    boundsProjection = projection;
+    boundsNear = nearPlane;
+    boundsFar = farPlane;
+    // ndc.x = projX * x / depth - offX for a view-space point at positive depth
+    projX = projection[0][0];
+    projY = projection[1][1];
+    offX = projection[2][0];
+    offY = projection[2][1];
+
+    for (unsigned int z = 0; z <= CLUSTER_Z; z++)
+        sliceNear[z] = nearPlane * std::pow(farPlane / nearPlane, (float)z / CLUSTER_Z);
+
+    for (unsigned int z = 0; z < CLUSTER_Z; z++)
+    {
+        float depths[2] = { sliceNear[z], sliceNear[z + 1] };
+        for (unsigned int x = 0; x < CLUSTER_X; x++)
+        {
+            float ndc[2] = { -1.0f + 2.0f * x / CLUSTER_X, -1.0f + 2.0f * (x + 1) / CLUSTER_X };
+            float low = 1e30f, high = -1e30f;
+            for (float n : ndc)
+                for (float d : depths)
+                {
+                    float value = (n + offX) * d / projX;
+                    low = std::min(low, value);
+                    high = std::max(high, value);
+                }
+            boundsMinX[z * CLUSTER_X + x] = low;
+            boundsMaxX[z * CLUSTER_X + x] = high;
+        }
+        for (unsigned int y = 0; y < CLUSTER_Y; y++)
+        {
+            float ndc[2] = { -1.0f + 2.0f * y / CLUSTER_Y, -1.0f + 2.0f * (y + 1) / CLUSTER_Y };
+            float low = 1e30f, high = -1e30f;
+            for (float n : ndc)
+                for (float d : depths)
+                {
+                    float value = (n + offY) * d / projY;
+                    low = std::min(low, value);
+                    high = std::max(high, value);
+                }
+            boundsMinY[z * CLUSTER_Y + y] = low;
+            boundsMaxY[z * CLUSTER_Y + y] = high;
+        }
+    }
+}
+
+void ClusteredLighting::bin(const glm::mat4& view, const glm::mat4& projection, float nearPlane, float farPlane,
+    float screenWidth, float screenHeight, ClusterBins& bins)
+{
+    PROFILE_SCOPE("ClusteredLighting::bin");
+    auto start = std::chrono::high_resolution_clock::now();
+
+    if (projection != boundsProjection || nearPlane != boundsNear || farPlane != boundsFar)
+        updateClusterBounds(projection, nearPlane, farPlane);
+
+    const std::size_t count = worldSpheres.size();
+
+    // world -> view space; only the third row is negated since depth is -z
+#ifdef SA_SSE2
+    const __m128 m0x = _mm_set1_ps(view[0][0]), m1x = _mm_set1_ps(view[1][0]), m2x = _mm_set1_ps(view[2][0]), m3x = _mm_set1_ps(view[3][0]);
+    const __m128 m0y = _mm_set1_ps(view[0][1]), m1y = _mm_set1_ps(view[1][1]), m2y = _mm_set1_ps(view[2][1]), m3y = _mm_set1_ps(view[3][1]);
+    const __m128 m0z = _mm_set1_ps(-view[0][2]), m1z = _mm_set1_ps(-view[1][2]), m2z = _mm_set1_ps(-view[2][2]), m3z = _mm_set1_ps(-view[3][2]);
+    for (std::size_t i = 0; i + 4 <= count; i += 4)
+    {
+        // gather 4 spheres into x/y/z/radius registers
+        __m128 a = _mm_loadu_ps(&worldSpheres[i].x);
+        __m128 b = _mm_loadu_ps(&worldSpheres[i + 1].x);
+        __m128 c = _mm_loadu_ps(&worldSpheres[i + 2].x);
+        __m128 d = _mm_loadu_ps(&worldSpheres[i + 3].x);
+        _MM_TRANSPOSE4_PS(a, b, c, d);
+        __m128 vx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m0x, a), _mm_mul_ps(m1x, b)), _mm_add_ps(_mm_mul_ps(m2x, c), m3x));
+        __m128 vy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m0y, a), _mm_mul_ps(m1y, b)), _mm_add_ps(_mm_mul_ps(m2y, c), m3y));
+        __m128 vz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m0z, a), _mm_mul_ps(m1z, b)), _mm_add_ps(_mm_mul_ps(m2z, c), m3z));
+        _mm_storeu_ps(&lightX[i], vx);
+        _mm_storeu_ps(&lightY[i], vy);
+        _mm_storeu_ps(&lightDepth[i], vz);
+        _mm_storeu_ps(&lightRange[i], d);
+    }
+    std::size_t tail = count & ~(std::size_t)3;
+#else
+    std::size_t tail = 0;
+#endif
+    for (std::size_t i = tail; i < count; i++)
+    {
+        glm::vec4 p = view * glm::vec4(glm::vec3(worldSpheres[i]), 1.0f);
+        lightX[i] = p.x;
+        lightY[i] = p.y;
+        lightDepth[i] = -p.z;
+        lightRange[i] = worldSpheres[i].w;
+    }
+
+    // each job owns a contiguous range of depth slices, so no cluster is shared
+    if (count >= PARALLEL_LIGHT_THRESHOLD)
+        jobSystem().parallelFor(CLUSTER_Z, 2, [this](unsigned int first, unsigned int last) { binSlices(first, last); });
+    else
+        binSlices(0, CLUSTER_Z);
+
+    // flatten the per-cluster slots into (offset, count) + one index list
+    std::vector<std::uint32_t>& grid = bins.grid;
+    std::vector<std::uint16_t>& indices = bins.indices;
+    grid.resize(CLUSTER_COUNT * 2);
+    indices.clear();
+    stats.occupiedClusters = 0;
+    stats.maxPerCluster = 0;
+    stats.overflow = 0;
+    for (unsigned int z = 0; z < CLUSTER_Z; z++)
+        stats.overflow += sliceOverflow[z];
+    for (unsigned int cluster = 0; cluster < CLUSTER_COUNT; cluster++)
+    {
+        unsigned int lights = clusterCounts[cluster];
+        grid[cluster * 2] = (std::uint32_t)indices.size();
+        grid[cluster * 2 + 1] = lights;
+        if (lights == 0)
+            continue;
+        const std::uint16_t* slots = &clusterSlots[(std::size_t)cluster * MAX_LIGHTS_PER_CLUSTER];
+        indices.insert(indices.end(), slots, slots + lights);
+        stats.occupiedClusters++;
+        stats.maxPerCluster = std::max(stats.maxPerCluster, lights);
+    }
+    stats.indexCount = (unsigned int)indices.size();
+
+    stats.visibleLights = 0;
+    for (std::size_t i = 0; i < count; i++)
+        if (lightDepth[i] + lightRange[i] > nearPlane && lightDepth[i] - lightRange[i] < farPlane)
+            stats.visibleLights++;
+
+    // slice = log(depth) * scale - bias, matching sliceNear
+    float scale = CLUSTER_Z / std::log(farPlane / nearPlane);
+    bins.params.dims = glm::uvec4(CLUSTER_X, CLUSTER_Y, CLUSTER_Z, (unsigned int)count);
+    bins.params.depth = glm::vec4(scale, std::log(nearPlane) * scale, screenWidth, screenHeight);
+    stats.binMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void ClusteredLighting::upload(const ClusterBins& bins, LightingBuffer& lighting)
+{
+    PROFILE_SCOPE("ClusteredLighting::upload");
+    if (lightsDirty && lightBuffer != 0)
+    {
+        const std::size_t count = worldSpheres.size();
+        std::vector<glm::vec4> texels(std::max<std::size_t>(count, 1) * 4, glm::vec4(0.0f));
+        for (std::size_t i = 0; i < count; i++)
+        {
+            const PointLightData& light = lightParams[i];
+            texels[i * 4 + 0] = worldSpheres[i];
+            texels[i * 4 + 1] = glm::vec4(light.ambient, light.constant);
+            texels[i * 4 + 2] = glm::vec4(light.diffuse, light.linear);
+            texels[i * 4 + 3] = glm::vec4(light.specular, light.quadratic);
+        }
+        lightBufferBytes = texels.size() * sizeof(glm::vec4);
+        glBindBuffer(GL_TEXTURE_BUFFER, lightBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, lightBufferBytes, texels.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        trackBufferBytes(trackedBytes, lightBufferBytes + GRID_BYTES + indexCapacity * sizeof(std::uint16_t));
+        lightsDirty = false;
+    }
+
+    if (gridBuffer != 0 && bins.grid.size() == CLUSTER_COUNT * 2)
+    {
+        glBindBuffer(GL_TEXTURE_BUFFER, gridBuffer);
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, GRID_BYTES, bins.grid.data());
+        glBindBuffer(GL_TEXTURE_BUFFER, indexBuffer);
+        if (bins.indices.size() > indexCapacity)
+        {
+            while (indexCapacity < bins.indices.size())
+                indexCapacity *= 2;
+            glBufferData(GL_TEXTURE_BUFFER, indexCapacity * sizeof(std::uint16_t), NULL, GL_STREAM_DRAW);
+            trackBufferBytes(trackedBytes, lightBufferBytes + GRID_BYTES + indexCapacity * sizeof(std::uint16_t));
+        }
+        if (!bins.indices.empty())
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, bins.indices.size() * sizeof(std::uint16_t), bins.indices.data());
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+    lighting.setClusterParams(bins.params);
+}
+
+void ClusteredLighting::binSlices(unsigned int firstSlice, unsigned int lastSlice)
+{
+    const std::size_t count = worldSpheres.size();
+    for (unsigned int z = firstSlice; z < lastSlice; z++)
+    {
+        std::uint16_t* counts = &clusterCounts[z * CLUSTER_X * CLUSTER_Y];
+        std::fill(counts, counts + CLUSTER_X * CLUSTER_Y, (std::uint16_t)0);
+        sliceOverflow[z] = 0;
+
+        const float dNear = sliceNear[z];
+        const float dFar = sliceNear[z + 1];
+        const float* minX = &boundsMinX[z * CLUSTER_X];
+        const float* maxX = &boundsMaxX[z * CLUSTER_X];
+        const float* minY = &boundsMinY[z * CLUSTER_Y];
+        const float* maxY = &boundsMaxY[z * CLUSTER_Y];
+
+        for (std::size_t i = 0; i < count; i++)
+        {
+            const float depth = lightDepth[i];
+            const float range = lightRange[i];
+            if (depth + range < dNear || depth - range > dFar)
+                continue;
+
+            // conservative tile rectangle of the sphere's slab inside this slice
+            const float d0 = std::max(dNear, depth - range);
+            const float d1 = std::min(dFar, depth + range);
+            const float cx = lightX[i], cy = lightY[i];
+            float ndcMinX = std::min(std::min((cx - range) / d0, (cx - range) / d1), std::min((cx + range) / d0, (cx + range) / d1)) * projX - offX;
+            float ndcMaxX = std::max(std::max((cx - range) / d0, (cx - range) / d1), std::max((cx + range) / d0, (cx + range) / d1)) * projX - offX;
+            float ndcMinY = std::min(std::min((cy - range) / d0, (cy - range) / d1), std::min((cy + range) / d0, (cy + range) / d1)) * projY - offY;
+            float ndcMaxY = std::max(std::max((cy - range) / d0, (cy - range) / d1), std::max((cy + range) / d0, (cy + range) / d1)) * projY - offY;
+            if (ndcMaxX < -1.0f || ndcMinX > 1.0f || ndcMaxY < -1.0f || ndcMinY > 1.0f)
+                continue;
+            const int x0 = toTile(ndcMinX, CLUSTER_X), x1 = toTile(ndcMaxX, CLUSTER_X);
+            const int y0 = toTile(ndcMinY, CLUSTER_Y), y1 = toTile(ndcMaxY, CLUSTER_Y);
+
+            const float range2 = range * range;
+            const float dz2 = squared(outside(depth, dNear, dFar));
+            for (int y = y0; y <= y1; y++)
+            {
+                const float dyz2 = dz2 + squared(outside(cy, minY[y], maxY[y]));
+                if (dyz2 > range2)
+                    continue;
+                std::uint16_t* rowCounts = counts + y * CLUSTER_X;
+                std::uint16_t* rowSlots = &clusterSlots[((std::size_t)z * CLUSTER_X * CLUSTER_Y + y * CLUSTER_X) * MAX_LIGHTS_PER_CLUSTER];
+
+                // sphere vs cell bounds, 4 columns per test
+                for (int xBase = x0 & ~3; xBase <= x1; xBase += 4)
+                {
+                    int mask = 0;
+#ifdef SA_SSE2
+                    __m128 c = _mm_set1_ps(cx);
+                    __m128 low = _mm_loadu_ps(minX + xBase);
+                    __m128 high = _mm_loadu_ps(maxX + xBase);
+                    __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(low, c), _mm_sub_ps(c, high)), _mm_setzero_ps());
+                    __m128 dist2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_set1_ps(dyz2));
+                    mask = _mm_movemask_ps(_mm_cmple_ps(dist2, _mm_set1_ps(range2)));
+#else
+                    for (int lane = 0; lane < 4; lane++)
+                        if (dyz2 + squared(outside(cx, minX[xBase + lane], maxX[xBase + lane])) <= range2)
+                            mask |= 1 << lane;
+#endif
+                    for (int lane = 0; lane < 4; lane++)
+                    {
+                        int x = xBase + lane;
+                        if (!(mask & (1 << lane)) || x < x0 || x > x1)
+                            continue;
+                        std::uint16_t& cell = rowCounts[x];
+                        if (cell < MAX_LIGHTS_PER_CLUSTER)
+                            rowSlots[x * MAX_LIGHTS_PER_CLUSTER + cell++] = (std::uint16_t)i;
+                        else
+                            sliceOverflow[z]++;
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,121 @@
+#ifndef CLUSTER_LIGHTING_H
+#define CLUSTER_LIGHTING_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "lighting_block.h"
+#include "shader.h"
+
+// froxel grid: screen tiles in x/y, exponential depth slices in z
+const unsigned int CLUSTER_X = 16;
+const unsigned int CLUSTER_Y = 16;
+const unsigned int CLUSTER_Z = 24;
+const unsigned int CLUSTER_COUNT = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+// lights beyond this in a single cluster are dropped (and counted in Stats::overflow)
+const unsigned int MAX_LIGHTS_PER_CLUSTER = 64;
+
+// texture units the cluster buffers are bound to; shader.fs samplers are pointed at them by attach()
+const unsigned int LIGHT_DATA_UNIT = 5;
+const unsigned int CLUSTER_GRID_UNIT = 6;
+const unsigned int CLUSTER_INDEX_UNIT = 7;
+
+// one frame's binning, made by ClusteredLighting::bin() and handed to upload(); app.cpp
+// carries it from the simulation thread to the render thread in the FrameSnapshot
+struct ClusterBins
+{
+    std::vector<std::uint32_t> grid;    // (offset, count) per cluster
+    std::vector<std::uint16_t> indices; // the clusters' light lists, flattened
+    ClusterParamsData params;
+};
+
+// Clustered forward shading for point lights.
+// Every frame bin() transforms the lights to view space and bins them into a
+// CLUSTER_X * CLUSTER_Y * CLUSTER_Z grid of view-frustum cells, slice ranges run as
+// jobSystem() jobs, with sphere/cell tests done four cells at a time where SSE2 is available.
+// upload() then sends the per-cluster (offset, count) grid and the flattened light index
+// list to the GPU as texture buffers, so shader.fs only shades the lights that reach a
+// fragment's cell. Light parameters are uploaded once when they change, not per frame.
+//
+// bin() makes no GL calls, so it runs on the simulation thread while the previous frame is
+// drawn; create(), upload(), bind() and release() belong to the GL thread. setLights() is
+// called before either thread starts using the lights.
+class ClusteredLighting
+{
+public:
+    struct Stats
+    {
+        unsigned int lights = 0;            // lights handed to setLights()
+        unsigned int visibleLights = 0;     // lights that overlapped the frustum last update
+        unsigned int occupiedClusters = 0;  // clusters with at least one light
+        unsigned int indexCount = 0;        // entries in the light index list
+        unsigned int maxPerCluster = 0;
+        unsigned int overflow = 0;          // light/cluster pairs dropped for MAX_LIGHTS_PER_CLUSTER
+        double binMilliseconds = 0.0;
+    };
+
+    ClusteredLighting();
+    ~ClusteredLighting() { release(); }
+    ClusteredLighting(const ClusteredLighting&) = delete;
+    ClusteredLighting& operator=(const ClusteredLighting&) = delete;
+
+    void create();
+    void release();
+
+    // points shader.fs's cluster samplers at the units above
+    void attach(const Shader& shader) const;
+
+    // replaces the light list; radii are derived from each light's attenuation
+    void setLights(const std::vector<PointLightData>& lights);
+
+    // bins the lights for this camera into `bins`, reusing its storage
+    void bin(const glm::mat4& view, const glm::mat4& projection, float nearPlane, float farPlane,
+        float screenWidth, float screenHeight, ClusterBins& bins);
+    // uploads the light parameters if they changed and the binning, and writes the grid
+    // parameters into the Lighting block so shader.fs can locate its cluster
+    void upload(const ClusterBins& bins, LightingBuffer& lighting);
+
+    // binds the three texture buffers to their units
+    void bind() const;
+
+    const Stats& getStats() const { return stats; }
+
+    // distance at which a light's attenuated intensity drops below 5/256
+    static float lightRadius(const PointLightData& light);
+
+private:
+    void binSlices(unsigned int firstSlice, unsigned int lastSlice);
+    void updateClusterBounds(const glm::mat4& projection, float nearPlane, float farPlane);
+
+    // view-space light spheres, structure-of-arrays; depth is -z (positive in front)
+    std::vector<float> lightX, lightY, lightDepth, lightRange;
+    // world-space inputs
+    std::vector<glm::vec4> worldSpheres;
+    std::vector<PointLightData> lightParams;
+    bool lightsDirty = true;
+
+    // view-space cluster bounds per slice: x bounds per column, y bounds per row
+    std::vector<float> boundsMinX, boundsMaxX, boundsMinY, boundsMaxY;
+    float sliceNear[CLUSTER_Z + 1];
+    glm::mat4 boundsProjection = glm::mat4(0.0f);
+    float boundsNear = 0.0f, boundsFar = 0.0f;
+    float projX = 1.0f, projY = 1.0f, offX = 0.0f, offY = 0.0f;
+
+    // binning output
+    std::vector<std::uint16_t> clusterCounts;
+    std::vector<std::uint16_t> clusterSlots;    // MAX_LIGHTS_PER_CLUSTER per cluster
+    std::vector<unsigned int> sliceOverflow;
+
+    unsigned int lightBuffer = 0, lightTexture = 0;
+    unsigned int gridBuffer = 0, gridTexture = 0;
+    unsigned int indexBuffer = 0, indexTexture = 0;
+    std::size_t indexCapacity = 0;
+    std::size_t lightBufferBytes = 0;
+    std::size_t trackedBytes = 0;     // all three buffers as counted in renderCounters()
+    Stats stats;
+};
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef CONTENT_HASH_H
+#define CONTENT_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// 64-bit FNV-1a, used to key on-disk caches by the content they were built from.
+// Not cryptographic; pass the previous result as `seed` to hash several blobs in a row.
+const std::uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ULL;
+const std::uint64_t FNV_PRIME = 0x100000001b3ULL;
+
+inline std::uint64_t hashBytes(const void* data, std::size_t size, std::uint64_t seed = FNV_OFFSET_BASIS)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    std::uint64_t hash = seed;
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+inline std::uint64_t hashString(const std::string& text, std::uint64_t seed = FNV_OFFSET_BASIS)
+{
+    // include the terminator so ("ab", "c") and ("a", "bc") hash differently
+    return hashBytes(text.c_str(), text.size() + 1, seed);
+}
+
+// 16 lowercase hex digits, used for cache file names
+inline std::string hashToHex(std::uint64_t hash)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string hex(16, '0');
+    for (int i = 15; i >= 0; --i)
+    {
+        hex[i] = digits[hash & 0xf];
+        hash >>= 4;
+    }
+    return hex;
+}
+
+#endif
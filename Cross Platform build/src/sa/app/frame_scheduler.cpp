@@ -0,0 +1,86 @@
+#include "frame_scheduler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+void FrameScheduler::setPacing(FramePacing pacing, double targetFps)
+{
+    this->pacing = pacing;
+    framePeriod = pacing == PACING_TARGET_FPS && targetFps > 0.0
+        ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / targetFps))
+        : Clock::duration::zero();
+    started = false;
+}
+
+unsigned int FrameScheduler::beginFrame(double elapsedSeconds)
+{
+    accumulator += std::max(elapsedSeconds, 0.0);
+    unsigned int steps = 0;
+    while (accumulator >= timestep && steps < MAX_SIMULATION_STEPS)
+    {
+        accumulator -= timestep;
+        steps++;
+    }
+    if (accumulator >= timestep)
+    {
+        // keep the fraction so the interpolation does not jump, drop the whole steps
+        double kept = std::fmod(accumulator, timestep);
+        stats.droppedSeconds += accumulator - kept;
+        accumulator = kept;
+    }
+    stats.frames++;
+    stats.steps += steps;
+    return steps;
+}
+
+void FrameScheduler::waitForNextFrame()
+{
+    if (pacing != PACING_TARGET_FPS || framePeriod == Clock::duration::zero())
+        return;
+
+    Clock::time_point now = Clock::now();
+    if (!started)
+    {
+        nextFrame = now;
+        started = true;
+    }
+    nextFrame += framePeriod;
+    // a frame that overran by more than a period starts the schedule again from now
+    // rather than rushing the following frames to catch up
+    if (nextFrame + framePeriod < now)
+    {
+        nextFrame = now;
+        return;
+    }
+    sleepUntil(nextFrame);
+}
+
+void FrameScheduler::sleepUntil(Clock::time_point deadline)
+{
+    // sleep in 1 ms slices while more than a pessimistic slice (mean + one deviation of
+    // what the OS actually delivered) is left, then spin the remainder
+    Clock::time_point start = Clock::now();
+    for (;;)
+    {
+        double remaining = std::chrono::duration<double>(deadline - Clock::now()).count();
+        double estimate = sleepMean + std::sqrt(sleepM2 / sleepCount);
+        if (remaining <= estimate)
+            break;
+
+        Clock::time_point before = Clock::now();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        double observed = std::chrono::duration<double>(Clock::now() - before).count();
+
+        sleepCount++;
+        double delta = observed - sleepMean;
+        sleepMean += delta / sleepCount;
+        sleepM2 += delta * (observed - sleepMean);
+    }
+    Clock::time_point spinStart = Clock::now();
+    while (Clock::now() < deadline)
+        std::this_thread::yield();
+
+    stats.sleptMilliseconds += std::chrono::duration<double, std::milli>(spinStart - start).count();
+    stats.spunMilliseconds += std::chrono::duration<double, std::milli>(Clock::now() - spinStart).count();
+}
@@ -0,0 +1,74 @@
+#ifndef FRAME_SCHEDULER_H
+#define FRAME_SCHEDULER_H
+
+#include <algorithm>
+#include <chrono>
+
+enum FramePacing
+{
+    PACING_VSYNC,       // the swap waits for the display
+    PACING_UNCAPPED,    // no waiting at all
+    PACING_TARGET_FPS   // waitForNextFrame() holds the frame rate at the target
+};
+
+// the simulation (camera drift and movement, the wormhole's spin) runs at this rate
+// whatever the frame rate
+const double SIMULATION_TIMESTEP = 1.0 / 60.0;
+// a frame never runs more steps than this; a longer stall (a breakpoint, a dragged
+// window) is dropped instead of being caught up all at once
+const unsigned int MAX_SIMULATION_STEPS = 8;
+
+// Fixed-timestep frame loop: beginFrame() adds the frame's elapsed time to an accumulator
+// and returns how many whole steps the simulation has to run; what is left over, as a
+// fraction of a step (getAlpha()), interpolates the rendered state between the last two
+// simulated ones. With PACING_TARGET_FPS, waitForNextFrame() sleeps while the OS timer can
+// be trusted and spins the last stretch, so frames start on time without a core burning
+// in a busy wait. The vsync and uncapped modes only set the swap interval (see app.cpp).
+class FrameScheduler
+{
+public:
+    struct Stats
+    {
+        unsigned long long frames = 0;
+        unsigned long long steps = 0;
+        double droppedSeconds = 0.0;        // clamped off by MAX_SIMULATION_STEPS
+        double sleptMilliseconds = 0.0;
+        double spunMilliseconds = 0.0;
+    };
+
+    explicit FrameScheduler(double timestep = SIMULATION_TIMESTEP) : timestep(timestep) {}
+
+    // targetFps only applies to PACING_TARGET_FPS
+    void setPacing(FramePacing pacing, double targetFps = 60.0);
+    FramePacing getPacing() const { return pacing; }
+    double getTimestep() const { return timestep; }
+
+    // adds `elapsedSeconds` of frame time; returns the number of fixed steps to run now
+    unsigned int beginFrame(double elapsedSeconds);
+    // how far past the last simulated state the frame is drawn, in steps, [0, 1)
+    float getAlpha() const { return (float)std::min(accumulator / timestep, 1.0); }
+
+    // PACING_TARGET_FPS: blocks until the next frame is due; otherwise returns at once
+    void waitForNextFrame();
+
+    const Stats& getStats() const { return stats; }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    void sleepUntil(Clock::time_point deadline);
+
+    double timestep;
+    double accumulator = 0.0;
+    FramePacing pacing = PACING_VSYNC;
+    Clock::duration framePeriod = Clock::duration::zero();
+    Clock::time_point nextFrame;
+    bool started = false;
+    // running mean and variance of how long a 1 ms sleep really takes (Welford)
+    double sleepMean = 0.002;
+    double sleepM2 = 0.0;
+    unsigned long long sleepCount = 1;
+    Stats stats;
+};
+
+#endif
@@ -0,0 +1,129 @@
+#ifndef FRAME_SNAPSHOT_H
+#define FRAME_SNAPSHOT_H
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "camera.h"
+#include "cluster_lighting.h"
+#include "lod_manager.h"
+
+// Everything the render thread needs to draw one frame. The simulation thread fills it in
+// and publishes it; from then on it is read-only until the render thread releases it.
+// The CPU work of a frame (light binning, LOD choice) is done on the simulation side and
+// arrives here, so the render thread only uploads and draws. The vectors keep their
+// storage as the two slots are reused.
+struct FrameSnapshot
+{
+    unsigned int frame = 0;         // sequence number of the snapshot
+    unsigned int tick = 0;          // index among the measured frames, see app.cpp
+    bool measured = false;
+    bool quit = false;              // no frame: the render thread finishes and exits
+
+    Camera camera;                  // interpolated pose the frame is drawn from
+    glm::mat4 view = glm::mat4(1.0f);
+    glm::mat4 projection = glm::mat4(1.0f);
+    float viewportWidth = 0.0f;
+    float viewportHeight = 0.0f;
+    ClusterBins clusterBins;        // the point lights binned for this view
+    std::vector<LodDraw> tunnelDraws;
+    LodDraw blackHoleDraw;
+    unsigned int tunnelTexture = 0; // GL texture names picked with 'T' and 'R'
+    unsigned int blackHoleTexture = 0;
+
+    float frameMilliseconds = 0.0f; // simulation frame time, for the HUD
+    bool showHud = false;
+    bool writeTrace = false;        // write the profiler history after this frame
+};
+
+// Lock-free handoff of FrameSnapshots from one producer thread (simulation) to one consumer
+// thread (render) through two slots: while the renderer reads one, the simulation fills the
+// other. Each side owns a counter and only reads the other's, so neither ever takes a lock;
+// a side that finds no slot ready backs off (spin, yield, then short sleeps) and the waits
+// are counted, which shows which side is the bottleneck. Snapshots are never dropped, so
+// headless runs render exactly the frames they simulate.
+class SnapshotBuffer
+{
+public:
+    struct Stats
+    {
+        unsigned long long published = 0;
+        unsigned long long simulationWaits = 0;     // both slots still queued or being drawn
+        unsigned long long renderWaits = 0;         // nothing new to draw yet
+    };
+
+    // simulation thread: the free slot to fill in, waiting while there is none
+    FrameSnapshot& beginWrite()
+    {
+        std::uint32_t index = published.load(std::memory_order_relaxed);
+        if (index - consumed.load(std::memory_order_acquire) == 2)
+        {
+            stats.simulationWaits++;
+            unsigned int spins = 0;
+            while (index - consumed.load(std::memory_order_acquire) == 2)
+                backOff(spins);
+        }
+        return slots[index % 2];
+    }
+    // simulation thread: hands the slot from beginWrite() to the render thread
+    void publish()
+    {
+        published.store(published.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        stats.published++;
+    }
+
+    // render thread: the oldest published snapshot, waiting while there is none
+    const FrameSnapshot& acquire()
+    {
+        std::uint32_t index = consumed.load(std::memory_order_relaxed);
+        if (published.load(std::memory_order_acquire) == index)
+        {
+            renderWaits++;
+            unsigned int spins = 0;
+            while (published.load(std::memory_order_acquire) == index)
+                backOff(spins);
+        }
+        return slots[index % 2];
+    }
+    // render thread: done with the snapshot from acquire(), its slot can be refilled
+    void release()
+    {
+        consumed.store(consumed.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // read once both threads are done (or joined)
+    Stats getStats() const
+    {
+        Stats result = stats;
+        result.renderWaits = renderWaits;
+        return result;
+    }
+
+private:
+    static void backOff(unsigned int& spins)
+    {
+        // a frame is milliseconds long: spinning past a few microseconds only burns a core
+        if (spins < 64)
+            spins++;
+        else if (spins < 128)
+        {
+            spins++;
+            std::this_thread::yield();
+        }
+        else
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+
+    FrameSnapshot slots[2];
+    std::atomic<std::uint32_t> published{ 0 };
+    std::atomic<std::uint32_t> consumed{ 0 };
+    Stats stats;                        // simulation thread's counts
+    unsigned long long renderWaits = 0; // render thread's count, kept apart from `stats`
+};
+
+#endif
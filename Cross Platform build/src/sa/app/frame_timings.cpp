@@ -0,0 +1,60 @@
+#include "frame_timings.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+
+void FrameTimings::collect(GpuTimer& timer, bool print, unsigned int waitFor)
+{
+    unsigned int frame = 0;
+    double milliseconds = 0.0;
+    while (timer.collect(frame, milliseconds, waitFor > 0))
+    {
+        if (waitFor > 0)
+            waitFor--;
+        if (gpuMilliseconds.size() <= frame)
+            gpuMilliseconds.resize(frame + 1, 0.0);
+        gpuMilliseconds[frame] = milliseconds;
+        if (print)
+            std::printf("frame %5u  cpu %8.3f ms  gpu %8.3f ms\n", frame,
+                frame < cpuMilliseconds.size() ? cpuMilliseconds[frame] : 0.0, milliseconds);
+    }
+}
+
+void FrameTimings::printSummary() const
+{
+    const std::vector<double>* series[] = { &cpuMilliseconds, &gpuMilliseconds };
+    const char* names[] = { "cpu", "gpu" };
+    std::printf("Frame timings: %u frames\n", (unsigned int)cpuMilliseconds.size());
+    for (int i = 0; i < 2; i++)
+    {
+        const std::vector<double>& times = *series[i];
+        if (times.empty())
+            continue;
+        double total = 0.0, least = times[0], most = times[0];
+        for (double time : times)
+        {
+            total += time;
+            least = std::min(least, time);
+            most = std::max(most, time);
+        }
+        std::printf("  %s  avg %8.3f ms  min %8.3f ms  max %8.3f ms\n", names[i], total / times.size(), least, most);
+    }
+}
+
+bool FrameTimings::writeLog(const std::string& path, const std::string& description) const
+{
+    FILE* file = std::fopen(path.c_str(), "w");
+    if (!file)
+    {
+        std::cout << "ERROR::FRAME_TIMINGS::FILE_NOT_WRITTEN: " << path << std::endl;
+        return false;
+    }
+    if (!description.empty())
+        std::fprintf(file, "# %s\n", description.c_str());
+    std::fprintf(file, "frame,cpu_ms,gpu_ms\n");
+    for (size_t frame = 0; frame < cpuMilliseconds.size(); frame++)
+        std::fprintf(file, "%u,%.4f,%.4f\n", (unsigned int)frame, cpuMilliseconds[frame],
+            frame < gpuMilliseconds.size() ? gpuMilliseconds[frame] : 0.0);
+    return std::fclose(file) == 0;
+}
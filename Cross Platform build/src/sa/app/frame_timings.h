@@ -0,0 +1,28 @@
+#ifndef FRAME_TIMINGS_H
+#define FRAME_TIMINGS_H
+
+#include "gpu_timer.h"
+
+#include <string>
+#include <vector>
+
+// CPU and GPU time of every measured frame. GPU times arrive a few frames late through a
+// GpuTimer; frames whose GPU time never came in keep 0.
+struct FrameTimings
+{
+    std::vector<double> cpuMilliseconds;
+    std::vector<double> gpuMilliseconds;
+
+    // takes every finished GPU time, blocking for the first `waitFor` of them;
+    // with `print` each frame is reported as its GPU time arrives
+    void collect(GpuTimer& timer, bool print, unsigned int waitFor);
+
+    // frame count and avg/min/max of both series
+    void printSummary() const;
+
+    // CSV of frame, cpu_ms, gpu_ms; `description` goes into a leading # comment so two
+    // logs of the same path can be told apart and compared
+    bool writeLog(const std::string& path, const std::string& description) const;
+};
+
+#endif
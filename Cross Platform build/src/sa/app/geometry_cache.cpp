@@ -0,0 +1,66 @@
+#include "geometry_cache.h"
+#include "mesh_generator.h"
+
+#include <cstring>
+
+namespace
+{
+    // boost-style hash_combine
+    void hashCombine(std::size_t& seed, std::size_t value)
+    {
+        seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    }
+
+    std::size_t hashFloat(float value)
+    {
+        if (value == 0.0f)
+            value = 0.0f;   // -0 and +0 compare equal so they must hash equal
+        unsigned int bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return std::hash<unsigned int>()(bits);
+    }
+}
+
+std::size_t CylinderKeyHash::operator()(const CylinderKey& key) const
+{
+    std::size_t seed = 0;
+    hashCombine(seed, hashFloat(key.baseRadius));
+    hashCombine(seed, hashFloat(key.topRadius));
+    hashCombine(seed, hashFloat(key.height));
+    hashCombine(seed, std::hash<int>()(key.sectorCount));
+    hashCombine(seed, std::hash<int>()(key.stackCount));
+    hashCombine(seed, std::hash<bool>()(key.smooth));
+    return seed;
+}
+
+const CachedCylinder& GeometryCache::getCylinder(const CylinderKey& key)
+{
+    auto it = cylinders.find(key);
+    if (it != cylinders.end())
+    {
+        ++stats.hits;
+        return it->second;
+    }
+    ++stats.misses;
+
+    // same layout Cylinder builds (smooth shading; Cylinder has no flat variant either)
+    GeneratedMesh cylinder;
+    generateCylinder(cylinder, key.baseRadius, key.topRadius, key.height, key.sectorCount, key.stackCount);
+
+    CachedCylinder& entry = cylinders[key];
+    entry.mesh.upload(cylinder.vertices.data(), (unsigned int)(cylinder.vertices.size() * sizeof(float)),
+        cylinder.indices.data(), (unsigned int)cylinder.indices.size());
+    entry.sideStart = cylinder.sideStart;
+    entry.sideCount = cylinder.sideCount;
+    entry.baseStart = cylinder.baseStart;
+    entry.baseCount = cylinder.baseCount;
+    entry.topStart = cylinder.topStart;
+    entry.topCount = cylinder.topCount;
+    entry.triangleCount = cylinder.getTriangleCount();
+    return entry;
+}
+
+void GeometryCache::clear()
+{
+    cylinders.clear();
+}
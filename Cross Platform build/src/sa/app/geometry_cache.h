@@ -0,0 +1,75 @@
+#ifndef GEOMETRY_CACHE_H
+#define GEOMETRY_CACHE_H
+
+#include "gpu_mesh.h"
+
+#include <cstddef>
+#include <unordered_map>
+
+// parameters that fully describe a Cylinder's geometry
+struct CylinderKey
+{
+    float baseRadius = 1.0f;
+    float topRadius = 1.0f;
+    float height = 1.0f;
+    int sectorCount = 36;
+    int stackCount = 1;
+    bool smooth = true;
+
+    bool operator==(const CylinderKey& other) const
+    {
+        return baseRadius == other.baseRadius && topRadius == other.topRadius &&
+            height == other.height && sectorCount == other.sectorCount &&
+            stackCount == other.stackCount && smooth == other.smooth;
+    }
+};
+
+struct CylinderKeyHash
+{
+    std::size_t operator()(const CylinderKey& key) const;
+};
+
+// uploaded cylinder plus the index ranges of its parts
+struct CachedCylinder
+{
+    GpuMesh mesh;
+    unsigned int sideStart = 0;
+    unsigned int sideCount = 0;
+    unsigned int baseStart = 0;
+    unsigned int baseCount = 0;
+    unsigned int topStart = 0;
+    unsigned int topCount = 0;
+    unsigned int triangleCount = 0;
+};
+
+// Retained-mode store of uploaded shapes. A shape is built and uploaded the first
+// time its parameters are requested and reused on every later request, so the render
+// loop never rebuilds vertices or allocates buffers once the scene is warm.
+class GeometryCache
+{
+public:
+    struct Stats
+    {
+        unsigned long long hits = 0;
+        unsigned long long misses = 0;
+    };
+
+    GeometryCache() {}
+    GeometryCache(const GeometryCache&) = delete;
+    GeometryCache& operator=(const GeometryCache&) = delete;
+
+    // returns the uploaded cylinder for these parameters, building it on first use
+    const CachedCylinder& getCylinder(const CylinderKey& key);
+
+    // frees every cached shape; needs the GL context that created them
+    void clear();
+
+    const Stats& getStats() const { return stats; }
+    std::size_t size() const { return cylinders.size(); }
+
+private:
+    std::unordered_map<CylinderKey, CachedCylinder, CylinderKeyHash> cylinders;
+    Stats stats;
+};
+
+#endif
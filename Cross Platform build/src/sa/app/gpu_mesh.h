@@ -0,0 +1,116 @@
+#ifndef GPU_MESH_H
+#define GPU_MESH_H
+
+#include <glad/glad.h>
+
+#include "render_counters.h"
+
+#include <cstddef>
+#include <utility>
+
+// GPU side of an interleaved position/normal/texcoord mesh (32 byte stride, the same
+// layout Cylinder and BlackHole produce). Owns its VAO/VBO/IBO and releases them on
+// destruction, so it can only be moved, never copied.
+class GpuMesh
+{
+public:
+    GpuMesh() {}
+    ~GpuMesh() { release(); }
+
+    GpuMesh(const GpuMesh&) = delete;
+    GpuMesh& operator=(const GpuMesh&) = delete;
+
+    GpuMesh(GpuMesh&& other) noexcept { *this = std::move(other); }
+    GpuMesh& operator=(GpuMesh&& other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            VAO = other.VAO;
+            VBO = other.VBO;
+            IBO = other.IBO;
+            indexCount = other.indexCount;
+            mode = other.mode;
+            residentBytes = other.residentBytes;
+            other.VAO = other.VBO = other.IBO = 0;
+            other.indexCount = 0;
+            other.residentBytes = 0;
+        }
+        return *this;
+    }
+
+    // uploads interleaved V/N/T vertices and indices; can be called again to replace the data
+    void upload(const float* vertices, unsigned int vertexBytes,
+        const unsigned int* indices, unsigned int indexCount, GLenum mode = GL_TRIANGLES)
+    {
+        if (VAO == 0)
+        {
+            glGenVertexArrays(1, &VAO);
+            glGenBuffers(1, &VBO);
+            glGenBuffers(1, &IBO);
+        }
+        this->indexCount = indexCount;
+        this->mode = mode;
+
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, vertexBytes, vertices, GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int), indices, GL_STATIC_DRAW);
+        trackBufferBytes(residentBytes, vertexBytes + indexCount * sizeof(unsigned int));
+
+        const GLsizei stride = 8 * sizeof(float);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)(6 * sizeof(float)));
+        glBindVertexArray(0);
+    }
+
+    // draws the whole index buffer
+    void draw() const
+    {
+        drawRange(0, indexCount);
+    }
+
+    // draws `count` indices starting at index `first`
+    void drawRange(unsigned int first, unsigned int count) const
+    {
+        if (VAO == 0)
+            return;
+        glBindVertexArray(VAO);
+        glDrawElements(mode, count, GL_UNSIGNED_INT, (void*)(first * sizeof(unsigned int)));
+        glBindVertexArray(0);
+        countStateChanges();
+        countDraw(mode, count);
+    }
+
+    void release()
+    {
+        if (VAO == 0)
+            return;
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &IBO);
+        VAO = VBO = IBO = 0;
+        indexCount = 0;
+        trackBufferBytes(residentBytes, 0);
+    }
+
+    bool isValid() const { return VAO != 0; }
+    unsigned int getVAO() const { return VAO; }
+    unsigned int getIndexCount() const { return indexCount; }
+    GLenum getMode() const { return mode; }
+
+private:
+    unsigned int VAO = 0;
+    unsigned int VBO = 0;
+    unsigned int IBO = 0;
+    unsigned int indexCount = 0;
+    GLenum mode = GL_TRIANGLES;
+    std::size_t residentBytes = 0;
+};
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <glad/glad.h>
+
+// Measures GPU time per frame from a pair of GL_TIMESTAMP queries (core since 3.3).
+// Timestamps nest freely, so the GL_TIME_ELAPSED target stays free for the profiler's
+// GPU scopes inside the frame. Results arrive a few frames late, so the pairs form a
+// small ring: a frame's result is collected once the GPU has finished it, and only a
+// full ring has to wait.
+class GpuTimer
+{
+public:
+    static const unsigned int LATENCY = 4;
+
+    GpuTimer() {}
+    ~GpuTimer() { release(); }
+
+    GpuTimer(const GpuTimer&) = delete;
+    GpuTimer& operator=(const GpuTimer&) = delete;
+
+    void create()
+    {
+        if (queries[0][0] == 0)
+            glGenQueries(LATENCY * 2, &queries[0][0]);
+        head = pending = 0;
+    }
+
+    // starts timing `frame`; with a full ring the oldest result has to be collected first
+    bool begin(unsigned int frame)
+    {
+        if (queries[0][0] == 0 || pending == LATENCY)
+            return false;
+        frames[head] = frame;
+        glQueryCounter(queries[head][0], GL_TIMESTAMP);
+        return true;
+    }
+
+    void end()
+    {
+        glQueryCounter(queries[head][1], GL_TIMESTAMP);
+        head = (head + 1) % LATENCY;
+        pending++;
+    }
+
+    // takes the oldest finished result; with `wait` blocks until it is available
+    bool collect(unsigned int& frame, double& milliseconds, bool wait = false)
+    {
+        if (pending == 0)
+            return false;
+        unsigned int oldest = (head + LATENCY - pending) % LATENCY;
+        if (!wait)
+        {
+            GLint available = 0;
+            glGetQueryObjectiv(queries[oldest][1], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                return false;
+        }
+        GLuint64 start = 0, end = 0;
+        glGetQueryObjectui64v(queries[oldest][0], GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(queries[oldest][1], GL_QUERY_RESULT, &end);
+        frame = frames[oldest];
+        milliseconds = (end - start) / 1.0e6;
+        pending--;
+        return true;
+    }
+
+    unsigned int getPending() const { return pending; }
+
+    void release()
+    {
+        if (queries[0][0] == 0)
+            return;
+        glDeleteQueries(LATENCY * 2, &queries[0][0]);
+        for (unsigned int i = 0; i < LATENCY; i++)
+            queries[i][0] = queries[i][1] = 0;
+        head = pending = 0;
+    }
+
+private:
+    unsigned int queries[LATENCY][2] = {};     // start and end timestamp
+    unsigned int frames[LATENCY] = {};
+    unsigned int head = 0;
+    unsigned int pending = 0;
+};
+
+#endif
@@ -0,0 +1,156 @@
+#include "headless_context.h"
+
+#include <glad/glad.h>
+
+#include <iostream>
+
+#ifdef SA_HAVE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <cstring>
+
+namespace
+{
+    EGLDisplay openDisplay()
+    {
+        // the surfaceless platform needs neither X11 nor a DRM device
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (getPlatformDisplay)
+        {
+            EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+            if (display != EGL_NO_DISPLAY && eglInitialize(display, NULL, NULL))
+                return display;
+        }
+        EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        if (display != EGL_NO_DISPLAY && eglInitialize(display, NULL, NULL))
+            return display;
+        return EGL_NO_DISPLAY;
+    }
+}
+
+bool HeadlessContext::create(int majorVersion, int minorVersion)
+{
+    release();
+    EGLDisplay eglDisplay = openDisplay();
+    if (eglDisplay == EGL_NO_DISPLAY)
+    {
+        std::cout << "ERROR::HEADLESS::EGL_DISPLAY: no EGL display could be initialized" << std::endl;
+        return false;
+    }
+    display = eglDisplay;
+
+    if (!eglBindAPI(EGL_OPENGL_API))
+    {
+        std::cout << "ERROR::HEADLESS::EGL_BIND_API: desktop OpenGL is not supported" << std::endl;
+        release();
+        return false;
+    }
+
+    // no surface is ever made, so any config (or none, with EGL_KHR_no_config_context) will do
+    EGLConfig config = EGL_NO_CONFIG_KHR;
+    const char* extensions = eglQueryString(eglDisplay, EGL_EXTENSIONS);
+    if (!extensions || !std::strstr(extensions, "EGL_KHR_no_config_context"))
+    {
+        const EGLint configAttributes[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+        EGLint configCount = 0;
+        if (!eglChooseConfig(eglDisplay, configAttributes, &config, 1, &configCount) || configCount == 0)
+        {
+            std::cout << "ERROR::HEADLESS::EGL_CONFIG: no OpenGL capable config" << std::endl;
+            release();
+            return false;
+        }
+    }
+
+    const EGLint contextAttributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, majorVersion,
+        EGL_CONTEXT_MINOR_VERSION, minorVersion,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    EGLContext eglContext = eglCreateContext(eglDisplay, config, EGL_NO_CONTEXT, contextAttributes);
+    if (eglContext == EGL_NO_CONTEXT)
+    {
+        std::cout << "ERROR::HEADLESS::EGL_CONTEXT: could not create a " << majorVersion << "." << minorVersion
+            << " core context (0x" << std::hex << eglGetError() << std::dec << ")" << std::endl;
+        release();
+        return false;
+    }
+    context = eglContext;
+
+    if (!eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, eglContext))
+    {
+        std::cout << "ERROR::HEADLESS::EGL_MAKE_CURRENT: surfaceless contexts are not supported" << std::endl;
+        release();
+        return false;
+    }
+    if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress))
+    {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        release();
+        return false;
+    }
+    return true;
+}
+
+void HeadlessContext::release()
+{
+    if (display == nullptr)
+        return;
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (context != nullptr)
+        eglDestroyContext(display, context);
+    eglTerminate(display);
+    context = nullptr;
+    display = nullptr;
+}
+
+bool HeadlessContext::makeCurrent()
+{
+    if (context == nullptr || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+    {
+        std::cout << "ERROR::HEADLESS::MAKE_CURRENT_FAILED: 0x" << std::hex << eglGetError() << std::dec << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void HeadlessContext::doneCurrent()
+{
+    if (display != nullptr)
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+}
+
+bool HeadlessContext::isSupported()
+{
+    return true;
+}
+
+#else
+
+bool HeadlessContext::create(int, int)
+{
+    std::cout << "ERROR::HEADLESS::UNSUPPORTED: built without EGL, headless mode is not available" << std::endl;
+    return false;
+}
+
+void HeadlessContext::release()
+{
+}
+
+bool HeadlessContext::makeCurrent()
+{
+    return false;
+}
+
+void HeadlessContext::doneCurrent()
+{
+}
+
+bool HeadlessContext::isSupported()
+{
+    return false;
+}
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef HEADLESS_CONTEXT_H
+#define HEADLESS_CONTEXT_H
+
+// OpenGL context without a window or display server, for CI hosts with no GPU.
+// Uses EGL on Mesa's surfaceless platform (llvmpipe when there is no GPU), falling back
+// to the default EGL display. There is no default framebuffer, so everything has to be
+// drawn into an OffscreenTarget. Only available when built with SA_HAVE_EGL.
+class HeadlessContext
+{
+public:
+    HeadlessContext() {}
+    ~HeadlessContext() { release(); }
+
+    HeadlessContext(const HeadlessContext&) = delete;
+    HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+    // creates a core profile context of the given version, makes it current and loads GL
+    bool create(int majorVersion = 3, int minorVersion = 3);
+    void release();
+
+    // moves the context between threads: it is current on at most one thread at a time
+    bool makeCurrent();
+    void doneCurrent();
+
+    bool isCurrent() const { return context != nullptr; }
+    // false when the build has no EGL support
+    static bool isSupported();
+
+private:
+    void* display = nullptr;
+    void* context = nullptr;
+};
+
+#endif
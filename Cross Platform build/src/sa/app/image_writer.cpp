@@ -0,0 +1,121 @@
+#include "image_writer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+    std::uint32_t crc32(const unsigned char* data, std::size_t size, std::uint32_t crc = 0)
+    {
+        static std::uint32_t table[256];
+        static bool tableReady = false;
+        if (!tableReady)
+        {
+            for (std::uint32_t n = 0; n < 256; n++)
+            {
+                std::uint32_t c = n;
+                for (int k = 0; k < 8; k++)
+                    c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                table[n] = c;
+            }
+            tableReady = true;
+        }
+        crc = ~crc;
+        for (std::size_t i = 0; i < size; i++)
+            crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    void putBigEndian(std::vector<unsigned char>& out, std::uint32_t value)
+    {
+        out.push_back((unsigned char)(value >> 24));
+        out.push_back((unsigned char)(value >> 16));
+        out.push_back((unsigned char)(value >> 8));
+        out.push_back((unsigned char)value);
+    }
+
+    void putChunk(std::vector<unsigned char>& out, const char* type, const std::vector<unsigned char>& data)
+    {
+        putBigEndian(out, (std::uint32_t)data.size());
+        std::size_t typeStart = out.size();
+        out.insert(out.end(), type, type + 4);
+        out.insert(out.end(), data.begin(), data.end());
+        putBigEndian(out, crc32(out.data() + typeStart, out.size() - typeStart));
+    }
+
+    bool writeFile(const std::string& path, const unsigned char* data, std::size_t size)
+    {
+        std::ofstream file(path, std::ios::binary);
+        if (!file)
+        {
+            std::cout << "ERROR::IMAGE::FILE_NOT_WRITTEN: " << path << std::endl;
+            return false;
+        }
+        file.write((const char*)data, size);
+        return (bool)file;
+    }
+}
+
+bool writePng(const std::string& path, int width, int height, const unsigned char* rgba)
+{
+    // every scanline starts with filter type 0 (none)
+    const std::size_t rowBytes = (std::size_t)width * 4;
+    std::vector<unsigned char> scanlines;
+    scanlines.reserve((rowBytes + 1) * height);
+    for (int y = 0; y < height; y++)
+    {
+        scanlines.push_back(0);
+        scanlines.insert(scanlines.end(), rgba + y * rowBytes, rgba + (y + 1) * rowBytes);
+    }
+
+    // zlib stream of stored deflate blocks (at most 65535 bytes each) and an Adler-32 trailer
+    std::vector<unsigned char> idat;
+    idat.reserve(scanlines.size() + scanlines.size() / 65535 * 5 + 16);
+    idat.push_back(0x78);
+    idat.push_back(0x01);
+    std::size_t offset = 0;
+    do
+    {
+        std::size_t blockSize = std::min<std::size_t>(scanlines.size() - offset, 65535);
+        bool last = offset + blockSize == scanlines.size();
+        idat.push_back(last ? 1 : 0);
+        idat.push_back((unsigned char)blockSize);
+        idat.push_back((unsigned char)(blockSize >> 8));
+        idat.push_back((unsigned char)~blockSize);
+        idat.push_back((unsigned char)(~blockSize >> 8));
+        idat.insert(idat.end(), scanlines.begin() + offset, scanlines.begin() + offset + blockSize);
+        offset += blockSize;
+    } while (offset < scanlines.size());
+    std::uint32_t a = 1, b = 0;
+    for (unsigned char byte : scanlines)
+    {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    putBigEndian(idat, (b << 16) | a);
+
+    std::vector<unsigned char> header;
+    putBigEndian(header, (std::uint32_t)width);
+    putBigEndian(header, (std::uint32_t)height);
+    header.push_back(8);    // bits per channel
+    header.push_back(6);    // RGBA
+    header.push_back(0);    // deflate
+    header.push_back(0);    // adaptive filtering
+    header.push_back(0);    // not interlaced
+
+    static const unsigned char SIGNATURE[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    std::vector<unsigned char> png(SIGNATURE, SIGNATURE + sizeof(SIGNATURE));
+    png.reserve(idat.size() + 64);
+    putChunk(png, "IHDR", header);
+    putChunk(png, "IDAT", idat);
+    putChunk(png, "IEND", std::vector<unsigned char>());
+    return writeFile(path, png.data(), png.size());
+}
+
+bool writeRaw(const std::string& path, int width, int height, const unsigned char* rgba)
+{
+    return writeFile(path, rgba, (std::size_t)width * height * 4);
+}
@@ -0,0 +1,14 @@
+#ifndef IMAGE_WRITER_H
+#define IMAGE_WRITER_H
+
+#include <string>
+
+// Frame export for headless runs. Both take tightly packed 8-bit RGBA, top row first.
+
+// writes a PNG; the image data is stored uncompressed so no zlib is needed
+bool writePng(const std::string& path, int width, int height, const unsigned char* rgba);
+
+// writes the pixels as they are, width * height * 4 bytes with no header
+bool writeRaw(const std::string& path, int width, int height, const unsigned char* rgba);
+
+#endif
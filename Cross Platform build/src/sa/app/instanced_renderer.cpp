@@ -0,0 +1,126 @@
+#include "instanced_renderer.h"
+
+#include <cstddef>
+
+void InstancedRenderer::create()
+{
+    if (instanceBuffer == 0)
+        glGenBuffers(1, &instanceBuffer);
+    capacity = 0;
+    dirty = true;
+}
+
+void InstancedRenderer::release()
+{
+    if (instanceBuffer == 0)
+        return;
+    glDeleteBuffers(1, &instanceBuffer);
+    instanceBuffer = 0;
+    capacity = 0;
+    trackBufferBytes(trackedBytes, 0);
+}
+
+void InstancedRenderer::attach(const Shader& shader) const
+{
+    shader.use();
+    shader.setInt("layerTextures", LAYER_TEXTURE_UNIT);
+}
+
+void InstancedRenderer::clear()
+{
+    instances.clear();
+    dirty = true;
+}
+
+void InstancedRenderer::add(const glm::mat4& model, const glm::vec4& tint, float layer)
+{
+    InstanceData instance;
+    instance.model = model;
+    instance.tint = tint;
+    instance.layer = layer;
+    instances.push_back(instance);
+    dirty = true;
+}
+
+void InstancedRenderer::upload()
+{
+    const std::size_t bytes = instances.size() * sizeof(InstanceData);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    if (bytes > capacity)
+    {
+        capacity = bytes;
+        glBufferData(GL_ARRAY_BUFFER, capacity, instances.data(), GL_STREAM_DRAW);
+        trackBufferBytes(trackedBytes, capacity);
+    }
+    else
+    {
+        // orphan the old storage so the previous frame can keep reading it
+        glBufferData(GL_ARRAY_BUFFER, capacity, NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, instances.data());
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    stats.bytesUploaded += bytes;
+    dirty = false;
+}
+
+void InstancedRenderer::draw(const GpuMesh& mesh)
+{
+    draw(mesh, 0, mesh.getIndexCount());
+}
+
+void InstancedRenderer::draw(const GpuMesh& mesh, unsigned int first, unsigned int count)
+{
+    if (instanceBuffer == 0 || !mesh.isValid() || instances.empty() || count == 0)
+        return;
+    if (dirty)
+        upload();
+
+    if (layerTexture != 0)
+    {
+        glActiveTexture(GL_TEXTURE0 + LAYER_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, layerTexture);
+        glActiveTexture(GL_TEXTURE0);
+        countStateChanges();
+    }
+
+    // the instance arrays are enabled only for this draw, so plain draws of the same
+    // mesh keep reading the constant attributes set by setSingleInstance()
+    glBindVertexArray(mesh.getVAO());
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    const GLsizei stride = sizeof(InstanceData);
+    for (unsigned int column = 0; column < 4; column++)
+    {
+        const unsigned int location = INSTANCE_MODEL_LOCATION + column;
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, stride,
+            (void*)(offsetof(InstanceData, model) + column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(location, 1);
+    }
+    glEnableVertexAttribArray(INSTANCE_TINT_LOCATION);
+    glVertexAttribPointer(INSTANCE_TINT_LOCATION, 4, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(InstanceData, tint));
+    glVertexAttribDivisor(INSTANCE_TINT_LOCATION, 1);
+    glEnableVertexAttribArray(INSTANCE_LAYER_LOCATION);
+    glVertexAttribPointer(INSTANCE_LAYER_LOCATION, 1, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(InstanceData, layer));
+    glVertexAttribDivisor(INSTANCE_LAYER_LOCATION, 1);
+
+    glDrawElementsInstanced(mesh.getMode(), count, GL_UNSIGNED_INT,
+        (void*)(first * sizeof(unsigned int)), (GLsizei)instances.size());
+    countStateChanges();
+    countDraw(mesh.getMode(), count, (unsigned int)instances.size());
+
+    for (unsigned int location = INSTANCE_MODEL_LOCATION; location <= INSTANCE_LAYER_LOCATION; location++)
+        glDisableVertexAttribArray(location);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+
+    ++stats.drawCalls;
+    stats.instances += instances.size();
+}
+
+void InstancedRenderer::setSingleInstance(const glm::mat4& model, const glm::vec4& tint, float layer)
+{
+    for (unsigned int column = 0; column < 4; column++)
+        glVertexAttrib4fv(INSTANCE_MODEL_LOCATION + column, &model[column][0]);
+    glVertexAttrib4fv(INSTANCE_TINT_LOCATION, &tint[0]);
+    glVertexAttrib1f(INSTANCE_LAYER_LOCATION, layer);
+}
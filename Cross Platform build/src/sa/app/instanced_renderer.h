@@ -0,0 +1,83 @@
+#ifndef INSTANCED_RENDERER_H
+#define INSTANCED_RENDERER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "gpu_mesh.h"
+#include "shader.h"
+
+// attribute locations of the per-instance inputs in shader.vs
+const unsigned int INSTANCE_MODEL_LOCATION = 3;     // mat4, uses 3 to 6
+const unsigned int INSTANCE_TINT_LOCATION = 7;
+const unsigned int INSTANCE_LAYER_LOCATION = 8;
+// texture unit of shader.fs's layerTextures array
+const unsigned int LAYER_TEXTURE_UNIT = 4;
+
+// one instance as it is stored in the instance buffer
+struct InstanceData
+{
+    glm::mat4 model;
+    glm::vec4 tint;
+    float layer;        // layer of the array texture, negative to use the material maps
+};
+
+static_assert(sizeof(InstanceData) == 84, "InstanceData must stay tightly packed");
+
+// Draws many copies of one cached mesh with a single glDrawElementsInstanced.
+// Instances are collected on the CPU with add() and sent in one upload per frame
+// (the buffer is orphaned first, so the driver never waits on the previous frame's draw).
+// shader.vs reads the model matrix, tint and layer as instanced attributes; draws that
+// don't go through here set those attributes once with setSingleInstance() instead.
+class InstancedRenderer
+{
+public:
+    struct Stats
+    {
+        unsigned long long drawCalls = 0;
+        unsigned long long instances = 0;
+        unsigned long long bytesUploaded = 0;
+    };
+
+    InstancedRenderer() {}
+    ~InstancedRenderer() { release(); }
+    InstancedRenderer(const InstancedRenderer&) = delete;
+    InstancedRenderer& operator=(const InstancedRenderer&) = delete;
+
+    void create();
+    void release();
+
+    // points shader.fs's layerTextures sampler at LAYER_TEXTURE_UNIT
+    void attach(const Shader& shader) const;
+    // 2D array texture sampled by instances with a layer >= 0, bound on every draw
+    void setLayerTexture(unsigned int textureArray) { layerTexture = textureArray; }
+
+    void reserve(std::size_t count) { instances.reserve(count); }
+    void clear();
+    void add(const glm::mat4& model, const glm::vec4& tint = glm::vec4(1.0f), float layer = -1.0f);
+    std::size_t size() const { return instances.size(); }
+
+    // draws every added instance of the mesh, or of its index range [first, first + count)
+    void draw(const GpuMesh& mesh);
+    void draw(const GpuMesh& mesh, unsigned int first, unsigned int count);
+
+    // sets the instance attributes as constants for a plain (non-instanced) draw
+    static void setSingleInstance(const glm::mat4& model, const glm::vec4& tint = glm::vec4(1.0f), float layer = -1.0f);
+
+    const Stats& getStats() const { return stats; }
+
+private:
+    void upload();
+
+    std::vector<InstanceData> instances;
+    bool dirty = false;
+    unsigned int instanceBuffer = 0;
+    std::size_t capacity = 0;
+    std::size_t trackedBytes = 0;     // capacity as counted in renderCounters()
+    unsigned int layerTexture = 0;
+    Stats stats;
+};
+
+#endif
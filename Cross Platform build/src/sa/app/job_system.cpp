@@ -0,0 +1,400 @@
+#include "job_system.h"
+
+namespace
+{
+    // continuation list of a counter whose batch has finished: later continuations start at once
+    Job closedList;
+    Job* const CLOSED = &closedList;
+
+    thread_local const JobSystem* threadOwner = nullptr;
+    thread_local int threadSlot = -1;
+    // set while the thread runs a JOB_BACKGROUND job, whose own jobs are background too
+    thread_local bool runningBackground = false;
+
+    // xorshift, per thread: picks where a thief starts looking
+    unsigned int nextRandom()
+    {
+        thread_local unsigned int state = (unsigned int)std::hash<std::thread::id>()(std::this_thread::get_id()) | 1u;
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+}
+
+bool JobDeque::push(Job* job)
+{
+    std::int64_t b = bottom.load(std::memory_order_relaxed);
+    std::int64_t t = top.load(std::memory_order_acquire);
+    if (b - t >= (std::int64_t)JOB_DEQUE_CAPACITY)
+        return false;
+    jobs[b & (JOB_DEQUE_CAPACITY - 1)].store(job, std::memory_order_release);
+    bottom.store(b + 1, std::memory_order_release);
+    return true;
+}
+
+Job* JobDeque::pop()
+{
+    std::int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+    bottom.store(b, std::memory_order_seq_cst);
+    std::int64_t t = top.load(std::memory_order_seq_cst);
+    if (t > b)
+    {
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    Job* job = jobs[b & (JOB_DEQUE_CAPACITY - 1)].load(std::memory_order_acquire);
+    if (t == b)
+    {
+        // the last job: race the thieves for it
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            job = nullptr;
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+Job* JobDeque::steal()
+{
+    std::int64_t t = top.load(std::memory_order_seq_cst);
+    std::int64_t b = bottom.load(std::memory_order_seq_cst);
+    if (t >= b)
+        return nullptr;
+    Job* job = jobs[t & (JOB_DEQUE_CAPACITY - 1)].load(std::memory_order_acquire);
+    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        return nullptr;
+    return job;
+}
+
+void JobSystem::create(unsigned int workerCount)
+{
+    release();
+    if (workerCount == 0)
+        workerCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+    glThread = std::this_thread::get_id();
+    threadOwner = this;
+    threadSlot = 0;
+    stopping = false;
+    otherJobs = 0;
+    glThreadCount = 0;
+    backgroundRun = 0;
+    inlineCount = 0;
+    for (unsigned int i = 0; i <= workerCount; i++)
+        threads.emplace_back();
+    for (unsigned int i = 1; i <= workerCount; i++)
+        workers.emplace_back(&JobSystem::workerLoop, this, i);
+}
+
+void JobSystem::release()
+{
+    if (!workers.empty())
+    {
+        // workers only leave once they find nothing left to run
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        sleepCondition.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+        workers.clear();
+    }
+    if (std::this_thread::get_id() == glThread.load())
+        runGlThreadJobs();
+    threads.clear();
+    if (threadOwner == this)
+        threadOwner = nullptr;
+}
+
+void JobSystem::setGlThread()
+{
+    glThread = std::this_thread::get_id();
+}
+
+int JobSystem::threadIndex() const
+{
+    return threadOwner == this ? threadSlot : -1;
+}
+
+void JobSystem::addToCounter(JobCounter* counter)
+{
+    // a counter starts a new batch once the previous one has closed its continuation list
+    if (counter && counter->pending.fetch_add(1) == 0)
+    {
+        Job* expected = CLOSED;
+        counter->continuations.compare_exchange_strong(expected, nullptr);
+    }
+}
+
+void JobSystem::run(std::function<void()> work, JobCounter* counter, JobAffinity affinity)
+{
+    Job* job = new Job();
+    job->work = std::move(work);
+    job->counter = counter;
+    job->affinity = affinity == JOB_ANY && runningBackground ? JOB_BACKGROUND : affinity;
+    addToCounter(counter);
+    schedule(job);
+}
+
+void JobSystem::then(JobCounter& after, std::function<void()> work, JobCounter* counter, JobAffinity affinity)
+{
+    Job* job = new Job();
+    job->work = std::move(work);
+    job->counter = counter;
+    job->affinity = affinity == JOB_ANY && runningBackground ? JOB_BACKGROUND : affinity;
+    addToCounter(counter);
+
+    Job* head = after.continuations.load();
+    do
+    {
+        // a finished (or empty) batch starts the job straight away
+        if (head == CLOSED || (head == nullptr && after.isDone()))
+        {
+            schedule(job);
+            return;
+        }
+        job->next = head;
+    } while (!after.continuations.compare_exchange_weak(head, job));
+}
+
+void JobSystem::schedule(Job* job)
+{
+    if (job->affinity == JOB_GL_THREAD)
+    {
+        // the GL thread itself runs it right away when there are no workers to wait for
+        if (workers.empty() && std::this_thread::get_id() == glThread.load())
+        {
+            glThreadCount.fetch_add(1, std::memory_order_relaxed);
+            execute(job, threadIndex());
+            return;
+        }
+        std::lock_guard<std::mutex> lock(glMutex);
+        glJobs.push_back(job);
+        return;
+    }
+
+    int self = threadIndex();
+    if (job->affinity == JOB_BACKGROUND && !workers.empty())
+    {
+        {
+            std::lock_guard<std::mutex> lock(backgroundMutex);
+            background.push_back(job);
+            backgroundCount.fetch_add(1);
+        }
+        wakeWorker();
+        return;
+    }
+    if (workers.empty() || (self >= 0 && !threads[self].deque.push(job)))
+    {
+        inlineCount.fetch_add(1, std::memory_order_relaxed);
+        execute(job, self);
+        return;
+    }
+    if (self < 0)
+    {
+        std::lock_guard<std::mutex> lock(injectionMutex);
+        injected.push_back(job);
+        injectedCount.fetch_add(1);
+    }
+    wakeWorker();
+}
+
+void JobSystem::execute(Job* job, int self)
+{
+    const bool outer = runningBackground;
+    runningBackground = job->affinity == JOB_BACKGROUND;
+    if (runningBackground)
+        backgroundRun.fetch_add(1, std::memory_order_relaxed);
+    job->work();
+    runningBackground = outer;
+    if (self >= 0 && !threads.empty())
+        threads[self].jobs.fetch_add(1, std::memory_order_relaxed);
+    else
+        otherJobs.fetch_add(1, std::memory_order_relaxed);
+
+    JobCounter* counter = job->counter;
+    delete job;
+    if (!counter)
+        return;
+    counter->finishing.fetch_add(1);
+    if (counter->pending.fetch_sub(1) == 1)
+    {
+        // the batch is done: start what was waiting on it, newest registration last
+        Job* list = counter->continuations.exchange(CLOSED);
+        Job* reversed = nullptr;
+        while (list)
+        {
+            Job* next = list->next;
+            list->next = reversed;
+            reversed = list;
+            list = next;
+        }
+        while (reversed)
+        {
+            Job* next = reversed->next;
+            reversed->next = nullptr;
+            schedule(reversed);
+            reversed = next;
+        }
+    }
+    counter->finishing.fetch_sub(1);
+}
+
+Job* JobSystem::findJob(int self)
+{
+    if (threads.empty())
+        return nullptr;
+    if (self >= 0)
+    {
+        if (Job* job = threads[self].deque.pop())
+            return job;
+    }
+    if (injectedCount.load() > 0)
+    {
+        std::lock_guard<std::mutex> lock(injectionMutex);
+        if (!injected.empty())
+        {
+            Job* job = injected.front();
+            injected.pop_front();
+            injectedCount.fetch_sub(1);
+            return job;
+        }
+    }
+    const unsigned int count = (unsigned int)threads.size();
+    const unsigned int start = nextRandom() % count;
+    for (unsigned int i = 0; i < count; i++)
+    {
+        unsigned int victim = (start + i) % count;
+        if ((int)victim == self)
+            continue;
+        if (Job* job = threads[victim].deque.steal())
+        {
+            if (self >= 0)
+                threads[self].steals.fetch_add(1, std::memory_order_relaxed);
+            return job;
+        }
+    }
+    // the background queue last, and only for workers
+    if (self > 0 && backgroundCount.load() > 0)
+    {
+        std::lock_guard<std::mutex> lock(backgroundMutex);
+        if (!background.empty())
+        {
+            Job* job = background.front();
+            background.pop_front();
+            backgroundCount.fetch_sub(1);
+            return job;
+        }
+    }
+    return nullptr;
+}
+
+bool JobSystem::hasQueuedJobs() const
+{
+    if (injectedCount.load() > 0 || backgroundCount.load() > 0)
+        return true;
+    for (const ThreadState& thread : threads)
+    {
+        if (!thread.deque.empty())
+            return true;
+    }
+    return false;
+}
+
+void JobSystem::wait(JobCounter& counter)
+{
+    const int self = threadIndex();
+    const bool onGlThread = std::this_thread::get_id() == glThread.load();
+    unsigned int idle = 0;
+    while (!counter.isDone())
+    {
+        if (onGlThread)
+            runGlThreadJobs();
+        if (Job* job = findJob(self))
+        {
+            execute(job, self);
+            idle = 0;
+        }
+        else if (++idle > 64)
+            std::this_thread::yield();
+    }
+}
+
+void JobSystem::runGlThreadJobs()
+{
+    for (;;)
+    {
+        Job* job = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(glMutex);
+            if (glJobs.empty())
+                return;
+            job = glJobs.front();
+            glJobs.pop_front();
+        }
+        glThreadCount.fetch_add(1, std::memory_order_relaxed);
+        execute(job, threadIndex());
+    }
+}
+
+void JobSystem::wakeWorker()
+{
+    // pairs with the sleeper's increment-then-check in workerLoop: either it sees the new
+    // job, or this sees it sleeping and wakes it
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping.load() == 0)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    sleepCondition.notify_one();
+}
+
+void JobSystem::workerLoop(unsigned int index)
+{
+    threadOwner = this;
+    threadSlot = (int)index;
+    unsigned int idle = 0;
+    for (;;)
+    {
+        if (Job* job = findJob((int)index))
+        {
+            execute(job, (int)index);
+            idle = 0;
+            continue;
+        }
+        if (stopping.load())
+            return;
+        // a short spin catches the next job of a batch without a trip through the kernel
+        if (++idle < 64)
+            continue;
+        if (idle < 128)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleeping.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!hasQueuedJobs() && !stopping.load())
+            sleepCondition.wait(lock);
+        sleeping.fetch_sub(1);
+        idle = 0;
+    }
+}
+
+JobSystem::Stats JobSystem::getStats() const
+{
+    Stats stats;
+    for (const ThreadState& thread : threads)
+    {
+        stats.jobs += thread.jobs.load(std::memory_order_relaxed);
+        stats.steals += thread.steals.load(std::memory_order_relaxed);
+    }
+    stats.jobs += otherJobs.load(std::memory_order_relaxed);
+    stats.glThreadJobs = glThreadCount.load(std::memory_order_relaxed);
+    stats.backgroundJobs = backgroundRun.load(std::memory_order_relaxed);
+    stats.inlineJobs = inlineCount.load(std::memory_order_relaxed);
+    return stats;
+}
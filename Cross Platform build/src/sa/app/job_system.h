@@ -0,0 +1,200 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+const unsigned int JOB_DEQUE_CAPACITY = 1 << 12;    // per thread; a full deque runs new jobs inline
+
+struct Job;
+
+// where a job may run
+enum JobAffinity
+{
+    JOB_ANY,            // any thread, including one helping out while it waits on a counter
+    JOB_BACKGROUND,     // workers only: long jobs (texture decodes, cooks) that a frame thread
+                        // waiting on its own batch must not pick up; jobs they submit inherit it
+    JOB_GL_THREAD       // only the thread registered with setGlThread()
+};
+
+// Counts the unfinished jobs of a batch. wait() on it, or have more jobs start once it
+// reaches zero (JobSystem::then). Owned by the caller, and must outlive its jobs; reuse it
+// only after the batch it counted has finished.
+class JobCounter
+{
+public:
+    JobCounter() {}
+    JobCounter(const JobCounter&) = delete;
+    JobCounter& operator=(const JobCounter&) = delete;
+
+    // no job left, and the last one has finished with the counter
+    bool isDone() const { return pending.load() == 0 && finishing.load() == 0; }
+
+private:
+    friend class JobSystem;
+    std::atomic<int> pending{ 0 };
+    // threads between decrementing `pending` and their last access to the counter; a waiter
+    // that saw `pending` reach zero could otherwise free the counter under them
+    std::atomic<int> finishing{ 0 };
+    std::atomic<Job*> continuations{ nullptr };    // started when pending drops to zero
+};
+
+struct Job
+{
+    std::function<void()> work;
+    JobCounter* counter = nullptr;  // decremented once the work has run
+    Job* next = nullptr;            // in a counter's continuation list
+    JobAffinity affinity = JOB_ANY;
+};
+
+// Chase-Lev work-stealing deque: the owning thread pushes and pops at the bottom without
+// contention, other threads steal from the top with one compare-and-swap.
+class JobDeque
+{
+public:
+    // owner only; false when the deque is full
+    bool push(Job* job);
+    // owner only; newest job first
+    Job* pop();
+    // any thread; oldest job first, nullptr when empty or on losing a race
+    Job* steal();
+    bool empty() const { return bottom.load(std::memory_order_relaxed) <= top.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<Job*> jobs[JOB_DEQUE_CAPACITY] = {};
+    std::atomic<std::int64_t> top{ 0 };
+    std::atomic<std::int64_t> bottom{ 0 };
+};
+
+// Work-stealing job system. Every worker, and the thread that created the system (the main
+// thread), owns a JobDeque: jobs it submits go to its own deque, idle workers steal from the
+// others. Other threads submit through a locked queue. A thread waiting on a counter runs
+// jobs meanwhile, so jobs can submit and wait on nested batches (parallelFor inside a job).
+// Only workers run JOB_BACKGROUND jobs, from a queue of their own they turn to once
+// nothing else is left, so a frame's short jobs come first and a frame thread never helps
+// with them.
+//
+// JOB_GL_THREAD jobs (GL calls, which need the context) only run on the thread that last
+// called setGlThread(), from runGlThreadJobs() or from wait() called there. That is the
+// creating thread until another one takes the context.
+//
+// Before create(), and with no workers, jobs run on the calling thread as they are
+// submitted, so code using the system needs no serial fallback of its own.
+class JobSystem
+{
+public:
+    struct Stats
+    {
+        unsigned long long jobs = 0;            // run by workers and waiting threads
+        unsigned long long steals = 0;
+        unsigned long long glThreadJobs = 0;
+        unsigned long long backgroundJobs = 0;
+        unsigned long long inlineJobs = 0;      // run at submission (no workers, full deque)
+    };
+
+    JobSystem() {}
+    ~JobSystem() { release(); }
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // starts `workers` threads, or one per core but the caller's with 0; the calling
+    // thread becomes the main thread, and the GL thread
+    void create(unsigned int workers = 0);
+    // the calling thread, which now holds the GL context, runs the JOB_GL_THREAD jobs
+    void setGlThread();
+    // waits for the queued jobs, then stops the workers
+    void release();
+    unsigned int getWorkerCount() const { return (unsigned int)workers.size(); }
+
+    // runs `work` on a thread `affinity` allows, counted by `counter` (may be null)
+    void run(std::function<void()> work, JobCounter* counter = nullptr, JobAffinity affinity = JOB_ANY);
+    // runs `work` (counted by `counter`) once every job counted by `after` has finished;
+    // add the batch's jobs to `after` first
+    void then(JobCounter& after, std::function<void()> work, JobCounter* counter = nullptr, JobAffinity affinity = JOB_ANY);
+
+    // returns once the counter's jobs have finished, running other jobs meanwhile
+    void wait(JobCounter& counter);
+    // GL thread: runs the JOB_GL_THREAD jobs queued so far
+    void runGlThreadJobs();
+
+    // calls function(begin, end) over [0, count) in chunks of `grain` (0 picks about four
+    // chunks per thread) and returns when all have run; the caller runs chunks too
+    template <typename Function>
+    void parallelFor(unsigned int count, unsigned int grain, Function function)
+    {
+        if (count == 0)
+            return;
+        if (grain == 0)
+            grain = std::max(1u, count / ((getWorkerCount() + 1) * 4));
+        if (workers.empty() || grain >= count)
+        {
+            function(0u, count);
+            return;
+        }
+        JobCounter counter;
+        for (unsigned int begin = grain; begin < count; begin += grain)
+        {
+            unsigned int end = std::min(count, begin + grain);
+            run([&function, begin, end]() { function(begin, end); }, &counter);
+        }
+        function(0u, grain);
+        wait(counter);
+    }
+
+    Stats getStats() const;
+
+private:
+    // index of the calling thread's deque: 0 main thread, 1.. workers, -1 any other thread
+    int threadIndex() const;
+    void addToCounter(JobCounter* counter);
+    void schedule(Job* job);
+    void execute(Job* job, int self);
+    Job* findJob(int self);
+    bool hasQueuedJobs() const;
+    void workerLoop(unsigned int index);
+    void wakeWorker();
+
+    // a thread's deque and its counts, on a cache line of their own
+    struct alignas(64) ThreadState
+    {
+        JobDeque deque;
+        std::atomic<unsigned long long> jobs{ 0 };
+        std::atomic<unsigned long long> steals{ 0 };
+    };
+
+    std::vector<std::thread> workers;
+    std::deque<ThreadState> threads;        // 0 main thread, 1.. workers; never moved
+    std::mutex injectionMutex;              // jobs from threads that own no deque
+    std::deque<Job*> injected;
+    std::atomic<unsigned int> injectedCount{ 0 };
+    std::mutex glMutex;
+    std::deque<Job*> glJobs;
+    std::mutex backgroundMutex;
+    std::deque<Job*> background;
+    std::atomic<unsigned int> backgroundCount{ 0 };
+    std::mutex sleepMutex;
+    std::condition_variable sleepCondition;
+    std::atomic<unsigned int> sleeping{ 0 };
+    std::atomic<bool> stopping{ false };
+    std::atomic<std::thread::id> glThread;
+    std::atomic<unsigned long long> otherJobs{ 0 };    // run by threads that own no deque
+    std::atomic<unsigned long long> glThreadCount{ 0 };
+    std::atomic<unsigned long long> backgroundRun{ 0 };
+    std::atomic<unsigned long long> inlineCount{ 0 };
+};
+
+// the process-wide job system; app.cpp creates it at startup
+inline JobSystem& jobSystem()
+{
+    static JobSystem system;
+    return system;
+}
+
+#endif
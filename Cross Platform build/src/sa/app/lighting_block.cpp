@@ -0,0 +1,98 @@
+#include "lighting_block.h"
+
+#include <cstring>
+#include <iostream>
+
+void LightingBuffer::create()
+{
+    if (UBO == 0)
+        glGenBuffers(1, &UBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(LightingData), &data, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    trackBufferBytes(trackedBytes, sizeof(LightingData));
+    glBindBufferBase(GL_UNIFORM_BUFFER, LIGHTING_BINDING, UBO);
+    dirtyBegin = dirtyEnd = 0;
+}
+
+void LightingBuffer::release()
+{
+    if (UBO == 0)
+        return;
+    glDeleteBuffers(1, &UBO);
+    UBO = 0;
+    trackBufferBytes(trackedBytes, 0);
+}
+
+bool LightingBuffer::attach(const Shader& shader) const
+{
+    if (!shader.bindUniformBlock("Lighting", LIGHTING_BINDING))
+        return false;
+
+    GLuint blockIndex = glGetUniformBlockIndex(shader.ID, "Lighting");
+    GLint blockSize = 0;
+    glGetActiveUniformBlockiv(shader.ID, blockIndex, GL_UNIFORM_BLOCK_DATA_SIZE, &blockSize);
+    if (blockSize != (GLint)sizeof(LightingData))
+        std::cout << "ERROR::LIGHTING::BLOCK_SIZE_MISMATCH: shader " << blockSize << " bytes, expected " << sizeof(LightingData) << std::endl;
+    return true;
+}
+
+void LightingBuffer::setDirLight(const DirLightData& light)
+{
+    write(offsetof(LightingData, dirLight), &light, sizeof(light));
+}
+
+void LightingBuffer::setClusterParams(const ClusterParamsData& params)
+{
+    write(offsetof(LightingData, cluster), &params, sizeof(params));
+}
+
+void LightingBuffer::setSpotLight(const SpotLightData& light)
+{
+    write(offsetof(LightingData, spotLight), &light, sizeof(light));
+}
+
+void LightingBuffer::setSpotLightPose(const glm::vec3& position, const glm::vec3& direction)
+{
+    const std::size_t spot = offsetof(LightingData, spotLight);
+    write(spot + offsetof(SpotLightData, position), &position, sizeof(position));
+    write(spot + offsetof(SpotLightData, direction), &direction, sizeof(direction));
+}
+
+void LightingBuffer::write(std::size_t offset, const void* value, std::size_t size)
+{
+    char* target = reinterpret_cast<char*>(&data) + offset;
+    if (std::memcmp(target, value, size) == 0)
+        return;
+    std::memcpy(target, value, size);
+
+    if (dirtyBegin == dirtyEnd)
+    {
+        dirtyBegin = offset;
+        dirtyEnd = offset + size;
+    }
+    else
+    {
+        if (offset < dirtyBegin)
+            dirtyBegin = offset;
+        if (offset + size > dirtyEnd)
+            dirtyEnd = offset + size;
+    }
+}
+
+bool LightingBuffer::upload()
+{
+    if (UBO == 0 || dirtyBegin == dirtyEnd)
+        return false;
+
+    glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, dirtyBegin, dirtyEnd - dirtyBegin,
+        reinterpret_cast<const char*>(&data) + dirtyBegin);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    countUniformUpload();
+    ++stats.uploads;
+    stats.bytesUploaded += dirtyEnd - dirtyBegin;
+    dirtyBegin = dirtyEnd = 0;
+    return true;
+}
@@ -0,0 +1,125 @@
+#ifndef LIGHTING_BLOCK_H
+#define LIGHTING_BLOCK_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+#include "shader.h"
+
+// uniform buffer binding point shared by every program that declares the Lighting block
+const unsigned int LIGHTING_BINDING = 0;
+
+// C++ mirrors of the std140 structs in shader.fs. Each vec3 is followed by a float
+// (or padding) so every member lands on the offset std140 gives it. They are plain
+// aggregates so the whole block can be compared and copied bytewise.
+// PointLightData is not part of the block: point lights are binned by
+// ClusteredLighting and read from a texture buffer.
+struct DirLightData
+{
+    glm::vec3 direction;
+    float pad0;
+    glm::vec3 ambient;
+    float pad1;
+    glm::vec3 diffuse;
+    float pad2;
+    glm::vec3 specular;
+    float pad3;
+};
+
+struct PointLightData
+{
+    glm::vec3 position;
+    float constant;
+    glm::vec3 ambient;
+    float linear;
+    glm::vec3 diffuse;
+    float quadratic;
+    glm::vec3 specular;
+    float pad0;
+};
+
+struct SpotLightData
+{
+    glm::vec3 position;
+    float constant;
+    glm::vec3 direction;
+    float linear;
+    glm::vec3 ambient;
+    float quadratic;
+    glm::vec3 diffuse;
+    float cutOff;
+    glm::vec3 specular;
+    float outerCutOff;
+};
+
+// where shader.fs finds its cluster, filled in by ClusteredLighting::upload()
+struct ClusterParamsData
+{
+    glm::uvec4 dims;    // cells in x, y, z and the number of point lights
+    glm::vec4 depth;    // slice scale, slice bias, viewport width, viewport height
+};
+
+struct LightingData
+{
+    DirLightData dirLight;
+    SpotLightData spotLight;
+    ClusterParamsData cluster;
+};
+
+static_assert(sizeof(DirLightData) == 64, "DirLight must match its std140 size");
+static_assert(sizeof(PointLightData) == 64, "PointLight must match its std140 size");
+static_assert(sizeof(SpotLightData) == 80, "SpotLight must match its std140 size");
+static_assert(offsetof(LightingData, spotLight) == 64, "spotLight offset must match std140");
+static_assert(offsetof(LightingData, cluster) == 144, "cluster offset must match std140");
+
+// Persistent uniform buffer behind the Lighting block.
+// Setters only touch a CPU shadow copy and widen a dirty byte range when the value
+// actually changed; upload() then sends that range with a single glBufferSubData, or
+// nothing at all when the lights were left alone.
+class LightingBuffer
+{
+public:
+    struct Stats
+    {
+        unsigned long long uploads = 0;
+        unsigned long long bytesUploaded = 0;
+    };
+
+    LightingBuffer() : data() {}
+    ~LightingBuffer() { release(); }
+    LightingBuffer(const LightingBuffer&) = delete;
+    LightingBuffer& operator=(const LightingBuffer&) = delete;
+
+    // allocates the buffer and binds it to LIGHTING_BINDING
+    void create();
+    void release();
+
+    // points a program's Lighting block at LIGHTING_BINDING; false if it has none
+    bool attach(const Shader& shader) const;
+
+    void setDirLight(const DirLightData& light);
+    void setSpotLight(const SpotLightData& light);
+    // the flashlight follows the camera, so its pose is the only part that changes per frame
+    void setSpotLightPose(const glm::vec3& position, const glm::vec3& direction);
+    void setClusterParams(const ClusterParamsData& params);
+
+    // sends the dirty range, returns true if anything was uploaded
+    bool upload();
+
+    const LightingData& getData() const { return data; }
+    const Stats& getStats() const { return stats; }
+
+private:
+    void write(std::size_t offset, const void* value, std::size_t size);
+
+    unsigned int UBO = 0;
+    std::size_t trackedBytes = 0;     // buffer size as counted in renderCounters()
+    LightingData data;
+    std::size_t dirtyBegin = 0;
+    std::size_t dirtyEnd = 0;
+    Stats stats;
+};
+
+#endif
@@ -0,0 +1,126 @@
+#include "lod_manager.h"
+#include "instanced_renderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+float lodMaxScreenRadius(int sectors, float pixelError)
+{
+    const float PI = 3.14159265358979f;
+    return pixelError / (1.0f - std::cos(PI / std::max(sectors, 3)));
+}
+
+LodLevel makeLodLevel(const GeneratedMesh& geometry, int sectors, float pixelError)
+{
+    LodLevel level;
+    level.mesh.upload(geometry.vertices.data(), (unsigned int)(geometry.vertices.size() * sizeof(float)),
+        geometry.indices.data(), (unsigned int)geometry.indices.size());
+    level.triangleCount = geometry.getTriangleCount();
+    level.maxScreenRadius = lodMaxScreenRadius(sectors, pixelError);
+    return level;
+}
+
+unsigned int LodManager::addShape(LodShape&& shape)
+{
+    if (shape.levels.size() > MAX_LOD_LEVELS)
+        shape.levels.resize(MAX_LOD_LEVELS);
+    shapes.push_back(std::move(shape));
+    return (unsigned int)shapes.size() - 1;
+}
+
+unsigned int LodManager::addObject(unsigned int shape, const glm::mat4& model)
+{
+    Object object;
+    object.shape = shape;
+    object.level = 0;
+    objects.push_back(object);
+    setModel((unsigned int)objects.size() - 1, model);
+    return (unsigned int)objects.size() - 1;
+}
+
+void LodManager::setModel(unsigned int object, const glm::mat4& model)
+{
+    Object& target = objects[object];
+    const LodShape& source = shapes[target.shape];
+    target.model = model;
+    target.worldCenter = glm::vec3(model * glm::vec4(source.boundsCenter, 1.0f));
+    // the largest axis scale keeps the sphere conservative under non-uniform scaling
+    float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+    target.worldRadius = source.boundsRadius * scale;
+    target.worldLodRadius = (source.lodRadius > 0.0f ? source.lodRadius : source.boundsRadius) * scale;
+}
+
+void LodManager::beginFrame(const Camera& camera, const glm::mat4& projection, float viewportHeight)
+{
+    eye = camera.Position;
+    // projection[1][1] = cot(fovy / 2): a unit at distance 1 covers this many pixels
+    pixelsPerUnit = projection[1][1] * viewportHeight * 0.5f;
+}
+
+float LodManager::getScreenRadius(unsigned int object) const
+{
+    const Object& target = objects[object];
+    // distance rather than view depth, so turning the camera never changes a level;
+    // inside the bounds the object is as close as it gets
+    float distance = glm::length(target.worldCenter - eye);
+    if (distance <= target.worldRadius)
+        return std::numeric_limits<float>::max();
+    return target.worldLodRadius * pixelsPerUnit / distance;
+}
+
+unsigned int LodManager::select(unsigned int object)
+{
+    Object& target = objects[object];
+    const std::vector<LodLevel>& levels = shapes[target.shape].levels;
+    if (levels.empty())
+        return 0;
+    const unsigned int coarsest = (unsigned int)levels.size() - 1;
+    const float radius = getScreenRadius(object);
+
+    // level i is enough up to levels[i].maxScreenRadius; move only once that is clearly exceeded
+    unsigned int level = std::min(target.level, coarsest);
+    while (level > 0 && radius > levels[level].maxScreenRadius * (1.0f + LOD_HYSTERESIS))
+        level--;
+    while (level < coarsest && radius < levels[level + 1].maxScreenRadius * (1.0f - LOD_HYSTERESIS))
+        level++;
+    target.level = level;
+    return level;
+}
+
+LodDraw LodManager::choose(unsigned int object)
+{
+    LodDraw draw;
+    draw.object = object;
+    draw.level = select(object);
+    draw.model = objects[object].model;
+    return draw;
+}
+
+void LodManager::draw(const LodDraw& draw)
+{
+    const std::vector<LodLevel>& levels = shapes[objects[draw.object].shape].levels;
+    if (draw.level >= levels.size())
+        return;
+
+    InstancedRenderer::setSingleInstance(draw.model);
+    levels[draw.level].mesh.draw();
+    triangles += levels[draw.level].triangleCount;
+    levelObjects[draw.level]++;
+}
+
+void LodManager::endFrame()
+{
+    stats.frameTriangles = triangles;
+    stats.totalTriangles += triangles;
+    stats.frames++;
+    std::copy(levelObjects, levelObjects + MAX_LOD_LEVELS, stats.levelObjects);
+    triangles = 0;
+    std::fill(levelObjects, levelObjects + MAX_LOD_LEVELS, 0u);
+}
+
+void LodManager::clear()
+{
+    objects.clear();
+    shapes.clear();
+}
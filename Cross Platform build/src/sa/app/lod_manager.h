@@ -0,0 +1,122 @@
+#ifndef LOD_MANAGER_H
+#define LOD_MANAGER_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "camera.h"
+#include "gpu_mesh.h"
+#include "mesh_generator.h"
+
+const unsigned int MAX_LOD_LEVELS = 8;
+// a level is switched only once the projected radius is this far past its threshold,
+// so an object sitting on a boundary doesn't flip between levels every frame
+const float LOD_HYSTERESIS = 0.15f;
+
+// one resident tessellation of a shape
+struct LodLevel
+{
+    GpuMesh mesh;
+    unsigned int triangleCount = 0;
+    // largest projected radius, in pixels, this level is good for
+    float maxScreenRadius = 0.0f;
+};
+
+// all resident levels of a shape, finest first, and its model-space bounding sphere
+struct LodShape
+{
+    std::vector<LodLevel> levels;
+    glm::vec3 boundsCenter = glm::vec3(0.0f);
+    float boundsRadius = 0.0f;
+    // radius of the rings the levels' chord sag is measured on, which picks the level;
+    // 0 takes boundsRadius (right for a sphere, far too large for a long segment)
+    float lodRadius = 0.0f;
+};
+
+// largest projected radius at which a ring of `sectors` segments stays within
+// `pixelError` pixels of the true circle (chord sag r * (1 - cos(pi / sectors)))
+float lodMaxScreenRadius(int sectors, float pixelError = 1.0f);
+
+// uploads a generated mesh as a level for a shape of `sectors` sectors
+LodLevel makeLodLevel(const GeneratedMesh& geometry, int sectors, float pixelError = 1.0f);
+
+// one object as a frame draws it: what choose() picked, for draw()
+struct LodDraw
+{
+    unsigned int object = 0;
+    unsigned int level = 0;
+    glm::mat4 model = glm::mat4(1.0f);
+};
+
+// Keeps several tessellations of each shape resident and picks one per object per frame
+// from its projected screen-space radius. Objects remember their level so a change needs
+// the radius to cross the threshold by LOD_HYSTERESIS. Every draw is counted, giving the
+// triangles submitted per frame.
+//
+// Choosing and drawing are apart so they can run on different threads: beginFrame(),
+// setModel(), select() and choose() keep to the simulation thread, which passes the
+// LodDraws on; draw() and endFrame() keep to the GL thread. Shapes and objects are all
+// added before either starts.
+class LodManager
+{
+public:
+    struct Stats
+    {
+        unsigned long long frameTriangles = 0;      // submitted during the last finished frame
+        unsigned long long totalTriangles = 0;
+        unsigned long long frames = 0;
+        unsigned int levelObjects[MAX_LOD_LEVELS] = {};     // objects drawn per level last frame
+    };
+
+    LodManager() {}
+    LodManager(const LodManager&) = delete;
+    LodManager& operator=(const LodManager&) = delete;
+
+    // takes ownership of the shape's levels; returns its id
+    unsigned int addShape(LodShape&& shape);
+    // places a shape in the world; returns the object id
+    unsigned int addObject(unsigned int shape, const glm::mat4& model);
+    // moves an object; its bounds follow
+    void setModel(unsigned int object, const glm::mat4& model);
+
+    // starts choosing a frame seen from `camera` through `projection` onto a viewport
+    // `viewportHeight` pixels high
+    void beginFrame(const Camera& camera, const glm::mat4& projection, float viewportHeight);
+    // picks the object's level for this frame (with hysteresis) and returns it
+    unsigned int select(unsigned int object);
+    // selects and returns the object's draw for this frame
+    LodDraw choose(unsigned int object);
+
+    // sets the draw's model matrix as the instance attributes and draws its level
+    void draw(const LodDraw& draw);
+    // closes the frame's triangle count
+    void endFrame();
+
+    // projected radius of the object's LOD rings in pixels, as levels are chosen by
+    float getScreenRadius(unsigned int object) const;
+    unsigned int getLevel(unsigned int object) const { return objects[object].level; }
+    const Stats& getStats() const { return stats; }
+    void clear();
+
+private:
+    struct Object
+    {
+        unsigned int shape;
+        glm::mat4 model;
+        glm::vec3 worldCenter;
+        float worldRadius;
+        float worldLodRadius;       // LodShape::lodRadius, scaled
+        unsigned int level;
+    };
+
+    std::vector<LodShape> shapes;
+    std::vector<Object> objects;
+    glm::vec3 eye = glm::vec3(0.0f);
+    float pixelsPerUnit = 1.0f;     // projected size of one unit at distance 1
+    unsigned long long triangles = 0;
+    unsigned int levelObjects[MAX_LOD_LEVELS] = {};
+    Stats stats;
+};
+
+#endif
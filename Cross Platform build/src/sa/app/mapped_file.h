@@ -0,0 +1,36 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+// A whole file mapped read-only into memory (mmap, or a file mapping on Windows).
+// The pages are loaded on first touch, so handing data() straight to glBufferData reads
+// the file without an intermediate copy. Owns the mapping; movable, not copyable.
+class MappedFile
+{
+public:
+    MappedFile() {}
+    ~MappedFile() { close(); }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept { *this = static_cast<MappedFile&&>(other); }
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    // false (and nothing mapped) if the file is missing, empty or cannot be mapped
+    bool open(const std::string& path);
+    void close();
+
+    bool isOpen() const { return bytes != nullptr; }
+    const unsigned char* data() const { return bytes; }
+    std::size_t size() const { return length; }
+
+private:
+    const unsigned char* bytes = nullptr;
+    std::size_t length = 0;
+#ifdef _WIN32
+    void* mapping = nullptr;            // HANDLE of the file mapping object
+#endif
+};
+
+#endif
@@ -6,31 +6,16 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "meshlet.h"
 #include "shader.h"
+#include "vertex_format.h"
 
+#include <cstddef>
 #include <string>
+#include <utility>
 #include <vector>
 using namespace std;
 
-#define MAX_BONE_INFLUENCE 4
-
-struct Vertex {
-    // position
-    glm::vec3 Position;
-    // normal
-    glm::vec3 Normal;
-    // texCoords
-    glm::vec2 TexCoords;
-    // tangent
-    glm::vec3 Tangent;
-    // bitangent
-    glm::vec3 Bitangent;
-	//bone indexes which will influence this vertex
-	int m_BoneIDs[MAX_BONE_INFLUENCE];
-	//weights from each bone
-	float m_Weights[MAX_BONE_INFLUENCE];
-};
-
 struct Texture {
     unsigned int id;
     string type;
@@ -39,25 +24,96 @@ struct Texture {
 
 class Mesh {
 public:
-    // mesh Data
+    // mesh Data (vertices and indices stay empty for meshes uploaded from packed memory, as Model's are)
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
     vector<Texture>      textures;
     unsigned int VAO;
+    unsigned int indexCount = 0;
+    GLenum indexType = GL_UNSIGNED_INT;         // or GL_UNSIGNED_SHORT
+    unsigned int vertexFormat = VERTEX_FULL;    // packed format on the GPU, see vertex_format.h
 
-    // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    // constructor, takes over the vectors; the GPU copy is packed in `layout`
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, VertexLayout layout = VERTEX_FULL)
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
+        this->vertices = std::move(vertices);
+        this->indices = std::move(indices);
+        this->textures = std::move(textures);
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+        if(layout == VERTEX_FULL)
+        {
+            setupMesh(this->vertices.data(), VERTEX_FULL, this->vertices.size(), this->indices.data(), sizeof(unsigned int), this->indices.size());
+        }
+        else
+        {
+            vector<unsigned char> packed;
+            unsigned int format = packVertices(this->vertices.data(), this->vertices.size(), layout, packed);
+            setupMesh(packed.data(), format, this->vertices.size(), this->indices.data(), sizeof(unsigned int), this->indices.size());
+        }
+    }
+
+    // uploads vertices already packed in `format` straight from memory the mesh does not keep,
+    // e.g. a mapped mesh cache file; `indexSize` is 2 (unsigned short) or 4 (unsigned int) bytes.
+    // With meshlets (see meshlet.h) the mesh can be drawn culled.
+    Mesh(const void* vertices, unsigned int format, std::size_t vertexCount, const void* indices, unsigned int indexSize,
+        std::size_t indexCount, vector<Texture> textures, const Meshlet* meshlets = nullptr, std::size_t meshletCount = 0)
+    {
+        this->textures = std::move(textures);
+        setupMesh(vertices, format, vertexCount, indices, indexSize, indexCount);
+        culler.setMeshlets(meshlets, meshletCount);
     }
 
     // render the mesh
     void Draw(Shader &shader) 
+    {
+        bindTextures(shader);
+
+        // draw mesh
+        glBindVertexArray(VAO);
+        glDrawElements(GL_TRIANGLES, indexCount, indexType, 0);
+        glBindVertexArray(0);
+        countStateChanges();
+        countDraw(GL_TRIANGLES, indexCount);
+
+        // always good practice to set everything back to defaults once configured.
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // render only the meshlets inside the frustum that face the eye, in one glMultiDrawElements;
+    // `view` is the camera in this mesh's model space. Meshes without meshlets draw whole.
+    void Draw(Shader &shader, const MeshletView &view)
+    {
+        if(culler.getMeshletCount() == 0)
+        {
+            Draw(shader);
+            return;
+        }
+        const unsigned int draws = culler.cull(view, indexType == GL_UNSIGNED_SHORT ? 2 : 4);
+        if(draws == 0)
+            return;
+        bindTextures(shader);
+
+        glBindVertexArray(VAO);
+        glMultiDrawElements(GL_TRIANGLES, culler.getCounts(), indexType, culler.getOffsets(), draws);
+        glBindVertexArray(0);
+        countStateChanges();
+        countDraw(GL_TRIANGLES, culler.getVisibleIndices());
+
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+private:
+    // render data 
+    unsigned int VBO, EBO;
+    std::size_t residentBytes = 0;
+    MeshletCuller culler;
+    // the `vertexLayout` uniform, resolved for the program it was last drawn with
+    unsigned int layoutProgram = 0;
+    UniformHandle<int> layoutUniform;
+
+    // binds the textures to the samplers named after their type, and sets the vertex layout
+    void bindTextures(Shader &shader)
     {
         // bind appropriate textures
         unsigned int diffuseNr  = 1;
@@ -80,27 +136,30 @@ public:
                 number = std::to_string(heightNr++); // transfer unsigned int to string
 
             // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
+            glUniform1i(shader.getUniformLocation(name + number), i);
+            countUniformUpload();
             // and finally bind the texture
             glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            countStateChanges();
         }
         
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+        // tell the shader how to decode the normal and tangent (see model.vs)
+        if(shader.ID != layoutProgram)
+        {
+            layoutUniform = shader.uniform<int>("vertexLayout");
+            layoutProgram = shader.ID;
+        }
+        layoutUniform.set(vertexLayout(vertexFormat));
     }
 
-private:
-    // render data 
-    unsigned int VBO, EBO;
-
     // initializes all the buffer objects/arrays
-    void setupMesh()
+    void setupMesh(const void* vertices, unsigned int format, std::size_t vertexCount, const void* indices, unsigned int indexSize,
+        std::size_t indexCount)
     {
+        this->indexCount = static_cast<unsigned int>(indexCount);
+        this->indexType = indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        this->vertexFormat = format;
+        const std::size_t vertexBytes = vertexCount * vertexStride(format);
         // create buffers/arrays
         glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
@@ -109,37 +168,14 @@ private:
         glBindVertexArray(VAO);
         // load data into vertex buffers
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        // A great thing about structs is that their memory layout is sequential for all its items.
-        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-        // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);  
+        glBufferData(GL_ARRAY_BUFFER, vertexBytes, vertices, GL_STATIC_DRAW);  
 
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-        // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);	
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);	
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);	
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-		// ids
-		glEnableVertexAttribArray(5);
-		glVertexAttribIPointer(5, 4, GL_INT, sizeof(Vertex), (void*)offsetof(Vertex, m_BoneIDs));
-
-		// weights
-		glEnableVertexAttribArray(6);
-		glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, m_Weights));
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * indexSize, indices, GL_STATIC_DRAW);
+        trackBufferBytes(residentBytes, vertexBytes + indexCount * indexSize);
+
+        // set the vertex attribute pointers for the layout
+        setVertexAttributes(format);
         glBindVertexArray(0);
     }
 };
@@ -0,0 +1,355 @@
+#include "mesh_cache.h"
+#include "content_hash.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <thread>
+
+namespace
+{
+    const char MESH_CACHE_MAGIC[4] = { 'S', 'A', 'M', 'C' };
+
+    struct FileHeader
+    {
+        char magic[4];
+        std::uint32_t version;
+        std::uint64_t key;
+        std::uint32_t vertexStride;
+        std::uint32_t meshCount;
+        std::uint32_t textureCount;
+        std::uint32_t nodeCount;
+        std::uint32_t meshletCount;
+        std::uint32_t unused;
+        std::uint64_t stringBytes;
+        std::uint64_t vertexBytes;
+        std::uint64_t indexBytes;
+    };
+
+    // the records as stored; the same layout on every platform we build for
+    struct MeshRecord
+    {
+        std::uint64_t vertexOffset;     // into the vertex blob, bytes
+        std::uint64_t indexOffset;      // into the index blob, bytes
+        std::uint32_t vertexFormat, vertexCount, indexCount;
+        std::uint32_t firstTexture, textureCount;
+        std::uint32_t indexSize;        // 2 or 4
+        std::uint32_t firstMeshlet, meshletCount;
+    };
+    struct TextureRecord
+    {
+        std::uint32_t type, path;       // into the string blob
+    };
+    struct NodeRecord
+    {
+        std::int32_t parent;
+        std::uint32_t name;
+        std::uint32_t firstMesh, meshCount;
+        float transform[16];
+    };
+    // meshlets are stored as Meshlet itself, so the views can point straight at them
+    static_assert(sizeof(Meshlet) == 10 * sizeof(std::uint32_t), "Meshlet must be stored without padding");
+
+    std::size_t align16(std::size_t offset)
+    {
+        return (offset + 15) & ~(std::size_t)15;
+    }
+
+    // where each section starts, given the header's counts; the end of the index blob last
+    struct Layout
+    {
+        std::size_t meshes, textures, nodes, meshlets, strings, vertices, indices, end;
+    };
+
+    Layout layout(const FileHeader& header)
+    {
+        Layout at;
+        at.meshes = align16(sizeof(FileHeader));
+        at.textures = align16(at.meshes + (std::size_t)header.meshCount * sizeof(MeshRecord));
+        at.nodes = align16(at.textures + (std::size_t)header.textureCount * sizeof(TextureRecord));
+        at.meshlets = align16(at.nodes + (std::size_t)header.nodeCount * sizeof(NodeRecord));
+        at.strings = align16(at.meshlets + (std::size_t)header.meshletCount * sizeof(Meshlet));
+        at.vertices = align16(at.strings + header.stringBytes);
+        at.indices = align16(at.vertices + header.vertexBytes);
+        at.end = at.indices + header.indexBytes;
+        return at;
+    }
+
+    void pad(std::ofstream& file, std::size_t from, std::size_t to)
+    {
+        static const char zeros[16] = {};
+        file.write(zeros, to - from);
+    }
+}
+
+unsigned int MeshCacheBuilder::addString(const std::string& text)
+{
+    const unsigned int offset = (unsigned int)strings.size();
+    strings.insert(strings.end(), text.c_str(), text.c_str() + text.size() + 1);
+    return offset;
+}
+
+unsigned int MeshCacheBuilder::addNode(int parent, const std::string& name, const float transform[16])
+{
+    Node node;
+    node.parent = parent;
+    node.name = addString(name);
+    node.firstMesh = (unsigned int)meshes.size();
+    node.meshCount = 0;
+    std::memcpy(node.transform, transform, sizeof(node.transform));
+    nodes.push_back(node);
+    return (unsigned int)nodes.size() - 1;
+}
+
+void MeshCacheBuilder::addMesh(unsigned int node, const void* vertices, unsigned int vertexFormat, unsigned int vertexCount,
+    const void* indices, unsigned int indexSize, unsigned int indexCount, const std::vector<Meshlet>& meshlets,
+    const std::vector<MeshCacheTexture>& textures)
+{
+    // every mesh's indices start 4-byte aligned, whatever their size
+    this->indices.resize((this->indices.size() + 3) & ~(std::size_t)3, 0);
+    Mesh mesh;
+    mesh.vertexOffset = this->vertices.size();
+    mesh.indexOffset = this->indices.size();
+    mesh.vertexFormat = vertexFormat;
+    mesh.vertexCount = vertexCount;
+    mesh.indexSize = indexSize;
+    mesh.indexCount = indexCount;
+    mesh.firstMeshlet = (unsigned int)this->meshlets.size();
+    mesh.meshletCount = (unsigned int)meshlets.size();
+    mesh.firstTexture = (unsigned int)this->textures.size() / 2;
+    mesh.textureCount = (unsigned int)textures.size();
+    const unsigned char* bytes = static_cast<const unsigned char*>(vertices);
+    this->vertices.insert(this->vertices.end(), bytes, bytes + (std::size_t)vertexCount * vertexStride);
+    const unsigned char* indexBytes = static_cast<const unsigned char*>(indices);
+    this->indices.insert(this->indices.end(), indexBytes, indexBytes + (std::size_t)indexCount * indexSize);
+    this->meshlets.insert(this->meshlets.end(), meshlets.begin(), meshlets.end());
+    for (const MeshCacheTexture& texture : textures)
+    {
+        this->textures.push_back(addString(texture.type));
+        this->textures.push_back(addString(texture.path));
+    }
+    meshes.push_back(mesh);
+    nodes[node].meshCount++;
+}
+
+bool MeshCacheBuilder::save(const std::string& path, std::uint64_t key) const
+{
+    FileHeader header;
+    std::memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC));
+    header.version = MESH_CACHE_VERSION;
+    header.key = key;
+    header.vertexStride = vertexStride;
+    header.meshCount = (std::uint32_t)meshes.size();
+    header.textureCount = (std::uint32_t)textures.size() / 2;
+    header.nodeCount = (std::uint32_t)nodes.size();
+    header.meshletCount = (std::uint32_t)meshlets.size();
+    header.unused = 0;
+    header.stringBytes = strings.size();
+    header.vertexBytes = vertices.size();
+    header.indexBytes = indices.size();
+    const Layout at = layout(header);
+
+    std::vector<MeshRecord> meshRecords(meshes.size());
+    for (std::size_t i = 0; i < meshes.size(); i++)
+    {
+        meshRecords[i].vertexOffset = meshes[i].vertexOffset;
+        meshRecords[i].indexOffset = meshes[i].indexOffset;
+        meshRecords[i].vertexFormat = meshes[i].vertexFormat;
+        meshRecords[i].vertexCount = meshes[i].vertexCount;
+        meshRecords[i].indexCount = meshes[i].indexCount;
+        meshRecords[i].firstTexture = meshes[i].firstTexture;
+        meshRecords[i].textureCount = meshes[i].textureCount;
+        meshRecords[i].indexSize = meshes[i].indexSize;
+        meshRecords[i].firstMeshlet = meshes[i].firstMeshlet;
+        meshRecords[i].meshletCount = meshes[i].meshletCount;
+    }
+    std::vector<NodeRecord> nodeRecords(nodes.size());
+    for (std::size_t i = 0; i < nodes.size(); i++)
+    {
+        nodeRecords[i].parent = nodes[i].parent;
+        nodeRecords[i].name = nodes[i].name;
+        nodeRecords[i].firstMesh = nodes[i].firstMesh;
+        nodeRecords[i].meshCount = nodes[i].meshCount;
+        std::memcpy(nodeRecords[i].transform, nodes[i].transform, sizeof(nodes[i].transform));
+    }
+
+    // written aside and renamed into place, so a reader never maps half a file
+    const std::string temporary = path + "." + hashToHex(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        pad(file, sizeof(header), at.meshes);
+        file.write(reinterpret_cast<const char*>(meshRecords.data()), meshRecords.size() * sizeof(MeshRecord));
+        pad(file, at.meshes + meshRecords.size() * sizeof(MeshRecord), at.textures);
+        file.write(reinterpret_cast<const char*>(textures.data()), textures.size() * sizeof(unsigned int));
+        pad(file, at.textures + textures.size() * sizeof(unsigned int), at.nodes);
+        file.write(reinterpret_cast<const char*>(nodeRecords.data()), nodeRecords.size() * sizeof(NodeRecord));
+        pad(file, at.nodes + nodeRecords.size() * sizeof(NodeRecord), at.meshlets);
+        file.write(reinterpret_cast<const char*>(meshlets.data()), meshlets.size() * sizeof(Meshlet));
+        pad(file, at.meshlets + meshlets.size() * sizeof(Meshlet), at.strings);
+        file.write(strings.data(), strings.size());
+        pad(file, at.strings + strings.size(), at.vertices);
+        file.write(reinterpret_cast<const char*>(vertices.data()), vertices.size());
+        pad(file, at.vertices + vertices.size(), at.indices);
+        file.write(reinterpret_cast<const char*>(indices.data()), indices.size());
+        if (!file)
+        {
+            std::cout << "ERROR::MESH_CACHE::CANNOT_WRITE: " << path << std::endl;
+            return false;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    if (error)
+    {
+        // another process stored the same model first
+        std::filesystem::remove(temporary, error);
+    }
+    return true;
+}
+
+bool MeshCacheFile::open(const std::string& path, std::uint64_t key, std::uint32_t vertexStride)
+{
+    close();
+    meshCount = textureCount = nodeCount = 0;
+    if (!file.open(path))
+        return false;
+    FileHeader header;
+    if (file.size() < sizeof(header))
+    {
+        close();
+        return false;
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+    // blob sizes beyond the file would wrap the layout's arithmetic
+    if (header.stringBytes > file.size() || header.vertexBytes > file.size() || header.indexBytes > file.size())
+    {
+        close();
+        return false;
+    }
+    const Layout at = layout(header);
+    const char* strings = reinterpret_cast<const char*>(file.data() + at.strings);
+    if (std::memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC)) != 0 ||
+        header.version != MESH_CACHE_VERSION || header.key != key || header.vertexStride != vertexStride ||
+        at.end > file.size() || (header.stringBytes > 0 && strings[header.stringBytes - 1] != '\0'))
+    {
+        close();
+        return false;
+    }
+    meshCount = header.meshCount;
+    textureCount = header.textureCount;
+    nodeCount = header.nodeCount;
+    meshRecords = at.meshes;
+    textureRecords = at.textures;
+    nodeRecords = at.nodes;
+    meshletRecords = at.meshlets;
+    stringBlob = at.strings;
+    vertexBlob = at.vertices;
+    indexBlob = at.indices;
+
+    // every range the views point at has to lie in its section
+    for (unsigned int i = 0; i < meshCount; i++)
+    {
+        const MeshRecord& mesh = reinterpret_cast<const MeshRecord*>(file.data() + meshRecords)[i];
+        if (mesh.vertexOffset + (std::uint64_t)mesh.vertexCount * vertexStride > header.vertexBytes ||
+            (mesh.indexSize != 2 && mesh.indexSize != 4) || mesh.indexOffset % mesh.indexSize != 0 ||
+            mesh.indexOffset + (std::uint64_t)mesh.indexCount * mesh.indexSize > header.indexBytes ||
+            (std::uint64_t)mesh.firstMeshlet + mesh.meshletCount > header.meshletCount ||
+            (std::uint64_t)mesh.firstTexture + mesh.textureCount > textureCount)
+        {
+            std::cout << "ERROR::MESH_CACHE::CORRUPT_FILE: " << path << std::endl;
+            close();
+            return false;
+        }
+        const Meshlet* meshlets = reinterpret_cast<const Meshlet*>(file.data() + meshletRecords) + mesh.firstMeshlet;
+        for (unsigned int j = 0; j < mesh.meshletCount; j++)
+        {
+            if ((std::uint64_t)meshlets[j].firstIndex + meshlets[j].indexCount > mesh.indexCount)
+            {
+                std::cout << "ERROR::MESH_CACHE::CORRUPT_FILE: " << path << std::endl;
+                close();
+                return false;
+            }
+        }
+    }
+    for (unsigned int i = 0; i < textureCount; i++)
+    {
+        const TextureRecord& texture = reinterpret_cast<const TextureRecord*>(file.data() + textureRecords)[i];
+        if (texture.type >= header.stringBytes || texture.path >= header.stringBytes)
+        {
+            std::cout << "ERROR::MESH_CACHE::CORRUPT_FILE: " << path << std::endl;
+            close();
+            return false;
+        }
+    }
+    for (unsigned int i = 0; i < nodeCount; i++)
+    {
+        const NodeRecord& node = reinterpret_cast<const NodeRecord*>(file.data() + nodeRecords)[i];
+        if (node.name >= header.stringBytes || node.parent < -1 || node.parent >= (std::int32_t)i ||
+            (std::uint64_t)node.firstMesh + node.meshCount > meshCount)
+        {
+            std::cout << "ERROR::MESH_CACHE::CORRUPT_FILE: " << path << std::endl;
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+MeshCacheFile::MeshView MeshCacheFile::getMesh(unsigned int index) const
+{
+    const MeshRecord& record = reinterpret_cast<const MeshRecord*>(file.data() + meshRecords)[index];
+    MeshView mesh;
+    mesh.vertices = file.data() + vertexBlob + record.vertexOffset;
+    mesh.vertexFormat = record.vertexFormat;
+    mesh.vertexCount = record.vertexCount;
+    mesh.indices = file.data() + indexBlob + record.indexOffset;
+    mesh.indexSize = record.indexSize;
+    mesh.meshlets = reinterpret_cast<const Meshlet*>(file.data() + meshletRecords) + record.firstMeshlet;
+    mesh.meshletCount = record.meshletCount;
+    mesh.indexCount = record.indexCount;
+    mesh.firstTexture = record.firstTexture;
+    mesh.textureCount = record.textureCount;
+    return mesh;
+}
+
+MeshCacheFile::TextureView MeshCacheFile::getTexture(unsigned int index) const
+{
+    const TextureRecord& record = reinterpret_cast<const TextureRecord*>(file.data() + textureRecords)[index];
+    const char* strings = reinterpret_cast<const char*>(file.data() + stringBlob);
+    TextureView texture;
+    texture.type = strings + record.type;
+    texture.path = strings + record.path;
+    return texture;
+}
+
+MeshCacheFile::NodeView MeshCacheFile::getNode(unsigned int index) const
+{
+    const NodeRecord& record = reinterpret_cast<const NodeRecord*>(file.data() + nodeRecords)[index];
+    NodeView node;
+    node.parent = record.parent;
+    node.name = reinterpret_cast<const char*>(file.data() + stringBlob) + record.name;
+    node.transform = record.transform;
+    node.firstMesh = record.firstMesh;
+    node.meshCount = record.meshCount;
+    return node;
+}
+
+bool meshCacheKey(const std::string& path, unsigned int importFlags, unsigned int vertexLayout, std::uint64_t& key)
+{
+    MappedFile source;
+    if (!source.open(path))
+        return false;
+    key = hashBytes(&MESH_CACHE_VERSION, sizeof(MESH_CACHE_VERSION));
+    key = hashBytes(&importFlags, sizeof(importFlags), key);
+    key = hashBytes(&vertexLayout, sizeof(vertexLayout), key);
+    key = hashBytes(source.data(), source.size(), key);
+    return true;
+}
+
+std::string meshCachePath(const std::string& cacheDirectory, std::uint64_t key)
+{
+    return cacheDirectory + "/" + hashToHex(key) + ".mesh";
+}
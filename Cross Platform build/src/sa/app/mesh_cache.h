@@ -0,0 +1,136 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mapped_file.h"
+#include "meshlet.h"
+
+// bump when the file layout, or what Model stores in it, changes
+const std::uint32_t MESH_CACHE_VERSION = 4;
+
+// Binary mesh cache.
+// A model's imported meshes stored the way they are uploaded: each mesh's interleaved
+// vertices (in the packed vertex format the caller names, see vertex_format.h) and
+// 16- or 32-bit indices as blobs, its meshlets (see meshlet.h), its material textures as
+// (sampler type, path) pairs, and the node hierarchy, each node owning a contiguous run of meshes. Files are
+// named after a hash of the source model's bytes, the import flags and the vertex layout
+// (see meshCacheKey()), so an edited model or a change of either gets a new entry. Only the
+// model file itself is hashed; files it references (an .obj's .mtl) are not.
+//
+// MeshCacheBuilder collects a model on import and saves it; MeshCacheFile maps a saved
+// file and hands out pointers into the mapping, which can go straight to glBufferData.
+//
+//   header | mesh records | texture records | node records | meshlets | strings | vertices | indices
+//
+// The sections after the header are 16-byte aligned and sized from the header's counts.
+struct MeshCacheTexture
+{
+    std::string type;       // sampler name prefix, e.g. "texture_diffuse"
+    std::string path;       // as the material names it, relative to the model's directory
+};
+
+class MeshCacheBuilder
+{
+public:
+    // vertices are stored as opaque records of `vertexStride` bytes
+    explicit MeshCacheBuilder(std::uint32_t vertexStride) : vertexStride(vertexStride) {}
+
+    // returns the new node's index; `transform` is column major (glm's layout)
+    unsigned int addNode(int parent, const std::string& name, const float transform[16]);
+    // appends a mesh to node `node`; a node's meshes must be added before the next node.
+    // `vertexFormat` is stored for the reader, the cache does not interpret it. `indexSize` is
+    // 2 or 4 bytes; the meshlets' index ranges must lie within the mesh's indices.
+    void addMesh(unsigned int node, const void* vertices, unsigned int vertexFormat, unsigned int vertexCount,
+        const void* indices, unsigned int indexSize, unsigned int indexCount, const std::vector<Meshlet>& meshlets,
+        const std::vector<MeshCacheTexture>& textures);
+
+    // written aside and renamed into place; false (with an error printed) if it cannot be
+    bool save(const std::string& path, std::uint64_t key) const;
+
+private:
+    struct Mesh
+    {
+        std::uint64_t vertexOffset, indexOffset;   // bytes
+        unsigned int vertexFormat, vertexCount, indexSize, indexCount;
+        unsigned int firstMeshlet, meshletCount;
+        unsigned int firstTexture, textureCount;
+    };
+    struct Node
+    {
+        int parent;
+        unsigned int name;              // into strings
+        unsigned int firstMesh, meshCount;
+        float transform[16];
+    };
+
+    unsigned int addString(const std::string& text);
+
+    std::uint32_t vertexStride;
+    std::vector<Mesh> meshes;
+    std::vector<unsigned int> textures;  // pairs of string offsets: type, path
+    std::vector<Node> nodes;
+    std::vector<Meshlet> meshlets;
+    std::vector<char> strings;
+    std::vector<unsigned char> vertices;
+    std::vector<unsigned char> indices;
+};
+
+class MeshCacheFile
+{
+public:
+    struct MeshView
+    {
+        const void* vertices;           // vertexCount records of the stride it was saved with
+        unsigned int vertexFormat;      // as given to MeshCacheBuilder::addMesh()
+        unsigned int vertexCount;
+        const void* indices;
+        unsigned int indexSize;         // 2 (unsigned short) or 4 (unsigned int) bytes
+        unsigned int indexCount;
+        const Meshlet* meshlets;
+        unsigned int meshletCount;
+        unsigned int firstTexture, textureCount;
+    };
+    struct TextureView
+    {
+        const char* type;
+        const char* path;
+    };
+    struct NodeView
+    {
+        int parent;                     // -1 for the root
+        const char* name;
+        const float* transform;         // 16 floats, column major
+        unsigned int firstMesh, meshCount;
+    };
+
+    // maps the file; false if it is missing, truncated, of another version, saved under
+    // another key or with another vertex stride
+    bool open(const std::string& path, std::uint64_t key, std::uint32_t vertexStride);
+    void close() { file.close(); }
+
+    unsigned int getMeshCount() const { return meshCount; }
+    unsigned int getTextureCount() const { return textureCount; }
+    unsigned int getNodeCount() const { return nodeCount; }
+    MeshView getMesh(unsigned int index) const;
+    TextureView getTexture(unsigned int index) const;
+    NodeView getNode(unsigned int index) const;
+
+private:
+    MappedFile file;
+    unsigned int meshCount = 0, textureCount = 0, nodeCount = 0;
+    std::size_t meshRecords = 0, textureRecords = 0, nodeRecords = 0, meshletRecords = 0;
+    std::size_t stringBlob = 0, vertexBlob = 0, indexBlob = 0;
+};
+
+// the cache key of the model file at `path` imported with `importFlags` and stored in
+// `vertexLayout`; false if the file cannot be read
+bool meshCacheKey(const std::string& path, unsigned int importFlags, unsigned int vertexLayout, std::uint64_t& key);
+
+// the cache entry a model with this key is stored under
+std::string meshCachePath(const std::string& cacheDirectory, std::uint64_t key);
+
+#endif
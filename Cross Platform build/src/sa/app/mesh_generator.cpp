@@ -0,0 +1,324 @@
+#include "mesh_generator.h"
+#include "simd.h"
+#include "profiler.h"
+#include "job_system.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    const int MIN_SECTOR_COUNT = 3;
+    const int MIN_STACK_COUNT = 1;
+    // below this many vertices a mesh is generated on the calling thread
+    const std::size_t PARALLEL_VERTEX_THRESHOLD = 1 << 16;
+    const unsigned int MIN_RINGS_PER_THREAD = 16;
+    const float PI = 3.14159265358979f;
+
+    // per-sector values shared by every ring, padded to a multiple of 4 for the SIMD sweep
+    struct SectorTable
+    {
+        std::vector<float> cosines;
+        std::vector<float> sines;
+        std::vector<float> s;
+        int sectorCount = 0;
+    };
+
+    void buildSectorTable(SectorTable& table, int sectorCount)
+    {
+        const std::size_t columns = (std::size_t)sectorCount + 1;
+        const std::size_t padded = (columns + 3) & ~(std::size_t)3;
+        std::vector<float> angles(padded, 0.0f);
+        table.cosines.assign(padded, 0.0f);
+        table.sines.assign(padded, 0.0f);
+        table.s.assign(padded, 0.0f);
+        table.sectorCount = sectorCount;
+
+        const float sectorStep = 2.0f * PI / sectorCount;
+        for (std::size_t j = 0; j < columns; j++)
+        {
+            angles[j] = j * sectorStep;
+            table.s[j] = (float)j / sectorCount;
+        }
+        sinCosArray(angles.data(), table.sines.data(), table.cosines.data(), padded);
+        // the seam column must match the first exactly or the mesh shows a crack
+        table.cosines[sectorCount] = table.cosines[0];
+        table.sines[sectorCount] = table.sines[0];
+    }
+
+    // writes rings [firstRing, lastRing) of the swept surface and the quads below them
+    void sweepRings(float* vertices, unsigned int* indices, const std::vector<ProfilePoint>& profile,
+        const SectorTable& table, RevolutionAxis axis, const glm::vec3& center,
+        unsigned int firstRing, unsigned int lastRing)
+    {
+        PROFILE_SCOPE("sweepRings");
+        const unsigned int columns = (unsigned int)table.sectorCount + 1;
+        for (unsigned int i = firstRing; i < lastRing; i++)
+        {
+            const ProfilePoint& ring = profile[i];
+            float* out = vertices + (std::size_t)i * columns * 8;
+            unsigned int j = 0;
+#ifdef SA_SSE2
+            const __m128 radius = _mm_set1_ps(ring.radius);
+            const __m128 normalRadius = _mm_set1_ps(ring.normalRadius);
+            const __m128 height = _mm_set1_ps(ring.height + (axis == AXIS_Y ? center.y : center.z));
+            const __m128 normalHeight = _mm_set1_ps(ring.normalHeight);
+            const __m128 t = _mm_set1_ps(ring.t);
+            const __m128 centerX = _mm_set1_ps(center.x);
+            const __m128 centerSide = _mm_set1_ps(axis == AXIS_Y ? center.z : center.y);
+            for (; j + 4 <= columns; j += 4)
+            {
+                const __m128 c = _mm_loadu_ps(&table.cosines[j]);
+                const __m128 s = _mm_loadu_ps(&table.sines[j]);
+                __m128 px = _mm_add_ps(_mm_mul_ps(c, radius), centerX);
+                __m128 side = _mm_add_ps(_mm_mul_ps(s, radius), centerSide);
+                __m128 nx = _mm_mul_ps(c, normalRadius);
+                __m128 nSide = _mm_mul_ps(s, normalRadius);
+                __m128 py = axis == AXIS_Y ? height : side;
+                __m128 pz = axis == AXIS_Y ? side : height;
+                __m128 ny = axis == AXIS_Y ? normalHeight : nSide;
+                __m128 nz = axis == AXIS_Y ? nSide : normalHeight;
+                __m128 u = _mm_loadu_ps(&table.s[j]);
+                __m128 v = t;
+                // 8 attributes x 4 vertices -> 4 interleaved vertices
+                _MM_TRANSPOSE4_PS(px, py, pz, nx);
+                _MM_TRANSPOSE4_PS(ny, nz, u, v);
+                _mm_storeu_ps(out + 0, px);
+                _mm_storeu_ps(out + 4, ny);
+                _mm_storeu_ps(out + 8, py);
+                _mm_storeu_ps(out + 12, nz);
+                _mm_storeu_ps(out + 16, pz);
+                _mm_storeu_ps(out + 20, u);
+                _mm_storeu_ps(out + 24, nx);
+                _mm_storeu_ps(out + 28, v);
+                out += 32;
+            }
+#endif
+            for (; j < columns; j++)
+            {
+                const float c = table.cosines[j], s = table.sines[j];
+                out[0] = c * ring.radius + center.x;
+                out[3] = c * ring.normalRadius;
+                if (axis == AXIS_Y)
+                {
+                    out[1] = ring.height + center.y;
+                    out[2] = s * ring.radius + center.z;
+                    out[4] = ring.normalHeight;
+                    out[5] = s * ring.normalRadius;
+                }
+                else
+                {
+                    out[1] = s * ring.radius + center.y;
+                    out[2] = ring.height + center.z;
+                    out[4] = s * ring.normalRadius;
+                    out[5] = ring.normalHeight;
+                }
+                out[6] = table.s[j];
+                out[7] = ring.t;
+                out += 8;
+            }
+
+            // two triangles per sector between this ring and the next
+            if (i + 1 >= profile.size())
+                continue;
+            unsigned int* quad = indices + (std::size_t)i * table.sectorCount * 6;
+            unsigned int k1 = i * columns;
+            unsigned int k2 = k1 + columns;
+            for (int sector = 0; sector < table.sectorCount; ++sector, ++k1, ++k2)
+            {
+                quad[0] = k1;
+                quad[1] = k1 + 1;
+                quad[2] = k2;
+                quad[3] = k2;
+                quad[4] = k1 + 1;
+                quad[5] = k2 + 1;
+                quad += 6;
+            }
+        }
+    }
+
+    // resizes the mesh for the swept surface plus `extraVertices`/`extraIndices` and fills the surface
+    void sweep(GeneratedMesh& mesh, const std::vector<ProfilePoint>& profile, const SectorTable& table,
+        RevolutionAxis axis, const glm::vec3& center, std::size_t extraVertices, std::size_t extraIndices)
+    {
+        PROFILE_SCOPE("mesh sweep");
+        const unsigned int rings = (unsigned int)profile.size();
+        const unsigned int columns = (unsigned int)table.sectorCount + 1;
+        const std::size_t sideIndices = rings > 1 ? (std::size_t)(rings - 1) * table.sectorCount * 6 : 0;
+
+        // resize rather than push_back: every element is written exactly once below
+        mesh.vertices.resize(((std::size_t)rings * columns + extraVertices) * 8);
+        mesh.indices.resize(sideIndices + extraIndices);
+        mesh.sideStart = 0;
+        mesh.sideCount = (unsigned int)sideIndices;
+        mesh.baseStart = mesh.topStart = (unsigned int)sideIndices;
+        mesh.baseCount = mesh.topCount = 0;
+
+        const unsigned int threads = meshGeneratorThreads(rings, columns);
+        if (threads <= 1)
+        {
+            sweepRings(mesh.vertices.data(), mesh.indices.data(), profile, table, axis, center, 0, rings);
+            return;
+        }
+
+        // ring ranges are disjoint, so the chunks write disjoint vertices and indices
+        const unsigned int ringsPerThread = (rings + threads - 1) / threads;
+        jobSystem().parallelFor(rings, ringsPerThread, [&](unsigned int first, unsigned int last)
+        {
+            sweepRings(mesh.vertices.data(), mesh.indices.data(), profile, table, axis, center, first, last);
+        });
+    }
+}
+
+void sinCosArray(const float* angles, float* sines, float* cosines, std::size_t count)
+{
+    std::size_t i = 0;
+#ifdef SA_SSE2
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 s, c;
+        sinCosPs(_mm_loadu_ps(angles + i), &s, &c);
+        _mm_storeu_ps(sines + i, s);
+        _mm_storeu_ps(cosines + i, c);
+    }
+#endif
+    for (; i < count; i++)
+    {
+        sines[i] = std::sin(angles[i]);
+        cosines[i] = std::cos(angles[i]);
+    }
+}
+
+unsigned int meshGeneratorThreads(unsigned int rings, unsigned int sectors)
+{
+    if ((std::size_t)rings * sectors < PARALLEL_VERTEX_THRESHOLD)
+        return 1;
+    return std::max(1u, std::min(jobSystem().getWorkerCount() + 1, rings / MIN_RINGS_PER_THREAD));
+}
+
+void generateRevolution(GeneratedMesh& mesh, const std::vector<ProfilePoint>& profile, int sectorCount,
+    RevolutionAxis axis, const glm::vec3& center)
+{
+    SectorTable table;
+    buildSectorTable(table, std::max(sectorCount, MIN_SECTOR_COUNT));
+    sweep(mesh, profile, table, axis, center, 0, 0);
+}
+
+void generateSphere(GeneratedMesh& mesh, float radius, int sectorCount, int stackCount,
+    RevolutionAxis axis, const glm::vec3& center)
+{
+    stackCount = std::max(stackCount, 2);
+    const std::size_t rings = (std::size_t)stackCount + 1;
+    const std::size_t padded = (rings + 3) & ~(std::size_t)3;
+    std::vector<float> angles(padded, 0.0f), sines(padded), cosines(padded);
+    for (std::size_t i = 0; i < rings; i++)
+        angles[i] = PI * i / stackCount;
+    sinCosArray(angles.data(), sines.data(), cosines.data(), padded);
+
+    std::vector<ProfilePoint> profile(rings);
+    for (std::size_t i = 0; i < rings; i++)
+    {
+        ProfilePoint& point = profile[i];
+        point.normalRadius = sines[i];
+        point.normalHeight = cosines[i];
+        point.radius = radius * sines[i];
+        point.height = radius * cosines[i];
+        point.t = (float)i / stackCount;
+    }
+    // the poles sit exactly on the axis
+    profile.front().radius = profile.back().radius = 0.0f;
+    profile.front().normalRadius = profile.back().normalRadius = 0.0f;
+    generateRevolution(mesh, profile, sectorCount, axis, center);
+}
+
+void generateCylinder(GeneratedMesh& mesh, float baseRadius, float topRadius, float height,
+    int sectorCount, int stackCount, bool caps)
+{
+    sectorCount = std::max(sectorCount, MIN_SECTOR_COUNT);
+    stackCount = std::max(stackCount, MIN_STACK_COUNT);
+
+    // side normals lean by the slope of a cone
+    const float zAngle = std::atan2(baseRadius - topRadius, height);
+    const float normalRadius = std::cos(zAngle);
+    const float normalHeight = std::sin(zAngle);
+    std::vector<ProfilePoint> profile(stackCount + 1);
+    for (int i = 0; i <= stackCount; i++)
+    {
+        ProfilePoint& point = profile[i];
+        float along = (float)i / stackCount;
+        point.height = -(height * 0.5f) + along * height;
+        point.radius = baseRadius + along * (topRadius - baseRadius);
+        point.normalRadius = normalRadius;
+        point.normalHeight = normalHeight;
+        point.t = 1.0f - along;    // top-to-bottom
+    }
+
+    SectorTable table;
+    buildSectorTable(table, sectorCount);
+    const std::size_t capVertices = caps ? 2 * ((std::size_t)sectorCount + 1) : 0;
+    const std::size_t capIndices = caps ? 2 * (std::size_t)sectorCount * 3 : 0;
+    sweep(mesh, profile, table, AXIS_Z, glm::vec3(0.0f), capVertices, capIndices);
+    if (!caps)
+        return;
+
+    // base and top: a centre vertex plus one ring each, fanned
+    const unsigned int baseVertex = (unsigned int)(profile.size() * (sectorCount + 1));
+    const unsigned int topVertex = baseVertex + sectorCount + 1;
+    float* out = mesh.vertices.data() + (std::size_t)baseVertex * 8;
+    for (int cap = 0; cap < 2; cap++)
+    {
+        const float z = cap == 0 ? -height * 0.5f : height * 0.5f;
+        const float nz = cap == 0 ? -1.0f : 1.0f;
+        const float radius = cap == 0 ? baseRadius : topRadius;
+        const float flip = cap == 0 ? -1.0f : 1.0f;     // the base's texture is mirrored
+        const float centre[8] = { 0.0f, 0.0f, z, 0.0f, 0.0f, nz, 0.5f, 0.5f };
+        std::copy(centre, centre + 8, out);
+        out += 8;
+        for (int j = 0; j < sectorCount; j++)
+        {
+            const float x = table.cosines[j], y = table.sines[j];
+            const float vertex[8] = { x * radius, y * radius, z, 0.0f, 0.0f, nz, flip * x * 0.5f + 0.5f, -y * 0.5f + 0.5f };
+            std::copy(vertex, vertex + 8, out);
+            out += 8;
+        }
+    }
+
+    unsigned int* index = mesh.indices.data() + mesh.sideCount;
+    mesh.baseStart = mesh.sideCount;
+    for (int i = 0, k = baseVertex + 1; i < sectorCount; ++i, ++k)
+    {
+        *index++ = baseVertex;
+        *index++ = i < sectorCount - 1 ? k + 1 : baseVertex + 1;
+        *index++ = k;
+    }
+    mesh.baseCount = sectorCount * 3;
+    mesh.topStart = mesh.baseStart + mesh.baseCount;
+    for (int i = 0, k = topVertex + 1; i < sectorCount; ++i, ++k)
+    {
+        *index++ = topVertex;
+        *index++ = k;
+        *index++ = i < sectorCount - 1 ? k + 1 : topVertex + 1;
+    }
+    mesh.topCount = sectorCount * 3;
+}
+
+void generateWormholeThroat(GeneratedMesh& mesh, float throatRadius, float length,
+    int sectorCount, int stackCount)
+{
+    stackCount = std::max(stackCount, MIN_STACK_COUNT);
+    std::vector<ProfilePoint> profile(stackCount + 1);
+    for (int i = 0; i <= stackCount; i++)
+    {
+        ProfilePoint& point = profile[i];
+        float along = (float)i / stackCount;
+        float l = (along - 0.5f) * length;
+        float r = std::sqrt(throatRadius * throatRadius + l * l);
+        point.radius = r;
+        point.height = throatRadius * std::asinh(l / throatRadius);
+        // (dr/dl, dz/dl) = (l, b0) / r is the unit tangent, so the outward normal is (b0, -l) / r
+        point.normalRadius = throatRadius / r;
+        point.normalHeight = -l / r;
+        point.t = 1.0f - along;
+    }
+    generateRevolution(mesh, profile, sectorCount, AXIS_Z);
+}
@@ -0,0 +1,70 @@
+#ifndef MESH_GENERATOR_H
+#define MESH_GENERATOR_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+// Shared generator for the scene's parametric shapes. Spheres, cylinders and the
+// wormhole throat are all surfaces of revolution, so each one is described by a profile
+// (one entry per stack) that is swept around an axis. Sector sines/cosines are computed
+// once per mesh with a SIMD kernel; every ring is then a scaled copy of that table,
+// written four vertices at a time straight into a preallocated buffer in the 32 byte
+// interleaved V/N/T layout GpuMesh expects. Large meshes split their rings across threads.
+
+// axis the profile is swept around: Cylinder uses z, BlackHole/Sphere use y
+enum RevolutionAxis
+{
+    AXIS_Y,
+    AXIS_Z
+};
+
+// one ring of a surface of revolution
+struct ProfilePoint
+{
+    float radius;           // distance from the axis
+    float height;           // position along the axis
+    float normalRadius;     // normal, split into its radial and axial parts
+    float normalHeight;
+    float t;                // texture coordinate along the profile
+};
+
+struct GeneratedMesh
+{
+    std::vector<float> vertices;            // interleaved V/N/T, 8 floats per vertex
+    std::vector<unsigned int> indices;      // triangle list
+    // index ranges: the swept surface, then the caps (cylinders only)
+    unsigned int sideStart = 0, sideCount = 0;
+    unsigned int baseStart = 0, baseCount = 0;
+    unsigned int topStart = 0, topCount = 0;
+
+    unsigned int getVertexCount() const { return (unsigned int)(vertices.size() / 8); }
+    unsigned int getTriangleCount() const { return (unsigned int)(indices.size() / 3); }
+};
+
+// sweeps `profile` around `axis` with `sectorCount` sectors; replaces the mesh contents
+void generateRevolution(GeneratedMesh& mesh, const std::vector<ProfilePoint>& profile, int sectorCount,
+    RevolutionAxis axis = AXIS_Z, const glm::vec3& center = glm::vec3(0.0f));
+
+// UV sphere; texture t runs from 0 at the +axis pole to 1 at the -axis pole
+void generateSphere(GeneratedMesh& mesh, float radius, int sectorCount, int stackCount,
+    RevolutionAxis axis = AXIS_Y, const glm::vec3& center = glm::vec3(0.0f));
+
+// same vertex and index order as Cylinder (smooth), so the two are interchangeable
+void generateCylinder(GeneratedMesh& mesh, float baseRadius, float topRadius, float height,
+    int sectorCount, int stackCount, bool caps = true);
+
+// Embedding surface of the Morris-Thorne/Ellis wormhole, r(l) = sqrt(b0^2 + l^2) and
+// z(l) = b0 * asinh(l / b0), for proper distance l in [-length/2, length/2] from the throat
+// of radius b0. Along the z axis like Cylinder, with t running 1 -> 0 like its sides.
+void generateWormholeThroat(GeneratedMesh& mesh, float throatRadius, float length,
+    int sectorCount, int stackCount);
+
+// sines and cosines of `count` angles, 4 at a time where SSE2 is available
+void sinCosArray(const float* angles, float* sines, float* cosines, std::size_t count);
+
+// number of jobSystem() threads generateRevolution uses for a mesh of this size
+unsigned int meshGeneratorThreads(unsigned int rings, unsigned int sectors);
+
+#endif
@@ -0,0 +1,296 @@
+#include "mesh_optimizer.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "profiler.h"
+
+namespace
+{
+    // FIFO post-transform cache by timestamps: a vertex is cached while fewer than `size`
+    // vertices have been transformed after it
+    class FifoCache
+    {
+    public:
+        FifoCache(std::size_t vertexCount, unsigned int size) : stamps(vertexCount, 0), size(size), time(size + 1) {}
+
+        // true on a miss, which transforms (and caches) the vertex
+        bool access(unsigned int vertex)
+        {
+            if (time - stamps[vertex] <= size)
+                return false;
+            stamps[vertex] = time++;
+            return true;
+        }
+
+        void clear()
+        {
+            // every stamp falls out of the window
+            time += size + 1;
+        }
+
+    private:
+        std::vector<unsigned int> stamps;
+        unsigned int size;
+        unsigned int time;
+    };
+
+    // the triangles around each vertex, as offsets into one array
+    struct Adjacency
+    {
+        std::vector<unsigned int> offsets;      // vertexCount + 1
+        std::vector<unsigned int> triangles;
+
+        Adjacency(const unsigned int* indices, std::size_t indexCount, std::size_t vertexCount)
+            : offsets(vertexCount + 1, 0), triangles(indexCount)
+        {
+            for (std::size_t i = 0; i < indexCount; i++)
+                offsets[indices[i] + 1]++;
+            for (std::size_t v = 0; v < vertexCount; v++)
+                offsets[v + 1] += offsets[v];
+            std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+            for (std::size_t i = 0; i < indexCount; i++)
+                triangles[fill[indices[i]]++] = (unsigned int)(i / 3);
+        }
+    };
+
+    unsigned int countMisses(FifoCache& cache, const unsigned int* triangle)
+    {
+        return (unsigned int)cache.access(triangle[0]) + cache.access(triangle[1]) + cache.access(triangle[2]);
+    }
+
+    struct Cluster
+    {
+        unsigned int first, count;      // triangles
+        float sortKey;
+    };
+}
+
+VertexCacheStats analyzeVertexCache(const unsigned int* indices, std::size_t indexCount, std::size_t vertexCount,
+    unsigned int cacheSize)
+{
+    VertexCacheStats stats;
+    stats.triangles = indexCount / 3;
+    FifoCache cache(vertexCount, cacheSize);
+    std::vector<unsigned char> used(vertexCount, 0);
+    for (std::size_t i = 0; i < stats.triangles * 3; i++)
+    {
+        stats.transforms += cache.access(indices[i]);
+        stats.vertices += !used[indices[i]];
+        used[indices[i]] = 1;
+    }
+    return stats;
+}
+
+void optimizeVertexCache(unsigned int* indices, std::size_t indexCount, std::size_t vertexCount, unsigned int cacheSize)
+{
+    const std::size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+        return;
+    PROFILE_SCOPE("optimize vertex cache");
+    const Adjacency adjacency(indices, triangleCount * 3, vertexCount);
+    std::vector<unsigned int> live(vertexCount);        // triangles not emitted yet
+    for (std::size_t v = 0; v < vertexCount; v++)
+        live[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+
+    std::vector<unsigned int> cacheTime(vertexCount, 0);
+    std::vector<unsigned char> emitted(triangleCount, 0);
+    std::vector<unsigned int> deadEnd;                  // recently used vertices, to resume from
+    std::vector<unsigned int> candidates;
+    std::vector<unsigned int> result;
+    result.reserve(triangleCount * 3);
+    deadEnd.reserve(triangleCount * 3);
+    unsigned int time = cacheSize + 1;
+    std::size_t cursor = 0;                             // the input order, the last resort
+
+    long long fanning = 0;
+    while (fanning >= 0)
+    {
+        // emit every remaining triangle around the fanning vertex
+        candidates.clear();
+        const unsigned int vertex = (unsigned int)fanning;
+        for (unsigned int a = adjacency.offsets[vertex]; a < adjacency.offsets[vertex + 1]; a++)
+        {
+            const unsigned int triangle = adjacency.triangles[a];
+            if (emitted[triangle])
+                continue;
+            emitted[triangle] = 1;
+            for (unsigned int k = 0; k < 3; k++)
+            {
+                const unsigned int v = indices[triangle * 3 + k];
+                result.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (time - cacheTime[v] > cacheSize)
+                    cacheTime[v] = time++;
+            }
+        }
+
+        // next: the candidate that stays cached through its own fan and has been in longest
+        fanning = -1;
+        int bestPriority = -1;
+        for (unsigned int v : candidates)
+        {
+            if (live[v] == 0)
+                continue;
+            int priority = 0;
+            if (time - cacheTime[v] + 2 * live[v] <= cacheSize)
+                priority = (int)(time - cacheTime[v]);
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                fanning = v;
+            }
+        }
+        if (fanning >= 0)
+            continue;
+
+        // dead end: back up to a recent vertex with triangles left, else scan for one
+        while (!deadEnd.empty() && fanning < 0)
+        {
+            const unsigned int v = deadEnd.back();
+            deadEnd.pop_back();
+            if (live[v] > 0)
+                fanning = v;
+        }
+        while (fanning < 0 && cursor < vertexCount)
+        {
+            if (live[cursor] > 0)
+                fanning = (long long)cursor;
+            cursor++;
+        }
+    }
+    std::memcpy(indices, result.data(), result.size() * sizeof(unsigned int));
+}
+
+void optimizeOverdraw(unsigned int* indices, std::size_t indexCount, const float* positions, std::size_t positionStride,
+    std::size_t vertexCount, float threshold, unsigned int cacheSize)
+{
+    const std::size_t triangleCount = indexCount / 3;
+    if (triangleCount < 2)
+        return;
+    PROFILE_SCOPE("optimize overdraw");
+    const unsigned char* positionBytes = reinterpret_cast<const unsigned char*>(positions);
+    auto position = [&](unsigned int vertex)
+    {
+        return glm::make_vec3(reinterpret_cast<const float*>(positionBytes + vertex * positionStride));
+    };
+
+    // hard boundaries: triangles whose three vertices all miss, where the cache order
+    // itself starts over; the clusters between them can go in any order at no cost. A run
+    // shorter than OVERDRAW_MIN_CLUSTER joins the next: where faces share no vertices (flat
+    // shading) every triangle misses all three, and sorting them one by one would scatter them
+    std::vector<unsigned int> boundaries(1, 0);
+    FifoCache cache(vertexCount, cacheSize);
+    for (unsigned int t = 0; t < triangleCount; t++)
+    {
+        if (countMisses(cache, indices + t * 3) == 3 && t - boundaries.back() >= OVERDRAW_MIN_CLUSTER)
+            boundaries.push_back(t);
+    }
+    boundaries.push_back((unsigned int)triangleCount);
+
+    // soft boundaries: within a cluster, split again each time the run since the last split
+    // has OVERDRAW_MIN_CLUSTER triangles and an ACMR within `threshold` of the cluster's own
+    // (counted with the cache cold)
+    std::vector<Cluster> clusters;
+    for (std::size_t b = 0; b + 1 < boundaries.size(); b++)
+    {
+        const unsigned int first = boundaries[b], end = boundaries[b + 1];
+        cache.clear();
+        unsigned int clusterMisses = 0;
+        for (unsigned int t = first; t < end; t++)
+            clusterMisses += countMisses(cache, indices + t * 3);
+        const float target = threshold * (float)clusterMisses / (float)(end - first);
+
+        cache.clear();
+        unsigned int start = first, misses = 0;
+        for (unsigned int t = first; t < end; t++)
+        {
+            misses += countMisses(cache, indices + t * 3);
+            const unsigned int count = t + 1 - start;
+            if ((count >= OVERDRAW_MIN_CLUSTER && (float)misses <= target * (float)count) || t + 1 == end)
+            {
+                clusters.push_back({ start, t + 1 - start, 0.0f });
+                start = t + 1;
+                misses = 0;
+                cache.clear();
+            }
+        }
+    }
+
+    // sort key: how far the cluster's area-weighted centroid lies along its average normal,
+    // measured from the centre of the mesh
+    glm::vec3 meshCentre(0.0f);
+    for (std::size_t i = 0; i < triangleCount * 3; i++)
+        meshCentre += position(indices[i]);
+    meshCentre /= (float)(triangleCount * 3);
+    for (Cluster& cluster : clusters)
+    {
+        glm::vec3 centroid(0.0f), normal(0.0f);
+        float area = 0.0f;
+        for (unsigned int t = cluster.first; t < cluster.first + cluster.count; t++)
+        {
+            const glm::vec3 a = position(indices[t * 3]), b = position(indices[t * 3 + 1]), c = position(indices[t * 3 + 2]);
+            const glm::vec3 n = glm::cross(b - a, c - a);     // twice the area, along the normal
+            const float weight = glm::length(n);
+            centroid += (a + b + c) * (weight / 3.0f);
+            normal += n;
+            area += weight;
+        }
+        const float normalLength = glm::length(normal);
+        if (area > 0.0f && normalLength > 0.0f)
+            cluster.sortKey = glm::dot(centroid / area - meshCentre, normal / normalLength);
+    }
+    std::stable_sort(clusters.begin(), clusters.end(),
+        [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+    std::vector<unsigned int> result;
+    result.reserve(triangleCount * 3);
+    for (const Cluster& cluster : clusters)
+        result.insert(result.end(), indices + cluster.first * 3, indices + (cluster.first + cluster.count) * 3);
+    std::memcpy(indices, result.data(), result.size() * sizeof(unsigned int));
+}
+
+std::size_t optimizeVertexFetch(unsigned int* indices, std::size_t indexCount, void* vertices, std::size_t vertexCount,
+    std::size_t vertexStride)
+{
+    PROFILE_SCOPE("optimize vertex fetch");
+    const unsigned int unused = ~0u;
+    std::vector<unsigned int> remap(vertexCount, unused);
+    unsigned int next = 0;
+    for (std::size_t i = 0; i < indexCount; i++)
+    {
+        unsigned int& target = remap[indices[i]];
+        if (target == unused)
+            target = next++;
+        indices[i] = target;
+    }
+
+    unsigned char* bytes = static_cast<unsigned char*>(vertices);
+    std::vector<unsigned char> reordered((std::size_t)next * vertexStride);
+    for (std::size_t v = 0; v < vertexCount; v++)
+    {
+        if (remap[v] != unused)
+            std::memcpy(&reordered[remap[v] * vertexStride], bytes + v * vertexStride, vertexStride);
+    }
+    std::memcpy(bytes, reordered.data(), reordered.size());
+    return next;
+}
+
+std::size_t optimizeMesh(unsigned int* indices, std::size_t indexCount, void* vertices, std::size_t vertexCount,
+    std::size_t vertexStride, MeshOptimizationStats* stats)
+{
+    if (stats)
+        stats->before += analyzeVertexCache(indices, indexCount, vertexCount);
+    optimizeVertexCache(indices, indexCount, vertexCount);
+    optimizeOverdraw(indices, indexCount, static_cast<const float*>(vertices), vertexStride, vertexCount);
+    vertexCount = optimizeVertexFetch(indices, indexCount, vertices, vertexCount, vertexStride);
+    if (stats)
+        stats->after += analyzeVertexCache(indices, indexCount, vertexCount);
+    return vertexCount;
+}
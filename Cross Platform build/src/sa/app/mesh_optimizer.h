@@ -0,0 +1,68 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <cstddef>
+
+// Triangle and vertex order for indexed triangle lists, run by Model on import.
+//   optimizeVertexCache()  Tipsify (Sander, Nehab & Barczak 2007): fans around one vertex
+//                          at a time, moving on to the cached vertex with the most life
+//                          left, so most indices hit the post-transform cache.
+//   optimizeOverdraw()     cuts that order into clusters where the cache starts cold anyway
+//                          (and, within `threshold` of the cluster's ACMR, a little more
+//                          often), then draws the clusters facing away from the mesh's
+//                          centre first. Outward surfaces of a closed mesh tend to occlude
+//                          the rest, so fewer fragments are shaded for nothing from any view.
+//   optimizeVertexFetch()  renumbers the vertices in the order the indices first use them,
+//                          so the vertex fetch walks memory forward; unused ones are dropped.
+// The cache is modelled as a FIFO of VERTEX_CACHE_SIZE entries, conservative for current
+// GPUs, whose caches are larger and batch-based.
+const unsigned int VERTEX_CACHE_SIZE = 16;
+const float OVERDRAW_THRESHOLD = 1.05f;    // ACMR the overdraw pass may give up, as a factor
+const unsigned int OVERDRAW_MIN_CLUSTER = 16;  // triangles in a cluster the overdraw pass sorts
+
+// post-transform cache behaviour of an index buffer, summable over meshes
+struct VertexCacheStats
+{
+    unsigned long long triangles = 0;
+    unsigned long long vertices = 0;        // distinct vertices the indices reference
+    unsigned long long transforms = 0;      // cache misses, i.e. vertex shader runs
+
+    // average cache miss ratio: transforms per triangle (0.5 at best on a large grid, 3 at worst)
+    float getACMR() const { return triangles ? (float)transforms / (float)triangles : 0.0f; }
+    // average transform to vertex ratio: 1.0 means every vertex is shaded once
+    float getATVR() const { return vertices ? (float)transforms / (float)vertices : 0.0f; }
+
+    VertexCacheStats& operator+=(const VertexCacheStats& other)
+    {
+        triangles += other.triangles;
+        vertices += other.vertices;
+        transforms += other.transforms;
+        return *this;
+    }
+};
+
+struct MeshOptimizationStats
+{
+    VertexCacheStats before, after;
+};
+
+// simulates the FIFO cache over `indices`; every index must be below `vertexCount`
+VertexCacheStats analyzeVertexCache(const unsigned int* indices, std::size_t indexCount, std::size_t vertexCount,
+    unsigned int cacheSize = VERTEX_CACHE_SIZE);
+
+// the passes rewrite `indices` in place; each keeps the set of triangles and their winding
+void optimizeVertexCache(unsigned int* indices, std::size_t indexCount, std::size_t vertexCount,
+    unsigned int cacheSize = VERTEX_CACHE_SIZE);
+// expects the order optimizeVertexCache() leaves; positions are 3 floats `positionStride` bytes apart
+void optimizeOverdraw(unsigned int* indices, std::size_t indexCount, const float* positions, std::size_t positionStride,
+    std::size_t vertexCount, float threshold = OVERDRAW_THRESHOLD, unsigned int cacheSize = VERTEX_CACHE_SIZE);
+// reorders the `vertexStride`-byte records of `vertices` to match; returns how many are left
+std::size_t optimizeVertexFetch(unsigned int* indices, std::size_t indexCount, void* vertices, std::size_t vertexCount,
+    std::size_t vertexStride);
+
+// the three passes in order, for vertices that start with their float3 position; returns the
+// new vertex count and, if `stats` is given, adds the cache figures before and after to it
+std::size_t optimizeMesh(unsigned int* indices, std::size_t indexCount, void* vertices, std::size_t vertexCount,
+    std::size_t vertexStride, MeshOptimizationStats* stats = nullptr);
+
+#endif
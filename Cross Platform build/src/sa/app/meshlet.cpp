@@ -0,0 +1,256 @@
+#include "meshlet.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+
+#include "profiler.h"
+#include "render_counters.h"
+#include "simd.h"
+
+namespace
+{
+    // bounding sphere and normal cone of the triangles indices[first, first + count)
+    void computeBounds(Meshlet& meshlet, const unsigned int* indices, const unsigned char* positions, std::size_t positionStride)
+    {
+        auto position = [&](unsigned int vertex)
+        {
+            return glm::make_vec3(reinterpret_cast<const float*>(positions + vertex * positionStride));
+        };
+        const unsigned int* first = indices + meshlet.firstIndex;
+        const unsigned int* end = first + meshlet.indexCount;
+
+        // sphere around the box's centre: not minimal, but cheap and never too small
+        glm::vec3 lower = position(*first), upper = lower;
+        for (const unsigned int* index = first; index != end; index++)
+        {
+            lower = glm::min(lower, position(*index));
+            upper = glm::max(upper, position(*index));
+        }
+        meshlet.center = (lower + upper) * 0.5f;
+        float radiusSquared = 0.0f;
+        for (const unsigned int* index = first; index != end; index++)
+        {
+            const glm::vec3 offset = position(*index) - meshlet.center;
+            radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+        }
+        meshlet.radius = std::sqrt(radiusSquared);
+
+        // cone around the average normal, as wide as the normal furthest from it
+        glm::vec3 axis(0.0f);
+        for (const unsigned int* triangle = first; triangle != end; triangle += 3)
+        {
+            const glm::vec3 a = position(triangle[0]), b = position(triangle[1]), c = position(triangle[2]);
+            const glm::vec3 normal = glm::cross(b - a, c - a);
+            const float length = glm::length(normal);
+            if (length > 0.0f)
+                axis += normal / length;
+        }
+        meshlet.coneAxis = glm::vec3(0.0f);
+        meshlet.coneCutoff = FLT_MAX;
+        const float axisLength = glm::length(axis);
+        if (axisLength <= 0.0f)
+            return;
+        axis /= axisLength;
+        float minimumDot = 1.0f;
+        for (const unsigned int* triangle = first; triangle != end; triangle += 3)
+        {
+            const glm::vec3 a = position(triangle[0]), b = position(triangle[1]), c = position(triangle[2]);
+            const glm::vec3 normal = glm::cross(b - a, c - a);
+            const float length = glm::length(normal);
+            if (length > 0.0f)
+                minimumDot = std::min(minimumDot, glm::dot(normal / length, axis));
+        }
+        meshlet.coneAxis = axis;
+        if (minimumDot > 0.0f)
+            meshlet.coneCutoff = std::sqrt(1.0f - minimumDot * minimumDot);
+    }
+}
+
+void buildMeshlets(const unsigned int* indices, std::size_t indexCount, const float* positions, std::size_t positionStride,
+    std::size_t vertexCount, std::vector<Meshlet>& meshlets)
+{
+    meshlets.clear();
+    const unsigned int triangleCount = (unsigned int)(indexCount / 3);
+    if (triangleCount == 0)
+        return;
+    PROFILE_SCOPE("build meshlets");
+    const unsigned char* positionBytes = reinterpret_cast<const unsigned char*>(positions);
+
+    auto position = [&](unsigned int vertex)
+    {
+        return glm::make_vec3(reinterpret_cast<const float*>(positionBytes + vertex * positionStride));
+    };
+
+    // stamps[v] is the last meshlet that used vertex v
+    std::vector<unsigned int> stamps(vertexCount, ~0u);
+    Meshlet meshlet{};
+    unsigned int vertices = 0;
+    glm::vec3 lower(0.0f), upper(0.0f);     // the meshlet's box so far
+    for (unsigned int t = 0; t < triangleCount; t++)
+    {
+        const unsigned int* triangle = indices + t * 3;
+        const unsigned int id = (unsigned int)meshlets.size();
+        unsigned int added = 0;     // distinct vertices the meshlet does not have yet
+        for (unsigned int k = 0; k < 3; k++)
+            added += stamps[triangle[k]] != id && (k < 1 || triangle[k] != triangle[0]) && (k < 2 || triangle[k] != triangle[1]);
+        const glm::vec3 a = position(triangle[0]), b = position(triangle[1]), c = position(triangle[2]);
+        const glm::vec3 triangleLower = glm::min(a, glm::min(b, c)), triangleUpper = glm::max(a, glm::max(b, c));
+        // a triangle sharing nothing with the meshlet, away from it, is where the cache order
+        // jumped to another part of the mesh; going on would stretch the bounds over both.
+        // Flat shaded faces share no vertices with their neighbours but touch them, so they stay.
+        const bool disjoint = added == 3 && meshlet.indexCount > 0 &&
+            glm::any(glm::lessThan(triangleUpper, lower) || glm::greaterThan(triangleLower, upper));
+        if (vertices + added > MESHLET_MAX_VERTICES || meshlet.indexCount / 3 == MESHLET_MAX_TRIANGLES || disjoint)
+        {
+            computeBounds(meshlet, indices, positionBytes, positionStride);
+            meshlets.push_back(meshlet);
+            meshlet = Meshlet{};
+            meshlet.firstIndex = t * 3;
+            vertices = 0;
+        }
+        if (meshlet.indexCount == 0)
+        {
+            lower = triangleLower;
+            upper = triangleUpper;
+        }
+        else
+        {
+            lower = glm::min(lower, triangleLower);
+            upper = glm::max(upper, triangleUpper);
+        }
+        for (unsigned int k = 0; k < 3; k++)
+        {
+            if (stamps[triangle[k]] != (unsigned int)meshlets.size())
+            {
+                stamps[triangle[k]] = (unsigned int)meshlets.size();
+                vertices++;
+            }
+        }
+        meshlet.indexCount += 3;
+    }
+    computeBounds(meshlet, indices, positionBytes, positionStride);
+    meshlets.push_back(meshlet);
+}
+
+MeshletView makeMeshletView(const glm::mat4& projection, const glm::mat4& view, const glm::mat4& model)
+{
+    // the planes of the clip matrix's frustum, in the space it transforms from (Gribb & Hartmann)
+    const glm::mat4 clip = projection * view * model;
+    const glm::vec4 row0(clip[0][0], clip[1][0], clip[2][0], clip[3][0]);
+    const glm::vec4 row1(clip[0][1], clip[1][1], clip[2][1], clip[3][1]);
+    const glm::vec4 row2(clip[0][2], clip[1][2], clip[2][2], clip[3][2]);
+    const glm::vec4 row3(clip[0][3], clip[1][3], clip[2][3], clip[3][3]);
+    MeshletView meshletView;
+    meshletView.planes[0] = row3 + row0;
+    meshletView.planes[1] = row3 - row0;
+    meshletView.planes[2] = row3 + row1;
+    meshletView.planes[3] = row3 - row1;
+    meshletView.planes[4] = row3 + row2;
+    meshletView.planes[5] = row3 - row2;
+    for (glm::vec4& plane : meshletView.planes)
+        plane /= glm::length(glm::vec3(plane));
+    meshletView.eye = glm::vec3(glm::inverse(view * model)[3]);
+    return meshletView;
+}
+
+void MeshletCuller::setMeshlets(const Meshlet* meshlets, std::size_t count)
+{
+    meshletCount = (unsigned int)count;
+    const std::size_t padded = (count + 3) & ~(std::size_t)3;
+    std::vector<float>* lanes[] = { &centerX, &centerY, &centerZ, &radius, &coneX, &coneY, &coneZ, &coneCutoff };
+    for (std::vector<float>* lane : lanes)
+        lane->assign(padded, 0.0f);
+    firstIndex.resize(count);
+    indexCount.resize(count);
+    for (std::size_t i = 0; i < count; i++)
+    {
+        centerX[i] = meshlets[i].center.x;
+        centerY[i] = meshlets[i].center.y;
+        centerZ[i] = meshlets[i].center.z;
+        radius[i] = meshlets[i].radius;
+        coneX[i] = meshlets[i].coneAxis.x;
+        coneY[i] = meshlets[i].coneAxis.y;
+        coneZ[i] = meshlets[i].coneAxis.z;
+        coneCutoff[i] = meshlets[i].coneCutoff;
+        firstIndex[i] = meshlets[i].firstIndex;
+        indexCount[i] = meshlets[i].indexCount;
+    }
+    counts.reserve(count);
+    offsets.reserve(count);
+}
+
+unsigned int MeshletCuller::cull(const MeshletView& view, unsigned int indexSize)
+{
+    counts.clear();
+    offsets.clear();
+    visibleIndices = 0;
+    unsigned int visibleMeshlets = 0;
+    unsigned int end = ~0u;     // where the last command's range stops
+    auto emit = [&](unsigned int meshlet)
+    {
+        visibleMeshlets++;
+        visibleIndices += indexCount[meshlet];
+        if (firstIndex[meshlet] == end)
+            counts.back() += (GLsizei)indexCount[meshlet];
+        else
+        {
+            counts.push_back((GLsizei)indexCount[meshlet]);
+            offsets.push_back(reinterpret_cast<const void*>((std::uintptr_t)firstIndex[meshlet] * indexSize));
+        }
+        end = firstIndex[meshlet] + indexCount[meshlet];
+    };
+
+#ifdef SA_SSE2
+    const __m128 eyeX = _mm_set1_ps(view.eye.x), eyeY = _mm_set1_ps(view.eye.y), eyeZ = _mm_set1_ps(view.eye.z);
+    for (unsigned int base = 0; base < meshletCount; base += 4)
+    {
+        const __m128 x = _mm_loadu_ps(&centerX[base]), y = _mm_loadu_ps(&centerY[base]), z = _mm_loadu_ps(&centerZ[base]);
+        const __m128 r = _mm_loadu_ps(&radius[base]);
+        const __m128 negativeR = _mm_sub_ps(_mm_setzero_ps(), r);
+
+        // inside or touching every plane
+        __m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (const glm::vec4& plane : view.planes)
+        {
+            __m128 distance = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.x)), _mm_mul_ps(y, _mm_set1_ps(plane.y)));
+            distance = _mm_add_ps(distance, _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+            visible = _mm_and_ps(visible, _mm_cmpge_ps(distance, negativeR));
+        }
+
+        // and not facing away from the eye
+        const __m128 dx = _mm_sub_ps(x, eyeX), dy = _mm_sub_ps(y, eyeY), dz = _mm_sub_ps(z, eyeZ);
+        const __m128 along = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, _mm_loadu_ps(&coneX[base])),
+            _mm_mul_ps(dy, _mm_loadu_ps(&coneY[base]))), _mm_mul_ps(dz, _mm_loadu_ps(&coneZ[base])));
+        const __m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+        const __m128 backfacing = _mm_cmpge_ps(along, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&coneCutoff[base]), distance), r));
+        visible = _mm_andnot_ps(backfacing, visible);
+
+        int mask = _mm_movemask_ps(visible);
+        if (meshletCount - base < 4)
+            mask &= (1 << (meshletCount - base)) - 1;
+        for (unsigned int lane = 0; mask != 0; lane++, mask >>= 1)
+        {
+            if (mask & 1)
+                emit(base + lane);
+        }
+    }
+#else
+    for (unsigned int i = 0; i < meshletCount; i++)
+    {
+        const glm::vec3 center(centerX[i], centerY[i], centerZ[i]);
+        bool visible = true;
+        for (const glm::vec4& plane : view.planes)
+            visible = visible && glm::dot(glm::vec3(plane), center) + plane.w >= -radius[i];
+        const glm::vec3 toCenter = center - view.eye;
+        if (visible && glm::dot(toCenter, glm::vec3(coneX[i], coneY[i], coneZ[i])) <
+            coneCutoff[i] * glm::length(toCenter) + radius[i])
+            emit(i);
+    }
+#endif
+    countMeshlets(visibleMeshlets, meshletCount - visibleMeshlets);
+    return (unsigned int)counts.size();
+}
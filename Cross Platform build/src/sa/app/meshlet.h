@@ -0,0 +1,75 @@
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+// Meshlets: a mesh's triangles cut into small runs of its index buffer, each with bounds to
+// cull it by. buildMeshlets() walks the indices in order (after optimizeMesh() that order is
+// already local) and closes a meshlet whenever the next triangle would take it past
+// MESHLET_MAX_VERTICES distinct vertices or MESHLET_MAX_TRIANGLES triangles, or shares no
+// vertex with it and lies outside its box, so a meshlet is the range
+// [firstIndex, firstIndex + indexCount) of the unchanged index buffer.
+//
+// Each frame MeshletCuller tests the meshlets against the view frustum and their normal cone
+// against the eye, four at a time, and leaves the survivors as one glMultiDrawElements
+// command list, neighbouring ranges merged. Everything is done in the mesh's model space,
+// which is exact for the frustum; the cone test assumes the model matrix scales uniformly.
+const unsigned int MESHLET_MAX_VERTICES = 64;
+const unsigned int MESHLET_MAX_TRIANGLES = 124;
+
+struct Meshlet
+{
+    unsigned int firstIndex, indexCount;
+    glm::vec3 center;       // bounding sphere
+    float radius;
+    // normal cone: the meshlet faces away from every eye with
+    // dot(center - eye, coneAxis) >= coneCutoff * length(center - eye) + radius;
+    // coneCutoff is the sine of the cone's half angle, FLT_MAX when it is wider than 90 degrees
+    glm::vec3 coneAxis;
+    float coneCutoff;
+};
+
+// replaces `meshlets` with those of the triangle list; positions are 3 floats `positionStride` bytes apart
+void buildMeshlets(const unsigned int* indices, std::size_t indexCount, const float* positions, std::size_t positionStride,
+    std::size_t vertexCount, std::vector<Meshlet>& meshlets);
+
+// a camera as a mesh's model space sees it
+struct MeshletView
+{
+    glm::vec4 planes[6];    // frustum, normalized, positive inside
+    glm::vec3 eye;
+};
+
+MeshletView makeMeshletView(const glm::mat4& projection, const glm::mat4& view, const glm::mat4& model);
+
+class MeshletCuller
+{
+public:
+    // keeps the bounds as structure of arrays, padded to a multiple of 4
+    void setMeshlets(const Meshlet* meshlets, std::size_t count);
+    unsigned int getMeshletCount() const { return meshletCount; }
+
+    // fills the command list with the meshlets visible from `view`; `indexSize` is the
+    // index buffer's (2 or 4 bytes), for the offsets. Returns the number of draws.
+    unsigned int cull(const MeshletView& view, unsigned int indexSize);
+
+    // the command list, glMultiDrawElements' counts and indices arguments
+    const GLsizei* getCounts() const { return counts.data(); }
+    const void* const* getOffsets() const { return offsets.data(); }
+    unsigned int getVisibleIndices() const { return visibleIndices; }
+
+private:
+    unsigned int meshletCount = 0;
+    std::vector<float> centerX, centerY, centerZ, radius;
+    std::vector<float> coneX, coneY, coneZ, coneCutoff;
+    std::vector<unsigned int> firstIndex, indexCount;
+    std::vector<GLsizei> counts;
+    std::vector<const void*> offsets;
+    unsigned int visibleIndices = 0;
+};
+
+#endif
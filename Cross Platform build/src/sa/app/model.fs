@@ -0,0 +1,27 @@
+
+// fragment shader for Model / Mesh (model.h): the first diffuse map lit by one directional
+// light, with the first normal map when the mesh has one
+
+#version 330 core
+out vec4 FragColor;
+
+in vec3 FragPos;
+in vec2 TexCoords;
+in mat3 TBN;
+
+uniform sampler2D texture_diffuse1;
+uniform sampler2D texture_normal1;
+uniform bool hasNormalMap;
+uniform vec3 lightDirection;    // towards the light, world space
+uniform vec3 ambient;
+
+void main()
+{
+    vec3 normal = vec3(0.0, 0.0, 1.0);
+    if (hasNormalMap)
+        normal = texture(texture_normal1, TexCoords).rgb * 2.0 - 1.0;
+    normal = normalize(TBN * normal);
+    vec3 color = texture(texture_diffuse1, TexCoords).rgb;
+    float diffuse = max(dot(normal, normalize(lightDirection)), 0.0);
+    FragColor = vec4(color * (ambient + diffuse), 1.0);
+}
@@ -11,31 +11,65 @@
 #include <assimp/postprocess.h>
 
 #include "mesh.h"
+#include "mesh_cache.h"
+#include "mesh_optimizer.h"
 #include "shader.h"
+#include "texture_manager.h"
 
+#include <cstdint>
+#include <filesystem>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <unordered_map>
 #include <vector>
 using namespace std;
 
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
 
+// what Assimp is asked to do on import; part of the mesh cache key. Formats like OBJ give
+// every face corner a vertex of its own until JoinIdenticalVertices welds them, and without
+// shared vertices optimizeMesh() and buildMeshlets() have nothing to work with.
+const unsigned int MODEL_IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_GenSmoothNormals |
+    aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+// where imported models are cached (see mesh_cache.h)
+const char* const MODEL_CACHE_DIRECTORY = "mesh_cache";
+
+// a node of the model's hierarchy; its meshes are meshes[firstMesh, firstMesh + meshCount)
+struct ModelNode
+{
+    string name;
+    int parent;             // index into Model::nodes, -1 for the root
+    glm::mat4 transform;    // relative to the parent
+    unsigned int firstMesh, meshCount;
+};
+
 class Model 
 {
 public:
     // model data 
     vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+    vector<TextureHandle> textureHandles;   // the model's references to textures_loaded, given back with it
     vector<Mesh>    meshes;
+    vector<ModelNode> nodes;
     string directory;
     bool gammaCorrection;
+    VertexLayout layout;                // how the meshes store their vertices, see vertex_format.h
+    bool loadedFromCache = false;
+    // vertex cache figures of the imported meshes before and after optimizeMesh(); zero
+    // when the model came from the mesh cache, which stores the optimized meshes
+    MeshOptimizationStats optimization;
 
-    // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    // constructor, expects a filepath to a 3D model. The first import is stored in
+    // cacheDirectory, and later loads map that instead of running Assimp; an empty
+    // cacheDirectory always imports. Compact layouts need a shader that decodes them,
+    // such as model.vs.
+    Model(string const &path, bool gamma = false, VertexLayout layout = VERTEX_FULL,
+        string const &cacheDirectory = MODEL_CACHE_DIRECTORY) : gammaCorrection(gamma), layout(layout)
     {
-        loadModel(path);
+        loadModel(path, cacheDirectory);
     }
 
     // draws the model, and thus all its meshes
@@ -44,57 +78,128 @@ public:
         for(unsigned int i = 0; i < meshes.size(); i++)
             meshes[i].Draw(shader);
     }
+
+    // draws only the meshlets of each mesh that are in view and face the camera;
+    // `view` is made by makeMeshletView() with the model matrix the shader is given
+    void Draw(Shader &shader, const MeshletView &view)
+    {
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].Draw(shader, view);
+    }
     
 private:
-    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
-    void loadModel(string const &path)
+    // loads a model from the mesh cache, or with ASSIMP (any extension it supports) and
+    // caches it, and stores the resulting meshes in the meshes vector.
+    void loadModel(string const &path, string const &cacheDirectory)
     {
+        // retrieve the directory path of the filepath
+        directory = path.substr(0, path.find_last_of('/'));
+
+        std::uint64_t key = 0;
+        const bool cached = !cacheDirectory.empty() && meshCacheKey(path, MODEL_IMPORT_FLAGS, layout, key);
+        if(cached && loadFromCache(meshCachePath(cacheDirectory, key), key))
+            return;
+
         // read file via ASSIMP
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        const aiScene* scene = importer.ReadFile(path, MODEL_IMPORT_FLAGS);
         // check for errors
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
             cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
             return;
         }
-        // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
 
-        // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+        // process ASSIMP's root node recursively, collecting what the cache stores on the way
+        MeshCacheBuilder builder((std::uint32_t)vertexStride(layout));
+        processNode(scene->mRootNode, scene, -1, cached ? &builder : nullptr);
+        if(cached)
+        {
+            std::error_code error;
+            std::filesystem::create_directories(cacheDirectory, error);
+            builder.save(meshCachePath(cacheDirectory, key), key);
+        }
+    }
+
+    // uploads every mesh straight from the mapped cache file; nothing is copied on the way
+    bool loadFromCache(string const &cachePath, std::uint64_t key)
+    {
+        MeshCacheFile file;
+        if(!file.open(cachePath, key, (std::uint32_t)vertexStride(layout)))
+            return false;
+        for(unsigned int i = 0; i < file.getNodeCount(); i++)
+        {
+            MeshCacheFile::NodeView node = file.getNode(i);
+            ModelNode modelNode;
+            modelNode.name = node.name;
+            modelNode.parent = node.parent;
+            std::memcpy(&modelNode.transform[0][0], node.transform, sizeof(modelNode.transform));
+            modelNode.firstMesh = node.firstMesh;
+            modelNode.meshCount = node.meshCount;
+            nodes.push_back(modelNode);
+        }
+        meshes.reserve(file.getMeshCount());
+        for(unsigned int i = 0; i < file.getMeshCount(); i++)
+        {
+            MeshCacheFile::MeshView mesh = file.getMesh(i);
+            vector<Texture> textures;
+            for(unsigned int j = 0; j < mesh.textureCount; j++)
+            {
+                MeshCacheFile::TextureView texture = file.getTexture(mesh.firstTexture + j);
+                textures.push_back(loadTexture(texture.path, texture.type));
+            }
+            meshes.emplace_back(mesh.vertices, mesh.vertexFormat, mesh.vertexCount, mesh.indices, mesh.indexSize,
+                mesh.indexCount, std::move(textures), mesh.meshlets, mesh.meshletCount);
+        }
+        loadedFromCache = true;
+        return true;
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene)
+    void processNode(aiNode *node, const aiScene *scene, int parent, MeshCacheBuilder *builder)
     {
+        ModelNode modelNode;
+        modelNode.name = node->mName.C_Str();
+        modelNode.parent = parent;
+        // aiMatrix4x4 is row major, glm column major
+        for(unsigned int row = 0; row < 4; row++)
+            for(unsigned int column = 0; column < 4; column++)
+                modelNode.transform[column][row] = node->mTransformation[row][column];
+        modelNode.firstMesh = static_cast<unsigned int>(meshes.size());
+        modelNode.meshCount = node->mNumMeshes;
+        const int index = static_cast<int>(nodes.size());
+        nodes.push_back(modelNode);
+        const unsigned int cacheNode = builder ? builder->addNode(parent, modelNode.name, &modelNode.transform[0][0]) : 0;
+
         // process each mesh located at the current node
         for(unsigned int i = 0; i < node->mNumMeshes; i++)
         {
             // the node object only contains indices to index the actual objects in the scene. 
             // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
             aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            processMesh(mesh, scene, builder, cacheNode);
         }
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
         for(unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            processNode(node->mChildren[i], scene);
+            processNode(node->mChildren[i], scene, index, builder);
         }
 
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    void processMesh(aiMesh *mesh, const aiScene *scene, MeshCacheBuilder *builder, unsigned int cacheNode)
     {
         // data to fill
         vector<Vertex> vertices;
         vector<unsigned int> indices;
         vector<Texture> textures;
+        vertices.reserve(mesh->mNumVertices);
+        indices.reserve(mesh->mNumFaces * 3);
 
         // walk through each of the mesh's vertices
         for(unsigned int i = 0; i < mesh->mNumVertices; i++)
         {
-            Vertex vertex;
+            Vertex vertex{}; // zeroed, so unused fields (bones) are stored in the mesh cache as zeros
             glm::vec3 vector; // we declare a placeholder vector since assimp uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
             // positions
             vector.x = mesh->mVertices[i].x;
@@ -164,8 +269,36 @@ private:
         std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
         textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
         
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        // reorder triangles and vertices for the post-transform cache, overdraw and fetch
+        vertices.resize(optimizeMesh(indices.data(), indices.size(), vertices.data(), vertices.size(), sizeof(Vertex), &optimization));
+        // and cut them into meshlets to cull by (see meshlet.h)
+        vector<Meshlet> meshlets;
+        buildMeshlets(indices.data(), indices.size(), reinterpret_cast<const float*>(vertices.data()), sizeof(Vertex), vertices.size(), meshlets);
+        // 16-bit indices wherever they reach every vertex
+        vector<unsigned short> shortIndices;
+        const void* indexData = indices.data();
+        unsigned int indexSize = sizeof(unsigned int);
+        if(vertices.size() < 65536)
+        {
+            shortIndices.assign(indices.begin(), indices.end());
+            indexData = shortIndices.data();
+            indexSize = sizeof(unsigned short);
+        }
+
+        // pack the vertices once, for the cache and the upload
+        vector<unsigned char> packed;
+        const unsigned int format = packVertices(vertices.data(), vertices.size(), layout, packed);
+        if(builder)
+        {
+            vector<MeshCacheTexture> cacheTextures;
+            for(const Texture &texture : textures)
+                cacheTextures.push_back({ texture.type, texture.path });
+            builder->addMesh(cacheNode, packed.data(), format, static_cast<unsigned int>(vertices.size()),
+                indexData, indexSize, static_cast<unsigned int>(indices.size()), meshlets, cacheTextures);
+        }
+        // create a mesh object from the extracted mesh data
+        meshes.emplace_back(packed.data(), format, vertices.size(), indexData, indexSize, indices.size(), std::move(textures),
+            meshlets.data(), meshlets.size());
     }
 
     // checks all material textures of a given type and loads the textures if they're not loaded yet.
@@ -177,69 +310,39 @@ private:
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
-            }
+            textures.push_back(loadTexture(str.C_Str(), typeName));
         }
         return textures;
     }
-};
-
-
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
-{
-    string filename = string(path);
-    filename = directory + '/' + filename;
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
+    // textures_loaded index of each texture id
+    unordered_map<unsigned int, size_t> loadedById;
 
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
+    // the texture at `path` (relative to the model); the registry hands every model the
+    // same texture for the same file, and this model holds one reference to it
+    Texture loadTexture(const char *path, string const &typeName)
     {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+        TextureHandle handle(TextureFromFile(path, this->directory));
+        // loaded before: the extra reference goes with `handle`
+        auto found = loadedById.find(handle.get());
+        if(found != loadedById.end())
+            return textures_loaded[found->second];
+        Texture texture;
+        texture.id = handle.get();
+        texture.type = typeName;
+        texture.path = path;
+        loadedById[texture.id] = textures_loaded.size();
+        textures_loaded.push_back(texture);
+        textureHandles.push_back(std::move(handle));
+        return texture;
     }
+};
+
 
-    return textureID;
+// the texture shows a placeholder until its image is decoded and uploaded, see texture_manager.h;
+// the caller owns a reference to it (textureManager().unload() gives it back)
+unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
+{
+    return textureManager().load(directory + '/' + string(path));
 }
 #endif
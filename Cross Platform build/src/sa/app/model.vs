@@ -0,0 +1,54 @@
+
+// vertex shader for Model / Mesh (model.h), in any of the vertex layouts of vertex_format.h
+
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;      // VERTEX_FULL: the normal; compact: octahedral xy
+layout (location = 2) in vec2 aTexCoords;   // floats, halfs or unorm16; the attribute format converts them
+layout (location = 3) in vec4 aTangent;     // VERTEX_FULL: xyz; compact: octahedral xy, bitangent sign in w
+layout (location = 4) in vec3 aBitangent;   // VERTEX_FULL only
+
+out vec3 FragPos;
+out vec2 TexCoords;
+out mat3 TBN;           // tangent space to world space
+
+uniform int vertexLayout;   // 0 (VERTEX_FULL) or a compact layout, set by Mesh::Draw
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+vec3 octahedralDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+void main()
+{
+    vec3 normal, tangent, bitangent;
+    if (vertexLayout == 0)
+    {
+        normal = aNormal;
+        tangent = aTangent.xyz;
+        bitangent = aBitangent;
+    }
+    else
+    {
+        normal = octahedralDecode(aNormal.xy);
+        tangent = octahedralDecode(aTangent.xy);
+        bitangent = cross(normal, tangent) * (aTangent.w < 0.0 ? -1.0 : 1.0);
+    }
+
+    FragPos = vec3(model * vec4(aPos, 1.0));
+    // cofactor matrix: the inverse transpose up to scale, without a per-vertex inverse()
+    mat3 m = mat3(model);
+    mat3 cofactor = mat3(cross(m[1], m[2]), cross(m[2], m[0]), cross(m[0], m[1]));
+    vec3 N = normalize(cofactor * normal * sign(dot(m[0], cofactor[0])));
+    vec3 T = normalize(m * tangent);
+    vec3 B = normalize(m * bitangent);
+    TBN = mat3(T, B, N);
+    TexCoords = aTexCoords;
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
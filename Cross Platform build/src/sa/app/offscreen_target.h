@@ -0,0 +1,100 @@
+#ifndef OFFSCREEN_TARGET_H
+#define OFFSCREEN_TARGET_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+// Framebuffer object with an RGBA8 colour and a 24-bit depth/stencil renderbuffer, for
+// rendering without a window. Frames are read back top row first, ready to be written out.
+class OffscreenTarget
+{
+public:
+    OffscreenTarget() {}
+    ~OffscreenTarget() { release(); }
+
+    OffscreenTarget(const OffscreenTarget&) = delete;
+    OffscreenTarget& operator=(const OffscreenTarget&) = delete;
+
+    bool create(int width, int height)
+    {
+        release();
+        this->width = width;
+        this->height = height;
+
+        glGenRenderbuffers(1, &colorBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glGenRenderbuffers(1, &depthBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        glGenFramebuffers(1, &FBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+        GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        if (status != GL_FRAMEBUFFER_COMPLETE)
+        {
+            std::cout << "ERROR::OFFSCREEN::FRAMEBUFFER_INCOMPLETE: 0x" << std::hex << status << std::dec << std::endl;
+            release();
+            return false;
+        }
+        return true;
+    }
+
+    // makes the target the draw and read framebuffer and sets the viewport to cover it
+    void bind() const
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glViewport(0, 0, width, height);
+    }
+
+    // reads the colour buffer as tightly packed RGBA, top row first; waits for the frame to finish
+    void readPixels(std::vector<unsigned char>& rgba) const
+    {
+        const size_t rowBytes = (size_t)width * 4;
+        rgba.resize(rowBytes * height);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, FBO);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+
+        // GL returns the bottom row first
+        std::vector<unsigned char> row(rowBytes);
+        for (int y = 0; y < height / 2; y++)
+        {
+            unsigned char* top = rgba.data() + y * rowBytes;
+            unsigned char* bottom = rgba.data() + (height - 1 - y) * rowBytes;
+            std::copy(top, top + rowBytes, row.begin());
+            std::copy(bottom, bottom + rowBytes, top);
+            std::copy(row.begin(), row.end(), bottom);
+        }
+    }
+
+    void release()
+    {
+        if (FBO == 0)
+            return;
+        glDeleteFramebuffers(1, &FBO);
+        glDeleteRenderbuffers(1, &colorBuffer);
+        glDeleteRenderbuffers(1, &depthBuffer);
+        FBO = colorBuffer = depthBuffer = 0;
+    }
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    bool isValid() const { return FBO != 0; }
+
+private:
+    unsigned int FBO = 0;
+    unsigned int colorBuffer = 0;
+    unsigned int depthBuffer = 0;
+    int width = 0;
+    int height = 0;
+};
+
+#endif
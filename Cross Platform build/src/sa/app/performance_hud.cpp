@@ -0,0 +1,143 @@
+#include "performance_hud.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+
+#ifdef SA_HAVE_IMGUI
+#include <imgui.h>
+#include <imgui_impl_opengl3.h>
+#endif
+
+namespace
+{
+    double megabytes(long long bytes)
+    {
+        return bytes / (1024.0 * 1024.0);
+    }
+
+    // average of the `n` largest values, which end up at the front
+    float slowestAverage(float* values, unsigned int count, unsigned int n)
+    {
+        n = std::max(1u, std::min(n, count));
+        std::nth_element(values, values + (n - 1), values + count, std::greater<float>());
+        float total = 0.0f;
+        for (unsigned int i = 0; i < n; i++)
+            total += values[i];
+        return total / n;
+    }
+}
+
+bool PerformanceHud::create()
+{
+#ifdef SA_HAVE_IMGUI
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    ImGui::GetIO().IniFilename = NULL;
+    ImGui::StyleColorsDark();
+    if (!ImGui_ImplOpenGL3_Init("#version 330"))
+    {
+        std::cout << "ERROR::PERFORMANCE_HUD::IMGUI_INIT_FAILED" << std::endl;
+        ImGui::DestroyContext();
+        return false;
+    }
+#endif
+    created = true;
+    return true;
+}
+
+void PerformanceHud::release()
+{
+#ifdef SA_HAVE_IMGUI
+    if (created)
+    {
+        ImGui_ImplOpenGL3_Shutdown();
+        ImGui::DestroyContext();
+    }
+#endif
+    created = false;
+    visible = false;
+}
+
+void PerformanceHud::toggle()
+{
+    if (!created)
+        return;
+    visible = !visible;
+    // the history only covers frames seen while visible
+    next = count = 0;
+    lowOnePercent = lowPointOnePercent = 0.0f;
+    lastPrint = std::chrono::steady_clock::now();
+}
+
+void PerformanceHud::setVisible(bool visible)
+{
+    if (visible != this->visible)
+        toggle();
+}
+
+void PerformanceHud::addFrame(float milliseconds, const RenderCounters& counters)
+{
+    if (!visible)
+        return;
+    frameTimes[next] = milliseconds;
+    next = (next + 1) % HUD_HISTORY;
+    count = std::min(count + 1, HUD_HISTORY);
+    frameCounters = counters;
+    updateLows();
+}
+
+void PerformanceHud::updateLows()
+{
+    // a thousand floats: partitioning a copy every frame costs a few microseconds
+    float sorted[HUD_HISTORY];
+    std::copy(frameTimes, frameTimes + count, sorted);
+    lowOnePercent = slowestAverage(sorted, count, count / 100);
+    lowPointOnePercent = slowestAverage(sorted, count, count / 1000);
+}
+
+void PerformanceHud::draw(float width, float height)
+{
+    if (!visible || count == 0)
+        return;
+    const float last = frameTimes[(next + HUD_HISTORY - 1) % HUD_HISTORY];
+
+#ifdef SA_HAVE_IMGUI
+    ImGuiIO& io = ImGui::GetIO();
+    io.DisplaySize = ImVec2(width, height);
+    io.DeltaTime = last > 0.0f ? last / 1000.0f : 1.0f / 60.0f;
+    ImGui_ImplOpenGL3_NewFrame();
+    ImGui::NewFrame();
+
+    ImGui::SetNextWindowPos(ImVec2(10.0f, 10.0f), ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowBgAlpha(0.6f);
+    ImGui::Begin("Performance", NULL, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoFocusOnAppearing | ImGuiWindowFlags_NoNav);
+    ImGui::Text("%.2f ms  (%.0f fps)", last, last > 0.0f ? 1000.0f / last : 0.0f);
+    // oldest first once the ring has wrapped; scaled so the worst frame stays on the graph
+    ImGui::PlotLines("##frame times", frameTimes, (int)count, count == HUD_HISTORY ? (int)next : 0, NULL, 0.0f,
+        std::max(lowPointOnePercent * 1.1f, 1.0f), ImVec2(320.0f, 80.0f));
+    ImGui::Text("1%% low %.2f ms   0.1%% low %.2f ms", lowOnePercent, lowPointOnePercent);
+    ImGui::Separator();
+    ImGui::Text("draw calls      %u", frameCounters.drawCalls);
+    ImGui::Text("triangles       %llu", frameCounters.triangles);
+    ImGui::Text("state changes   %u", frameCounters.stateChanges);
+    ImGui::Text("uniform uploads %u", frameCounters.uniformUploads);
+    ImGui::Text("texture memory  %.1f MB", megabytes(frameCounters.textureBytes));
+    ImGui::Text("buffer memory   %.1f MB", megabytes(frameCounters.bufferBytes));
+    ImGui::End();
+
+    ImGui::Render();
+    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+#else
+    (void)width;
+    (void)height;
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (now - lastPrint < std::chrono::seconds(1))
+        return;
+    lastPrint = now;
+    std::printf("HUD %.2f ms  1%% low %.2f  0.1%% low %.2f  draws %u  tris %llu  state %u  uniforms %u  tex %.1f MB  buf %.1f MB\n",
+        last, lowOnePercent, lowPointOnePercent, frameCounters.drawCalls, frameCounters.triangles, frameCounters.stateChanges,
+        frameCounters.uniformUploads, megabytes(frameCounters.textureBytes), megabytes(frameCounters.bufferBytes));
+#endif
+}
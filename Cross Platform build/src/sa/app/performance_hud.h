@@ -0,0 +1,50 @@
+#ifndef PERFORMANCE_HUD_H
+#define PERFORMANCE_HUD_H
+
+#include <chrono>
+
+#include "render_counters.h"
+
+const unsigned int HUD_HISTORY = 1000;  // frames in the graph and in the 1%/0.1% lows
+
+// On-screen performance overlay for windowed runs: a rolling frame-time graph, the 1% and
+// 0.1% lows (average of the slowest 1% / 0.1% of the last HUD_HISTORY frames) and the
+// RenderCounters of the frame. Drawn with Dear ImGui when the build has it (SA_HAVE_IMGUI,
+// see CMakeLists.txt), otherwise printed to the console once a second.
+//
+// While hidden, addFrame() and draw() return straight away: no history is kept and no
+// ImGui frame is started, so the only cost left is the counters' own increments.
+//
+// The HUD belongs to the render thread and takes no input, so it only uses ImGui's OpenGL
+// backend: the GLFW one would call into GLFW off the main thread.
+class PerformanceHud
+{
+public:
+    // with the GL context current
+    bool create();
+    void release();
+
+    void toggle();
+    void setVisible(bool visible);
+    bool isVisible() const { return visible; }
+
+    // once per frame, after the scene is drawn and before the counters are reset
+    void addFrame(float milliseconds, const RenderCounters& counters);
+    // draws the overlay into the current width x height framebuffer, before the swap
+    void draw(float width, float height);
+
+private:
+    void updateLows();
+
+    float frameTimes[HUD_HISTORY];
+    unsigned int next = 0;
+    unsigned int count = 0;
+    float lowOnePercent = 0.0f;
+    float lowPointOnePercent = 0.0f;
+    RenderCounters frameCounters;
+    bool visible = false;
+    bool created = false;
+    std::chrono::steady_clock::time_point lastPrint;
+};
+
+#endif
@@ -0,0 +1,199 @@
+#include "profiler.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+
+namespace
+{
+    void writeJsonString(FILE* file, const char* text)
+    {
+        std::fputc('"', file);
+        for (; *text; text++)
+        {
+            if (*text == '"' || *text == '\\')
+                std::fputc('\\', file);
+            if ((unsigned char)*text >= 0x20)
+                std::fputc(*text, file);
+        }
+        std::fputc('"', file);
+    }
+}
+
+Profiler::Profiler() : origin(std::chrono::steady_clock::now())
+{
+}
+
+std::uint64_t Profiler::now() const
+{
+    return (std::uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count();
+}
+
+Profiler::ThreadRecord& Profiler::threadRecord()
+{
+    // registered on the thread's first event; after that the ring is reached without locking
+    thread_local ThreadRecord* record = nullptr;
+    if (record == nullptr)
+    {
+        std::unique_ptr<ThreadRecord> created(new ThreadRecord());
+        std::lock_guard<std::mutex> lock(threadsMutex);
+        created->id = (unsigned int)threads.size();
+        created->name = created->id == 0 ? "main" : "thread " + std::to_string(created->id);
+        record = created.get();
+        threads.push_back(std::move(created));
+    }
+    return *record;
+}
+
+void Profiler::record(const char* name, std::uint64_t start, std::uint64_t end)
+{
+    ProfileEvent event = { name, start, end };
+    if (!threadRecord().ring.push(event))
+        ringDrops.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Profiler::setThreadName(const char* name)
+{
+    ThreadRecord& record = threadRecord();
+    std::lock_guard<std::mutex> lock(threadsMutex);
+    record.name = name;
+}
+
+int Profiler::beginGpuScope(const char* name)
+{
+    GpuFrame& frame = gpuFrames[gpuFrame];
+    if (gpuScopeOpen || frame.count == PROFILE_GPU_SCOPES)
+    {
+        if (!gpuScopeOpen)
+            stats.droppedEvents++;
+        return -1;
+    }
+    if (frame.queries[0] == 0)
+        glGenQueries(PROFILE_GPU_SCOPES, frame.queries);
+
+    int slot = (int)frame.count++;
+    frame.names[slot] = name;
+    frame.submitted[slot] = now();
+    glBeginQuery(GL_TIME_ELAPSED, frame.queries[slot]);
+    gpuScopeOpen = true;
+    return slot;
+}
+
+void Profiler::endGpuScope(int slot)
+{
+    if (slot < 0)
+        return;
+    glEndQuery(GL_TIME_ELAPSED);
+    gpuScopeOpen = false;
+}
+
+void Profiler::resolveGpuFrame(GpuFrame& frame)
+{
+    for (unsigned int i = 0; i < frame.count; i++)
+    {
+        // two frames on the results are normally long in; never wait for a late one
+        GLint available = 0;
+        glGetQueryObjectiv(frame.queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+        {
+            stats.droppedEvents++;
+            continue;
+        }
+        GLuint64 duration = 0;
+        glGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT, &duration);
+
+        // elapsed queries carry no start time: lay the scopes out back to back on the GPU
+        // track, each no earlier than it was submitted
+        TraceEvent event;
+        event.name = frame.names[i];
+        event.start = std::max(frame.submitted[i], gpuCursor);
+        event.duration = duration;
+        event.thread = GPU_THREAD;
+        gpuCursor = event.start + duration;
+        addToHistory(event);
+        stats.gpuEvents++;
+    }
+    frame.count = 0;
+}
+
+void Profiler::addToHistory(const TraceEvent& event)
+{
+    if (history.size() < PROFILE_HISTORY_CAPACITY)
+    {
+        history.push_back(event);
+        return;
+    }
+    history[historyNext] = event;
+    historyNext = (historyNext + 1) % PROFILE_HISTORY_CAPACITY;
+}
+
+void Profiler::beginFrame()
+{
+    {
+        std::lock_guard<std::mutex> lock(threadsMutex);
+        for (const std::unique_ptr<ThreadRecord>& thread : threads)
+        {
+            const unsigned int id = thread->id;
+            thread->ring.drain([&](const ProfileEvent& event)
+            {
+                TraceEvent traceEvent = { event.name, event.start, event.end - event.start, id };
+                addToHistory(traceEvent);
+                stats.cpuEvents++;
+            });
+        }
+        stats.threads = (unsigned int)threads.size();
+    }
+    stats.droppedEvents += ringDrops.exchange(0, std::memory_order_relaxed);
+
+    // the other buffer was filled two frames ago; reuse it for this frame
+    gpuFrame ^= 1;
+    resolveGpuFrame(gpuFrames[gpuFrame]);
+    stats.frames++;
+}
+
+bool Profiler::writeChromeTrace(const std::string& path)
+{
+    FILE* file = std::fopen(path.c_str(), "w");
+    if (!file)
+    {
+        std::cout << "ERROR::PROFILER::FILE_NOT_WRITTEN: " << path << std::endl;
+        return false;
+    }
+
+    std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    {
+        std::lock_guard<std::mutex> lock(threadsMutex);
+        for (const std::unique_ptr<ThreadRecord>& thread : threads)
+        {
+            std::fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", thread->id);
+            writeJsonString(file, thread->name.c_str());
+            std::fprintf(file, "}},\n");
+        }
+    }
+    std::fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"GPU\"}}", GPU_THREAD);
+
+    // oldest first: once the history has wrapped it starts at historyNext
+    for (std::size_t i = 0; i < history.size(); i++)
+    {
+        const TraceEvent& event = history[(historyNext + i) % history.size()];
+        std::fprintf(file, ",\n{\"name\":");
+        writeJsonString(file, event.name);
+        std::fprintf(file, ",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+            event.thread == GPU_THREAD ? "gpu" : "cpu", event.thread, event.start / 1000.0, event.duration / 1000.0);
+    }
+    std::fprintf(file, "\n]}\n");
+    return std::fclose(file) == 0;
+}
+
+void Profiler::release()
+{
+    for (GpuFrame& frame : gpuFrames)
+    {
+        if (frame.queries[0] != 0)
+            glDeleteQueries(PROFILE_GPU_SCOPES, frame.queries);
+        frame = GpuFrame();
+    }
+    gpuScopeOpen = false;
+}
@@ -0,0 +1,199 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Frame profiler. CPU scopes are timed with RAII objects and pushed into a ring owned by
+// the calling thread, so recording takes no lock and threads never contend. Once a frame,
+// beginFrame() (on the GL thread) drains every ring into a rolling history and resolves
+// the GPU scopes. GPU scopes use GL_TIME_ELAPSED queries, double-buffered by frame: a
+// frame's queries are read back two frames later, after the GPU has long finished them,
+// so the pipeline is never stalled. The history can be written as Chrome trace JSON
+// (chrome://tracing, ui.perfetto.dev) at any time.
+//
+// Use the macros rather than the classes: without SA_PROFILER (Release builds, see
+// CMakeLists.txt) they expand to nothing. Scope names must be string literals, only the
+// pointer is stored. GPU scopes cannot nest (only one GL_TIME_ELAPSED query may be active);
+// an inner one is ignored.
+
+const unsigned int PROFILE_RING_CAPACITY = 1 << 14;    // per thread, between two beginFrame()s
+const unsigned int PROFILE_HISTORY_CAPACITY = 1 << 18; // events kept for export
+const unsigned int PROFILE_GPU_SCOPES = 64;            // per frame
+
+// a finished scope; times are nanoseconds since the profiler started
+struct ProfileEvent
+{
+    const char* name;
+    std::uint64_t start;
+    std::uint64_t end;
+};
+
+// Single producer (the owning thread), single consumer (beginFrame) event ring.
+class ProfileRing
+{
+public:
+    // false when the consumer has fallen a whole ring behind; the event is dropped
+    bool push(const ProfileEvent& event)
+    {
+        std::uint32_t writeIndex = head.load(std::memory_order_relaxed);
+        if (writeIndex - tail.load(std::memory_order_acquire) == PROFILE_RING_CAPACITY)
+            return false;
+        events[writeIndex % PROFILE_RING_CAPACITY] = event;
+        head.store(writeIndex + 1, std::memory_order_release);
+        return true;
+    }
+
+    template <typename Function>
+    void drain(Function function)
+    {
+        std::uint32_t readIndex = tail.load(std::memory_order_relaxed);
+        std::uint32_t end = head.load(std::memory_order_acquire);
+        for (; readIndex != end; readIndex++)
+            function(events[readIndex % PROFILE_RING_CAPACITY]);
+        tail.store(end, std::memory_order_release);
+    }
+
+private:
+    ProfileEvent events[PROFILE_RING_CAPACITY];
+    std::atomic<std::uint32_t> head{ 0 };
+    std::atomic<std::uint32_t> tail{ 0 };
+};
+
+class Profiler
+{
+public:
+    struct Stats
+    {
+        unsigned long long cpuEvents = 0;
+        unsigned long long gpuEvents = 0;
+        unsigned long long droppedEvents = 0;   // full rings, GPU scope overflow or results not ready
+        unsigned int threads = 0;
+        unsigned int frames = 0;
+    };
+
+    Profiler();
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    // nanoseconds since the profiler started
+    std::uint64_t now() const;
+
+    // records a finished CPU scope on the calling thread's ring
+    void record(const char* name, std::uint64_t start, std::uint64_t end);
+    // names the calling thread in the trace
+    void setThreadName(const char* name);
+
+    // GL thread only; returns the query slot, or -1 if the scope is not timed
+    int beginGpuScope(const char* name);
+    void endGpuScope(int slot);
+
+    // GL thread, once per frame: drains the thread rings, reads back the GPU scopes of two
+    // frames ago and starts a new frame
+    void beginFrame();
+
+    // writes the history (oldest events first) as Chrome trace JSON
+    bool writeChromeTrace(const std::string& path);
+
+    const Stats& getStats() const { return stats; }
+    // deletes the GPU queries; needs the GL context
+    void release();
+
+private:
+    struct ThreadRecord
+    {
+        ProfileRing ring;
+        std::string name;
+        unsigned int id;
+    };
+
+    struct TraceEvent
+    {
+        const char* name;
+        std::uint64_t start;
+        std::uint64_t duration;
+        unsigned int thread;    // GPU_THREAD for GPU scopes
+    };
+
+    struct GpuFrame
+    {
+        unsigned int queries[PROFILE_GPU_SCOPES] = {};
+        const char* names[PROFILE_GPU_SCOPES] = {};
+        std::uint64_t submitted[PROFILE_GPU_SCOPES] = {};
+        unsigned int count = 0;
+    };
+
+    static const unsigned int GPU_THREAD = 0xffffffffu;
+
+    ThreadRecord& threadRecord();
+    void addToHistory(const TraceEvent& event);
+    void resolveGpuFrame(GpuFrame& frame);
+
+    std::chrono::steady_clock::time_point origin;
+    std::mutex threadsMutex;        // taken when a thread first records and by beginFrame, never per event
+    std::vector<std::unique_ptr<ThreadRecord>> threads;
+    std::atomic<unsigned long long> ringDrops{ 0 };
+    std::vector<TraceEvent> history;    // rolling, oldest at historyNext once full
+    std::size_t historyNext = 0;
+    GpuFrame gpuFrames[2];
+    unsigned int gpuFrame = 0;
+    bool gpuScopeOpen = false;
+    std::uint64_t gpuCursor = 0;        // end of the last GPU event laid out in the trace
+    Stats stats;
+};
+
+// the process-wide profiler the macros record into
+inline Profiler& profiler()
+{
+    static Profiler instance;
+    return instance;
+}
+
+class ProfileScope
+{
+public:
+    explicit ProfileScope(const char* name) : name(name), start(profiler().now()) {}
+    ~ProfileScope() { profiler().record(name, start, profiler().now()); }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    const char* name;
+    std::uint64_t start;
+};
+
+class GpuProfileScope
+{
+public:
+    explicit GpuProfileScope(const char* name) : slot(profiler().beginGpuScope(name)) {}
+    ~GpuProfileScope() { profiler().endGpuScope(slot); }
+
+    GpuProfileScope(const GpuProfileScope&) = delete;
+    GpuProfileScope& operator=(const GpuProfileScope&) = delete;
+
+private:
+    int slot;
+};
+
+#ifdef SA_PROFILER
+#define SA_PROFILE_JOIN2(a, b) a##b
+#define SA_PROFILE_JOIN(a, b) SA_PROFILE_JOIN2(a, b)
+#define PROFILE_SCOPE(name) ProfileScope SA_PROFILE_JOIN(profileScope, __LINE__)(name)
+#define PROFILE_GPU_SCOPE(name) GpuProfileScope SA_PROFILE_JOIN(gpuProfileScope, __LINE__)(name)
+#define PROFILE_THREAD(name) profiler().setThreadName(name)
+#define PROFILE_FRAME() profiler().beginFrame()
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_GPU_SCOPE(name) ((void)0)
+#define PROFILE_THREAD(name) ((void)0)
+#define PROFILE_FRAME() ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef RENDER_COUNTERS_H
+#define RENDER_COUNTERS_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+
+// GL work per frame and resident GPU memory, counted where the calls are made (Shader,
+// GpuMesh, Cylinder, InstancedRenderer, Mesh::Draw, the lighting buffers) and shown by
+// PerformanceHud. Plain increments on the GL thread, so they cost nothing worth measuring
+// whether or not anything reads them.
+struct RenderCounters
+{
+    // per frame, cleared by beginFrame()
+    unsigned int drawCalls = 0;
+    unsigned long long triangles = 0;
+    unsigned int stateChanges = 0;      // program, vertex array and texture binds
+    unsigned int uniformUploads = 0;    // glUniform* calls and uniform buffer updates
+    unsigned int meshletsDrawn = 0;     // by MeshletCuller, see meshlet.h
+    unsigned int meshletsCulled = 0;
+    // resident, carried across frames
+    long long textureBytes = 0;
+    long long bufferBytes = 0;
+
+    void beginFrame()
+    {
+        drawCalls = 0;
+        triangles = 0;
+        stateChanges = 0;
+        uniformUploads = 0;
+        meshletsDrawn = 0;
+        meshletsCulled = 0;
+    }
+};
+
+inline RenderCounters& renderCounters()
+{
+    static RenderCounters counters;
+    return counters;
+}
+
+// counts one draw of `count` indices/vertices in `mode`, `instances` times
+inline void countDraw(GLenum mode, unsigned int count, unsigned int instances = 1)
+{
+    RenderCounters& counters = renderCounters();
+    ++counters.drawCalls;
+    if (mode == GL_TRIANGLES)
+        counters.triangles += (unsigned long long)(count / 3) * instances;
+    else if ((mode == GL_TRIANGLE_STRIP || mode == GL_TRIANGLE_FAN) && count >= 3)
+        counters.triangles += (unsigned long long)(count - 2) * instances;
+}
+
+inline void countStateChanges(unsigned int changes = 1)
+{
+    renderCounters().stateChanges += changes;
+}
+
+inline void countUniformUpload()
+{
+    ++renderCounters().uniformUploads;
+}
+
+inline void countMeshlets(unsigned int drawn, unsigned int culled)
+{
+    RenderCounters& counters = renderCounters();
+    counters.meshletsDrawn += drawn;
+    counters.meshletsCulled += culled;
+}
+
+// keeps a buffer store in the resident total: pass the owner's running `tracked` size and
+// the new size whenever the store is (re)allocated, and 0 when it is deleted
+inline void trackBufferBytes(std::size_t& tracked, std::size_t bytes)
+{
+    renderCounters().bufferBytes += (long long)bytes - (long long)tracked;
+    tracked = bytes;
+}
+
+inline void trackTextureBytes(long long bytes)
+{
+    renderCounters().textureBytes += bytes;
+}
+
+// size of an 8-bit texture with `components` channels; a full mip chain adds a third
+inline long long textureBytes(int width, int height, int components, bool mipmaps)
+{
+    long long bytes = (long long)width * height * components;
+    return mipmaps ? bytes + bytes / 3 : bytes;
+}
+
+#endif
@@ -0,0 +1,136 @@
+#include "run_options.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+    void printUsage(const char* program)
+    {
+        std::cout << "usage: " << program << " [--headless] [--frames N] [--warmup N] [--width W] [--height H]"
+            << " [--output DIR] [--format png|raw] [--quiet] [--record FILE | --play FILE] [--frame-log FILE] [--trace FILE]"
+            << " [--pacing vsync|uncapped|FPS] [--uncompressed-textures]" << std::endl;
+    }
+
+    bool parsePositive(const char* text, long maximum, long& value)
+    {
+        char* end = nullptr;
+        value = std::strtol(text, &end, 10);
+        return end != text && *end == '\0' && value > 0 && value <= maximum;
+    }
+}
+
+bool parseRunOptions(int argc, char** argv, RunOptions& options)
+{
+    bool formatGiven = false;
+    for (int i = 1; i < argc; i++)
+    {
+        const char* argument = argv[i];
+        // every option but the switches takes the next argument as its value
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        long number = 0;
+        if (std::strcmp(argument, "--headless") == 0)
+            options.headless = true;
+        else if (std::strcmp(argument, "--quiet") == 0)
+            options.printFrames = false;
+        else if (std::strcmp(argument, "--uncompressed-textures") == 0)
+            options.compressTextures = false;
+        else if (!value)
+        {
+            std::cout << "ERROR::OPTIONS::MISSING_VALUE: " << argument << std::endl;
+            printUsage(argv[0]);
+            return false;
+        }
+        else if (std::strcmp(argument, "--frames") == 0 && parsePositive(value, 10000000, number))
+        {
+            options.frames = (unsigned int)number;
+            i++;
+        }
+        else if (std::strcmp(argument, "--warmup") == 0 && (std::strcmp(value, "0") == 0 || parsePositive(value, 10000, number)))
+        {
+            options.warmupFrames = (unsigned int)number;
+            i++;
+        }
+        else if (std::strcmp(argument, "--width") == 0 && parsePositive(value, 16384, number))
+        {
+            options.width = (int)number;
+            i++;
+        }
+        else if (std::strcmp(argument, "--height") == 0 && parsePositive(value, 16384, number))
+        {
+            options.height = (int)number;
+            i++;
+        }
+        else if (std::strcmp(argument, "--output") == 0)
+        {
+            options.outputDirectory = value;
+            i++;
+        }
+        else if (std::strcmp(argument, "--record") == 0)
+        {
+            options.recordPath = value;
+            i++;
+        }
+        else if (std::strcmp(argument, "--play") == 0)
+        {
+            options.playPath = value;
+            i++;
+        }
+        else if (std::strcmp(argument, "--frame-log") == 0)
+        {
+            options.frameLogPath = value;
+            i++;
+        }
+        else if (std::strcmp(argument, "--trace") == 0)
+        {
+            options.tracePath = value;
+            i++;
+        }
+        else if (std::strcmp(argument, "--pacing") == 0 && (std::strcmp(value, "vsync") == 0 || std::strcmp(value, "uncapped") == 0))
+        {
+            options.pacing = std::strcmp(value, "vsync") == 0 ? PACING_VSYNC : PACING_UNCAPPED;
+            i++;
+        }
+        else if (std::strcmp(argument, "--pacing") == 0 && parsePositive(value, 1000, number))
+        {
+            options.pacing = PACING_TARGET_FPS;
+            options.targetFps = (double)number;
+            i++;
+        }
+        else if (std::strcmp(argument, "--format") == 0 && (std::strcmp(value, "png") == 0 || std::strcmp(value, "raw") == 0))
+        {
+            options.format = std::strcmp(value, "png") == 0 ? FRAME_PNG : FRAME_RAW;
+            formatGiven = true;
+            i++;
+        }
+        else
+        {
+            std::cout << "ERROR::OPTIONS::INVALID: " << argument << " " << value << std::endl;
+            printUsage(argv[0]);
+            return false;
+        }
+    }
+
+    if (!options.recordPath.empty() && !options.playPath.empty())
+    {
+        std::cout << "ERROR::OPTIONS::INVALID: --record and --play cannot be combined" << std::endl;
+        printUsage(argv[0]);
+        return false;
+    }
+    if (options.outputDirectory.empty())
+        options.format = FRAME_NONE;
+    else if (!formatGiven)
+        options.format = FRAME_PNG;
+    if (!options.headless && !options.outputDirectory.empty())
+        std::cout << "--output only applies to --headless runs" << std::endl;
+    return true;
+}
+
+std::string frameFileName(const RunOptions& options, unsigned int frame)
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "frame_%05u.%s", frame, options.format == FRAME_RAW ? "rgba" : "png");
+    return options.outputDirectory + "/" + name;
+}
@@ -0,0 +1,60 @@
+#ifndef RUN_OPTIONS_H
+#define RUN_OPTIONS_H
+
+#include <string>
+
+#include "frame_scheduler.h"
+
+enum FrameFormat
+{
+    FRAME_NONE,     // frames are rendered but not written
+    FRAME_PNG,
+    FRAME_RAW       // width * height * 4 bytes of RGBA per file
+};
+
+// frames a headless run measures when neither --frames nor --play sets the length
+const unsigned int DEFAULT_HEADLESS_FRAMES = 300;
+
+// Command line of the app. With no arguments it opens the usual interactive window.
+//   --headless         render without a window through EGL into an offscreen framebuffer
+//   --frames N         number of frames a headless run measures (default 300, or the
+//                      whole path with --play)
+//   --warmup N         frames rendered first and left out of the timings and output (default 2)
+//   --width W          offscreen framebuffer size (default 900 x 900)
+//   --height H
+//   --output DIR       write every frame into DIR as frame_00000.png / .rgba
+//   --format png|raw   format of the written frames (default png)
+//   --quiet            only print the timing summary, not every frame
+//   --record FILE      record the camera at a fixed tick into FILE (see CameraPath)
+//   --play FILE        drive the camera from a recorded path, one tick per frame
+//   --frame-log FILE   write the CPU/GPU time of every frame to FILE as CSV
+//   --trace FILE       write the profiler history as Chrome trace JSON on exit (see profiler.h)
+//   --pacing MODE      windowed frame pacing: vsync (default), uncapped, or a target frame
+//                      rate such as 144 (see FrameScheduler)
+//   --uncompressed-textures  load textures as RGB(A) instead of cooked DXT (see texture_cooker.h)
+struct RunOptions
+{
+    bool headless = false;
+    unsigned int frames = 0;        // 0 picks the default above
+    unsigned int warmupFrames = 2;
+    int width = 900;
+    int height = 900;
+    std::string outputDirectory;
+    FrameFormat format = FRAME_NONE;
+    bool printFrames = true;
+    std::string recordPath;
+    std::string playPath;
+    std::string frameLogPath;
+    std::string tracePath;
+    FramePacing pacing = PACING_VSYNC;
+    double targetFps = 60.0;
+    bool compressTextures = true;
+};
+
+// fills `options` from the command line; prints the usage and returns false on bad input
+bool parseRunOptions(int argc, char** argv, RunOptions& options);
+
+// file a headless run writes frame `frame` to
+std::string frameFileName(const RunOptions& options, unsigned int frame);
+
+#endif
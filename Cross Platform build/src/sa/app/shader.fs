@@ -9,6 +9,8 @@ struct Material {
     float shininess;
 }; 
 
+// the light structs are laid out for std140 and mirrored by lighting_block.h:
+// every vec3 is followed by a float or padding, so keep the member order in sync.
 struct DirLight {
     vec3 direction;
 	
@@ -19,46 +21,62 @@ struct DirLight {
 
 struct PointLight {
     vec3 position;
-    
     float constant;
-    float linear;
-    float quadratic;
-	
     vec3 ambient;
+    float linear;
     vec3 diffuse;
+    float quadratic;
     vec3 specular;
 };
 
 struct SpotLight {
     vec3 position;
-    vec3 direction;
-    float cutOff;
-    float outerCutOff;
-  
     float constant;
+    vec3 direction;
     float linear;
-    float quadratic;
-  
     vec3 ambient;
+    float quadratic;
     vec3 diffuse;
-    vec3 specular;       
+    float cutOff;
+    vec3 specular;
+    float outerCutOff;
 };
 
-#define NR_POINT_LIGHTS 4
-
 in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoords;
+in float ViewDepth;
+in vec4 Tint;
+flat in float Layer;
+
+// shared by every program through the LIGHTING_BINDING uniform buffer
+layout (std140) uniform Lighting
+{
+    DirLight dirLight;
+    SpotLight spotLight;
+    uvec4 clusterDims;      // cells in x, y, z and the number of point lights
+    vec4 clusterDepth;      // slice scale, slice bias, viewport width, viewport height
+};
+
+// clustered point lights (see cluster_lighting.h)
+uniform samplerBuffer lightData;        // 4 texels per light: position/radius, ambient/constant, diffuse/linear, specular/quadratic
+uniform usamplerBuffer clusterGrid;     // (first index, light count) per cluster
+uniform usamplerBuffer clusterLights;   // light indices, grouped by cluster
 
 uniform vec3 viewPos;
-uniform DirLight dirLight;
-uniform PointLight pointLights[NR_POINT_LIGHTS];
-uniform SpotLight spotLight;
 uniform Material material;
+// instanced draws may pick their diffuse map from this array by layer
+uniform sampler2DArray layerTextures;
+
+// surface colors, sampled once per fragment and shared by every light
+vec3 diffuseColor;
+vec3 specularColor;
 
 // function prototypes
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+vec3 CalcPointLight(PointLight light, float radius, vec3 normal, vec3 fragPos, vec3 viewDir);
+PointLight FetchPointLight(int index, out float radius);
+int ClusterIndex();
 vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
 
 void main()
@@ -66,6 +84,12 @@ void main()
     // properties
     vec3 norm = normalize(Normal);
     vec3 viewDir = normalize(viewPos - FragPos);
+    if (Layer >= 0.0)
+        diffuseColor = texture(layerTextures, vec3(TexCoords, Layer)).rgb;
+    else
+        diffuseColor = texture(material.diffuse, TexCoords).rgb;
+    diffuseColor *= Tint.rgb;
+    specularColor = texture(material.specular, TexCoords).rgb;
     
     // == =====================================================
     // Our lighting is set up in 3 phases: directional, point lights and an optional flashlight
@@ -75,13 +99,18 @@ void main()
     // == =====================================================
     // phase 1: directional lighting
     vec3 result = CalcDirLight(dirLight, norm, viewDir);
-    // phase 2: point lights
-    for(int i = 0; i < NR_POINT_LIGHTS; i++)
-        result += CalcPointLight(pointLights[i], norm, FragPos, viewDir);    
+    // phase 2: point lights, only those binned into this fragment's cluster
+    uvec2 cluster = texelFetch(clusterGrid, ClusterIndex()).xy;
+    for(uint i = 0u; i < cluster.y; i++)
+    {
+        float radius;
+        PointLight light = FetchPointLight(int(texelFetch(clusterLights, int(cluster.x + i)).x), radius);
+        result += CalcPointLight(light, radius, norm, FragPos, viewDir);
+    }
     // phase 3: spot light
     result += CalcSpotLight(spotLight, norm, FragPos, viewDir);    
     
-    FragColor = vec4(result, 1.0);
+    FragColor = vec4(result, Tint.a);
 }
 
 // calculates the color when using a directional light.
@@ -94,14 +123,42 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
     vec3 reflectDir = reflect(-lightDir, normal);
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
+    vec3 ambient = light.ambient * diffuseColor;
+    vec3 diffuse = light.diffuse * diff * diffuseColor;
+    vec3 specular = light.specular * spec * specularColor;
     return (ambient + diffuse + specular);
 }
 
+// finds the cluster this fragment falls in: screen tile in x/y, log depth slice in z
+int ClusterIndex()
+{
+    int slice = int(max(log(ViewDepth) * clusterDepth.x - clusterDepth.y, 0.0));
+    slice = min(slice, int(clusterDims.z) - 1);
+    ivec2 tile = ivec2(gl_FragCoord.xy / clusterDepth.zw * vec2(clusterDims.xy));
+    tile = clamp(tile, ivec2(0), ivec2(clusterDims.xy) - 1);
+    return tile.x + int(clusterDims.x) * (tile.y + int(clusterDims.y) * slice);
+}
+
+PointLight FetchPointLight(int index, out float radius)
+{
+    vec4 positionRadius = texelFetch(lightData, index * 4);
+    vec4 ambientConstant = texelFetch(lightData, index * 4 + 1);
+    vec4 diffuseLinear = texelFetch(lightData, index * 4 + 2);
+    vec4 specularQuadratic = texelFetch(lightData, index * 4 + 3);
+    PointLight light;
+    light.position = positionRadius.xyz;
+    light.ambient = ambientConstant.rgb;
+    light.constant = ambientConstant.a;
+    light.diffuse = diffuseLinear.rgb;
+    light.linear = diffuseLinear.a;
+    light.specular = specularQuadratic.rgb;
+    light.quadratic = specularQuadratic.a;
+    radius = positionRadius.w;
+    return light;
+}
+
 // calculates the color when using a point light.
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
+vec3 CalcPointLight(PointLight light, float radius, vec3 normal, vec3 fragPos, vec3 viewDir)
 {
     vec3 lightDir = normalize(light.position - fragPos);
     // diffuse shading
@@ -112,10 +169,13 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     // attenuation
     float distance = length(light.position - fragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));    
+    // fade to zero at the cluster radius so lights don't pop at cell borders
+    float window = clamp(1.0 - pow(distance / radius, 4.0), 0.0, 1.0);
+    attenuation *= window * window;
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
+    vec3 ambient = light.ambient * diffuseColor;
+    vec3 diffuse = light.diffuse * diff * diffuseColor;
+    vec3 specular = light.specular * spec * specularColor;
     ambient *= attenuation;
     diffuse *= attenuation;
     specular *= attenuation;
@@ -139,9 +199,9 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     float epsilon = light.cutOff - light.outerCutOff;
     float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
+    vec3 ambient = light.ambient * diffuseColor;
+    vec3 diffuse = light.diffuse * diff * diffuseColor;
+    vec3 specular = light.specular * spec * specularColor;
     ambient *= attenuation * intensity;
     diffuse *= attenuation * intensity;
     specular *= attenuation * intensity;
@@ -4,10 +4,80 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include "render_counters.h"
+
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
+
+// counts how much work pre-resolved UniformHandles saved compared to name lookups; only
+// SA_PROFILER builds count (see profiler.h), so Release sets stay a bare glUniform* call
+struct UniformStats
+{
+    unsigned long long stringLookups = 0;       // set*() calls resolved through a name
+    unsigned long long lookupsAvoided = 0;      // handle sets that needed no name lookup
+    // std::string names handle sets did not build: a set*() call builds one from its literal
+    // on every call, with a heap allocation once the name outgrows the small-string buffer
+    unsigned long long allocationsAvoided = 0;
+};
+
+inline UniformStats& uniformStats()
+{
+    static UniformStats stats;
+    return stats;
+}
+
+inline void countUniformLookup(bool avoided)
+{
+#ifdef SA_PROFILER
+    UniformStats& stats = uniformStats();
+    if (avoided)
+    {
+        ++stats.lookupsAvoided;
+        ++stats.allocationsAvoided;
+    }
+    else
+        ++stats.stringLookups;
+#else
+    (void)avoided;
+#endif
+}
+
+inline void uploadUniform(int location, bool value) { glUniform1i(location, (int)value); }
+inline void uploadUniform(int location, int value) { glUniform1i(location, value); }
+inline void uploadUniform(int location, float value) { glUniform1f(location, value); }
+inline void uploadUniform(int location, const glm::vec2& value) { glUniform2fv(location, 1, &value[0]); }
+inline void uploadUniform(int location, const glm::vec3& value) { glUniform3fv(location, 1, &value[0]); }
+inline void uploadUniform(int location, const glm::vec4& value) { glUniform4fv(location, 1, &value[0]); }
+inline void uploadUniform(int location, const glm::mat2& mat) { glUniformMatrix2fv(location, 1, GL_FALSE, &mat[0][0]); }
+inline void uploadUniform(int location, const glm::mat3& mat) { glUniformMatrix3fv(location, 1, GL_FALSE, &mat[0][0]); }
+inline void uploadUniform(int location, const glm::mat4& mat) { glUniformMatrix4fv(location, 1, GL_FALSE, &mat[0][0]); }
+
+// A uniform location resolved once from Shader::uniform<T>(). Setting it goes straight to
+// glUniform*, so hot loops never build or hash a name. Like the set*() functions it writes
+// to the currently bound program. An unknown name gives a handle whose sets are no-ops.
+template <typename T>
+class UniformHandle
+{
+public:
+    UniformHandle() {}
+    explicit UniformHandle(int location) : location(location) {}
+
+    void set(const T& value) const
+    {
+        uploadUniform(location, value);
+        countUniformUpload();
+        countUniformLookup(true);
+    }
+
+    bool isValid() const { return location >= 0; }
+    int getLocation() const { return location; }
+
+private:
+    int location = -1;
+};
 
 class Shader
 {
@@ -20,34 +90,47 @@ public:
         // 1. retrieve the vertex/fragment source code from filePath
         std::string vertexCode;
         std::string fragmentCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
+        readFile(vertexPath, vertexCode);
+        readFile(fragmentPath, fragmentCode);
+        // 2. compile and link
+        ID = compileProgram(vertexCode, fragmentCode);
+        reflectUniforms();
+    }
+    // wraps a program that has already been linked (see ShaderCache)
+    // ------------------------------------------------------------------------
+    explicit Shader(unsigned int programID) : ID(programID)
+    {
+        reflectUniforms();
+    }
+    // reads a whole shader source file, returns false if it could not be read
+    // ------------------------------------------------------------------------
+    static bool readFile(const char* path, std::string& code)
+    {
+        std::ifstream shaderFile;
         // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+        shaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
         try
         {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();
+            shaderFile.open(path);
+            std::stringstream shaderStream;
+            shaderStream << shaderFile.rdbuf();
+            shaderFile.close();
+            code = shaderStream.str();
         }
         catch (std::ifstream::failure& e)
         {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << e.what() << std::endl;
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << path << " " << e.what() << std::endl;
+            return false;
         }
+        return true;
+    }
+    // compiles and links a vertex/fragment pair. retrievableBinary asks the driver to keep
+    // the linked binary around so it can be fetched with glGetProgramBinary afterwards.
+    // ------------------------------------------------------------------------
+    static unsigned int compileProgram(const std::string& vertexCode, const std::string& fragmentCode, bool retrievableBinary = false)
+    {
         const char* vShaderCode = vertexCode.c_str();
         const char* fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
         unsigned int vertex, fragment;
         // vertex shader
         vertex = glCreateShader(GL_VERTEX_SHADER);
@@ -60,85 +143,166 @@ public:
         glCompileShader(fragment);
         checkCompileErrors(fragment, "FRAGMENT");
         // shader Program
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
+        unsigned int program = glCreateProgram();
+        glAttachShader(program, vertex);
+        glAttachShader(program, fragment);
+        if (retrievableBinary)
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(program);
+        checkCompileErrors(program, "PROGRAM");
         // delete the shaders as they're linked into our program now and no longer necessery
         glDeleteShader(vertex);
         glDeleteShader(fragment);
-
+        return program;
     }
     // activate the shader
     // ------------------------------------------------------------------------
     void use() const
     {
         glUseProgram(ID);
+        countStateChanges();
+    }
+    // location of an active uniform, -1 if the program has no uniform by that name
+    // ------------------------------------------------------------------------
+    int getUniformLocation(const std::string& name) const
+    {
+        countUniformLookup(false);
+        auto it = uniformLocations.find(name);
+        return it != uniformLocations.end() ? it->second : -1;
+    }
+    // resolves a typed handle once so it can be set every frame without a name lookup
+    // ------------------------------------------------------------------------
+    template <typename T>
+    UniformHandle<T> uniform(const std::string& name) const
+    {
+        auto it = uniformLocations.find(name);
+        int location = it != uniformLocations.end() ? it->second : -1;
+        return UniformHandle<T>(location);
+    }
+    // points the named uniform block at a buffer binding point, false if the program has no such block
+    // ------------------------------------------------------------------------
+    bool bindUniformBlock(const char* blockName, unsigned int binding) const
+    {
+        GLuint blockIndex = glGetUniformBlockIndex(ID, blockName);
+        if (blockIndex == GL_INVALID_INDEX)
+            return false;
+        glUniformBlockBinding(ID, blockIndex, binding);
+        return true;
     }
     // utility uniform functions
     // ------------------------------------------------------------------------
     void setBool(const std::string& name, bool value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+        glUniform1i(getUniformLocation(name), (int)value);
+        countUniformUpload();
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string& name, int value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        glUniform1i(getUniformLocation(name), value);
+        countUniformUpload();
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string& name, float value) const
     {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        glUniform1f(getUniformLocation(name), value);
+        countUniformUpload();
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string& name, const glm::vec2& value) const
     {
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform2fv(getUniformLocation(name), 1, &value[0]);
+        countUniformUpload();
     }
     void setVec2(const std::string& name, float x, float y) const
     {
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+        glUniform2f(getUniformLocation(name), x, y);
+        countUniformUpload();
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string& name, const glm::vec3& value) const
     {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform3fv(getUniformLocation(name), 1, &value[0]);
+        countUniformUpload();
     }
     void setVec3(const std::string& name, float x, float y, float z) const
     {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+        glUniform3f(getUniformLocation(name), x, y, z);
+        countUniformUpload();
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string& name, const glm::vec4& value) const
     {
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform4fv(getUniformLocation(name), 1, &value[0]);
+        countUniformUpload();
     }
     void setVec4(const std::string& name, float x, float y, float z, float w) const
     {
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+        glUniform4f(getUniformLocation(name), x, y, z, w);
+        countUniformUpload();
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string& name, const glm::mat2& mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(getUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
+        countUniformUpload();
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string& name, const glm::mat3& mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(getUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
+        countUniformUpload();
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string& name, const glm::mat4& mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(getUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
+        countUniformUpload();
     }
 
 private:
+    std::unordered_map<std::string, int> uniformLocations;
+
+    // queries every active uniform once after linking. Arrays are stored both by their
+    // base name and element by element ("lights[2]") so either spelling resolves.
+    // ------------------------------------------------------------------------
+    void reflectUniforms()
+    {
+        uniformLocations.clear();
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::string name(maxLength > 0 ? maxLength : 1, '\0');
+        for (GLint i = 0; i < count; i++)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(ID, (GLuint)i, (GLsizei)name.size(), &length, &size, &type, &name[0]);
+            std::string uniformName = name.substr(0, length);
+            GLint location = glGetUniformLocation(ID, uniformName.c_str());
+            if (location < 0)
+                continue;   // lives in a uniform block
+            uniformLocations[uniformName] = location;
+
+            // "values[0]" -> also register "values" and "values[1]".."values[size-1]"
+            std::string::size_type bracket = uniformName.rfind("[0]");
+            if (bracket != std::string::npos && bracket + 3 == uniformName.size())
+            {
+                std::string base = uniformName.substr(0, bracket);
+                uniformLocations[base] = location;
+                for (GLint element = 1; element < size; element++)
+                {
+                    std::string elementName = base + "[" + std::to_string(element) + "]";
+                    uniformLocations[elementName] = glGetUniformLocation(ID, elementName.c_str());
+                }
+            }
+        }
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
-    void checkCompileErrors(GLuint shader, std::string type)
+    static void checkCompileErrors(GLuint shader, std::string type)
     {
         GLint success;
         GLchar infoLog[1024];
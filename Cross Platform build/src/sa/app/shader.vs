@@ -5,20 +5,34 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+// per-instance attributes (see instanced_renderer.h); plain draws set them as constant
+// vertex attributes instead of a model uniform
+layout (location = 3) in mat4 aModel;       // occupies locations 3-6
+layout (location = 7) in vec4 aTint;
+layout (location = 8) in float aLayer;      // texture array layer, negative for the material maps
 
 out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoords;
+out float ViewDepth;    // distance in front of the camera, selects the light cluster slice
+out vec4 Tint;
+flat out float Layer;
 
-uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;  
+    FragPos = vec3(aModel * vec4(aPos, 1.0));
+    // cofactor matrix: the inverse transpose up to scale, without a per-vertex inverse()
+    mat3 m = mat3(aModel);
+    mat3 cofactor = mat3(cross(m[1], m[2]), cross(m[2], m[0]), cross(m[0], m[1]));
+    Normal = cofactor * aNormal * sign(dot(m[0], cofactor[0]));
     TexCoords = aTexCoords;
+    Tint = aTint;
+    Layer = aLayer;
     
-    gl_Position = projection * view * vec4(FragPos, 1.0);
+    vec4 viewPos = view * vec4(FragPos, 1.0);
+    ViewDepth = -viewPos.z;
+    gl_Position = projection * viewPos;
 }
\ No newline at end of file
@@ -0,0 +1,180 @@
+#include "shader_cache.h"
+#include "content_hash.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+    const char BINARY_MAGIC[4] = { 'S', 'A', 'P', 'B' };
+    const std::uint32_t BINARY_VERSION = 1;
+
+    // fixed header in front of every cached program binary
+    struct BinaryHeader
+    {
+        char magic[4];
+        std::uint32_t version;
+        std::uint32_t format;           // value handed back by glGetProgramBinary
+        std::uint32_t length;           // # of bytes following the header
+        std::uint64_t hash;             // source + driver hash the binary was built from
+    };
+
+    void deleteProgram(Shader* shader)
+    {
+        glDeleteProgram(shader->ID);
+        delete shader;
+    }
+
+    bool isLinked(unsigned int program)
+    {
+        GLint success = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        return success == GL_TRUE;
+    }
+}
+
+ShaderCache::ShaderCache(const std::string& binaryDirectory) : binaryDirectory(binaryDirectory)
+{
+}
+
+std::shared_ptr<Shader> ShaderCache::load(const char* vertexPath, const char* fragmentPath)
+{
+    std::string vertexCode;
+    std::string fragmentCode;
+    if (!Shader::readFile(vertexPath, vertexCode) || !Shader::readFile(fragmentPath, fragmentCode))
+        return nullptr;
+
+    std::uint64_t hash = hashString(vertexCode);
+    hash = hashString(fragmentCode, hash);
+    std::string key = std::string(vertexPath) + '\n' + fragmentPath + '\n' + hashToHex(hash);
+
+    auto it = programs.find(key);
+    if (it != programs.end())
+    {
+        ++stats.memoryHits;
+        return it->second;
+    }
+
+    bool persist = binariesSupported();
+    if (persist)
+        hash ^= driverHash;
+
+    unsigned int program = persist ? loadBinary(hash) : 0;
+    if (program != 0)
+    {
+        ++stats.binaryHits;
+    }
+    else
+    {
+        program = Shader::compileProgram(vertexCode, fragmentCode, persist);
+        if (!isLinked(program))
+        {
+            glDeleteProgram(program);
+            return nullptr;
+        }
+        ++stats.compiled;
+        if (persist)
+            saveBinary(hash, program);
+    }
+
+    std::shared_ptr<Shader> shader(new Shader(program), deleteProgram);
+    programs[key] = shader;
+    return shader;
+}
+
+void ShaderCache::clear()
+{
+    programs.clear();
+}
+
+bool ShaderCache::binariesSupported()
+{
+    if (binarySupport < 0)
+    {
+        GLint formats = 0;
+        if (!binaryDirectory.empty() && GLAD_GL_VERSION_4_1)
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        binarySupport = formats > 0 ? 1 : 0;
+
+        if (binarySupport)
+        {
+            const char* vendor = (const char*)glGetString(GL_VENDOR);
+            const char* renderer = (const char*)glGetString(GL_RENDERER);
+            const char* version = (const char*)glGetString(GL_VERSION);
+            driverHash = hashString(vendor ? vendor : "");
+            driverHash = hashString(renderer ? renderer : "", driverHash);
+            driverHash = hashString(version ? version : "", driverHash);
+
+            std::error_code error;
+            std::filesystem::create_directories(binaryDirectory, error);
+            if (error)
+            {
+                std::cout << "ERROR::SHADER_CACHE::CANNOT_CREATE_DIRECTORY: " << binaryDirectory << std::endl;
+                binarySupport = 0;
+            }
+        }
+    }
+    return binarySupport == 1;
+}
+
+std::string ShaderCache::binaryPath(std::uint64_t hash) const
+{
+    return binaryDirectory + "/" + hashToHex(hash) + ".bin";
+}
+
+unsigned int ShaderCache::loadBinary(std::uint64_t hash) const
+{
+    std::ifstream file(binaryPath(hash), std::ios::binary);
+    if (!file)
+        return 0;
+
+    BinaryHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC)) != 0 ||
+        header.version != BINARY_VERSION || header.hash != hash || header.length == 0)
+        return 0;
+
+    std::vector<char> binary(header.length);
+    if (!file.read(binary.data(), binary.size()))
+        return 0;
+
+    // the driver may still reject a binary (e.g. after an update); fall back to compiling
+    unsigned int program = glCreateProgram();
+    glProgramBinary(program, header.format, binary.data(), (GLsizei)binary.size());
+    if (!isLinked(program))
+    {
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+void ShaderCache::saveBinary(std::uint64_t hash, unsigned int program)
+{
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, NULL, &format, binary.data());
+
+    BinaryHeader header;
+    std::memcpy(header.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC));
+    header.version = BINARY_VERSION;
+    header.format = format;
+    header.length = (std::uint32_t)length;
+    header.hash = hash;
+
+    std::ofstream file(binaryPath(hash), std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(binary.data(), binary.size());
+    if (file)
+        ++stats.binaryWrites;
+    else
+        std::cout << "ERROR::SHADER_CACHE::CANNOT_WRITE_BINARY: " << binaryPath(hash) << std::endl;
+}
@@ -0,0 +1,56 @@
+#ifndef SHADER_CACHE_H
+#define SHADER_CACHE_H
+
+#include "shader.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+// Compile-once store of linked programs.
+// Programs are keyed by their source paths plus a hash of the source text, so asking
+// for the same pair again hands out the same shared Shader, and an edited file gets a
+// fresh program. When a binary directory is given and the driver supports program
+// binaries (GL 4.1+), linked programs are also written there with glGetProgramBinary
+// and later starts restore them with glProgramBinary without compiling any GLSL.
+// A program is deleted when the last handle to it (including the cache's) goes away.
+class ShaderCache
+{
+public:
+    struct Stats
+    {
+        unsigned int compiled = 0;      // programs built from GLSL source
+        unsigned int memoryHits = 0;    // load() calls answered from memory
+        unsigned int binaryHits = 0;    // programs restored from the binary directory
+        unsigned int binaryWrites = 0;  // binaries written to the binary directory
+    };
+
+    // an empty binaryDirectory disables the on-disk cache
+    explicit ShaderCache(const std::string& binaryDirectory = "");
+    ShaderCache(const ShaderCache&) = delete;
+    ShaderCache& operator=(const ShaderCache&) = delete;
+
+    // returns the linked program for this vertex/fragment pair, or nullptr if the
+    // sources could not be read or did not link
+    std::shared_ptr<Shader> load(const char* vertexPath, const char* fragmentPath);
+
+    // drops the cache's references; needs the GL context that created the programs
+    void clear();
+
+    const Stats& getStats() const { return stats; }
+
+private:
+    bool binariesSupported();
+    unsigned int loadBinary(std::uint64_t hash) const;
+    void saveBinary(std::uint64_t hash, unsigned int program);
+    std::string binaryPath(std::uint64_t hash) const;
+
+    std::string binaryDirectory;
+    int binarySupport = -1;             // -1 until queried from the driver
+    std::uint64_t driverHash = 0;       // binaries are only valid for the driver that made them
+    std::unordered_map<std::string, std::shared_ptr<Shader>> programs;
+    Stats stats;
+};
+
+#endif
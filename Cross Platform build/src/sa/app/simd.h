@@ -0,0 +1,55 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+// SA_SSE2 is defined when SSE2 intrinsics can be used unconditionally (every x86-64
+// target, or 32-bit x86 built with SSE2). Code using it must keep a scalar fallback.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SA_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#ifdef SA_SSE2
+// sine and cosine of 4 angles at once (Cephes polynomials, the same reduction as
+// sse_mathfun). Accurate to a couple of ulp for |x| up to a few thousand radians.
+inline void sinCosPs(__m128 x, __m128* sine, __m128* cosine)
+{
+    const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32((int)0x80000000));
+    __m128 signSin = _mm_and_ps(x, signMask);
+    x = _mm_andnot_ps(signMask, x);
+
+    // octant j = x * 4/pi rounded up to even, reduce x to [-pi/4, pi/4]
+    __m128i j = _mm_cvttps_epi32(_mm_mul_ps(x, _mm_set1_ps(1.27323954473516f)));
+    j = _mm_and_si128(_mm_add_epi32(j, _mm_set1_epi32(1)), _mm_set1_epi32(~1));
+    __m128 y = _mm_cvtepi32_ps(j);
+
+    __m128 swapSin = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(j, _mm_set1_epi32(4)), 29));
+    __m128 signCos = _mm_castsi128_ps(_mm_slli_epi32(_mm_andnot_si128(_mm_sub_epi32(j, _mm_set1_epi32(2)), _mm_set1_epi32(4)), 29));
+    __m128 polyMask = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(j, _mm_set1_epi32(2)), _mm_setzero_si128()));
+    signSin = _mm_xor_ps(signSin, swapSin);
+
+    // extended precision subtraction of y * pi/4
+    x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(-0.78515625f)));
+    x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(-2.4187564849853515625e-4f)));
+    x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(-3.77489497744594108e-8f)));
+    __m128 z = _mm_mul_ps(x, x);
+
+    __m128 c = _mm_set1_ps(2.443315711809948e-5f);
+    c = _mm_add_ps(_mm_mul_ps(c, z), _mm_set1_ps(-1.388731625493765e-3f));
+    c = _mm_add_ps(_mm_mul_ps(c, z), _mm_set1_ps(4.166664568298827e-2f));
+    c = _mm_mul_ps(_mm_mul_ps(c, z), z);
+    c = _mm_add_ps(_mm_sub_ps(c, _mm_mul_ps(z, _mm_set1_ps(0.5f))), _mm_set1_ps(1.0f));
+
+    __m128 s = _mm_set1_ps(-1.9515295891e-4f);
+    s = _mm_add_ps(_mm_mul_ps(s, z), _mm_set1_ps(8.3321608736e-3f));
+    s = _mm_add_ps(_mm_mul_ps(s, z), _mm_set1_ps(-1.6666654611e-1f));
+    s = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(s, z), x), x);
+
+    // pick the polynomial per octant
+    __m128 sinValue = _mm_or_ps(_mm_and_ps(polyMask, s), _mm_andnot_ps(polyMask, c));
+    __m128 cosValue = _mm_or_ps(_mm_and_ps(polyMask, c), _mm_andnot_ps(polyMask, s));
+    *sine = _mm_xor_ps(sinValue, signSin);
+    *cosine = _mm_xor_ps(cosValue, signCos);
+}
+#endif
+
+#endif
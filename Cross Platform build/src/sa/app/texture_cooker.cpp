@@ -0,0 +1,233 @@
+#include "texture_cooker.h"
+
+#include <stb_image.h>
+#include <image_DXT.h>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <thread>
+
+#include "content_hash.h"
+#include "job_system.h"
+#include "profiler.h"
+
+namespace
+{
+    const unsigned int FOURCC_DXT1 = ('D' << 0) | ('X' << 8) | ('T' << 16) | ('1' << 24);
+    const unsigned int FOURCC_DXT5 = ('D' << 0) | ('X' << 8) | ('T' << 16) | ('5' << 24);
+    const unsigned int DDS_MAGIC = ('D' << 0) | ('D' << 8) | ('S' << 16) | (' ' << 24);
+
+    std::size_t blockBytes(unsigned int format)
+    {
+        return format == GL_COMPRESSED_RGBA_DXT5 ? 16 : 8;
+    }
+
+    std::size_t levelSize(unsigned int format, int width, int height)
+    {
+        return (std::size_t)((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+    }
+
+    // next mip level, each texel the average of a 2x2 footprint (clamped at odd edges)
+    void downsample(const unsigned char* source, int width, int height, int components, std::vector<unsigned char>& target)
+    {
+        const int targetWidth = std::max(1, width / 2);
+        const int targetHeight = std::max(1, height / 2);
+        target.resize((std::size_t)targetWidth * targetHeight * components);
+        for (int y = 0; y < targetHeight; y++)
+        {
+            const unsigned char* row0 = source + (std::size_t)std::min(2 * y, height - 1) * width * components;
+            const unsigned char* row1 = source + (std::size_t)std::min(2 * y + 1, height - 1) * width * components;
+            unsigned char* out = &target[(std::size_t)y * targetWidth * components];
+            for (int x = 0; x < targetWidth; x++)
+            {
+                const int x0 = std::min(2 * x, width - 1) * components;
+                const int x1 = std::min(2 * x + 1, width - 1) * components;
+                for (int c = 0; c < components; c++)
+                    *out++ = (unsigned char)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+            }
+        }
+    }
+
+    // block rows are independent, so each job encodes a band of them straight into its place
+    void compressLevel(const unsigned char* pixels, int width, int height, int components, unsigned int format,
+        int quality, unsigned char* out)
+    {
+        const unsigned int blockRows = (unsigned int)(height + 3) / 4;
+        const int dxt5 = format == GL_COMPRESSED_RGBA_DXT5;
+        jobSystem().parallelFor(blockRows, 0, [&](unsigned int first, unsigned int last)
+        {
+            convert_image_rows_to_DXT(pixels, width, height, components, dxt5, quality, (int)first,
+                (int)(last - first), out);
+        });
+    }
+
+    bool readFile(const std::string& path, std::vector<unsigned char>& bytes)
+    {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file)
+            return false;
+        const std::streamoff size = file.tellg();
+        if (size <= 0)
+            return false;
+        bytes.resize((std::size_t)size);
+        file.seekg(0);
+        return (bool)file.read(reinterpret_cast<char*>(bytes.data()), size);
+    }
+}
+
+bool cookImage(const unsigned char* pixels, int width, int height, int components, CookedTexture& cooked,
+    int quality)
+{
+    if (!pixels || width < 1 || height < 1 || components < 3 || components > 4)
+        return false;
+    PROFILE_SCOPE("cook texture");
+    cooked.format = components == 4 ? GL_COMPRESSED_RGBA_DXT5 : GL_COMPRESSED_RGB_DXT1;
+    cooked.levels.clear();
+
+    std::size_t total = 0;
+    for (int w = width, h = height;; w = std::max(1, w / 2), h = std::max(1, h / 2))
+    {
+        CookedLevel level;
+        level.width = w;
+        level.height = h;
+        level.offset = total;
+        level.size = levelSize(cooked.format, w, h);
+        total += level.size;
+        cooked.levels.push_back(level);
+        if (w == 1 && h == 1)
+            break;
+    }
+    cooked.data.assign(total, 0);
+
+    std::vector<unsigned char> current, next;
+    const unsigned char* source = pixels;
+    for (std::size_t i = 0; i < cooked.levels.size(); i++)
+    {
+        const CookedLevel& level = cooked.levels[i];
+        compressLevel(source, level.width, level.height, components, cooked.format, quality, &cooked.data[level.offset]);
+        if (i + 1 < cooked.levels.size())
+        {
+            downsample(source, level.width, level.height, components, next);
+            current.swap(next);
+            source = current.data();
+        }
+    }
+    return true;
+}
+
+bool saveDDS(const std::string& path, const CookedTexture& cooked)
+{
+    if (cooked.levels.empty())
+        return false;
+    DDS_header header;
+    std::memset(&header, 0, sizeof(header));
+    header.dwMagic = DDS_MAGIC;
+    header.dwSize = 124;
+    header.dwFlags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_LINEARSIZE | DDSD_MIPMAPCOUNT;
+    header.dwWidth = cooked.levels[0].width;
+    header.dwHeight = cooked.levels[0].height;
+    header.dwPitchOrLinearSize = (unsigned int)cooked.levels[0].size;
+    header.dwMipMapCount = (unsigned int)cooked.levels.size();
+    header.sPixelFormat.dwSize = 32;
+    header.sPixelFormat.dwFlags = DDPF_FOURCC;
+    header.sPixelFormat.dwFourCC = cooked.format == GL_COMPRESSED_RGBA_DXT5 ? FOURCC_DXT5 : FOURCC_DXT1;
+    header.sCaps.dwCaps1 = DDSCAPS_TEXTURE | (cooked.levels.size() > 1 ? DDSCAPS_MIPMAP | DDSCAPS_COMPLEX : 0);
+
+    // written aside and renamed into place, so a reader never sees half a file
+    const std::string temporary = path + "." + hashToHex(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(cooked.data.data()), cooked.data.size());
+        if (!file)
+        {
+            std::cout << "ERROR::TEXTURE_COOKER::CANNOT_WRITE: " << path << std::endl;
+            return false;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    if (error)
+    {
+        // another thread or process stored the same image first
+        std::filesystem::remove(temporary, error);
+    }
+    return true;
+}
+
+bool loadDDS(const std::string& path, CookedTexture& cooked)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+    DDS_header header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.dwMagic != DDS_MAGIC ||
+        header.dwSize != 124 || !(header.sPixelFormat.dwFlags & DDPF_FOURCC) ||
+        header.dwWidth < 1 || header.dwHeight < 1 || header.dwMipMapCount > 32)
+        return false;
+    if (header.sPixelFormat.dwFourCC == FOURCC_DXT1)
+        cooked.format = GL_COMPRESSED_RGB_DXT1;
+    else if (header.sPixelFormat.dwFourCC == FOURCC_DXT5)
+        cooked.format = GL_COMPRESSED_RGBA_DXT5;
+    else
+        return false;
+
+    cooked.levels.clear();
+    std::size_t total = 0;
+    int width = (int)header.dwWidth, height = (int)header.dwHeight;
+    const unsigned int levels = std::max(1u, header.dwMipMapCount);
+    for (unsigned int i = 0; i < levels; i++)
+    {
+        CookedLevel level;
+        level.width = width;
+        level.height = height;
+        level.offset = total;
+        level.size = levelSize(cooked.format, width, height);
+        total += level.size;
+        cooked.levels.push_back(level);
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+    }
+    cooked.data.resize(total);
+    if (!file.read(reinterpret_cast<char*>(cooked.data.data()), total))
+    {
+        std::cout << "ERROR::TEXTURE_COOKER::TRUNCATED_DDS: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+std::string cookedTexturePath(const std::string& cacheDirectory, std::uint64_t contentHash, int quality)
+{
+    const std::uint64_t key = hashBytes(&quality, sizeof(quality), contentHash);
+    return cacheDirectory + "/" + hashToHex(hashString(TEXTURE_COOKER_VERSION, key)) + ".dds";
+}
+
+CookResult cookTextureFile(const std::string& path, const std::string& cacheDirectory, CookedTexture& cooked,
+    int quality)
+{
+    std::vector<unsigned char> bytes;
+    if (!readFile(path, bytes))
+        return COOK_FAILED;
+    const std::string cachePath = cookedTexturePath(cacheDirectory, hashBytes(bytes.data(), bytes.size()), quality);
+    if (loadDDS(cachePath, cooked))
+        return COOK_FROM_CACHE;
+
+    int width = 0, height = 0, components = 0;
+    unsigned char* pixels = stbi_load_from_memory(bytes.data(), (int)bytes.size(), &width, &height, &components, 0);
+    if (!pixels)
+        return COOK_FAILED;
+    const bool cookable = cookImage(pixels, width, height, components, cooked, quality);
+    stbi_image_free(pixels);
+    if (!cookable)
+        return COOK_FAILED;
+
+    std::error_code error;
+    std::filesystem::create_directories(cacheDirectory, error);
+    saveDDS(cachePath, cooked);
+    return COOK_ENCODED;
+}
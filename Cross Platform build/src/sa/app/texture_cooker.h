@@ -0,0 +1,69 @@
+#ifndef TEXTURE_COOKER_H
+#define TEXTURE_COOKER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <image_DXT.h>
+
+// S3TC formats, from GL_EXT_texture_compression_s3tc (not in the core headers)
+const unsigned int GL_COMPRESSED_RGB_DXT1 = 0x83F0;
+const unsigned int GL_COMPRESSED_RGBA_DXT5 = 0x83F3;
+
+// bump when the encoder or the mip filter changes, so cached textures are cooked again
+const char* const TEXTURE_COOKER_VERSION = "dxt-box-mips-2";
+
+struct CookedLevel
+{
+    int width = 0, height = 0;
+    std::size_t offset = 0;     // into CookedTexture::data
+    std::size_t size = 0;
+};
+
+// a DXT1 or DXT5 texture with its whole mip chain, finest level first, in one block
+struct CookedTexture
+{
+    unsigned int format = 0;    // GL_COMPRESSED_RGB_DXT1 or GL_COMPRESSED_RGBA_DXT5
+    std::vector<CookedLevel> levels;
+    std::vector<unsigned char> data;
+};
+
+// Texture cooker: turns an RGB(A) image into DXT1 (opaque) or DXT5 (with alpha) with a
+// box-filtered mip chain down to 1x1, using the bundled encoder (includes/image_DXT.c).
+// Each level is compressed in bands of block rows, one jobSystem() job per band, each
+// encoding its rows in place with convert_image_rows_to_DXT(). `quality` is one of the
+// DXT_QUALITY_* levels: FAST fits the block's bounding box, NORMAL its principal axis,
+// HIGH also refines the endpoints by least squares (about 3x NORMAL's time).
+//
+// Cooked textures are kept in a cache directory as DDS files named after a hash of the
+// source file's bytes (and TEXTURE_COOKER_VERSION): an edited image gets a new entry,
+// and the same image under another name reuses the old one. The texture_cook tool fills
+// the cache offline; TextureManager cooks whatever it misses on first load.
+//
+// Only 3- and 4-channel images are cooked; grey and grey-alpha images would change how
+// they sample, so they stay uncompressed.
+bool cookImage(const unsigned char* pixels, int width, int height, int components, CookedTexture& cooked,
+    int quality = DXT_QUALITY_NORMAL);
+
+// DDS files with a DXT1/DXT5 FourCC and a mip count, the form the cache stores
+bool saveDDS(const std::string& path, const CookedTexture& cooked);
+bool loadDDS(const std::string& path, CookedTexture& cooked);
+
+enum CookResult
+{
+    COOK_FAILED,        // unreadable file, or an image cookImage() does not take
+    COOK_FROM_CACHE,
+    COOK_ENCODED        // encoded now and written to the cache
+};
+
+// the cooked form of the image file at `path`, from `cacheDirectory` if it is there
+CookResult cookTextureFile(const std::string& path, const std::string& cacheDirectory, CookedTexture& cooked,
+    int quality = DXT_QUALITY_NORMAL);
+
+// the cache entry an image with these bytes, cooked at `quality`, is stored under
+std::string cookedTexturePath(const std::string& cacheDirectory, std::uint64_t contentHash,
+    int quality = DXT_QUALITY_NORMAL);
+
+#endif
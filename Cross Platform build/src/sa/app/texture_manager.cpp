@@ -0,0 +1,506 @@
+#include "texture_manager.h"
+
+#include <stb_image.h>
+
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+
+#include "content_hash.h"
+#include "mapped_file.h"
+#include "profiler.h"
+#include "render_counters.h"
+
+namespace
+{
+    // row starts in the ring are kept on this boundary, more than any driver asks of an
+    // unpack offset
+    const std::size_t STAGING_ALIGNMENT = 256;
+    const GLuint64 FENCE_TIMEOUT = 1000000000ull;   // ns; only finish() and release() wait
+
+    GLenum formatFor(int components)
+    {
+        if (components == 1)
+            return GL_RED;
+        if (components == 2)
+            return GL_RG;
+        if (components == 3)
+            return GL_RGB;
+        return GL_RGBA;
+    }
+
+    void setSampling()
+    {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+
+    bool hasExtension(const char* name)
+    {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; i++)
+        {
+            const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+            if (extension && std::strcmp(extension, name) == 0)
+                return true;
+        }
+        return false;
+    }
+}
+
+TextureManager::~TextureManager()
+{
+    // the GL context is gone by now; only the decodes and their memory are cleaned up
+    jobSystem().wait(decodes);
+    for (auto& entry : byTexture)
+        stbi_image_free(entry.second->pixels);
+    for (std::unique_ptr<Request>& request : orphans)
+        stbi_image_free(request->pixels);
+}
+
+bool TextureManager::setCompression(const std::string& directory)
+{
+    if (!hasExtension("GL_EXT_texture_compression_s3tc"))
+    {
+        std::cout << "ERROR::TEXTURE_MANAGER::NO_S3TC: textures are loaded uncompressed" << std::endl;
+        cacheDirectory.clear();
+        return false;
+    }
+    cacheDirectory = directory;
+    return true;
+}
+
+unsigned int TextureManager::load(const std::string& path)
+{
+    stats.requests++;
+    std::error_code error;
+    const std::filesystem::path absolute = std::filesystem::absolute(path, error);
+    const std::string key = (error ? std::filesystem::path(path) : absolute).lexically_normal().generic_string();
+    auto found = byPath.find(key);
+    if (found != byPath.end())
+    {
+        stats.duplicates++;
+        found->second->references++;
+        return found->second->texture;
+    }
+
+    // the same bytes under another name (a copy, or a link) share the texture too
+    std::uint64_t contentHash = 0;
+    if (contentHashing)
+    {
+        MappedFile file;
+        if (file.open(path))
+        {
+            contentHash = hashBytes(file.data(), file.size());
+            auto same = byContent.find(contentHash);
+            if (same != byContent.end())
+            {
+                Request* shared = same->second;
+                shared->keys.push_back(key);
+                shared->references++;
+                byPath[key] = shared;
+                stats.duplicates++;
+                stats.contentDuplicates++;
+                return shared->texture;
+            }
+        }
+    }
+
+    std::unique_ptr<Request> request(new Request());
+    request->path = path;
+    request->keys.push_back(key);
+    request->contentHash = contentHash;
+    request->references = 1;
+    glGenTextures(1, &request->texture);
+    glBindTexture(GL_TEXTURE_2D, request->texture);
+    const unsigned char placeholder[4] = { 128, 128, 128, 255 };
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+    setSampling();
+    request->residentBytes = textureBytes(1, 1, 4, false);
+    trackTextureBytes(request->residentBytes);
+
+    Request* pending = request.get();
+    byPath[key] = pending;
+    if (contentHash != 0)
+        byContent[contentHash] = pending;
+    uploadQueue.push_back(pending);
+    byTexture[pending->texture] = std::move(request);
+
+    const std::string cache = cacheDirectory;
+    jobSystem().run([pending, cache]()
+    {
+        PROFILE_SCOPE("decode texture");
+        if (!cache.empty())
+        {
+            CookResult result = cookTextureFile(pending->path, cache, pending->cooked);
+            if (result != COOK_FAILED)
+            {
+                pending->fromCache = result == COOK_FROM_CACHE;
+                pending->state.store(DECODED, std::memory_order_release);
+                return;
+            }
+            // grey images, or a file that cannot be read: the plain path reports the latter
+            pending->cooked.levels.clear();
+        }
+        // stb_image keeps its decoder state on the stack; only stbi_failure_reason() is shared
+        // between threads, and it is never read
+        pending->pixels = stbi_load(pending->path.c_str(), &pending->width, &pending->height, &pending->components, 0);
+        pending->state.store(pending->pixels ? DECODED : FAILED, std::memory_order_release);
+    }, &decodes, JOB_BACKGROUND);
+    return pending->texture;
+}
+
+void TextureManager::addReference(unsigned int texture)
+{
+    auto found = byTexture.find(texture);
+    if (found != byTexture.end())
+        found->second->references++;
+}
+
+void TextureManager::unload(unsigned int texture)
+{
+    auto found = byTexture.find(texture);
+    if (found == byTexture.end())
+        return;
+    Request* request = found->second.get();
+    if (--request->references > 0)
+        return;
+
+    for (const std::string& key : request->keys)
+        byPath.erase(key);
+    if (request->contentHash != 0)
+        byContent.erase(request->contentHash);
+    for (auto it = uploadQueue.begin(); it != uploadQueue.end(); ++it)
+    {
+        if (*it == request)
+        {
+            uploadQueue.erase(it);
+            break;
+        }
+    }
+    glDeleteTextures(1, &request->texture);
+    trackTextureBytes(-request->residentBytes);
+    stats.evictions++;
+    // a running decode still writes to the request; it is freed once that is done
+    if (request->state.load(std::memory_order_acquire) == DECODING)
+        orphans.push_back(std::move(found->second));
+    else
+        stbi_image_free(request->pixels);
+    byTexture.erase(found);
+}
+
+unsigned int TextureManager::getReferences(unsigned int texture) const
+{
+    auto found = byTexture.find(texture);
+    return found != byTexture.end() ? found->second->references : 0;
+}
+
+void TextureManager::freeOrphans()
+{
+    for (auto it = orphans.begin(); it != orphans.end();)
+    {
+        if ((*it)->state.load(std::memory_order_acquire) == DECODING)
+        {
+            ++it;
+            continue;
+        }
+        stbi_image_free((*it)->pixels);
+        it = orphans.erase(it);
+    }
+}
+
+void TextureManager::update()
+{
+    if (!orphans.empty())
+        freeOrphans();
+    if (uploadQueue.empty())
+    {
+        retireStaging(false);
+        return;
+    }
+    PROFILE_SCOPE("texture uploads");
+    uploadPending(TEXTURE_UPLOAD_BUDGET, false);
+}
+
+void TextureManager::finish()
+{
+    jobSystem().wait(decodes);
+    uploadPending(0, true);
+}
+
+bool TextureManager::isReady(unsigned int texture) const
+{
+    auto found = byTexture.find(texture);
+    return found != byTexture.end() && found->second->state.load(std::memory_order_acquire) == READY;
+}
+
+unsigned int TextureManager::getPending() const
+{
+    unsigned int pending = 0;
+    for (const Request* request : uploadQueue)
+    {
+        if (request->state.load(std::memory_order_acquire) != FAILED)
+            pending++;
+    }
+    return pending;
+}
+
+unsigned int TextureManager::uploadPending(std::size_t budget, bool wait)
+{
+    retireStaging(false);
+    std::size_t spent = 0;
+    unsigned int uploaded = 0;
+    for (auto it = uploadQueue.begin(); it != uploadQueue.end();)
+    {
+        Request& request = **it;
+        const int state = request.state.load(std::memory_order_acquire);
+        if (state == DECODING)
+        {
+            ++it;
+            continue;
+        }
+        if (state == FAILED)
+        {
+            std::cout << "Texture failed to load at path: " << request.path << std::endl;
+            stats.failed++;
+            it = uploadQueue.erase(it);
+            continue;
+        }
+        // the budget is checked before an image, so one larger than it still goes through
+        if (budget != 0 && spent >= budget)
+            break;
+        const std::size_t size = request.cooked.levels.empty()
+            ? (std::size_t)request.width * request.height * request.components : request.cooked.data.size();
+        if (!(request.cooked.levels.empty() ? upload(request, wait) : uploadCompressed(request, wait)))
+            break;      // the ring is full of uploads the GPU has not read yet
+        spent += size;
+        uploaded++;
+        it = uploadQueue.erase(it);
+    }
+    return uploaded;
+}
+
+void TextureManager::createStaging()
+{
+    if (stagingBuffer != 0)
+        return;
+    glGenBuffers(1, &stagingBuffer);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stagingBuffer);
+    if (GLAD_GL_VERSION_4_4 && glBufferStorage)
+    {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_PIXEL_UNPACK_BUFFER, TEXTURE_STAGING_BYTES, nullptr, flags);
+        stagingMemory = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, TEXTURE_STAGING_BYTES, flags);
+    }
+    else
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, TEXTURE_STAGING_BYTES, nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    stats.persistentMapping = stagingMemory != nullptr;
+}
+
+bool TextureManager::upload(Request& request, bool wait)
+{
+    const std::size_t size = (std::size_t)request.width * request.height * request.components;
+    const GLenum format = formatFor(request.components);
+    createStaging();
+
+    glBindTexture(GL_TEXTURE_2D, request.texture);
+    // decoded rows are tightly packed
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    std::size_t offset = 0;
+    bool staged = false;
+    if (size <= TEXTURE_STAGING_BYTES)
+    {
+        if (!allocateStaging(size, wait, offset))
+        {
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+            return false;
+        }
+        staged = writeStaging(offset, request.pixels, size);
+    }
+    if (staged)
+    {
+        glTexImage2D(GL_TEXTURE_2D, 0, format, request.width, request.height, 0, format, GL_UNSIGNED_BYTE,
+            (const void*)offset);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        stagingInFlight.push_back({ offset, size, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) });
+        stats.streamedBytes += size;
+    }
+    else
+    {
+        glTexImage2D(GL_TEXTURE_2D, 0, format, request.width, request.height, 0, format, GL_UNSIGNED_BYTE, request.pixels);
+        stats.directBytes += size;
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    const long long resident = textureBytes(request.width, request.height, request.components, true);
+    trackTextureBytes(resident - request.residentBytes);
+    request.residentBytes = resident;
+
+    stbi_image_free(request.pixels);
+    request.pixels = nullptr;
+    request.state.store(READY, std::memory_order_release);
+    stats.uploads++;
+    return true;
+}
+
+bool TextureManager::uploadCompressed(Request& request, bool wait)
+{
+    const CookedTexture& cooked = request.cooked;
+    const std::size_t size = cooked.data.size();
+    createStaging();
+
+    glBindTexture(GL_TEXTURE_2D, request.texture);
+    const unsigned char* source = cooked.data.data();
+    std::size_t offset = 0;
+    if (size <= TEXTURE_STAGING_BYTES)
+    {
+        if (!allocateStaging(size, wait, offset))
+            return false;
+        if (writeStaging(offset, cooked.data.data(), size))
+            source = nullptr;
+    }
+    if (source)
+        stats.directBytes += size;
+    else
+        stats.streamedBytes += size;
+
+    // the whole chain is cooked, so no glGenerateMipmap
+    for (std::size_t i = 0; i < cooked.levels.size(); i++)
+    {
+        const CookedLevel& level = cooked.levels[i];
+        const void* data = source ? (const void*)(source + level.offset) : (const void*)(offset + level.offset);
+        glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)i, cooked.format, level.width, level.height, 0,
+            (GLsizei)level.size, data);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)cooked.levels.size() - 1);
+    if (!source)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        stagingInFlight.push_back({ offset, size, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) });
+    }
+
+    const CookedLevel& top = cooked.levels[0];
+    const int components = cooked.format == GL_COMPRESSED_RGBA_DXT5 ? 4 : 3;
+    trackTextureBytes((long long)size - request.residentBytes);
+    request.residentBytes = (long long)size;
+    stats.compressed++;
+    stats.cacheHits += request.fromCache ? 1 : 0;
+    stats.compressedBytes += size;
+    stats.uncompressedBytes += textureBytes(top.width, top.height, components, true);
+    stats.uploads++;
+
+    request.cooked.data = std::vector<unsigned char>();
+    request.state.store(READY, std::memory_order_release);
+    return true;
+}
+
+bool TextureManager::writeStaging(std::size_t offset, const void* data, std::size_t size)
+{
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stagingBuffer);
+    if (stagingMemory)
+    {
+        std::memcpy(stagingMemory + offset, data, size);
+        return true;
+    }
+    // the range was fenced free, so the driver need not synchronize the mapping
+    void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, offset, size,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if (!mapped)
+    {
+        // nothing was written: the caller uploads from client memory instead
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return false;
+    }
+    std::memcpy(mapped, data, size);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    return true;
+}
+
+bool TextureManager::allocateStaging(std::size_t size, bool wait, std::size_t& offset)
+{
+    for (;;)
+    {
+        std::size_t start = (stagingHead + STAGING_ALIGNMENT - 1) / STAGING_ALIGNMENT * STAGING_ALIGNMENT;
+        if (start + size > TEXTURE_STAGING_BYTES)
+            start = 0;      // wrap; the tail of the ring is skipped this time round
+        bool overlaps = false;
+        for (const StagingRange& range : stagingInFlight)
+        {
+            if (start < range.offset + range.size && range.offset < start + size)
+            {
+                overlaps = true;
+                break;
+            }
+        }
+        if (!overlaps)
+        {
+            offset = start;
+            stagingHead = start + size;
+            return true;
+        }
+        if (!wait || stagingInFlight.empty())
+            return false;
+        if (!retireStaging(true))
+        {
+            // the range may still be read: leave it fenced and the upload for later
+            std::cout << "ERROR::TEXTURE_MANAGER::FENCE_TIMEOUT: staging memory is still in use" << std::endl;
+            return false;
+        }
+    }
+}
+
+bool TextureManager::retireStaging(bool waitOldest)
+{
+    while (!stagingInFlight.empty())
+    {
+        StagingRange& oldest = stagingInFlight.front();
+        GLenum result = glClientWaitSync(oldest.fence, waitOldest ? GL_SYNC_FLUSH_COMMANDS_BIT : 0,
+            waitOldest ? FENCE_TIMEOUT : 0);
+        // a timeout or a failed wait keeps the range: the GPU may not have read it yet
+        if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+            return !waitOldest;
+        glDeleteSync(oldest.fence);
+        stagingInFlight.pop_front();
+        waitOldest = false;
+    }
+    return true;
+}
+
+void TextureManager::release()
+{
+    jobSystem().wait(decodes);
+    while (!stagingInFlight.empty())
+    {
+        glDeleteSync(stagingInFlight.front().fence);
+        stagingInFlight.pop_front();
+    }
+    if (stagingBuffer != 0)
+    {
+        if (stagingMemory)
+        {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stagingBuffer);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            stagingMemory = nullptr;
+        }
+        glDeleteBuffers(1, &stagingBuffer);
+        stagingBuffer = 0;
+    }
+    for (auto& entry : byTexture)
+    {
+        glDeleteTextures(1, &entry.second->texture);
+        trackTextureBytes(-entry.second->residentBytes);
+        stbi_image_free(entry.second->pixels);
+    }
+    freeOrphans();
+    byTexture.clear();
+    byPath.clear();
+    byContent.clear();
+    uploadQueue.clear();
+    stagingHead = 0;
+}
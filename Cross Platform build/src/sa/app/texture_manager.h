@@ -0,0 +1,200 @@
+#ifndef TEXTURE_MANAGER_H
+#define TEXTURE_MANAGER_H
+
+#include <glad/glad.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "job_system.h"
+#include "texture_cooker.h"
+
+const std::size_t TEXTURE_STAGING_BYTES = 32 << 20;    // pixel unpack ring shared by all uploads
+const std::size_t TEXTURE_UPLOAD_BUDGET = 8 << 20;     // bytes update() streams per frame
+
+// Asynchronous texture loading.
+// load() hands out the texture's GL name at once. Until the image is in, the texture holds
+// a 1x1 grey placeholder, so it can be bound and drawn with straight away. The file is
+// decoded by a JOB_BACKGROUND jobSystem() job. update(), once a frame on the GL thread, streams the
+// decoded images through a pixel unpack buffer and generates their mipmaps. Nothing waits
+// on the GPU: the copies go into a ring of staging memory fenced per upload. The ring is
+// persistently mapped where the driver has GL 4.4; otherwise each upload maps its range
+// unsynchronized.
+//
+// The manager is also the process-wide texture registry. Textures are keyed by normalized
+// absolute path, so a repeated path gets the texture already made for it, from any model,
+// and each file is decoded and resident once. Every load() takes a reference, which
+// unload() (or a TextureHandle) gives back; the last one deletes the texture, so its GPU
+// memory goes with its last user.
+//
+// Content hashing is opt-in. With setContentHashing() a new path is hashed too, and a
+// file with the same bytes as a loaded one shares its texture; that match has to be made
+// before load() returns the texture, so the file is read on the calling thread.
+//
+// With setCompression(), RGB(A) images are loaded as DXT1/DXT5 with their mip chain from
+// the cooked texture cache instead (see texture_cooker.h), and cooked there on a miss;
+// the upload is then glCompressedTexImage2D per level, and nothing is decoded at all.
+//
+// Every call but the decode jobs' work is made on the GL thread.
+class TextureManager
+{
+public:
+    struct Stats
+    {
+        unsigned int requests = 0;
+        unsigned int duplicates = 0;        // load() calls answered with an existing texture
+        unsigned int contentDuplicates = 0; // of those, found by content under another path
+        unsigned int evictions = 0;         // textures deleted by their last unload()
+        unsigned int uploads = 0;
+        unsigned int failed = 0;            // files that could not be decoded (they keep the placeholder)
+        unsigned long long streamedBytes = 0;   // through the staging ring
+        unsigned long long directBytes = 0;     // images larger than the ring, uploaded from client memory
+        bool persistentMapping = false;
+        unsigned int compressed = 0;        // uploaded as DXT
+        unsigned int cacheHits = 0;         // of those, loaded from the cooked texture cache
+        unsigned long long compressedBytes = 0;
+        unsigned long long uncompressedBytes = 0;   // what the compressed textures would take as RGB(A)
+    };
+
+    TextureManager() {}
+    ~TextureManager();
+    TextureManager(const TextureManager&) = delete;
+    TextureManager& operator=(const TextureManager&) = delete;
+
+    // GL thread, before the first load(): cook RGB(A) textures into `cacheDirectory` and load
+    // them compressed; returns false (and keeps loading uncompressed) without S3TC support
+    bool setCompression(const std::string& cacheDirectory);
+
+    // GL thread, before the first load(): also key textures by a hash of the file's bytes.
+    // load() then maps and hashes every new path before it returns, on the GL thread, which
+    // stalls the frame for a large file: for loading screens, not for streaming. Off by default.
+    void setContentHashing(bool enabled) { contentHashing = enabled; }
+
+    // the texture for `path`, showing the placeholder until the image has been uploaded;
+    // takes a reference to it
+    unsigned int load(const std::string& path);
+    // another reference to a loaded texture
+    void addReference(unsigned int texture);
+    // gives a reference back; the last one deletes the texture (a pending decode is dropped
+    // when it finishes). Unknown textures are ignored.
+    void unload(unsigned int texture);
+    unsigned int getReferences(unsigned int texture) const;
+    // textures currently registered
+    unsigned int getTextureCount() const { return (unsigned int)byTexture.size(); }
+    // uploads decoded images, up to TEXTURE_UPLOAD_BUDGET bytes
+    void update();
+    // waits for every decode and uploads everything (headless runs, where frames must not
+    // depend on how fast the decoding went)
+    void finish();
+    bool isReady(unsigned int texture) const;
+    // number of textures still showing their placeholder for a pending decode or upload
+    unsigned int getPending() const;
+
+    // deletes the textures and the staging ring, whatever their references; waits for
+    // outstanding decodes first
+    void release();
+
+    const Stats& getStats() const { return stats; }
+
+private:
+    enum State { DECODING, DECODED, FAILED, READY };
+
+    struct Request
+    {
+        std::string path;
+        std::vector<std::string> keys;      // every normalized path registered for it
+        std::uint64_t contentHash = 0;      // with content hashing only
+        unsigned int texture = 0;
+        unsigned int references = 0;
+        std::atomic<int> state{ DECODING };
+        unsigned char* pixels = nullptr;    // stbi_load result, freed after the upload
+        int width = 0, height = 0, components = 0;
+        CookedTexture cooked;               // used instead of `pixels` when it has levels
+        bool fromCache = false;
+        long long residentBytes = 0;        // counted in renderCounters().textureBytes
+    };
+
+    // a range of the staging ring the GPU may still be reading
+    struct StagingRange
+    {
+        std::size_t offset, size;
+        GLsync fence;
+    };
+
+    void createStaging();
+    bool upload(Request& request, bool wait);
+    bool uploadCompressed(Request& request, bool wait);
+    bool allocateStaging(std::size_t size, bool wait, std::size_t& offset);
+    // binds the staging buffer and copies `data` into the allocated range; false, with the
+    // buffer unbound again, when the range could not be mapped
+    bool writeStaging(std::size_t offset, const void* data, std::size_t size);
+    // frees the ranges whose fences have signalled, oldest first; with `waitOldest` it
+    // first waits (up to a second) for the oldest, and returns false if that never came
+    bool retireStaging(bool waitOldest);
+    unsigned int uploadPending(std::size_t budget, bool wait);
+    void freeOrphans();
+
+    std::unordered_map<unsigned int, std::unique_ptr<Request>> byTexture;   // owns the requests
+    std::unordered_map<std::string, Request*> byPath;
+    std::unordered_map<std::uint64_t, Request*> byContent;
+    std::vector<std::unique_ptr<Request>> orphans;  // unloaded while their decode was running
+    std::deque<Request*> uploadQueue;       // decoded or decoding, in request order
+    JobCounter decodes;
+    std::string cacheDirectory;             // empty: no compression
+    bool contentHashing = false;
+
+    unsigned int stagingBuffer = 0;
+    unsigned char* stagingMemory = nullptr; // persistent mapping, or null
+    std::size_t stagingHead = 0;
+    std::deque<StagingRange> stagingInFlight;
+    Stats stats;
+};
+
+// the process-wide texture manager; model.h loads through it too
+inline TextureManager& textureManager()
+{
+    static TextureManager manager;
+    return manager;
+}
+
+// One counted reference to a texture of textureManager(), given back when the handle goes.
+// Handles must be gone before the GL context is, unless textureManager().release() ran first.
+class TextureHandle
+{
+public:
+    TextureHandle() {}
+    // takes over a reference load() returned
+    explicit TextureHandle(unsigned int texture) : texture(texture) {}
+    TextureHandle(const TextureHandle& other) : texture(other.texture)
+    {
+        if (texture != 0)
+            textureManager().addReference(texture);
+    }
+    TextureHandle(TextureHandle&& other) noexcept : texture(other.texture) { other.texture = 0; }
+    TextureHandle& operator=(TextureHandle other)
+    {
+        std::swap(texture, other.texture);
+        return *this;
+    }
+    ~TextureHandle() { reset(); }
+
+    void reset()
+    {
+        if (texture != 0)
+            textureManager().unload(texture);
+        texture = 0;
+    }
+    unsigned int get() const { return texture; }
+
+private:
+    unsigned int texture = 0;
+};
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef UV_SPHERE_H
+#define UV_SPHERE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "gpu_mesh.h"
+#include "mesh_generator.h"
+#include "profiler.h"
+
+// UV sphere mesh resource shared by BlackHole and Sphere.
+// The three stages are kept apart: the constructor only generates the interleaved
+// V/N/T vertices and triangle indices on the CPU (see mesh_generator.h), upload() sends
+// them to the GPU once, and Draw() just binds and draws. The GPU buffers are owned by a GpuMesh, so a
+// sphere can be moved but never copied, and its buffers are freed exactly once.
+class UVSphere
+{
+public:
+    UVSphere(float radius, const glm::vec3& center, unsigned int xSegments = 64, unsigned int ySegments = 64)
+        : radius(radius), center(center), xSegments(xSegments), ySegments(ySegments)
+    {
+        generate();
+    }
+
+    UVSphere(UVSphere&&) = default;
+    UVSphere& operator=(UVSphere&&) = default;
+
+    // uploads the generated geometry; does nothing once the mesh is on the GPU
+    void upload()
+    {
+        if (mesh.isValid())
+            return;
+        mesh.upload(geometry.vertices.data(), (unsigned int)(geometry.vertices.size() * sizeof(float)),
+            geometry.indices.data(), (unsigned int)geometry.indices.size());
+    }
+
+    // draws the sphere, uploading it first if that hasn't happened yet
+    void Draw()
+    {
+        upload();
+        mesh.draw();
+    }
+
+    // frees the CPU copy once it is no longer needed; the GPU mesh stays valid
+    void releaseCpuData()
+    {
+        std::vector<float>().swap(geometry.vertices);
+        std::vector<unsigned int>().swap(geometry.indices);
+    }
+
+    const GpuMesh& getMesh() const { return mesh; }
+    const GeneratedMesh& getGeometry() const { return geometry; }
+    const std::vector<float>& getVertices() const { return geometry.vertices; }
+    const std::vector<unsigned int>& getIndices() const { return geometry.indices; }
+    float getRadius() const { return radius; }
+    const glm::vec3& getCenter() const { return center; }
+
+private:
+    void generate()
+    {
+        PROFILE_SCOPE("UVSphere::generate");
+        generateSphere(geometry, radius, (int)xSegments, (int)ySegments, AXIS_Y, center);
+    }
+
+    float radius;
+    glm::vec3 center;
+    unsigned int xSegments;
+    unsigned int ySegments;
+    GeneratedMesh geometry;
+    GpuMesh mesh;
+};
+
+#endif
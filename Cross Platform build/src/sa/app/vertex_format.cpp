@@ -0,0 +1,190 @@
+#include "vertex_format.h"
+
+#include <glad/glad.h>
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+    // the compact layouts, as stored
+    struct CompactVertex
+    {
+        float position[3];
+        std::uint32_t normal;           // 2 x snorm16, octahedral
+        std::uint32_t tangent;          // snorm 10/10/10/2: octahedral xy, unused z, sign in w
+        std::uint32_t texCoords;        // 2 x half or 2 x unorm16
+    };
+
+    struct CompactSkinnedVertex
+    {
+        CompactVertex base;
+        std::uint8_t boneIDs[MAX_BONE_INFLUENCE];
+        std::uint8_t weights[MAX_BONE_INFLUENCE];
+    };
+
+    float signNotZero(float v)
+    {
+        return v >= 0.0f ? 1.0f : -1.0f;
+    }
+
+    void packCompact(const Vertex& vertex, bool unormUVs, CompactVertex& out)
+    {
+        std::memcpy(out.position, &vertex.Position, sizeof(out.position));
+        out.normal = glm::packSnorm2x16(octahedralEncode(vertex.Normal));
+        // the handedness of the tangent frame: rebuilding the bitangent as
+        // cross(normal, tangent) gets it right up to this sign
+        const float handedness = signNotZero(glm::dot(glm::cross(vertex.Normal, vertex.Tangent), vertex.Bitangent));
+        out.tangent = glm::packSnorm3x10_1x2(glm::vec4(octahedralEncode(vertex.Tangent), 0.0f, handedness));
+        out.texCoords = unormUVs ? glm::packUnorm2x16(vertex.TexCoords) : glm::packHalf2x16(vertex.TexCoords);
+    }
+
+    // bone indices that do not fit a byte are clamped, weights rounded to sum to 255
+    void packSkin(const Vertex& vertex, CompactSkinnedVertex& out, bool& clamped)
+    {
+        float total = 0.0f;
+        for (int i = 0; i < MAX_BONE_INFLUENCE; i++)
+            total += std::max(0.0f, vertex.m_Weights[i]);
+        int sum = 0, largest = 0;
+        for (int i = 0; i < MAX_BONE_INFLUENCE; i++)
+        {
+            const int id = vertex.m_BoneIDs[i];
+            clamped |= id < 0 || id > 255;
+            out.boneIDs[i] = (std::uint8_t)std::min(255, std::max(0, id));
+            const float weight = total > 0.0f ? std::max(0.0f, vertex.m_Weights[i]) / total : 0.0f;
+            out.weights[i] = (std::uint8_t)std::lround(weight * 255.0f);
+            sum += out.weights[i];
+            if (out.weights[i] > out.weights[largest])
+                largest = i;
+        }
+        // the rounding error goes to the largest weight, so the weights still sum to one
+        if (total > 0.0f)
+            out.weights[largest] = (std::uint8_t)(out.weights[largest] + 255 - sum);
+    }
+}
+
+std::size_t vertexStride(unsigned int format)
+{
+    switch (vertexLayout(format))
+    {
+    case VERTEX_COMPACT:
+        return sizeof(CompactVertex);
+    case VERTEX_COMPACT_SKINNED:
+        return sizeof(CompactSkinnedVertex);
+    default:
+        return sizeof(Vertex);
+    }
+}
+
+unsigned int packVertices(const Vertex* vertices, std::size_t count, VertexLayout layout,
+    std::vector<unsigned char>& packed)
+{
+    packed.resize(count * vertexStride(layout));
+    if (layout == VERTEX_FULL)
+    {
+        std::memcpy(packed.data(), vertices, packed.size());
+        return VERTEX_FULL;
+    }
+
+    // unorm16 is 32 times finer than half floats near 1.0, but cannot tile
+    bool unormUVs = true;
+    for (std::size_t i = 0; i < count && unormUVs; i++)
+    {
+        const glm::vec2& uv = vertices[i].TexCoords;
+        unormUVs = uv.x >= 0.0f && uv.x <= 1.0f && uv.y >= 0.0f && uv.y <= 1.0f;
+    }
+
+    if (layout == VERTEX_COMPACT)
+    {
+        CompactVertex* out = reinterpret_cast<CompactVertex*>(packed.data());
+        for (std::size_t i = 0; i < count; i++)
+            packCompact(vertices[i], unormUVs, out[i]);
+    }
+    else
+    {
+        CompactSkinnedVertex* out = reinterpret_cast<CompactSkinnedVertex*>(packed.data());
+        bool clamped = false;
+        for (std::size_t i = 0; i < count; i++)
+        {
+            packCompact(vertices[i], unormUVs, out[i].base);
+            packSkin(vertices[i], out[i], clamped);
+        }
+        if (clamped)
+            std::cout << "ERROR::VERTEX_FORMAT::BONE_INDEX_OUT_OF_RANGE: bone indices above 255 were clamped" << std::endl;
+    }
+    return layout | (unormUVs ? VERTEX_UV_UNORM16 : 0);
+}
+
+void setVertexAttributes(unsigned int format)
+{
+    const VertexLayout layout = vertexLayout(format);
+    const GLsizei stride = (GLsizei)vertexStride(format);
+    if (layout == VERTEX_FULL)
+    {
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, Normal));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, TexCoords));
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, Tangent));
+        glEnableVertexAttribArray(4);
+        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, Bitangent));
+        glEnableVertexAttribArray(5);
+        glVertexAttribIPointer(5, 4, GL_INT, stride, (void*)offsetof(Vertex, m_BoneIDs));
+        glEnableVertexAttribArray(6);
+        glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, m_Weights));
+        return;
+    }
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(CompactVertex, position));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, stride, (void*)offsetof(CompactVertex, normal));
+    glEnableVertexAttribArray(2);
+    if (format & VERTEX_UV_UNORM16)
+        glVertexAttribPointer(2, 2, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)offsetof(CompactVertex, texCoords));
+    else
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)offsetof(CompactVertex, texCoords));
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)offsetof(CompactVertex, tangent));
+    glDisableVertexAttribArray(4);
+    if (layout == VERTEX_COMPACT_SKINNED)
+    {
+        glEnableVertexAttribArray(5);
+        glVertexAttribIPointer(5, 4, GL_UNSIGNED_BYTE, stride, (void*)offsetof(CompactSkinnedVertex, boneIDs));
+        glEnableVertexAttribArray(6);
+        glVertexAttribPointer(6, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*)offsetof(CompactSkinnedVertex, weights));
+    }
+    else
+    {
+        // no skinning data; shaders for this layout must not read attributes 5 and 6
+        glDisableVertexAttribArray(5);
+        glDisableVertexAttribArray(6);
+    }
+}
+
+glm::vec2 octahedralEncode(const glm::vec3& n)
+{
+    const float l1 = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+    if (l1 <= 0.0f)
+        return glm::vec2(0.0f);
+    glm::vec2 p = glm::vec2(n.x, n.y) / l1;
+    // the lower hemisphere folds over the diagonals
+    if (n.z < 0.0f)
+        p = glm::vec2((1.0f - std::fabs(p.y)) * signNotZero(p.x), (1.0f - std::fabs(p.x)) * signNotZero(p.y));
+    return p;
+}
+
+glm::vec3 octahedralDecode(const glm::vec2& e)
+{
+    glm::vec3 n(e.x, e.y, 1.0f - std::fabs(e.x) - std::fabs(e.y));
+    const float t = std::max(-n.z, 0.0f);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    return glm::normalize(n);
+}
@@ -0,0 +1,71 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#define MAX_BONE_INFLUENCE 4
+
+struct Vertex {
+    // position
+    glm::vec3 Position;
+    // normal
+    glm::vec3 Normal;
+    // texCoords
+    glm::vec2 TexCoords;
+    // tangent
+    glm::vec3 Tangent;
+    // bitangent
+    glm::vec3 Bitangent;
+	//bone indexes which will influence this vertex
+	int m_BoneIDs[MAX_BONE_INFLUENCE];
+	//weights from each bone
+	float m_Weights[MAX_BONE_INFLUENCE];
+};
+
+// How a Mesh stores its vertices on the GPU.
+// VERTEX_FULL uploads Vertex as declared above (88 bytes). The compact layouts keep the
+// float position and quantize the rest:
+//   normal      octahedral, 2 x snorm16
+//   tangent     octahedral, 10 + 10 bit snorm, with the bitangent's sign in the 2-bit w
+//               (the bitangent itself is rebuilt as cross(normal, tangent) * sign)
+//   texcoords   2 x unorm16 when every UV of the mesh lies in [0, 1], else 2 x half float
+//   bones       4 x uint8 indices and 4 x unorm8 weights (VERTEX_COMPACT_SKINNED only)
+// which is 24 bytes without skinning data and 32 with it. The attribute locations stay
+// those of VERTEX_FULL (0 position ... 6 weights); shaders decode the compact normal
+// and tangent when the `vertexLayout` uniform is not VERTEX_FULL (see model.vs).
+enum VertexLayout
+{
+    VERTEX_FULL = 0,
+    VERTEX_COMPACT = 1,             // static meshes: no bone data at all
+    VERTEX_COMPACT_SKINNED = 2
+};
+
+// flag on a packed vertex format (a VertexLayout in the low bits): UVs stored as unorm16
+const unsigned int VERTEX_UV_UNORM16 = 0x100;
+
+inline VertexLayout vertexLayout(unsigned int format)
+{
+    return (VertexLayout)(format & 0xff);
+}
+
+// bytes per vertex of a packed format or layout
+std::size_t vertexStride(unsigned int format);
+
+// packs `count` vertices in `layout` into `packed` and returns the packed format
+// (the layout, plus VERTEX_UV_UNORM16 when the UVs allowed it). VERTEX_FULL is a copy.
+unsigned int packVertices(const Vertex* vertices, std::size_t count, VertexLayout layout,
+    std::vector<unsigned char>& packed);
+
+// points attributes 0-6 of the bound vertex array at the buffer bound to GL_ARRAY_BUFFER,
+// holding vertices of the packed `format`; attributes a layout lacks are disabled
+void setVertexAttributes(unsigned int format);
+
+// unit vector to octahedral coordinates in [-1, 1]^2 and back
+glm::vec2 octahedralEncode(const glm::vec3& n);
+glm::vec3 octahedralDecode(const glm::vec2& e);
+
+#endif
@@ -0,0 +1,372 @@
+// Benchmark for the DXT encoder in includes/image_DXT.c: megapixels per second and RMSE
+// against the source image, for the encoder it replaced (kept below, ported as it was),
+// each quality level on one thread, and NORMAL in bands of block rows across 1..N threads,
+// the way the texture cooker runs it. CPU only.
+//
+//   dxt_bench [IMAGE]     (a synthetic 2048x2048 image without one)
+
+#include <stb_image.h>
+#include <image_DXT.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "job_system.h"
+
+namespace
+{
+    const int SYNTHETIC_SIZE = 2048;
+
+    // The encoder before the rewrite: endpoints from the power method on the covariance
+    // matrix, indices by projecting each pixel onto the quantized endpoints' line.
+    int legacyBitRange(int c, int fromBits, int toBits)
+    {
+        int b = (1 << (fromBits - 1)) + c * ((1 << toBits) - 1);
+        return (b + (b >> fromBits)) >> fromBits;
+    }
+
+    int legacyTo565(int r, int g, int b)
+    {
+        return (legacyBitRange(r, 8, 5) << 11) | (legacyBitRange(g, 8, 6) << 5) | legacyBitRange(b, 8, 5);
+    }
+
+    void legacyFrom565(unsigned int c, int* rgb)
+    {
+        rgb[0] = legacyBitRange((c >> 11) & 31, 5, 8);
+        rgb[1] = legacyBitRange((c >> 5) & 63, 6, 8);
+        rgb[2] = legacyBitRange(c & 31, 5, 8);
+    }
+
+    void legacyColorBlock(const unsigned char* block, unsigned char* out)
+    {
+        float sum[3] = { 0.0f, 0.0f, 0.0f };
+        float rr = 0.0f, gg = 0.0f, bb = 0.0f, rg = 0.0f, rb = 0.0f, gb = 0.0f;
+        for (int i = 0; i < 16; i++)
+        {
+            const float r = block[i * 4], g = block[i * 4 + 1], b = block[i * 4 + 2];
+            sum[0] += r;
+            sum[1] += g;
+            sum[2] += b;
+            rr += r * r;
+            gg += g * g;
+            bb += b * b;
+            rg += r * g;
+            rb += r * b;
+            gb += g * b;
+        }
+        for (float& s : sum)
+            s *= 1.0f / 16.0f;
+        rr -= 16.0f * sum[0] * sum[0];
+        gg -= 16.0f * sum[1] * sum[1];
+        bb -= 16.0f * sum[2] * sum[2];
+        rg -= 16.0f * sum[0] * sum[1];
+        rb -= 16.0f * sum[0] * sum[2];
+        gb -= 16.0f * sum[1] * sum[2];
+        float axis[3] = { 1.0f, 2.718281828f, 3.141592654f };
+        for (int iteration = 0; iteration < 3; iteration++)
+        {
+            const float x = axis[0], y = axis[1], z = axis[2];
+            axis[0] = x * rr + y * rg + z * rb;
+            axis[1] = x * rg + y * gg + z * gb;
+            axis[2] = x * rb + y * gb + z * bb;
+        }
+        const float scale = 1.0f / (0.00001f + axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+        float dotMax = axis[0] * block[0] + axis[1] * block[1] + axis[2] * block[2], dotMin = dotMax;
+        for (int i = 1; i < 16; i++)
+        {
+            const float dot = axis[0] * block[i * 4] + axis[1] * block[i * 4 + 1] + axis[2] * block[i * 4 + 2];
+            if (dot < dotMin)
+                dotMin = dot;
+            else if (dot > dotMax)
+                dotMax = dot;
+        }
+        const float offset = axis[0] * sum[0] + axis[1] * sum[1] + axis[2] * sum[2];
+        dotMin = (dotMin - offset) * scale;
+        dotMax = (dotMax - offset) * scale;
+        int c0[3], c1[3];
+        for (int i = 0; i < 3; i++)
+        {
+            c0[i] = std::min(255, std::max(0, (int)(0.5f + sum[i] + dotMax * axis[i])));
+            c1[i] = std::min(255, std::max(0, (int)(0.5f + sum[i] + dotMin * axis[i])));
+        }
+        int e0 = legacyTo565(c0[0], c0[1], c0[2]), e1 = legacyTo565(c1[0], c1[1], c1[2]);
+        if (e0 < e1)
+            std::swap(e0, e1);
+        out[0] = e0 & 255;
+        out[1] = e0 >> 8;
+        out[2] = e1 & 255;
+        out[3] = e1 >> 8;
+        out[4] = out[5] = out[6] = out[7] = 0;
+
+        int p0[3], p1[3];
+        legacyFrom565(e0, p0);
+        legacyFrom565(e1, p1);
+        float line[3], length2 = 0.0f;
+        for (int i = 0; i < 3; i++)
+        {
+            line[i] = (float)(p1[i] - p0[i]);
+            length2 += line[i] * line[i];
+        }
+        if (length2 > 0.0f)
+            length2 = 1.0f / length2;
+        for (float& l : line)
+            l *= length2;
+        const float lineOffset = line[0] * p0[0] + line[1] * p0[1] + line[2] * p0[2];
+        static const int swizzle[] = { 0, 2, 3, 1 };
+        for (int i = 0; i < 16; i++)
+        {
+            const float dot = line[0] * block[i * 4] + line[1] * block[i * 4 + 1] + line[2] * block[i * 4 + 2] - lineOffset;
+            const int value = std::min(3, std::max(0, (int)(dot * 3.0f + 0.5f)));
+            out[4 + i / 4] |= swizzle[value] << ((i & 3) * 2);
+        }
+    }
+
+    void legacyAlphaBlock(const unsigned char* block, unsigned char* out)
+    {
+        int a0 = block[3], a1 = block[3];
+        for (int i = 1; i < 16; i++)
+        {
+            if (block[i * 4 + 3] > a0)
+                a0 = block[i * 4 + 3];
+            else if (block[i * 4 + 3] < a1)
+                a1 = block[i * 4 + 3];
+        }
+        out[0] = (unsigned char)a0;
+        out[1] = (unsigned char)a1;
+        for (int i = 2; i < 8; i++)
+            out[i] = 0;
+        static const int swizzle[] = { 1, 7, 6, 5, 4, 3, 2, 0 };
+        // a flat block divides by zero here, as it always did (the float result is harmless)
+        const float scale = 7.9999f / (a0 - a1);
+        for (int i = 0, bit = 16; i < 16; i++, bit += 3)
+        {
+            const int value = swizzle[(int)((block[i * 4 + 3] - a1) * scale) & 7];
+            out[bit >> 3] |= value << (bit & 7);
+            if ((bit & 7) > 5)
+                out[1 + (bit >> 3)] |= value >> (8 - (bit & 7));
+        }
+    }
+
+    // the old loops padded partial blocks with the block's first pixel
+    std::vector<unsigned char> legacyEncode(const unsigned char* pixels, int width, int height, int channels, bool dxt5)
+    {
+        const int blocksWide = (width + 3) / 4, blocksHigh = (height + 3) / 4;
+        std::vector<unsigned char> out((std::size_t)blocksWide * blocksHigh * (dxt5 ? 16 : 8));
+        unsigned char* next = out.data();
+        const int step = channels < 3 ? 0 : 1;
+        for (int by = 0; by < blocksHigh; by++)
+        {
+            for (int bx = 0; bx < blocksWide; bx++)
+            {
+                unsigned char block[64];
+                for (int i = 0; i < 16; i++)
+                {
+                    const int x = bx * 4 + (i & 3), y = by * 4 + i / 4;
+                    if (x >= width || y >= height)
+                    {
+                        std::copy(block, block + 4, block + i * 4);
+                        continue;
+                    }
+                    const unsigned char* p = pixels + ((std::size_t)y * width + x) * channels;
+                    block[i * 4] = p[0];
+                    block[i * 4 + 1] = p[step];
+                    block[i * 4 + 2] = p[2 * step];
+                    block[i * 4 + 3] = (channels & 1) ? 255 : p[channels - 1];
+                }
+                if (dxt5)
+                {
+                    legacyAlphaBlock(block, next);
+                    next += 8;
+                }
+                legacyColorBlock(block, next);
+                next += 8;
+            }
+        }
+        return out;
+    }
+
+    // reference DXT decoder (4 color mode only, which both encoders always write)
+    void decodeColorBlock(const unsigned char* in, unsigned char* rgba, int stride)
+    {
+        const int e0 = in[0] | (in[1] << 8), e1 = in[2] | (in[3] << 8);
+        int palette[4][3];
+        for (int k = 0; k < 2; k++)
+        {
+            const int e = k == 0 ? e0 : e1, r = (e >> 11) & 31, g = (e >> 5) & 63, b = e & 31;
+            palette[k][0] = (r << 3) | (r >> 2);
+            palette[k][1] = (g << 2) | (g >> 4);
+            palette[k][2] = (b << 3) | (b >> 2);
+        }
+        for (int c = 0; c < 3; c++)
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        for (int i = 0; i < 16; i++)
+        {
+            const int index = (in[4 + i / 4] >> ((i & 3) * 2)) & 3;
+            unsigned char* p = rgba + (i / 4) * stride + (i & 3) * 4;
+            p[0] = (unsigned char)palette[index][0];
+            p[1] = (unsigned char)palette[index][1];
+            p[2] = (unsigned char)palette[index][2];
+        }
+    }
+
+    void decodeAlphaBlock(const unsigned char* in, unsigned char* rgba, int stride)
+    {
+        int values[8] = { in[0], in[1] };
+        for (int k = 1; k < 7; k++)
+            values[k + 1] = in[0] > in[1] ? ((7 - k) * in[0] + k * in[1]) / 7 : 0;
+        unsigned long long bits = 0;
+        for (int i = 0; i < 6; i++)
+            bits |= (unsigned long long)in[2 + i] << (8 * i);
+        for (int i = 0; i < 16; i++)
+            rgba[(i / 4) * stride + (i & 3) * 4 + 3] = (unsigned char)values[(bits >> (3 * i)) & 7];
+    }
+
+    // root mean square error per channel of the decoded image against the source
+    double rmse(const std::vector<unsigned char>& compressed, const unsigned char* pixels, int width, int height,
+        int channels, bool dxt5)
+    {
+        const int blocksWide = (width + 3) / 4, blocksHigh = (height + 3) / 4, stride = blocksWide * 16;
+        std::vector<unsigned char> decoded((std::size_t)stride * blocksHigh * 4, 255);
+        const unsigned char* block = compressed.data();
+        for (int by = 0; by < blocksHigh; by++)
+        {
+            for (int bx = 0; bx < blocksWide; bx++)
+            {
+                unsigned char* target = &decoded[(std::size_t)by * 4 * stride + bx * 16];
+                if (dxt5)
+                {
+                    decodeAlphaBlock(block, target, stride);
+                    block += 8;
+                }
+                decodeColorBlock(block, target, stride);
+                block += 8;
+            }
+        }
+        const int compared = dxt5 ? 4 : 3;
+        double sum = 0.0;
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                const unsigned char* source = pixels + ((std::size_t)y * width + x) * channels;
+                const unsigned char* result = &decoded[(std::size_t)y * stride + x * 4];
+                for (int c = 0; c < compared; c++)
+                {
+                    const int expected = c < 3 ? source[channels < 3 ? 0 : c] : ((channels & 1) ? 255 : source[channels - 1]);
+                    sum += (double)(result[c] - expected) * (result[c] - expected);
+                }
+            }
+        }
+        return std::sqrt(sum / ((double)width * height * compared));
+    }
+
+    // best time in milliseconds over enough runs to fill ~0.5 s (at least 2)
+    template <typename Function>
+    double measure(Function function)
+    {
+        double best = 1e30, total = 0.0;
+        for (int run = 0; run < 2 || (total < 500.0 && run < 100); run++)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            function();
+            double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+            best = std::min(best, elapsed);
+            total += elapsed;
+        }
+        return best;
+    }
+
+    // smooth gradients, hard edges and noise, with an alpha ramp
+    std::vector<unsigned char> syntheticImage(int size)
+    {
+        std::vector<unsigned char> pixels((std::size_t)size * size * 4);
+        unsigned int seed = 12345;
+        for (int y = 0; y < size; y++)
+        {
+            for (int x = 0; x < size; x++)
+            {
+                seed = seed * 1664525u + 1013904223u;
+                const int noise = (int)(seed >> 28) - 8;
+                unsigned char* p = &pixels[((std::size_t)y * size + x) * 4];
+                const bool stripe = ((x / 37) + (y / 53)) & 1;
+                p[0] = (unsigned char)std::min(255, std::max(0, x * 255 / size + noise));
+                p[1] = (unsigned char)std::min(255, std::max(0, (stripe ? 200 : 40) + noise));
+                p[2] = (unsigned char)(127.5 + 127.5 * std::sin(x * 0.013 + y * 0.021));
+                p[3] = (unsigned char)(y * 255 / size);
+            }
+        }
+        return pixels;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int width = SYNTHETIC_SIZE, height = SYNTHETIC_SIZE, channels = 4;
+    std::vector<unsigned char> image;
+    if (argc > 1)
+    {
+        unsigned char* loaded = stbi_load(argv[1], &width, &height, &channels, 0);
+        if (!loaded)
+        {
+            std::printf("cannot load %s\n", argv[1]);
+            return 1;
+        }
+        image.assign(loaded, loaded + (std::size_t)width * height * channels);
+        stbi_image_free(loaded);
+    }
+    else
+        image = syntheticImage(SYNTHETIC_SIZE);
+    const unsigned char* pixels = image.data();
+    const double megapixels = (double)width * height * 1e-6;
+    const int blockRows = (height + 3) / 4;
+    std::printf("%s: %d x %d, %d channels\n\n", argc > 1 ? argv[1] : "synthetic", width, height, channels);
+
+    const char* qualityNames[] = { "fast", "normal", "high" };
+    const unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+    for (int dxt5 = 0; dxt5 < 2; dxt5++)
+    {
+        const std::size_t size = (std::size_t)((width + 3) / 4) * blockRows * (dxt5 ? 16 : 8);
+        std::vector<unsigned char> compressed(size);
+        std::printf("%s encoder           threads        ms      MP/s     RMSE\n", dxt5 ? "DXT5" : "DXT1");
+
+        double legacyMs = measure([&]() { compressed = legacyEncode(pixels, width, height, channels, dxt5 != 0); });
+        std::printf("     legacy            %7u %9.2f %9.1f %8.3f\n", 1u, legacyMs, megapixels * 1000.0 / legacyMs,
+            rmse(compressed, pixels, width, height, channels, dxt5 != 0));
+
+        for (int quality = DXT_QUALITY_FAST; quality <= DXT_QUALITY_HIGH; quality++)
+        {
+            double ms = measure([&]()
+            {
+                convert_image_rows_to_DXT(pixels, width, height, channels, dxt5, quality, 0, blockRows, compressed.data());
+            });
+            std::printf("     %-17s %7u %9.2f %9.1f %8.3f\n", qualityNames[quality], 1u, ms, megapixels * 1000.0 / ms,
+                rmse(compressed, pixels, width, height, channels, dxt5 != 0));
+        }
+
+        // bands of block rows as jobs, like the texture cooker
+        for (unsigned int threads = 1; threads <= cores; threads++)
+        {
+            jobSystem().create(threads - 1);
+            double ms = measure([&]()
+            {
+                jobSystem().parallelFor((unsigned int)blockRows, 0, [&](unsigned int first, unsigned int last)
+                {
+                    convert_image_rows_to_DXT(pixels, width, height, channels, dxt5, DXT_QUALITY_NORMAL, (int)first,
+                        (int)(last - first), compressed.data());
+                });
+            });
+            jobSystem().release();
+            std::printf("     normal, banded    %7u %9.2f %9.1f %8.1fx\n", threads, ms, megapixels * 1000.0 / ms, legacyMs / ms);
+        }
+        std::printf("\n");
+    }
+    return 0;
+}
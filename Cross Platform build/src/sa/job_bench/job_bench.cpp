@@ -0,0 +1,85 @@
+// Micro-benchmark for the job system: what one job costs to schedule and run, and how a
+// compute-bound parallelFor scales from one thread to every core. CPU only.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "job_system.h"
+
+namespace
+{
+    const unsigned int EMPTY_JOBS = 100000;
+    const unsigned int WORK_ITEMS = 1 << 18;
+
+    // best time in milliseconds over enough runs to fill ~0.2 s (at least 3)
+    template <typename Function>
+    double measure(Function function)
+    {
+        double best = 1e30, total = 0.0;
+        for (int run = 0; run < 3 || (total < 200.0 && run < 1000); run++)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            function();
+            double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+            best = std::min(best, elapsed);
+            total += elapsed;
+        }
+        return best;
+    }
+
+    // enough arithmetic per item that the loop is compute bound, not memory bound
+    float work(unsigned int item)
+    {
+        float x = (float)item * 0.001f;
+        for (int i = 0; i < 32; i++)
+            x = std::sin(x) * 0.5f + std::cos(x * 1.1f);
+        return x;
+    }
+}
+
+int main()
+{
+    const unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<float> results(WORK_ITEMS);
+    double single = 0.0;
+
+    std::printf("threads  empty job ns  submit+wait ms  parallelFor ms  speedup  steals\n");
+    for (unsigned int threads = 1; threads <= cores; threads++)
+    {
+        jobSystem().create(threads - 1);
+
+        // empty jobs: scheduling, stealing and counting with nothing to hide them behind
+        double empty = measure([&]()
+        {
+            JobCounter counter;
+            for (unsigned int i = 0; i < EMPTY_JOBS; i++)
+                jobSystem().run([]() {}, &counter);
+            jobSystem().wait(counter);
+        });
+
+        double loop = measure([&]()
+        {
+            jobSystem().parallelFor(WORK_ITEMS, 0, [&](unsigned int begin, unsigned int end)
+            {
+                for (unsigned int item = begin; item < end; item++)
+                    results[item] = work(item);
+            });
+        });
+        if (threads == 1)
+            single = loop;
+
+        std::printf("%7u %13.1f %15.3f %15.3f %7.2fx %7llu\n", threads, empty * 1e6 / EMPTY_JOBS, empty, loop,
+            single / loop, jobSystem().getStats().steals);
+        jobSystem().release();
+    }
+    // keeps the loop from being optimized away
+    double checksum = 0.0;
+    for (float result : results)
+        checksum += result;
+    std::printf("checksum %.3f\n", checksum);
+    return 0;
+}
@@ -0,0 +1,189 @@
+// Micro-benchmark for mesh generation: the original Cylinder and sphere builders
+// against mesh_generator, from 36 to 4096 sectors. Then what optimizeMesh() (the pass
+// Model runs on import) makes of the generated meshes' vertex cache behaviour, in their
+// own order and with the triangles shuffled, as an unordered export would have them.
+// Last, buildMeshlets() and a MeshletCuller frame on those meshes seen from outside.
+// CPU only, no window is opened.
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "Cylinder.h"
+#include "job_system.h"
+#include "mesh_generator.h"
+#include "mesh_optimizer.h"
+#include "meshlet.h"
+
+namespace
+{
+    // the sphere builder BlackHole/Sphere used before mesh_generator (push_back per attribute)
+    void legacySphere(unsigned int xSegments, unsigned int ySegments, std::vector<float>& data, std::vector<unsigned int>& indices)
+    {
+        const float PI = 3.14159265359f;
+        std::vector<glm::vec3> positions;
+        std::vector<glm::vec2> uv;
+        std::vector<glm::vec3> normals;
+        for (unsigned int x = 0; x <= xSegments; ++x)
+        {
+            for (unsigned int y = 0; y <= ySegments; ++y)
+            {
+                float xSegment = (float)x / (float)xSegments;
+                float ySegment = (float)y / (float)ySegments;
+                float xPos = std::cos(xSegment * 2.0f * PI) * std::sin(ySegment * PI);
+                float yPos = std::cos(ySegment * PI);
+                float zPos = std::sin(xSegment * 2.0f * PI) * std::sin(ySegment * PI);
+                positions.push_back(glm::vec3(xPos, yPos, zPos));
+                uv.push_back(glm::vec2(xSegment, ySegment));
+                normals.push_back(glm::vec3(xPos, yPos, zPos));
+            }
+        }
+        for (unsigned int y = 0; y < ySegments; ++y)
+        {
+            for (unsigned int x = 0; x <= xSegments; ++x)
+            {
+                indices.push_back(y * (xSegments + 1) + x);
+                indices.push_back((y + 1) * (xSegments + 1) + x);
+            }
+        }
+        for (unsigned int i = 0; i < positions.size(); ++i)
+        {
+            data.push_back(positions[i].x);
+            data.push_back(positions[i].y);
+            data.push_back(positions[i].z);
+            data.push_back(normals[i].x);
+            data.push_back(normals[i].y);
+            data.push_back(normals[i].z);
+            data.push_back(uv[i].x);
+            data.push_back(uv[i].y);
+        }
+    }
+
+    // best time in milliseconds over enough runs to fill ~0.2 s (at least 3)
+    template <typename Function>
+    double measure(Function function)
+    {
+        double best = 1e30, total = 0.0;
+        for (int run = 0; run < 3 || (total < 200.0 && run < 1000); run++)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            function();
+            double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+            best = std::min(best, elapsed);
+            total += elapsed;
+        }
+        return best;
+    }
+
+    void report(const char* shape, int sectors, int stacks, double vertices, double before, double after)
+    {
+        if (before > 0.0)
+            std::printf("%-9s %5d x %-5d %9.0f %10.3f %10.3f %8.1fx %8.1f\n", shape, sectors, stacks, vertices,
+                before, after, before / after, vertices / after / 1000.0);
+        else
+            std::printf("%-9s %5d x %-5d %9.0f %10s %10.3f %9s %8.1f\n", shape, sectors, stacks, vertices,
+                "-", after, "-", vertices / after / 1000.0);
+    }
+
+    void reportOptimization(const char* shape, const GeneratedMesh& mesh, bool shuffle)
+    {
+        std::vector<unsigned int> indices = mesh.indices;
+        if (shuffle)
+        {
+            std::vector<unsigned int> order(indices.size() / 3);
+            for (unsigned int i = 0; i < order.size(); i++)
+                order[i] = i;
+            std::shuffle(order.begin(), order.end(), std::mt19937(1));
+            for (unsigned int i = 0; i < order.size(); i++)
+                std::copy(&mesh.indices[order[i] * 3], &mesh.indices[order[i] * 3] + 3, &indices[i * 3]);
+        }
+        std::vector<float> vertices = mesh.vertices;
+        MeshOptimizationStats stats;
+        auto start = std::chrono::high_resolution_clock::now();
+        optimizeMesh(indices.data(), indices.size(), vertices.data(), mesh.getVertexCount(), 8 * sizeof(float), &stats);
+        double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        std::printf("%-9s %-8s %9llu %6.3f -> %5.3f %6.3f -> %5.3f %9.2f\n", shape, shuffle ? "shuffled" : "as built",
+            stats.before.triangles, stats.before.getACMR(), stats.after.getACMR(), stats.before.getATVR(),
+            stats.after.getATVR(), elapsed);
+    }
+
+    // meshlets of the optimized mesh, culled for a camera at `eye` looking at the origin
+    void reportMeshlets(const char* shape, const GeneratedMesh& mesh, const glm::vec3& eye)
+    {
+        std::vector<unsigned int> indices = mesh.indices;
+        std::vector<float> vertices = mesh.vertices;
+        const std::size_t vertexCount = optimizeMesh(indices.data(), indices.size(), vertices.data(), mesh.getVertexCount(),
+            8 * sizeof(float));
+        std::vector<Meshlet> meshlets;
+        double build = measure([&]() { buildMeshlets(indices.data(), indices.size(), vertices.data(), 8 * sizeof(float), vertexCount, meshlets); });
+
+        MeshletCuller culler;
+        culler.setMeshlets(meshlets.data(), meshlets.size());
+        const glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+        const glm::mat4 view = glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        const MeshletView meshletView = makeMeshletView(projection, view, glm::mat4(1.0f));
+        unsigned int draws = 0;
+        double cull = measure([&]() { draws = culler.cull(meshletView, 4); });
+        std::printf("%-9s %9zu %8zu %9.2f %9.1f %8.1f%% %6u\n", shape, indices.size() / 3, meshlets.size(), build,
+            cull * 1000.0, 100.0 * culler.getVisibleIndices() / indices.size(), draws);
+    }
+}
+
+int main()
+{
+    // large meshes sweep their rings as jobs, as in the app
+    jobSystem().create();
+    std::printf("shape     sectors x stacks  vertices  before ms   after ms  speedup  Mvert/s\n");
+    const int sectorCounts[] = { 36, 64, 128, 256, 512, 1024, 2048, 4096 };
+    for (int sectors : sectorCounts)
+    {
+        // a quarter as many stacks as sectors keeps the rings roughly square on a long tube
+        const int stacks = std::max(1, sectors / 4);
+        GeneratedMesh mesh;
+
+        // with every optional output, i.e. the work Cylinder used to do on each build
+        double before = measure([&]()
+        {
+            Cylinder cylinder(1.5f, 1.5f, 100.0f, sectors, stacks, true, CYLINDER_SEPARATE_ARRAYS | CYLINDER_LINE_INDICES);
+        });
+        double after = measure([&]() { GeneratedMesh fresh; generateCylinder(fresh, 1.5f, 1.5f, 100.0f, sectors, stacks); mesh = std::move(fresh); });
+        report("cylinder", sectors, stacks, mesh.getVertexCount(), before, after);
+
+        before = measure([&]()
+        {
+            std::vector<float> data;
+            std::vector<unsigned int> indices;
+            legacySphere(sectors, stacks * 2, data, indices);
+        });
+        after = measure([&]() { GeneratedMesh fresh; generateSphere(fresh, 1.4f, sectors, stacks * 2); mesh = std::move(fresh); });
+        report("sphere", sectors, stacks * 2, mesh.getVertexCount(), before, after);
+
+        after = measure([&]() { GeneratedMesh fresh; generateWormholeThroat(fresh, 1.5f, 100.0f, sectors, stacks); mesh = std::move(fresh); });
+        report("wormhole", sectors, stacks, mesh.getVertexCount(), 0.0, after);
+    }
+    std::printf("generator threads at 4096 x 1024: %u\n", meshGeneratorThreads(1025, 4097));
+
+    std::printf("\nvertex cache: FIFO of %u\n", VERTEX_CACHE_SIZE);
+    std::printf("shape     order    triangles  ACMR before/after  ATVR before/after  optimize ms\n");
+    GeneratedMesh sphere, cylinder;
+    generateSphere(sphere, 1.4f, 64, 32);
+    generateCylinder(cylinder, 1.5f, 1.5f, 100.0f, 512, 128);
+    for (bool shuffle : { false, true })
+    {
+        reportOptimization("sphere", sphere, shuffle);
+        reportOptimization("cylinder", cylinder, shuffle);
+    }
+
+    std::printf("\nmeshlets: at most %u vertices, %u triangles\n", MESHLET_MAX_VERTICES, MESHLET_MAX_TRIANGLES);
+    std::printf("shape     triangles meshlets  build ms   cull us  visible  draws\n");
+    reportMeshlets("sphere", sphere, glm::vec3(0.0f, 0.0f, 6.0f));
+    reportMeshlets("cylinder", cylinder, glm::vec3(20.0f, 0.0f, 0.0f));
+    return 0;
+}
@@ -0,0 +1,437 @@
+// End-to-end check and timing of the model loading path in model.h: Assimp import,
+// optimizeMesh(), buildMeshlets() and the mesh cache write, then the same model mapped
+// back from the cache. Loads the model given on the command line, or writes a sample
+// scene (a sphere under 65536 vertices, a grid over and a flat shaded sphere, sharing one
+// texture) and loads that, in each vertex layout. Checks that:
+//   - the cached load uploads the same vertex and index buffers as the import
+//   - meshes under 65536 vertices get 16-bit indices, larger ones 32-bit
+//   - two models of one file share their textures, which go with the last of them
+//   - meshlet culling draws fewer triangles than a full draw, and the same pixels
+//     for the imported and the cached model
+//   - the sample's meshes, the flat shaded one too, are not cut into tiny meshlets
+// Needs a GL context: headless through EGL where the build has it, otherwise a hidden
+// window. Run it from bin/sa, where model.vs and model.fs are. Exits non-zero if a
+// check fails.
+//
+//   model_bench [MODEL]
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "headless_context.h"
+#include "image_writer.h"
+#include "job_system.h"
+#include "mesh_generator.h"
+#include "model.h"
+#include "offscreen_target.h"
+#include "render_counters.h"
+#include "texture_manager.h"
+
+namespace
+{
+    const int TARGET_SIZE = 512;
+    // removed before and after the run, so the first load of each layout imports
+    const char* const CACHE_DIRECTORY = "model_bench_cache";
+    const char* const SAMPLE_DIRECTORY = "model_bench_sample";
+
+    int failures = 0;
+
+    void check(bool passed, const char* what)
+    {
+        if (!passed)
+        {
+            std::printf("FAILED: %s\n", what);
+            ++failures;
+        }
+    }
+
+    double millisecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // a flat square in the xz plane of cells x cells quads, laid out like GeneratedMesh
+    void generateGrid(GeneratedMesh& mesh, float size, int cells)
+    {
+        for (int z = 0; z <= cells; z++)
+            for (int x = 0; x <= cells; x++)
+            {
+                const float u = (float)x / cells, v = (float)z / cells;
+                const float vertex[8] = { (u - 0.5f) * size, -1.0f, (v - 0.5f) * size, 0.0f, 1.0f, 0.0f, u * 8.0f, v * 8.0f };
+                mesh.vertices.insert(mesh.vertices.end(), vertex, vertex + 8);
+            }
+        for (int z = 0; z < cells; z++)
+            for (int x = 0; x < cells; x++)
+            {
+                const unsigned int corner = z * (cells + 1) + x;
+                const unsigned int quad[6] = { corner, corner + cells + 1, corner + 1, corner + 1, corner + cells + 1, corner + cells + 2 };
+                mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+            }
+    }
+
+    // OBJ indices run over the whole file; positions and texture coordinates go in pairs
+    struct ObjCounts
+    {
+        unsigned int positions = 0, normals = 0;
+    };
+
+    // `flat`: one normal per face, so that no two faces share a vertex
+    void writeObject(std::ofstream& out, const char* name, const GeneratedMesh& mesh, bool flat, ObjCounts& counts)
+    {
+        out << "o " << name << "\nusemtl checker\n";
+        for (unsigned int i = 0; i < mesh.getVertexCount(); i++)
+        {
+            const float* vertex = &mesh.vertices[i * 8];
+            out << "v " << vertex[0] << ' ' << vertex[1] << ' ' << vertex[2] << '\n';
+            out << "vt " << vertex[6] << ' ' << vertex[7] << '\n';
+            if (!flat)
+                out << "vn " << vertex[3] << ' ' << vertex[4] << ' ' << vertex[5] << '\n';
+        }
+        for (std::size_t i = 0; i < mesh.indices.size(); i += 3)
+        {
+            if (flat)
+            {
+                const glm::vec3 a = glm::make_vec3(&mesh.vertices[mesh.indices[i] * 8]);
+                const glm::vec3 b = glm::make_vec3(&mesh.vertices[mesh.indices[i + 1] * 8]);
+                const glm::vec3 c = glm::make_vec3(&mesh.vertices[mesh.indices[i + 2] * 8]);
+                const glm::vec3 normal = glm::normalize(glm::cross(b - a, c - a) + glm::vec3(0.0f, 1e-9f, 0.0f));
+                out << "vn " << normal.x << ' ' << normal.y << ' ' << normal.z << '\n';
+            }
+            out << 'f';
+            for (std::size_t j = 0; j < 3; j++)
+            {
+                const unsigned int index = counts.positions + mesh.indices[i + j] + 1;
+                const unsigned int normal = flat ? counts.normals + (unsigned int)(i / 3) + 1 : counts.normals + mesh.indices[i + j] + 1;
+                out << ' ' << index << '/' << index << '/' << normal;
+            }
+            out << '\n';
+        }
+        counts.positions += mesh.getVertexCount();
+        counts.normals += flat ? mesh.getTriangleCount() : mesh.getVertexCount();
+    }
+
+    // scene.obj: a sphere small enough for 16-bit indices, a grid too large for them and a
+    // flat shaded sphere, all with the material of checker.png; returns the path of the OBJ
+    std::string writeSampleScene()
+    {
+        std::filesystem::create_directories(SAMPLE_DIRECTORY);
+        const std::string directory = SAMPLE_DIRECTORY;
+
+        std::vector<unsigned char> checker(64 * 64 * 4);
+        for (int y = 0; y < 64; y++)
+            for (int x = 0; x < 64; x++)
+            {
+                unsigned char* pixel = &checker[(y * 64 + x) * 4];
+                const unsigned char value = ((x / 8 + y / 8) & 1) ? 230 : 40;
+                pixel[0] = value;
+                pixel[1] = value;
+                pixel[2] = 255 - value;
+                pixel[3] = 255;
+            }
+        if (!writePng(directory + "/checker.png", 64, 64, checker.data()))
+            return "";
+
+        std::ofstream material(directory + "/scene.mtl");
+        material << "newmtl checker\nKd 1 1 1\nmap_Kd checker.png\n";
+
+        // once Assimp has joined the face corners again the sphere has 33 x 17 vertices,
+        // the grid 261 x 261 (68121) and the flat sphere three per triangle
+        GeneratedMesh sphere, grid, facets;
+        generateSphere(sphere, 1.0f, 32, 16);
+        generateGrid(grid, 8.0f, 260);
+        generateSphere(facets, 1.0f, 32, 16, AXIS_Y, glm::vec3(2.5f, 0.0f, 0.0f));
+        std::ofstream scene(directory + "/scene.obj");
+        scene << "mtllib scene.mtl\n";
+        ObjCounts counts;
+        writeObject(scene, "sphere", sphere, false, counts);
+        writeObject(scene, "grid", grid, false, counts);
+        writeObject(scene, "facets", facets, true, counts);
+        return scene ? directory + "/scene.obj" : "";
+    }
+
+    // the whole buffer bound to `target`
+    void readBuffer(GLenum target, std::vector<unsigned char>& data)
+    {
+        GLint size = 0;
+        glGetBufferParameteriv(target, GL_BUFFER_SIZE, &size);
+        data.resize(size);
+        if (size > 0)
+            glGetBufferSubData(target, 0, size, data.data());
+    }
+
+    // a mesh's vertex and index buffers as the GPU has them, found through its vertex array
+    void readMesh(const Mesh& mesh, std::vector<unsigned char>& vertices, std::vector<unsigned char>& indices)
+    {
+        glBindVertexArray(mesh.VAO);
+        readBuffer(GL_ELEMENT_ARRAY_BUFFER, indices);
+        GLint buffer = 0;
+        glGetVertexAttribiv(0, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING, &buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        readBuffer(GL_ARRAY_BUFFER, vertices);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindVertexArray(0);
+    }
+
+    // the bounding sphere of the model's positions, a float3 at the start of every layout's vertex
+    void findBounds(Model& model, glm::vec3& center, float& radius)
+    {
+        glm::vec3 low(1e30f), high(-1e30f);
+        std::vector<unsigned char> vertices, indices;
+        for (const Mesh& mesh : model.meshes)
+        {
+            readMesh(mesh, vertices, indices);
+            const std::size_t stride = vertexStride(mesh.vertexFormat);
+            for (std::size_t offset = 0; offset + stride <= vertices.size(); offset += stride)
+            {
+                glm::vec3 position;
+                std::memcpy(&position, &vertices[offset], sizeof(position));
+                low = glm::min(low, position);
+                high = glm::max(high, position);
+            }
+        }
+        center = (low + high) * 0.5f;
+        radius = glm::max(glm::length(high - low) * 0.5f, 0.001f);
+    }
+
+    // the imported model against the one mapped from the cache, mesh by mesh
+    void compareModels(Model& imported, Model& cached, unsigned int& shortMeshes, unsigned int& intMeshes)
+    {
+        check(!imported.loadedFromCache, "the first load imports");
+        check(cached.loadedFromCache, "the second load maps the cache");
+        check(!imported.meshes.empty(), "the model has meshes");
+        check(imported.meshes.size() == cached.meshes.size(), "as many meshes from the cache");
+        check(imported.nodes.size() == cached.nodes.size(), "as many nodes from the cache");
+        std::vector<unsigned char> importedVertices, importedIndices, cachedVertices, cachedIndices;
+        for (std::size_t i = 0; i < imported.meshes.size() && i < cached.meshes.size(); i++)
+        {
+            const Mesh& a = imported.meshes[i];
+            const Mesh& b = cached.meshes[i];
+            readMesh(a, importedVertices, importedIndices);
+            readMesh(b, cachedVertices, cachedIndices);
+            check(a.indexCount == b.indexCount && a.indexType == b.indexType && a.vertexFormat == b.vertexFormat,
+                "cached mesh has the same index count, index type and vertex format");
+            check(importedVertices == cachedVertices, "cached mesh has the same vertex buffer");
+            check(importedIndices == cachedIndices, "cached mesh has the same index buffer");
+
+            const std::size_t vertexCount = importedVertices.size() / vertexStride(a.vertexFormat);
+            const GLenum expected = vertexCount < 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+            check(a.indexType == expected, "16-bit indices exactly for meshes under 65536 vertices");
+            check(importedIndices.size() == (std::size_t)a.indexCount * (a.indexType == GL_UNSIGNED_SHORT ? 2 : 4),
+                "index buffer holds indexCount indices of indexType");
+            if (a.indexType == GL_UNSIGNED_SHORT)
+                ++shortMeshes;
+            else
+                ++intMeshes;
+        }
+    }
+
+    struct DrawResult
+    {
+        unsigned long long fullTriangles = 0, culledTriangles = 0;
+        float fewestPerMeshlet = 0.0f;      // triangles per meshlet of the mesh with the smallest
+        unsigned int meshletsDrawn = 0, meshletsCulled = 0;
+        std::vector<unsigned char> pixels;
+    };
+
+    // the model in full, then meshlet culled from close by, where part of it is out of view
+    void drawModel(Model& model, Shader& shader, OffscreenTarget& target, const glm::vec3& center, float radius, DrawResult& result)
+    {
+        const glm::vec3 eye = center + glm::vec3(0.0f, 0.4f, 1.2f) * radius;
+        const glm::mat4 projection = glm::perspective(glm::radians(45.0f), 1.0f, radius * 0.01f, radius * 10.0f);
+        const glm::mat4 view = glm::lookAt(eye, center, glm::vec3(0.0f, 1.0f, 0.0f));
+        const glm::mat4 identity(1.0f);
+
+        target.bind();
+        glEnable(GL_DEPTH_TEST);
+        shader.use();
+        shader.setMat4("projection", projection);
+        shader.setMat4("view", view);
+        shader.setMat4("model", identity);
+        shader.setVec3("lightDirection", glm::normalize(glm::vec3(0.3f, 1.0f, 0.5f)));
+        shader.setVec3("ambient", glm::vec3(0.2f));
+        shader.setBool("hasNormalMap", false);
+
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        renderCounters().beginFrame();
+        model.Draw(shader);
+        result.fullTriangles = renderCounters().triangles;
+
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        renderCounters().beginFrame();
+        model.Draw(shader, makeMeshletView(projection, view, identity));
+        result.culledTriangles = renderCounters().triangles;
+        result.meshletsDrawn = renderCounters().meshletsDrawn;
+        result.meshletsCulled = renderCounters().meshletsCulled;
+        target.readPixels(result.pixels);
+
+        // and mesh by mesh, for how many meshlets each was cut into
+        result.fewestPerMeshlet = FLT_MAX;
+        for (Mesh& mesh : model.meshes)
+        {
+            renderCounters().beginFrame();
+            mesh.Draw(shader, makeMeshletView(projection, view, identity));
+            const unsigned int meshlets = renderCounters().meshletsDrawn + renderCounters().meshletsCulled;
+            if (meshlets > 0)
+                result.fewestPerMeshlet = std::min(result.fewestPerMeshlet, (float)(mesh.indexCount / 3) / meshlets);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    const char* layoutName(VertexLayout layout)
+    {
+        return layout == VERTEX_FULL ? "full" : layout == VERTEX_COMPACT ? "compact" : "skinned";
+    }
+
+    // `sample`: the model is the sample scene, which has meshes of both index sizes and a texture
+    void run(const std::string& path, bool sample, VertexLayout layout, Shader& shader, OffscreenTarget& target)
+    {
+        const TextureManager::Stats texturesBefore = textureManager().getStats();
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        Model* imported = new Model(path, false, layout, CACHE_DIRECTORY);
+        const double importTime = millisecondsSince(start);
+        start = std::chrono::steady_clock::now();
+        Model* cached = new Model(path, false, layout, CACHE_DIRECTORY);
+        const double cacheTime = millisecondsSince(start);
+        textureManager().finish();
+
+        unsigned int shortMeshes = 0, intMeshes = 0;
+        compareModels(*imported, *cached, shortMeshes, intMeshes);
+        if (sample)
+        {
+            check(shortMeshes > 0 && intMeshes > 0, "the sample scene has 16-bit and 32-bit meshes");
+            check(imported->textures_loaded.size() == 1, "the sample scene's meshes share one texture");
+        }
+
+        // one texture object per file for both models, referenced by each
+        check(imported->textures_loaded.size() == cached->textures_loaded.size(), "both models load the same textures");
+        bool shared = true;
+        for (std::size_t i = 0; i < imported->textures_loaded.size() && i < cached->textures_loaded.size(); i++)
+            shared = shared && imported->textures_loaded[i].id == cached->textures_loaded[i].id
+                && textureManager().getReferences(imported->textures_loaded[i].id) == 2;
+        check(shared, "the models share their textures, one reference each");
+        const TextureManager::Stats& texturesAfter = textureManager().getStats();
+        check(texturesAfter.requests - texturesBefore.requests - (texturesAfter.duplicates - texturesBefore.duplicates)
+            == imported->textures_loaded.size(), "every texture file is decoded once");
+
+        glm::vec3 center;
+        float radius;
+        findBounds(*imported, center, radius);
+        DrawResult importedDraw, cachedDraw;
+        drawModel(*imported, shader, target, center, radius, importedDraw);
+        drawModel(*cached, shader, target, center, radius, cachedDraw);
+        check(glGetError() == GL_NO_ERROR, "drawing raises no GL error");
+        check(importedDraw.culledTriangles < importedDraw.fullTriangles, "meshlet culling draws fewer triangles");
+        check(importedDraw.culledTriangles == cachedDraw.culledTriangles && importedDraw.meshletsDrawn == cachedDraw.meshletsDrawn,
+            "the cached meshlets cull as the imported ones");
+        check(importedDraw.pixels == cachedDraw.pixels, "the cached model renders the same pixels");
+        if (sample)
+            check(importedDraw.fewestPerMeshlet >= 8.0f, "every mesh of the sample scene has 8 triangles or more per meshlet");
+
+        std::printf("%-8s %6zu %6u %6u %10.2f %9.2f %7.1fx %10llu %9llu %8u %7u %9.1f\n", layoutName(layout), imported->meshes.size(),
+            shortMeshes, intMeshes, importTime, cacheTime, importTime / (cacheTime > 0.0 ? cacheTime : 1e-3),
+            importedDraw.fullTriangles, importedDraw.culledTriangles, importedDraw.meshletsDrawn, importedDraw.meshletsCulled,
+            importedDraw.fewestPerMeshlet);
+
+        std::vector<unsigned int> textures;
+        for (const Texture& texture : imported->textures_loaded)
+            textures.push_back(texture.id);
+        delete imported;
+        bool kept = true;
+        for (unsigned int texture : textures)
+            kept = kept && textureManager().getReferences(texture) == 1 && glIsTexture(texture);
+        check(kept, "the textures stay while a model still uses them");
+        delete cached;
+        bool released = true;
+        for (unsigned int texture : textures)
+            released = released && textureManager().getReferences(texture) == 0 && !glIsTexture(texture);
+        check(released, "the last model deletes its textures");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    // texture decodes run as jobs, as in the app
+    jobSystem().create();
+
+    HeadlessContext headlessContext;
+    GLFWwindow* window = NULL;
+    if (HeadlessContext::isSupported())
+    {
+        if (!headlessContext.create(3, 3))
+            return -1;
+    }
+    else
+    {
+        glfwInit();
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+#ifdef __APPLE__
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+        window = glfwCreateWindow(TARGET_SIZE, TARGET_SIZE, "model_bench", NULL, NULL);
+        if (window == NULL)
+        {
+            std::cout << "Failed to create GLFW window" << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        glfwMakeContextCurrent(window);
+        if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+        {
+            std::cout << "Failed to initialize GLAD" << std::endl;
+            return -1;
+        }
+    }
+
+    const std::string path = argc > 1 ? argv[1] : writeSampleScene();
+    if (path.empty())
+    {
+        std::cout << "ERROR::MODEL_BENCH::SAMPLE_NOT_WRITTEN: " << SAMPLE_DIRECTORY << std::endl;
+        return -1;
+    }
+    std::error_code error;
+    std::filesystem::remove_all(CACHE_DIRECTORY, error);
+
+    {
+        OffscreenTarget target;
+        if (!target.create(TARGET_SIZE, TARGET_SIZE))
+            return -1;
+        Shader shader("model.vs", "model.fs");
+        std::printf("%s\n", path.c_str());
+        std::printf("layout   meshes 16-bit 32-bit  import ms  cache ms speedup  triangles    culled meshlets  culled  min tris\n");
+        const VertexLayout layouts[] = { VERTEX_FULL, VERTEX_COMPACT };
+        for (VertexLayout layout : layouts)
+            run(path, argc <= 1, layout, shader, target);
+    }
+
+    std::filesystem::remove_all(CACHE_DIRECTORY, error);
+    if (argc <= 1)
+        std::filesystem::remove_all(SAMPLE_DIRECTORY, error);
+    textureManager().release();
+    if (window)
+        glfwTerminate();
+
+    if (failures > 0)
+    {
+        std::printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    std::printf("all checks passed\n");
+    return 0;
+}
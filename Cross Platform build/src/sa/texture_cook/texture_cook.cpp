@@ -0,0 +1,88 @@
+// Offline texture cooker: fills the cooked texture cache the app loads DXT textures from
+// (see src/sa/app/texture_cooker.h), so not even the first run has to encode them.
+// Run it from the app's working directory, or pass --cache with the app's cache path.
+// --fast and --high pick the encoder quality; the app loads what was cooked at the
+// default (normal) quality, so those are for trying the trade-off out.
+//
+//   texture_cook [--cache DIR] [--fast|--high] FILE|DIRECTORY...
+
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "job_system.h"
+#include "texture_cooker.h"
+
+namespace
+{
+    bool isImage(const std::filesystem::path& path)
+    {
+        std::string extension = path.extension().string();
+        for (char& c : extension)
+            c = (char)std::tolower((unsigned char)c);
+        return extension == ".png" || extension == ".jpg" || extension == ".jpeg" || extension == ".tga" ||
+            extension == ".bmp" || extension == ".psd";
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string cacheDirectory = "texture_cache";
+    int quality = DXT_QUALITY_NORMAL;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--cache") == 0 && i + 1 < argc)
+        {
+            cacheDirectory = argv[++i];
+            continue;
+        }
+        if (std::strcmp(argv[i], "--fast") == 0 || std::strcmp(argv[i], "--high") == 0)
+        {
+            quality = argv[i][2] == 'f' ? DXT_QUALITY_FAST : DXT_QUALITY_HIGH;
+            continue;
+        }
+        std::error_code error;
+        if (std::filesystem::is_directory(argv[i], error))
+        {
+            for (const auto& entry : std::filesystem::recursive_directory_iterator(argv[i], error))
+            {
+                if (entry.is_regular_file() && isImage(entry.path()))
+                    files.push_back(entry.path().generic_string());
+            }
+        }
+        else
+            files.push_back(argv[i]);
+    }
+    if (files.empty())
+    {
+        std::printf("usage: %s [--cache DIR] [--fast|--high] FILE|DIRECTORY...\n", argv[0]);
+        return 1;
+    }
+
+    // each level is compressed in bands across every core
+    jobSystem().create();
+    std::printf("%-48s %-5s %11s %7s  %s\n", "file", "fmt", "bytes", "ms", "result");
+    unsigned int failed = 0;
+    for (const std::string& file : files)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        CookedTexture cooked;
+        CookResult result = cookTextureFile(file, cacheDirectory, cooked, quality);
+        double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        if (result == COOK_FAILED)
+        {
+            std::printf("%-48s %-5s %11s %7.1f  not cooked (unreadable, or not RGB/RGBA)\n", file.c_str(), "-", "-", elapsed);
+            failed++;
+            continue;
+        }
+        std::printf("%-48s %-5s %11zu %7.1f  %s\n", file.c_str(), cooked.format == GL_COMPRESSED_RGBA_DXT5 ? "DXT5" : "DXT1",
+            cooked.data.size(), elapsed, result == COOK_FROM_CACHE ? "already cached" : "cooked");
+    }
+    jobSystem().release();
+    return failed == files.size() ? 1 : 0;
+}